@@ -0,0 +1,88 @@
+#ifndef BENCH_INPUTS_HPP
+#define BENCH_INPUTS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "diffreader.hpp"
+#include "embedding_matrix.hpp"
+#include "synthetic_diff.hpp"
+
+using namespace std;
+
+// commands/gcommit/test.diff, the one real diff in the tree
+inline const string& testDiff() {
+  static const string diff = [] {
+    ifstream file(GCOMMIT_TEST_DIFF);
+    stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+  }();
+  return diff;
+}
+
+inline vector<DiffChunk> parseDiff(const string& diff) {
+  istringstream in(diff);
+  DiffReader reader(in);
+  reader.ingestDiff();
+  return reader.getChunks();
+}
+
+// n unit vectors drawn around sqrt(n) random centers, so clustering has
+// structure to find
+inline EmbeddingMatrix randomEmbeddings(size_t n, size_t dim, uint64_t seed = 7) {
+  mt19937_64 rng(seed);
+  normal_distribution<float> gauss;
+  size_t num_centers = max<size_t>(1, static_cast<size_t>(sqrt(static_cast<double>(n))));
+  EmbeddingMatrix centers(num_centers, dim);
+  for (float& v : centers.data) v = gauss(rng);
+  centers.normalizeRows();
+
+  EmbeddingMatrix data(n, dim);
+  for (size_t i = 0; i < n; i++) {
+    const float* center = centers.row(rng() % num_centers);
+    float* row = data.row(i);
+    for (size_t j = 0; j < dim; j++) row[j] = center[j] + 0.05f * gauss(rng);
+  }
+  data.normalizeRows();
+  return data;
+}
+
+// An /v1/embeddings response body for `count` inputs of width `dim`, with
+// vectors either as JSON arrays or base64 float32 (encoding_format=base64)
+inline string embeddingsResponse(size_t count, size_t dim, bool base64, uint64_t seed = 3) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  EmbeddingMatrix vectors = randomEmbeddings(count, dim, seed);
+  string body = "{\"object\":\"list\",\"data\":[";
+  for (size_t i = 0; i < count; i++) {
+    body += (i ? "," : "") + string("{\"object\":\"embedding\",\"index\":") + to_string(i) + ",\"embedding\":";
+    if (base64) {
+      string bytes(dim * sizeof(float), '\0');
+      memcpy(bytes.data(), vectors.row(i), bytes.size());
+      string encoded;
+      for (size_t b = 0; b < bytes.size(); b += 3) {
+        uint32_t chunk = static_cast<uint8_t>(bytes[b]) << 16;
+        if (b + 1 < bytes.size()) chunk |= static_cast<uint8_t>(bytes[b + 1]) << 8;
+        if (b + 2 < bytes.size()) chunk |= static_cast<uint8_t>(bytes[b + 2]);
+        encoded += alphabet[(chunk >> 18) & 63];
+        encoded += alphabet[(chunk >> 12) & 63];
+        encoded += b + 1 < bytes.size() ? alphabet[(chunk >> 6) & 63] : '=';
+        encoded += b + 2 < bytes.size() ? alphabet[chunk & 63] : '=';
+      }
+      body += "\"" + encoded + "\"}";
+    } else {
+      body += "[";
+      for (size_t j = 0; j < dim; j++) body += (j ? "," : "") + to_string(vectors.row(i)[j]);
+      body += "]}";
+    }
+  }
+  body += "],\"model\":\"text-embedding-3-small\",\"usage\":{\"prompt_tokens\":0,\"total_tokens\":0}}";
+  return body;
+}
+
+#endif // BENCH_INPUTS_HPP
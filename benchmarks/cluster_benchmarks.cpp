@@ -0,0 +1,55 @@
+#include <benchmark/benchmark.h>
+#include "bench_inputs.hpp"
+#include "distance.hpp"
+#include "hdbscan.hpp"
+#include "utils.hpp"
+
+static void BM_CosSim(benchmark::State& state) {
+  size_t dim = state.range(0);
+  EmbeddingMatrix data = randomEmbeddings(1024, dim);
+  size_t i = 0;
+  for (auto _ : state) {
+    float sim = cos_sim(span<const float>(data.row(i % 1024), dim), span<const float>(data.row((i + 1) % 1024), dim));
+    benchmark::DoNotOptimize(sim);
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CosSim)->Arg(256)->Arg(512)->Arg(1536);
+
+static void BM_ParseEmbedding(benchmark::State& state) {
+  string response = embeddingsResponse(1, state.range(0), false);
+  for (auto _ : state) {
+    vector<float> embedding = parse_embedding(response);
+    benchmark::DoNotOptimize(embedding.data());
+  }
+  state.SetBytesProcessed(state.iterations() * response.size());
+}
+BENCHMARK(BM_ParseEmbedding)->Arg(256)->Arg(1536);
+
+// A full batch as gcommit requests it: base64 float32 vectors
+static void BM_ParseEmbeddingsBase64(benchmark::State& state) {
+  size_t count = state.range(0);
+  string response = embeddingsResponse(count, 256, true);
+  for (auto _ : state) {
+    vector<vector<float>> embeddings = parse_embeddings(response, count);
+    benchmark::DoNotOptimize(embeddings.data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.SetBytesProcessed(state.iterations() * response.size());
+}
+BENCHMARK(BM_ParseEmbeddingsBase64)->Arg(64)->Arg(2048);
+
+// Exact distance matrix up to 4096 rows, HNSW k-NN graph above
+static void BM_HDBSCANFit(benchmark::State& state) {
+  EmbeddingMatrix data = randomEmbeddings(state.range(0), 256);
+  size_t clusters = 0;
+  for (auto _ : state) {
+    HDBSCANClustering hc(5, 2);
+    hc.fit(data);
+    clusters = hc.get_clusters().size();
+  }
+  state.counters["clusters"] = static_cast<double>(clusters);
+  state.SetItemsProcessed(state.iterations() * data.rows);
+}
+BENCHMARK(BM_HDBSCANFit)->Arg(100)->Arg(1000)->Arg(5000)->Arg(20000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,64 @@
+#include <benchmark/benchmark.h>
+#include "ast.hpp"
+#include "bench_inputs.hpp"
+
+// Args are synthetic diff sizes in lines; 0 is commands/gcommit/test.diff
+const string& benchDiff(int64_t lines) {
+  static unordered_map<int64_t, string> diffs;
+  if (lines == 0) return testDiff();
+  auto found = diffs.find(lines);
+  if (found == diffs.end()) {
+    SyntheticDiffOptions options;
+    options.lines = static_cast<size_t>(lines);
+    found = diffs.emplace(lines, syntheticDiff(options)).first;
+  }
+  return found->second;
+}
+
+static void diffSizes(benchmark::internal::Benchmark* bench) {
+  bench->Arg(0)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+}
+
+static void BM_IngestDiff(benchmark::State& state) {
+  const string& diff = benchDiff(state.range(0));
+  for (auto _ : state) {
+    vector<DiffChunk> chunks = parseDiff(diff);
+    benchmark::DoNotOptimize(chunks.data());
+  }
+  state.SetBytesProcessed(state.iterations() * diff.size());
+}
+BENCHMARK(BM_IngestDiff)->Apply(diffSizes);
+
+static void BM_CreatePatches(benchmark::State& state) {
+  vector<DiffChunk> chunks = parseDiff(benchDiff(state.range(0)));
+  for (auto _ : state) {
+    vector<string> patches = createPatches(chunks);
+    benchmark::DoNotOptimize(patches.data());
+  }
+  state.SetItemsProcessed(state.iterations() * chunks.size());
+}
+BENCHMARK(BM_CreatePatches)->Apply(diffSizes);
+
+// The AST chunking step of gcommit's main loop: one parse per hunk, then
+// chunkDiff (or line chunking for files without a grammar)
+static void BM_ChunkDiff(benchmark::State& state) {
+  vector<DiffChunk> hunks = parseDiff(benchDiff(state.range(0)));
+  size_t produced = 0;
+  for (auto _ : state) {
+    produced = 0;
+    for (const DiffChunk& hunk : hunks) {
+      string content = combineContent(hunk);
+      string language = detectLanguage(hunk.filepath, hunk.start <= 1 ? content : "");
+      if (language != "text") {
+        ts::Tree tree = codeToTree(content, language);
+        produced += chunkDiff(tree.getRootNode(), hunk, language).size();
+      } else {
+        produced += chunkByLines(hunk).size();
+      }
+    }
+    benchmark::DoNotOptimize(produced);
+  }
+  state.counters["chunks"] = static_cast<double>(produced);
+  state.SetItemsProcessed(state.iterations() * hunks.size());
+}
+BENCHMARK(BM_ChunkDiff)->Arg(0)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
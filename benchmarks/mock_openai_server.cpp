@@ -0,0 +1,447 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <netinet/in.h>
+#include <nlohmann/json.hpp>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include "hashing.hpp"
+
+using json = nlohmann::json;
+using namespace std;
+
+// A local stand-in for api.openai.com, so the whole gcommit pipeline can be
+// load-tested offline. Responses depend only on the request body:
+// embeddings are feature-hashed from the input's words (similar inputs get
+// similar vectors, so clustering has real structure to find) and chat
+// completions are named after a hash of the messages. Latency, 429s,
+// chunked encoding and connection resets are drawn from a seeded RNG.
+//
+//   mock_openai_server --port 8443 --write-ca /tmp/mock-ca.pem --latency lognormal:80,0.5 --rate-limit 0.02
+//   OPENAI_BASE_URL=https://127.0.0.1:8443/v1 CUSTOM_GIT_OPENAI_CA=/tmp/mock-ca.pem git gcommit
+
+namespace {
+
+struct ServerOptions {
+  int port = 8443;
+  string cert_file;   // PEM certificate and key; a self-signed pair is
+  string key_file;    // generated when these are not given
+  string write_ca;    // where to write the generated certificate
+  string latency = "fixed:0";
+  double rate_limit = 0.0;  // fraction of requests answered with 429
+  double chunked = 0.5;     // fraction of responses sent chunked
+  double reset = 0.0;       // fraction of connections reset instead of answered
+  uint64_t seed = 1;
+  int verbose = 0;
+};
+
+struct ServerStats {
+  atomic<size_t> connections{0};
+  atomic<size_t> requests{0};
+  atomic<size_t> rate_limited{0};
+  atomic<size_t> resets{0};
+  atomic<size_t> chunked{0};
+};
+
+ServerOptions options;
+ServerStats stats;
+volatile sig_atomic_t stopping = 0;
+mutex rng_lock;
+mt19937_64 rng;
+
+// Delay before the response, in milliseconds: fixed:MS, uniform:MIN,MAX or
+// lognormal:MEDIAN,SIGMA
+class LatencyModel {
+private:
+  string kind;
+  double a = 0.0;
+  double b = 0.0;
+
+public:
+  explicit LatencyModel(const string& spec) {
+    size_t colon = spec.find(':');
+    kind = spec.substr(0, colon);
+    string params = colon == string::npos ? "" : spec.substr(colon + 1);
+    size_t comma = params.find(',');
+    a = params.empty() ? 0.0 : stod(params.substr(0, comma));
+    b = comma == string::npos ? 0.0 : stod(params.substr(comma + 1));
+    if (kind != "fixed" && kind != "uniform" && kind != "lognormal") {
+      throw invalid_argument("latency must be fixed:MS, uniform:MIN,MAX or lognormal:MEDIAN,SIGMA");
+    }
+  }
+
+  double sample(mt19937_64& gen) const {
+    if (kind == "uniform") return uniform_real_distribution<double>(a, max(a, b))(gen);
+    if (kind == "lognormal") return lognormal_distribution<double>(log(max(a, 1e-3)), b)(gen);
+    return a;
+  }
+};
+
+unique_ptr<LatencyModel> latency;
+
+// What to do with one request, decided up front so the RNG lock is held once
+struct Plan {
+  bool reset;
+  bool rate_limit;
+  bool chunked;
+  double delay_ms;
+};
+
+Plan planRequest() {
+  lock_guard<mutex> guard(rng_lock);
+  uniform_real_distribution<double> unit(0.0, 1.0);
+  Plan plan;
+  plan.reset = unit(rng) < options.reset;
+  plan.rate_limit = unit(rng) < options.rate_limit;
+  plan.chunked = unit(rng) < options.chunked;
+  plan.delay_ms = latency->sample(rng);
+  return plan;
+}
+
+vector<float> embedText(const string& text, size_t dim) {
+  vector<float> vec(dim, 0.0f);
+  auto add = [&](uint64_t hash, float weight) {
+    for (int k = 0; k < 4; k++) {
+      hash = splitmix64(hash);
+      vec[hash % dim] += (hash >> 63) ? weight : -weight;
+    }
+  };
+  size_t start = 0;
+  for (size_t i = 0; i <= text.size(); i++) {
+    if (i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_')) continue;
+    if (i > start) add(fnv1a64(string_view(text).substr(start, i - start)), 1.0f);
+    start = i + 1;
+  }
+  add(fnv1a64(text), 0.25f);
+
+  double norm = 0.0;
+  for (float v : vec) norm += static_cast<double>(v) * v;
+  norm = sqrt(norm);
+  for (float& v : vec) v = static_cast<float>(v / norm);
+  return vec;
+}
+
+string base64Floats(const vector<float>& vec) {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(vec.data());
+  int size = static_cast<int>(vec.size() * sizeof(float));
+  string encoded(4 * ((size + 2) / 3), '\0');
+  EVP_EncodeBlock(reinterpret_cast<unsigned char*>(encoded.data()), bytes, size);
+  return encoded;
+}
+
+json embeddingsResponse(const json& request) {
+  vector<string> inputs;
+  if (request["input"].is_string()) {
+    inputs.push_back(request["input"].get<string>());
+  } else {
+    inputs = request["input"].get<vector<string>>();
+  }
+  size_t dim = request.value("dimensions", 1536);
+  bool base64 = request.value("encoding_format", "float") == "base64";
+
+  json data = json::array();
+  size_t tokens = 0;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    vector<float> vec = embedText(inputs[i], max<size_t>(1, dim));
+    json item = {{"object", "embedding"}, {"index", i}};
+    if (base64) {
+      item["embedding"] = base64Floats(vec);
+    } else {
+      item["embedding"] = vec;
+    }
+    data.push_back(item);
+    tokens += inputs[i].size() / 4 + 1;
+  }
+  return {{"object", "list"}, {"data", data}, {"model", request.value("model", "text-embedding-3-small")},
+          {"usage", {{"prompt_tokens", tokens}, {"total_tokens", tokens}}}};
+}
+
+json chatResponse(const json& request) {
+  static const char* verbs[] = {"update", "refactor", "fix", "add", "remove", "rename", "extract", "simplify"};
+  uint64_t hash = fnv1a64(request["messages"].dump());
+  char id[32];
+  snprintf(id, sizeof(id), "%08llx", static_cast<unsigned long long>(hash & 0xffffffff));
+  string content = string(verbs[hash % 8]) + " mock change " + id;
+  return {{"id", string("chatcmpl-mock-") + id},
+          {"object", "chat.completion"},
+          {"model", request.value("model", "gpt-4o-mini")},
+          {"choices", {{{"index", 0},
+                        {"message", {{"role", "assistant"}, {"content", content}}},
+                        {"finish_reason", "stop"}}}},
+          {"usage", {{"prompt_tokens", 0}, {"completion_tokens", 0}, {"total_tokens", 0}}}};
+}
+
+bool writeAll(SSL* ssl, const string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    int n = SSL_write(ssl, data.data() + sent, static_cast<int>(data.size() - sent));
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+bool sendResponse(SSL* ssl, int status, const string& reason, const string& body, bool chunked,
+                  const string& extra_headers = "") {
+  string head = "HTTP/1.1 " + to_string(status) + " " + reason + "\r\n";
+  head += "Content-Type: application/json\r\n" + extra_headers;
+  if (!chunked) {
+    head += "Content-Length: " + to_string(body.size()) + "\r\n\r\n";
+    return writeAll(ssl, head + body);
+  }
+  head += "Transfer-Encoding: chunked\r\n\r\n";
+  if (!writeAll(ssl, head)) return false;
+  // Small chunks so chunk boundaries land mid-read on the client
+  for (size_t pos = 0; pos < body.size(); pos += 4096) {
+    string part = body.substr(pos, 4096);
+    char size[16];
+    snprintf(size, sizeof(size), "%zx\r\n", part.size());
+    if (!writeAll(ssl, size + part + "\r\n")) return false;
+  }
+  return writeAll(ssl, "0\r\n\r\n");
+}
+
+// Reads one request. Returns false on EOF or a malformed request.
+bool readRequest(SSL* ssl, string& buffer, string& request_line, string& headers, string& body) {
+  char chunk[16384];
+  size_t header_end;
+  while ((header_end = buffer.find("\r\n\r\n")) == string::npos) {
+    int n = SSL_read(ssl, chunk, sizeof(chunk));
+    if (n <= 0) return false;
+    buffer.append(chunk, n);
+  }
+  headers = buffer.substr(0, header_end + 2);
+  request_line = headers.substr(0, headers.find("\r\n"));
+  transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+
+  size_t content_length = 0;
+  size_t cl_pos = headers.find("content-length:");
+  if (cl_pos != string::npos) content_length = stoul(headers.substr(cl_pos + 15));
+  size_t body_start = header_end + 4;
+  while (buffer.size() < body_start + content_length) {
+    int n = SSL_read(ssl, chunk, sizeof(chunk));
+    if (n <= 0) return false;
+    buffer.append(chunk, n);
+  }
+  body = buffer.substr(body_start, content_length);
+  buffer.erase(0, body_start + content_length);
+  return true;
+}
+
+// Closes with a TCP RST instead of a TLS close_notify
+void resetConnection(int fd) {
+  linger hard = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_LINGER, &hard, sizeof(hard));
+  close(fd);
+}
+
+void serveConnection(SSL_CTX* ctx, int fd) {
+  stats.connections++;
+  SSL* ssl = SSL_new(ctx);
+  SSL_set_fd(ssl, fd);
+  if (SSL_accept(ssl) <= 0) {
+    if (options.verbose >= 1) ERR_print_errors_fp(stderr);
+    SSL_free(ssl);
+    close(fd);
+    return;
+  }
+
+  string buffer, request_line, headers, body;
+  while (readRequest(ssl, buffer, request_line, headers, body)) {
+    size_t request_number = ++stats.requests;
+    Plan plan = planRequest();
+    if (options.verbose >= 1) cerr << request_number << " " << request_line << " (" << body.size() << " bytes)" << endl;
+
+    if (plan.reset) {
+      stats.resets++;
+      SSL_free(ssl);
+      resetConnection(fd);
+      return;
+    }
+    if (plan.delay_ms > 0) this_thread::sleep_for(chrono::duration<double, milli>(plan.delay_ms));
+    if (plan.chunked) stats.chunked++;
+
+    bool ok;
+    if (plan.rate_limit) {
+      stats.rate_limited++;
+      json error = {{"error", {{"message", "Rate limit reached (mock server)"}, {"type", "requests"},
+                               {"code", "rate_limit_exceeded"}}}};
+      ok = sendResponse(ssl, 429, "Too Many Requests", error.dump(), plan.chunked, "Retry-After: 1\r\n");
+    } else {
+      string path = request_line.substr(request_line.find(' ') + 1);
+      path = path.substr(0, path.find(' '));
+      try {
+        json request = json::parse(body);
+        if (path.ends_with("/embeddings")) {
+          ok = sendResponse(ssl, 200, "OK", embeddingsResponse(request).dump(), plan.chunked);
+        } else if (path.ends_with("/chat/completions")) {
+          ok = sendResponse(ssl, 200, "OK", chatResponse(request).dump(), plan.chunked);
+        } else {
+          ok = sendResponse(ssl, 404, "Not Found", R"({"error":{"message":"unknown path"}})", plan.chunked);
+        }
+      } catch (const exception& e) {
+        json error = {{"error", {{"message", string("bad request: ") + e.what()}}}};
+        ok = sendResponse(ssl, 400, "Bad Request", error.dump(), plan.chunked);
+      }
+    }
+    if (!ok || headers.find("connection: close") != string::npos) break;
+  }
+  SSL_shutdown(ssl);
+  SSL_free(ssl);
+  close(fd);
+}
+
+// Self-signed P-256 certificate for localhost and 127.0.0.1, valid for a
+// year. It is its own CA, so clients trust it with the written PEM.
+bool generateCertificate(SSL_CTX* ctx) {
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* cert = X509_new();
+  if (!key || !cert) return false;
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), static_cast<long>(options.seed & 0x7fffffff) + 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 365L * 24 * 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+
+  X509V3_CTX v3;
+  X509V3_set_ctx_nodb(&v3);
+  X509V3_set_ctx(&v3, cert, cert, nullptr, nullptr, 0);
+  const pair<int, const char*> extensions[] = {
+    {NID_subject_alt_name, "DNS:localhost,IP:127.0.0.1"},
+    {NID_basic_constraints, "critical,CA:TRUE"},
+    {NID_key_usage, "critical,digitalSignature,keyCertSign"},
+    {NID_ext_key_usage, "serverAuth"},
+  };
+  for (const auto& [nid, value] : extensions) {
+    X509_EXTENSION* ext = X509V3_EXT_conf_nid(nullptr, &v3, nid, value);
+    if (!ext) return false;
+    X509_add_ext(cert, ext, -1);
+    X509_EXTENSION_free(ext);
+  }
+  if (!X509_sign(cert, key, EVP_sha256())) return false;
+
+  bool ok = SSL_CTX_use_certificate(ctx, cert) == 1 && SSL_CTX_use_PrivateKey(ctx, key) == 1;
+  if (ok && !options.write_ca.empty()) {
+    FILE* out = fopen(options.write_ca.c_str(), "w");
+    ok = out && PEM_write_X509(out, cert);
+    if (out) fclose(out);
+  }
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return ok;
+}
+
+int usage(const char* program) {
+  cerr << "Usage: " << program
+       << " [--port N] [--cert cert.pem --key key.pem] [--write-ca ca.pem] [--latency fixed:MS|uniform:MIN,MAX|lognormal:MEDIAN,SIGMA]"
+          " [--rate-limit FRACTION] [--chunked FRACTION] [--reset FRACTION] [--seed N] [-v]"
+       << endl;
+  return 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    try {
+      if (arg == "--port" && has_value) {
+        options.port = stoi(argv[++i]);
+      } else if (arg == "--cert" && has_value) {
+        options.cert_file = argv[++i];
+      } else if (arg == "--key" && has_value) {
+        options.key_file = argv[++i];
+      } else if (arg == "--write-ca" && has_value) {
+        options.write_ca = argv[++i];
+      } else if (arg == "--latency" && has_value) {
+        options.latency = argv[++i];
+      } else if (arg == "--rate-limit" && has_value) {
+        options.rate_limit = stod(argv[++i]);
+      } else if (arg == "--chunked" && has_value) {
+        options.chunked = stod(argv[++i]);
+      } else if (arg == "--reset" && has_value) {
+        options.reset = stod(argv[++i]);
+      } else if (arg == "--seed" && has_value) {
+        options.seed = stoull(argv[++i]);
+      } else if (arg == "-v") {
+        options.verbose = 1;
+      } else {
+        return usage(argv[0]);
+      }
+    } catch (const exception& e) {
+      cerr << "Error: bad value for " << arg << endl;
+      return 1;
+    }
+  }
+
+  try {
+    latency = make_unique<LatencyModel>(options.latency);
+  } catch (const exception& e) {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  rng.seed(options.seed);
+  signal(SIGPIPE, SIG_IGN);
+  // No SA_RESTART, so accept() returns and the totals below get printed
+  struct sigaction stop = {};
+  stop.sa_handler = [](int) { stopping = 1; };
+  sigaction(SIGINT, &stop, nullptr);
+  sigaction(SIGTERM, &stop, nullptr);
+
+  SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+  bool have_cert = options.cert_file.empty()
+    ? generateCertificate(ctx)
+    : SSL_CTX_use_certificate_chain_file(ctx, options.cert_file.c_str()) == 1 &&
+      SSL_CTX_use_PrivateKey_file(ctx, options.key_file.c_str(), SSL_FILETYPE_PEM) == 1;
+  if (!have_cert) {
+    ERR_print_errors_fp(stderr);
+    cerr << "Error: could not set up the server certificate" << endl;
+    return 1;
+  }
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(options.port);
+  socklen_t addr_len = sizeof(addr);
+  if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || listen(listener, 1024) == -1 ||
+      getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addr_len) == -1) {
+    perror("listen");
+    return 1;
+  }
+  // Scripts wait for this line; with --port 0 it carries the chosen port
+  cerr << "Listening on https://127.0.0.1:" << ntohs(addr.sin_port) << endl;
+
+  while (!stopping) {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd == -1) {
+      if (errno == EINTR) continue;
+      perror("accept");
+      break;
+    }
+    thread(serveConnection, ctx, fd).detach();
+  }
+  cerr << stats.connections << " connections, " << stats.requests << " requests (" << stats.rate_limited
+       << " rate limited, " << stats.resets << " reset, " << stats.chunked << " chunked)" << endl;
+  return 0;
+}
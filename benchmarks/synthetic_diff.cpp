@@ -0,0 +1,290 @@
+#include "synthetic_diff.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// How one language spells a small function. {id} and {k} are substituted;
+// body statements are indented by `indent`.
+struct LanguageTemplate {
+  string name;
+  string extension;
+  vector<string> prelude;   // file header, before the first function
+  vector<string> postlude;  // file footer, after the last function
+  vector<string> opening;   // signature and local setup
+  vector<string> closing;   // return and closing brace
+  string indent;
+  vector<string> statements;
+};
+
+const vector<LanguageTemplate>& templates() {
+  static const vector<LanguageTemplate> all = {
+    {"python", ".py", {"import logging", "", "logger = logging.getLogger(__name__)", ""}, {},
+     {"def fn_{id}(value, items):", "    total = 0"}, {"    return total", ""}, "    ",
+     {"total += value * {k}", "items.append(total % {k})", "value = (value + {k}) % 97",
+      "if total > {k}: total -= {k}", "logger.debug(\"step %d\", {k})"}},
+    {"cpp", ".cpp", {"#include <vector>", ""}, {},
+     {"int fn_{id}(int value, std::vector<int>& items) {", "  int total = 0;"}, {"  return total;", "}", ""}, "  ",
+     {"total += value * {k};", "items.push_back(total % {k});", "value = (value + {k}) % 97;",
+      "if (total > {k}) total -= {k};", "items.reserve(items.size() + {k});"}},
+    {"go", ".go", {"package gen", ""}, {},
+     {"func fn{id}(value int, items []int) int {", "\ttotal := 0"}, {"\treturn total", "}", ""}, "\t",
+     {"total += value * {k}", "items = append(items, total%{k})", "value = (value + {k}) % 97",
+      "if total > {k} { total -= {k} }"}},
+    {"javascript", ".js", {"'use strict';", ""}, {},
+     {"function fn{id}(value, items) {", "  let total = 0;"}, {"  return total;", "}", ""}, "  ",
+     {"total += value * {k};", "items.push(total % {k});", "value = (value + {k}) % 97;",
+      "if (total > {k}) total -= {k};", "console.debug('step', {k});"}},
+    {"java", ".java", {"package gen;", "", "public class Generated {"}, {"}"},
+     {"    static int fn{id}(int value, java.util.List<Integer> items) {", "        int total = 0;"},
+     {"        return total;", "    }", ""}, "        ",
+     {"total += value * {k};", "items.add(total % {k});", "value = (value + {k}) % 97;",
+      "if (total > {k}) total -= {k};"}},
+    {"rust", ".rs", {}, {},
+     {"fn fn_{id}(mut value: i64, items: &mut Vec<i64>) -> i64 {", "    let mut total = 0;"},
+     {"    total", "}", ""}, "    ",
+     {"total += value * {k};", "items.push(total % {k});", "value = (value + {k}) % 97;",
+      "if total > {k} { total -= {k}; }"}},
+    {"text", ".md", {"# Generated notes", ""}, {},
+     {"## Section {id}", ""}, {"", ""}, "",
+     {"The total grows by {k} for each value.", "Items are appended in order {k}.",
+      "Values wrap around modulo 97 after {k} steps.", "Large totals are reduced by {k}."}},
+  };
+  return all;
+}
+
+string substitute(string text, size_t id, size_t k) {
+  for (size_t pos; (pos = text.find("{id}")) != string::npos;) text.replace(pos, 4, to_string(id));
+  for (size_t pos; (pos = text.find("{k}")) != string::npos;) text.replace(pos, 3, to_string(k));
+  return text;
+}
+
+class Generator {
+private:
+  const SyntheticDiffOptions& options;
+  ostream& out;
+  mt19937_64 rng;
+  vector<const LanguageTemplate*> languages;
+  size_t written = 0;
+  size_t next_function = 0;
+
+  bool chance(double p) { return uniform_real_distribution<double>(0.0, 1.0)(rng) < p; }
+  size_t pick(size_t n) { return n ? rng() % n : 0; }
+
+  void line(const string& text) {
+    out << text << '\n';
+    written++;
+  }
+
+  string hash() {
+    char buffer[8];
+    snprintf(buffer, sizeof(buffer), "%07llx", static_cast<unsigned long long>(rng() & 0xfffffff));
+    return buffer;
+  }
+
+  string statement(const LanguageTemplate& lang, size_t id) {
+    return lang.indent + substitute(lang.statements[pick(lang.statements.size())], id, 1 + pick(99));
+  }
+
+  vector<string> function(const LanguageTemplate& lang, size_t id, size_t body) {
+    vector<string> lines;
+    for (const string& l : lang.opening) lines.push_back(substitute(l, id, 0));
+    for (size_t s = 0; s < body; s++) lines.push_back(statement(lang, id));
+    for (const string& l : lang.closing) lines.push_back(substitute(l, id, 0));
+    return lines;
+  }
+
+  // Whole file as it exists on one side of a new or deleted file diff
+  vector<string> wholeFile(const LanguageTemplate& lang, size_t functions) {
+    vector<string> lines = lang.prelude;
+    for (size_t f = 0; f < functions; f++) {
+      vector<string> fn = function(lang, next_function++, 2 + pick(8));
+      lines.insert(lines.end(), fn.begin(), fn.end());
+    }
+    lines.insert(lines.end(), lang.postlude.begin(), lang.postlude.end());
+    return lines;
+  }
+
+  string path(const LanguageTemplate& lang, size_t file) {
+    return "src/" + lang.name + "/pkg_" + to_string(file / 16) + "/module_" + to_string(file) + lang.extension;
+  }
+
+  void header(const string& old_path, const string& new_path) {
+    line("diff --git a/" + old_path + " b/" + new_path);
+  }
+
+  void newFile(const LanguageTemplate& lang, const string& file) {
+    vector<string> lines = wholeFile(lang, 1 + pick(20));
+    header(file, file);
+    line("new file mode 100644");
+    line("index 0000000.." + hash());
+    line("--- /dev/null");
+    line("+++ b/" + file);
+    line("@@ -0,0 +1," + to_string(lines.size()) + " @@");
+    for (const string& l : lines) line("+" + l);
+  }
+
+  void deletedFile(const LanguageTemplate& lang, const string& file) {
+    vector<string> lines = wholeFile(lang, 1 + pick(20));
+    header(file, file);
+    line("deleted file mode 100644");
+    line("index " + hash() + "..0000000");
+    line("--- a/" + file);
+    line("+++ /dev/null");
+    line("@@ -1," + to_string(lines.size()) + " +0,0 @@");
+    for (const string& l : lines) line("-" + l);
+  }
+
+  void binaryFile(size_t file) {
+    string name = "assets/image_" + to_string(file) + ".png";
+    header(name, name);
+    if (chance(0.5)) {
+      line("new file mode 100644");
+      line("index 0000000.." + hash());
+      line("Binary files /dev/null and b/" + name + " differ");
+    } else {
+      line("index " + hash() + ".." + hash() + " 100644");
+      line("Binary files a/" + name + " and b/" + name + " differ");
+    }
+  }
+
+  // One function rewritten: statements replaced, dropped and added, with
+  // the signature and closing lines as context
+  void hunk(const LanguageTemplate& lang, size_t& old_line, size_t& new_line) {
+    size_t id = next_function++;
+    vector<string> body;
+    for (size_t s = 0, n = 2 + pick(10); s < n; s++) body.push_back(statement(lang, id));
+
+    vector<string> diff;
+    size_t old_count = lang.opening.size() + lang.closing.size();
+    size_t new_count = old_count;
+    for (const string& l : lang.opening) diff.push_back(" " + substitute(l, id, 0));
+    bool changed = false;
+    for (const string& s : body) {
+      if (chance(0.15)) {
+        diff.push_back("+" + statement(lang, id));
+        new_count++;
+        changed = true;
+      }
+      double roll = uniform_real_distribution<double>(0.0, 1.0)(rng);
+      if (roll < 0.2) {
+        diff.push_back("-" + s);
+        old_count++;
+        changed = true;
+      } else if (roll < 0.4) {
+        diff.push_back("-" + s);
+        diff.push_back("+" + statement(lang, id));
+        old_count++;
+        new_count++;
+        changed = true;
+      } else {
+        diff.push_back(" " + s);
+        old_count++;
+        new_count++;
+      }
+    }
+    if (!changed) {
+      diff.push_back("+" + statement(lang, id));
+      new_count++;
+    }
+    for (const string& l : lang.closing) diff.push_back(" " + substitute(l, id, 0));
+
+    line("@@ -" + to_string(old_line) + "," + to_string(old_count) + " +" + to_string(new_line) + "," +
+         to_string(new_count) + " @@ " + substitute(lang.opening[0], id, 0));
+    for (const string& l : diff) line(l);
+    old_line += old_count;
+    new_line += new_count;
+  }
+
+  void editedFile(const LanguageTemplate& lang, const string& old_path, const string& new_path, size_t hunks) {
+    header(old_path, new_path);
+    if (old_path != new_path) {
+      line("similarity index " + to_string(70 + pick(29)) + "%");
+      line("rename from " + old_path);
+      line("rename to " + new_path);
+    }
+    line("index " + hash() + ".." + hash() + " 100644");
+    line("--- a/" + old_path);
+    line("+++ b/" + new_path);
+
+    size_t old_line = lang.prelude.size() + 1;
+    size_t new_line = old_line;
+    for (size_t h = 0; h < hunks && written < options.lines; h++) {
+      // Unchanged functions between edits, at least one line apart so git
+      // would not merge the hunks
+      size_t gap = (1 + pick(3)) * (lang.opening.size() + 6 + lang.closing.size());
+      old_line += gap;
+      new_line += gap;
+      hunk(lang, old_line, new_line);
+    }
+  }
+
+  void pureRename(const string& old_path, const string& new_path) {
+    header(old_path, new_path);
+    line("similarity index 100%");
+    line("rename from " + old_path);
+    line("rename to " + new_path);
+  }
+
+public:
+  Generator(const SyntheticDiffOptions& options, ostream& out) : options(options), out(out), rng(options.seed) {
+    for (const string& name : options.languages) {
+      auto found = find_if(templates().begin(), templates().end(),
+                           [&](const LanguageTemplate& t) { return t.name == name; });
+      if (found == templates().end()) throw invalid_argument("unknown language: " + name);
+      languages.push_back(&*found);
+    }
+    if (languages.empty()) throw invalid_argument("no languages to generate");
+  }
+
+  void run() {
+    for (size_t file = 0; written < options.lines; file++) {
+      const LanguageTemplate& lang = *languages[file % languages.size()];
+      string file_path = path(lang, file);
+      double roll = uniform_real_distribution<double>(0.0, 1.0)(rng);
+      double edge = options.binary_files;
+      if (roll < edge) {
+        binaryFile(file);
+        continue;
+      }
+      if (roll < (edge += options.new_files)) {
+        newFile(lang, file_path);
+        continue;
+      }
+      if (roll < (edge += options.deleted_files)) {
+        deletedFile(lang, file_path);
+        continue;
+      }
+      string new_path = file_path;
+      if (roll < (edge += options.renames)) {
+        new_path = path(lang, file + 1000000);
+        if (chance(0.5)) {
+          pureRename(file_path, new_path);
+          continue;
+        }
+      }
+      // Log-uniform: mostly a handful of hunks, occasionally thousands
+      double max_hunks = static_cast<double>(max<size_t>(1, options.max_hunks_per_file));
+      size_t hunks = static_cast<size_t>(exp(uniform_real_distribution<double>(0.0, log(max_hunks))(rng)));
+      editedFile(lang, file_path, new_path, max<size_t>(1, hunks));
+    }
+  }
+};
+
+} // namespace
+
+void writeSyntheticDiff(ostream& out, const SyntheticDiffOptions& options) {
+  Generator(options, out).run();
+}
+
+string syntheticDiff(const SyntheticDiffOptions& options) {
+  ostringstream out;
+  writeSyntheticDiff(out, options);
+  return out.str();
+}
@@ -0,0 +1,34 @@
+#ifndef SYNTHETIC_DIFF_HPP
+#define SYNTHETIC_DIFF_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct SyntheticDiffOptions {
+  size_t lines = 100000;            // stop once the diff reaches this many lines
+  size_t max_hunks_per_file = 2000; // hunk counts per file are log-uniform up to this
+  uint64_t seed = 1;
+  // Fraction of files that are created, deleted, renamed or binary; the
+  // rest are edited in place
+  double new_files = 0.05;
+  double deleted_files = 0.05;
+  double renames = 0.05;
+  double binary_files = 0.02;
+  // Any of python, cpp, go, javascript, java, rust, text
+  vector<string> languages = {"python", "cpp", "go", "javascript", "java", "rust", "text"};
+};
+
+// Writes a git-style unified diff. Every hunk spans whole functions, so
+// each hunk's old and new text parses cleanly with the language's
+// tree-sitter grammar (Java methods sit inside a class that isn't part of
+// the hunk). Line numbers and hunk counts are consistent, and the output
+// depends only on the options.
+// Throws invalid_argument for an unknown language.
+void writeSyntheticDiff(ostream& out, const SyntheticDiffOptions& options);
+string syntheticDiff(const SyntheticDiffOptions& options);
+
+#endif // SYNTHETIC_DIFF_HPP
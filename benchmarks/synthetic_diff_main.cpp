@@ -0,0 +1,59 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "synthetic_diff.hpp"
+
+using namespace std;
+
+// Writes a synthetic diff for load testing, e.g.
+//   synthetic_diff --lines 1000000 --seed 7 -o big.diff
+//   synthetic_diff --lines 50000 | gcommit
+int main(int argc, char *argv[]) {
+  SyntheticDiffOptions options;
+  string output;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    try {
+      if (arg == "--lines" && has_value) {
+        options.lines = stoull(argv[++i]);
+      } else if (arg == "--seed" && has_value) {
+        options.seed = stoull(argv[++i]);
+      } else if (arg == "--max-hunks" && has_value) {
+        options.max_hunks_per_file = stoull(argv[++i]);
+      } else if (arg == "--languages" && has_value) {
+        options.languages.clear();
+        stringstream list(argv[++i]);
+        for (string name; getline(list, name, ',');) options.languages.push_back(name);
+      } else if (arg == "-o" && has_value) {
+        output = argv[++i];
+      } else {
+        cerr << "Usage: " << argv[0]
+             << " [--lines N] [--seed N] [--max-hunks N] [--languages python,cpp,go,javascript,java,rust,text] [-o out.diff]"
+             << endl;
+        return 1;
+      }
+    } catch (const exception& e) {
+      cerr << "Error: " << arg << " requires a non-negative integer" << endl;
+      return 1;
+    }
+  }
+
+  try {
+    if (output.empty()) {
+      writeSyntheticDiff(cout, options);
+    } else {
+      ofstream file(output, ios::binary | ios::trunc);
+      if (!file) {
+        cerr << "Error: could not open " << output << endl;
+        return 1;
+      }
+      writeSyntheticDiff(file, options);
+    }
+  } catch (const invalid_argument& e) {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
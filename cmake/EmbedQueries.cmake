@@ -0,0 +1,19 @@
+# Embeds the tree-sitter chunking queries (shared/queries/*.scm) into a
+# generated header so the installed binaries never need to locate them on
+# disk. Each file becomes one {"<language>", R"scm(...)scm"} initializer
+# entry, keyed by the file's base name.
+function(embed_chunk_queries query_dir output_file)
+  file(GLOB query_files CONFIGURE_DEPENDS "${query_dir}/*.scm")
+  # The glob only notices added or removed files; re-run configure (and so
+  # regenerate the output) when an existing query is edited too
+  set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${query_files})
+  set(content "// Generated by cmake/EmbedQueries.cmake from ${query_dir}. Do not edit.\n")
+  foreach(query_file ${query_files})
+    get_filename_component(language ${query_file} NAME_WE)
+    file(READ ${query_file} query)
+    string(APPEND content "{\"${language}\", R\"scm(${query})scm\"},\n")
+  endforeach()
+  # configure_file only touches the output when it changes, avoiding rebuilds
+  file(WRITE ${output_file}.tmp "${content}")
+  configure_file(${output_file}.tmp ${output_file} COPYONLY)
+endfunction()
@@ -0,0 +1,58 @@
+# Tree-sitter grammars linked in addition to the core set (python, cpp, java,
+# javascript, go). Must be included after cpp-tree-sitter so that
+# add_grammar_from_repo is available. Sets CUSTOM_GIT_EXTRA_GRAMMAR_TARGETS.
+option(CUSTOM_GIT_EXTRA_GRAMMARS "Statically link Rust, TypeScript, C#, Ruby and Kotlin grammars" ON)
+
+set(CUSTOM_GIT_EXTRA_GRAMMAR_TARGETS "")
+
+if(CUSTOM_GIT_EXTRA_GRAMMARS)
+  add_grammar_from_repo(tree-sitter-rust
+    https://github.com/tree-sitter/tree-sitter-rust.git
+    0.23.2
+  )
+
+  add_grammar_from_repo(tree-sitter-c-sharp
+    https://github.com/tree-sitter/tree-sitter-c-sharp.git
+    0.23.1
+  )
+
+  add_grammar_from_repo(tree-sitter-ruby
+    https://github.com/tree-sitter/tree-sitter-ruby.git
+    0.23.1
+  )
+
+  add_grammar_from_repo(tree-sitter-kotlin
+    https://github.com/fwcd/tree-sitter-kotlin.git
+    0.3.8
+  )
+
+  # tree-sitter-typescript ships two grammars (typescript/ and tsx/) that
+  # share common/scanner.h, so add_grammar_from_repo cannot build it.
+  CPMAddPackage(
+    NAME tree-sitter-typescript
+    GIT_REPOSITORY https://github.com/tree-sitter/tree-sitter-typescript.git
+    VERSION 0.23.2
+    DOWNLOAD_ONLY YES
+  )
+  if(tree-sitter-typescript_ADDED)
+    foreach(dialect typescript tsx)
+      add_library(tree-sitter-${dialect}
+        ${tree-sitter-typescript_SOURCE_DIR}/${dialect}/src/parser.c
+        ${tree-sitter-typescript_SOURCE_DIR}/${dialect}/src/scanner.c
+      )
+      target_include_directories(tree-sitter-${dialect} PRIVATE
+        ${tree-sitter-typescript_SOURCE_DIR}/${dialect}/src
+      )
+      target_link_libraries(tree-sitter-${dialect} INTERFACE tree-sitter)
+    endforeach()
+  endif()
+
+  set(CUSTOM_GIT_EXTRA_GRAMMAR_TARGETS
+    tree-sitter-rust
+    tree-sitter-typescript
+    tree-sitter-tsx
+    tree-sitter-c-sharp
+    tree-sitter-ruby
+    tree-sitter-kotlin
+  )
+endif()
@@ -0,0 +1,428 @@
+#include "daemon.hpp"
+#include <nlohmann/json.hpp>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+// Settings a run reads from the environment; everything else it needs comes
+// from the arguments, stdin and the working directory
+static const char* const forwarded_env[] = {
+  "OPENAI_API_KEY", "OPENAI_BASE_URL", "CUSTOM_GIT_OPENAI_CA", "GIT_DIR", "GIT_WORK_TREE",
+};
+
+static bool writeAll(int fd, const char* data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    data += written;
+    length -= written;
+  }
+  return true;
+}
+
+static bool writeFrame(int fd, const json& frame) {
+  string line = frame.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+  return writeAll(fd, line.data(), line.size());
+}
+
+// Reads up to and excluding the next newline into line, keeping anything past
+// it in buffered for the next call
+static bool readLine(int fd, string& buffered, string& line) {
+  size_t newline;
+  while ((newline = buffered.find('\n')) == string::npos) {
+    char chunk[4096];
+    ssize_t got = read(fd, chunk, sizeof(chunk));
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) return false;
+    buffered.append(chunk, got);
+  }
+  line = buffered.substr(0, newline);
+  buffered.erase(0, newline + 1);
+  return true;
+}
+
+// Turns everything written to cout or cerr during a request into frames on the
+// client socket. Stages write from their own threads, so frames go out under a
+// lock shared by both streams.
+class FrameBuf : public streambuf {
+private:
+  int fd;
+  const char* stream;
+  mutex& lock;
+  string pending;
+
+  void flushPending() {
+    if (pending.empty()) return;
+    // A client that hung up just stops receiving; the run itself finishes
+    writeFrame(fd, {{"stream", stream}, {"data", pending}});
+    pending.clear();
+  }
+
+protected:
+  int_type overflow(int_type c) override {
+    if (c == traits_type::eof()) return traits_type::not_eof(c);
+    lock_guard<mutex> guard(lock);
+    pending += traits_type::to_char_type(c);
+    if (pending.size() >= 65536) flushPending();
+    return c;
+  }
+  streamsize xsputn(const char* s, streamsize n) override {
+    lock_guard<mutex> guard(lock);
+    pending.append(s, n);
+    if (pending.size() >= 65536) flushPending();
+    return n;
+  }
+  int sync() override {
+    lock_guard<mutex> guard(lock);
+    flushPending();
+    return 0;
+  }
+
+public:
+  FrameBuf(int fd, const char* stream, mutex& lock) : fd(fd), stream(stream), lock(lock) {}
+};
+
+static string socketDirectory() {
+  const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+  if (runtime_dir && *runtime_dir) return runtime_dir;
+  return "/tmp/gcommit-" + to_string(getuid());
+}
+
+string daemonSocketPath() {
+  return socketDirectory() + "/gcommit.sock";
+}
+
+// Only we may create or replace entries in the socket's directory, otherwise
+// another user could swap in a socket of their own
+static bool socketDirectoryIsPrivate(const string& dir) {
+  struct stat info;
+  return lstat(dir.c_str(), &info) == 0 && S_ISDIR(info.st_mode) && info.st_uid == getuid() &&
+         (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// A socket at path that we own, or false for anything else
+static bool ownSocketAt(const string& path) {
+  struct stat info;
+  return lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode) && info.st_uid == getuid();
+}
+
+// The process on the other end of a connected unix socket runs as us
+static bool peerIsCurrentUser(int fd) {
+#ifdef SO_PEERCRED
+  ucred peer;
+  socklen_t length = sizeof(peer);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) < 0) return false;
+  return peer.uid == getuid();
+#else
+  uid_t uid;
+  gid_t gid;
+  if (getpeereid(fd, &uid, &gid) < 0) return false;
+  return uid == getuid();
+#endif
+}
+
+static bool socketAddress(sockaddr_un& addr) {
+  string path = daemonSocketPath();
+  if (path.size() >= sizeof(addr.sun_path)) return false;
+  addr = {};
+  addr.sun_family = AF_UNIX;
+  path.copy(addr.sun_path, path.size());
+  return true;
+}
+
+int connectToDaemon() {
+  sockaddr_un addr;
+  if (!socketAddress(addr)) return -1;
+  if (!socketDirectoryIsPrivate(socketDirectory()) || !ownSocketAt(addr.sun_path)) return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || !peerIsCurrentUser(fd)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// A run reads its environment, working directory and stdio from process-wide
+// state (setenv, chdir, the cin/cout/cerr buffers), which is only sound
+// because the daemon serves one request at a time. RunContext installs a
+// client's state for the length of one run and puts the daemon's back when
+// it goes out of scope, even if the run throws.
+class RunContext {
+private:
+  string cwd;
+  vector<pair<const char*, optional<string>>> saved_env;
+  streambuf* saved_in;
+  streambuf* saved_out;
+  streambuf* saved_err;
+  int enter_error = 0;
+
+public:
+  RunContext(const vector<pair<const char*, optional<string>>>& env, const string& cwd, streambuf* in,
+             streambuf* out, streambuf* err)
+      : cwd(cwd) {
+    for (const auto& [name, value] : env) {
+      const char* current = getenv(name);
+      saved_env.push_back({name, current ? optional<string>(current) : nullopt});
+      if (value) {
+        setenv(name, value->c_str(), 1);
+      } else {
+        unsetenv(name);
+      }
+    }
+    saved_in = cin.rdbuf(in);
+    saved_out = cout.rdbuf(out);
+    saved_err = cerr.rdbuf(err);
+    if (chdir(cwd.c_str()) < 0) enter_error = errno;
+  }
+
+  ~RunContext() {
+    cout.flush();
+    cerr.flush();
+    cin.rdbuf(saved_in);
+    cout.rdbuf(saved_out);
+    cerr.rdbuf(saved_err);
+    for (const auto& [name, value] : saved_env) {
+      if (value) {
+        setenv(name, value->c_str(), 1);
+      } else {
+        unsetenv(name);
+      }
+    }
+    // Don't pin whatever directory the client ran in
+    if (enter_error == 0 && chdir("/") < 0) {
+      cerr << "Warning: cannot leave " << cwd << ": " << strerror(errno) << endl;
+    }
+  }
+
+  RunContext(const RunContext&) = delete;
+  RunContext& operator=(const RunContext&) = delete;
+
+  // 0 once the run is in the client's directory, else the chdir errno
+  int error() const { return enter_error; }
+};
+
+static filesystem::file_time_type binaryTime(const string& exe_path) {
+  error_code ec;
+  filesystem::file_time_type time = filesystem::last_write_time(exe_path, ec);
+  return ec ? filesystem::file_time_type() : time;
+}
+
+// Runs one request from fd. Returns false once the binary on disk has changed
+// and the daemon should make way for a fresh one.
+static bool serveClient(int fd, const GcommitRunner& run, const string& exe_path,
+                        filesystem::file_time_type started_binary) {
+  string buffered, header_line;
+  if (!readLine(fd, buffered, header_line)) return true;
+
+  if (!exe_path.empty() && binaryTime(exe_path) != started_binary) {
+    writeFrame(fd, {{"stale", true}});
+    return false;
+  }
+
+  json request;
+  size_t input_length;
+  try {
+    request = json::parse(header_line);
+    input_length = request.value("stdin", size_t(0));
+  } catch (const exception& e) {
+    writeFrame(fd, {{"stream", "stderr"}, {"data", string("Error: bad daemon request: ") + e.what() + "\n"}});
+    writeFrame(fd, {{"exit", 1}});
+    return true;
+  }
+
+  string input = std::move(buffered);
+  while (input.size() < input_length) {
+    char chunk[65536];
+    ssize_t got = read(fd, chunk, min(sizeof(chunk), input_length - input.size()));
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) return true;
+    input.append(chunk, got);
+  }
+  input.resize(input_length);
+
+  vector<string> args = {"gcommit"};
+  string cwd;
+  vector<pair<const char*, optional<string>>> env_values;
+  try {
+    cwd = request.value("cwd", string("/"));
+    json env = request.value("env", json::object());
+    for (const string& arg : request.value("args", vector<string>())) args.push_back(arg);
+    for (const char* name : forwarded_env) {
+      if (env.contains(name) && env[name].is_string()) {
+        env_values.push_back({name, env[name].get<string>()});
+      } else {
+        env_values.push_back({name, nullopt});
+      }
+    }
+  } catch (const exception& e) {
+    writeFrame(fd, {{"stream", "stderr"}, {"data", string("Error: bad daemon request: ") + e.what() + "\n"}});
+    writeFrame(fd, {{"exit", 1}});
+    return true;
+  }
+
+  int exit_code = 1;
+  mutex frame_lock;
+  FrameBuf out(fd, "stdout", frame_lock), err(fd, "stderr", frame_lock);
+  istringstream in(input);
+  {
+    RunContext context(env_values, cwd, in.rdbuf(), &out, &err);
+    if (context.error() != 0) {
+      cerr << "Error: cannot enter " << cwd << ": " << strerror(context.error()) << endl;
+    } else {
+      vector<char*> argv;
+      for (string& arg : args) argv.push_back(arg.data());
+      argv.push_back(nullptr);
+      try {
+        exit_code = run(static_cast<int>(args.size()), argv.data());
+      } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+      }
+    }
+  }
+
+  writeFrame(fd, {{"exit", exit_code}});
+  return true;
+}
+
+int runDaemon(const GcommitRunner& run, const string& exe_path, chrono::minutes idle_timeout) {
+  sockaddr_un addr;
+  if (!socketAddress(addr)) {
+    cerr << "Error: socket path too long: " << daemonSocketPath() << endl;
+    return 1;
+  }
+  // Our own fallback directory is created private; $XDG_RUNTIME_DIR already is
+  string dir = socketDirectory();
+  if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+    cerr << "Error: cannot create " << dir << ": " << strerror(errno) << endl;
+    return 1;
+  }
+  if (!socketDirectoryIsPrivate(dir)) {
+    cerr << "Error: " << dir << " must be a directory owned by you that no one else can write to" << endl;
+    return 1;
+  }
+  int probe = connectToDaemon();
+  if (probe >= 0) {
+    close(probe);
+    cerr << "Error: a gcommit daemon is already listening on " << daemonSocketPath() << endl;
+    return 1;
+  }
+  // Nothing answered, so a socket of ours at the path was left by a dead
+  // daemon. Anything else there is not ours to remove.
+  struct stat existing;
+  if (lstat(addr.sun_path, &existing) == 0) {
+    if (!ownSocketAt(addr.sun_path)) {
+      cerr << "Error: " << daemonSocketPath() << " exists and is not a gcommit socket" << endl;
+      return 1;
+    }
+    unlink(addr.sun_path);
+  }
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  mode_t old_umask = umask(0077);
+  int bound = listener < 0 ? -1 : ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  umask(old_umask);
+  if (bound < 0 || chmod(addr.sun_path, 0600) < 0 || listen(listener, 16) < 0) {
+    cerr << "Error: cannot listen on " << daemonSocketPath() << ": " << strerror(errno) << endl;
+    if (listener >= 0) close(listener);
+    return 1;
+  }
+  // Clients that hang up mid-run must not take the daemon with them
+  signal(SIGPIPE, SIG_IGN);
+  if (chdir("/") < 0) {
+    cerr << "Warning: cannot change to /: " << strerror(errno) << endl;
+  }
+  cerr << "gcommit daemon listening on " << daemonSocketPath() << endl;
+
+  filesystem::file_time_type started_binary = exe_path.empty() ? filesystem::file_time_type() : binaryTime(exe_path);
+  int timeout_ms = static_cast<int>(chrono::duration_cast<chrono::milliseconds>(idle_timeout).count());
+  while (true) {
+    pollfd pfd = {listener, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout_ms > 0 ? timeout_ms : -1);
+    if (ready < 0 && errno == EINTR) continue;
+    if (ready <= 0) break;
+
+    int client = accept(listener, nullptr, nullptr);
+    if (client < 0) continue;
+    // The socket is 0600 in a private directory, but check anyway in case
+    // either was loosened by hand
+    if (!peerIsCurrentUser(client)) {
+      cerr << "Refused a connection from another user" << endl;
+      close(client);
+      continue;
+    }
+    // A client that connects and never sends its request can't hold up the queue
+    timeval request_timeout = {10, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &request_timeout, sizeof(request_timeout));
+    bool keep_serving = serveClient(client, run, exe_path, started_binary);
+    close(client);
+    if (!keep_serving) {
+      cerr << "gcommit binary changed; daemon exiting" << endl;
+      break;
+    }
+  }
+
+  close(listener);
+  unlink(addr.sun_path);
+  return 0;
+}
+
+optional<int> runViaDaemon(int fd, const vector<string>& args, const string& input) {
+  char cwd[4096];
+  json env = json::object();
+  for (const char* name : forwarded_env) {
+    if (const char* value = getenv(name)) env[name] = value;
+  }
+  json request = {
+    {"args", args},
+    {"cwd", getcwd(cwd, sizeof(cwd)) ? cwd : "/"},
+    {"env", env},
+    {"stdin", input.size()}
+  };
+  string header = request.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+  // Don't die on SIGPIPE if the daemon goes away mid-send
+  auto old_pipe = signal(SIGPIPE, SIG_IGN);
+  bool sent = writeAll(fd, header.data(), header.size()) && writeAll(fd, input.data(), input.size());
+  signal(SIGPIPE, old_pipe);
+
+  bool started = false;
+  string buffered, line;
+  while (sent && readLine(fd, buffered, line)) {
+    json frame;
+    try {
+      frame = json::parse(line);
+    } catch (const json::exception&) {
+      continue;
+    }
+    if (frame.value("stale", false)) break;
+    started = true;
+    if (frame.contains("exit")) {
+      close(fd);
+      return frame["exit"].get<int>();
+    }
+    string data = frame.value("data", string());
+    if (frame.value("stream", string()) == "stderr") {
+      cerr << data << flush;
+    } else {
+      cout << data << flush;
+    }
+  }
+  close(fd);
+  if (!started) return nullopt;
+  cerr << "Error: the gcommit daemon exited mid-run" << endl;
+  return 1;
+}
@@ -0,0 +1,40 @@
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A resident gcommit keeps its TLS sessions, DNS answers, tree-sitter parsers
+// and embedding caches warm between invocations. Clients talk to it over a
+// per-user unix socket: one JSON line {"args", "cwd", "env", "stdin"} followed
+// by stdin bytes of diff, answered with NDJSON frames {"stream":"stdout"|"stderr",
+// "data"} and a final {"exit": code}. A daemon whose binary has been rebuilt
+// answers {"stale": true} and exits, and the client runs in-process instead.
+
+using GcommitRunner = function<int(int argc, char* argv[])>;
+
+// $XDG_RUNTIME_DIR/gcommit.sock, else /tmp/gcommit-<uid>/gcommit.sock. The
+// directory must belong to the user and be writable by no one else, and both
+// ends check that the peer runs as the same user.
+string daemonSocketPath();
+
+// Serves requests one at a time until no client has connected for idle_timeout.
+// Each run gets the client's environment, directory and stdio through
+// process-wide state, so requests are never served concurrently.
+// exe_path is compared by mtime before each request to detect rebuilds.
+int runDaemon(const GcommitRunner& run, const string& exe_path, chrono::minutes idle_timeout);
+
+// -1 if no daemon is listening, or if the directory, the socket or the
+// process listening on it is not the current user's
+int connectToDaemon();
+
+// Sends one invocation over fd (closed on return) and relays its output to
+// cout/cerr. nullopt if the daemon was stale or went away before starting.
+optional<int> runViaDaemon(int fd, const vector<string>& args, const string& input);
+
+#endif // DAEMON_HPP
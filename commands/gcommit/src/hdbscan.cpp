@@ -1,54 +1,676 @@
 #include "hdbscan.hpp"
-#include "Hdbscan/hdbscan.hpp"
-#include <unordered_map>
+#include "distance.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
-HDBSCANClustering::HDBSCANClustering(int min_cluster_size, int min_pts)
-    : min_cluster_size(min_cluster_size), min_pts(min_pts) {}
+namespace {
+
+// The approximate path links every point to at least this many neighbors
+const size_t KNN_GRAPH_NEIGHBORS = 16;
+// Quantized core distances are reranked over this many extra candidates
+const size_t RERANK_MARGIN = 8;
+const size_t BLOCK_ROWS = 32;
+const size_t BLOCK_COLS = 64;
+const double MAX_LAMBDA = 1e12;
+
+struct LinkageNode {
+  int left;
+  int right;
+  float distance;
+  int size;
+};
+
+struct CondensedEdge {
+  int parent;
+  int child;
+  double lambda;
+  int size;
+};
+
+inline float chordDistance(float similarity) {
+  return sqrt(max(0.0f, 2.0f - 2.0f * similarity));
+}
+
+float pairDistance(const PairDistance* pair_distance, int a, int b, float chord) {
+  if (pair_distance && a != b) pair_distance->adjust(a, b, 1, &chord);
+  return chord;
+}
+
+// Distances from rows [begin, end) to rows [max(i, col_begin), n), written
+// row-major into out (one full row of n per input row). Columns are walked
+// in tiles so a tile of rows stays in cache while every row of the block is
+// dotted against it.
+void distanceBlock(const QuantizedStore& data, const PairDistance* pair_distance, size_t begin, size_t end,
+                   size_t col_begin, float* out) {
+  size_t n = data.rows();
+  for (size_t jb = col_begin; jb < n; jb += BLOCK_COLS) {
+    size_t je = min(n, jb + BLOCK_COLS);
+    for (size_t i = begin; i < end; i++) {
+      float* o = out + (i - begin) * n;
+      size_t j0 = max(jb, i);
+      if (j0 < je) {
+        data.similarityMany(i, j0, je - j0, o + j0);
+        for (size_t j = j0; j < je; j++) o[j] = chordDistance(o[j]);
+        if (pair_distance) pair_distance->adjust(i, j0, je - j0, o + j0);
+      }
+    }
+  }
+  for (size_t i = begin; i < end; i++) {
+    out[(i - begin) * n + i] = 0.0f;
+  }
+}
+
+// Full symmetric distance matrix, computing only the upper triangle
+vector<float> distanceMatrix(const QuantizedStore& data, const PairDistance* pair_distance) {
+  TraceSpan trace("distance matrix", "hdbscan");
+  size_t n = data.rows();
+  vector<float> dense(n * n, 0.0f);
+  size_t blocks = (n + BLOCK_ROWS - 1) / BLOCK_ROWS;
+  parallelFor(blocks, [&](size_t block) {
+    size_t begin = block * BLOCK_ROWS;
+    distanceBlock(data, pair_distance, begin, min(n, begin + BLOCK_ROWS), begin, dense.data() + begin * n);
+  });
+  for (size_t i = 1; i < n; i++) {
+    for (size_t j = 0; j < i; j++) {
+      dense[i * n + j] = dense[j * n + i];
+    }
+  }
+  return dense;
+}
+
+// Distances to the k nearest other points, n x k ascending
+vector<float> nearestDistances(const vector<float>& dense, size_t n, size_t k) {
+  vector<float> nearest(n * k);
+  if (k == 0) return nearest;
+  size_t blocks = (n + BLOCK_ROWS - 1) / BLOCK_ROWS;
+  parallelFor(blocks, [&](size_t block) {
+    vector<float> scratch(n);
+    for (size_t i = block * BLOCK_ROWS; i < min(n, (block + 1) * BLOCK_ROWS); i++) {
+      copy(dense.begin() + i * n, dense.begin() + (i + 1) * n, scratch.begin());
+      // Index 0 after sorting is the point itself
+      partial_sort(scratch.begin(), scratch.begin() + k + 1, scratch.end());
+      copy(scratch.begin() + 1, scratch.begin() + k + 1, nearest.begin() + i * k);
+    }
+  });
+  return nearest;
+}
+
+// Distance to the k-th nearest other point
+vector<float> coreDistances(const vector<float>& nearest, size_t n, size_t k) {
+  vector<float> core(n, 0.0f);
+  for (size_t i = 0; i < n && k > 0; i++) core[i] = nearest[i * k + k - 1];
+  return core;
+}
+
+// Nearest distances from the exact distances of each row's k + RERANK_MARGIN
+// nearest candidates under the quantized distances
+vector<float> rerankedNearestDistances(const vector<float>& dense, const QuantizedStore& store,
+                                       const PairDistance* pair_distance, size_t k) {
+  size_t n = store.rows();
+  vector<float> nearest(n * k);
+  if (k == 0) return nearest;
+  size_t candidates = min(n, k + 1 + RERANK_MARGIN);
+  size_t blocks = (n + BLOCK_ROWS - 1) / BLOCK_ROWS;
+  parallelFor(blocks, [&](size_t block) {
+    vector<int> order(n);
+    vector<float> exact(candidates);
+    for (size_t i = block * BLOCK_ROWS; i < min(n, (block + 1) * BLOCK_ROWS); i++) {
+      const float* row = dense.data() + i * n;
+      for (size_t j = 0; j < n; j++) order[j] = static_cast<int>(j);
+      nth_element(order.begin(), order.begin() + (candidates - 1), order.end(), [&](int a, int b) {
+        return row[a] < row[b];
+      });
+      for (size_t c = 0; c < candidates; c++) {
+        exact[c] = order[c] == static_cast<int>(i)
+                       ? 0.0f
+                       : pairDistance(pair_distance, i, order[c], chordDistance(store.exactSimilarity(i, order[c])));
+      }
+      partial_sort(exact.begin(), exact.begin() + k + 1, exact.end());
+      copy(exact.begin() + 1, exact.begin() + k + 1, nearest.begin() + i * k);
+    }
+  });
+  return nearest;
+}
+
+// Prim's algorithm on the complete mutual reachability graph, O(n^2)
+vector<ReachabilityEdge> mutualReachabilityMST(const vector<float>& dense, const vector<float>& core) {
+  TraceSpan trace("mutual reachability MST", "hdbscan");
+  size_t n = core.size();
+  vector<ReachabilityEdge> edges;
+  edges.reserve(n - 1);
+
+  vector<float> best(n, numeric_limits<float>::infinity());
+  vector<int> from(n, -1);
+  vector<char> in_tree(n, 0);
+
+  size_t current = 0;
+  in_tree[0] = 1;
+  for (size_t step = 1; step < n; step++) {
+    const float* row = dense.data() + current * n;
+    size_t next = n;
+    float next_weight = numeric_limits<float>::infinity();
+    for (size_t j = 0; j < n; j++) {
+      if (in_tree[j]) continue;
+      float reach = max(row[j], max(core[current], core[j]));
+      if (reach < best[j]) {
+        best[j] = reach;
+        from[j] = static_cast<int>(current);
+      }
+      if (next == n || best[j] < next_weight) {
+        next = j;
+        next_weight = best[j];
+      }
+    }
+
+    edges.push_back({from[next], static_cast<int>(next), dense[from[next] * n + next], best[next]});
+    in_tree[next] = 1;
+    current = next;
+  }
+  return edges;
+}
+
+int findRoot(vector<int>& parent, int x) {
+  while (parent[x] != x) {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+
+// Kruskal over candidate edges: the lightest spanning forest
+vector<ReachabilityEdge> spanningForest(vector<ReachabilityEdge> candidates, size_t n) {
+  TraceSpan trace("spanning forest", "hdbscan");
+  sort(candidates.begin(), candidates.end(), [](const ReachabilityEdge& x, const ReachabilityEdge& y) {
+    return x.weight < y.weight;
+  });
+  vector<int> parent(n);
+  for (size_t i = 0; i < n; i++) parent[i] = static_cast<int>(i);
+  vector<ReachabilityEdge> edges;
+  for (const ReachabilityEdge& edge : candidates) {
+    int a = findRoot(parent, edge.a);
+    int b = findRoot(parent, edge.b);
+    if (a == b) continue;
+    parent[a] = b;
+    edges.push_back(edge);
+    if (edges.size() + 1 == n) break;
+  }
+  return edges;
+}
+
+// Approximate MST for large inputs. Core distances and candidate edges come
+// from the k-NN graph; Kruskal keeps the lightest spanning forest, and any
+// components the graph leaves disconnected are joined by an exact Prim pass
+// over one representative per component.
+vector<ReachabilityEdge> knnMutualReachabilityMST(const EmbeddingMatrix& data, const HNSWIndex& index,
+                                                  const PairDistance* pair_distance, size_t k,
+                                                  vector<float>& nearest) {
+  TraceSpan trace("k-NN graph MST", "hdbscan");
+  size_t n = data.rows;
+  vector<vector<pair<int, float>>> knn = index.knnAll(max(k, KNN_GRAPH_NEIGHBORS));
+  // Neighbors are found by embedding alone; their edges carry the combined distance
+  if (pair_distance) {
+    for (size_t i = 0; i < n; i++) {
+      for (auto& [j, dist] : knn[i]) dist = pairDistance(pair_distance, i, j, dist);
+      sort(knn[i].begin(), knn[i].end(), [](const auto& x, const auto& y) { return x.second < y.second; });
+    }
+  }
+
+  // Rows with fewer than k neighbors repeat their farthest one
+  nearest.assign(n * k, 0.0f);
+  for (size_t i = 0; i < n; i++) {
+    if (knn[i].empty()) continue;
+    for (size_t c = 0; c < k; c++) nearest[i * k + c] = knn[i][min(c, knn[i].size() - 1)].second;
+  }
+  vector<float> core = coreDistances(nearest, n, k);
+
+  vector<ReachabilityEdge> candidates;
+  for (size_t i = 0; i < n; i++) {
+    for (const auto& [j, dist] : knn[i]) {
+      candidates.push_back({static_cast<int>(i), j, dist, max(dist, max(core[i], core[j]))});
+    }
+  }
+  vector<ReachabilityEdge> edges = spanningForest(std::move(candidates), n);
+  if (edges.size() + 1 >= n) {
+    return edges;
+  }
+
+  vector<int> parent(n);
+  for (size_t i = 0; i < n; i++) parent[i] = static_cast<int>(i);
+  for (const ReachabilityEdge& edge : edges) parent[findRoot(parent, edge.a)] = findRoot(parent, edge.b);
+
+  vector<int> representatives;
+  for (size_t i = 0; i < n; i++) {
+    if (findRoot(parent, static_cast<int>(i)) == static_cast<int>(i)) {
+      representatives.push_back(static_cast<int>(i));
+    }
+  }
+  size_t count = representatives.size();
+  vector<float> best(count, numeric_limits<float>::infinity());
+  vector<float> best_distance(count, 0.0f);
+  vector<int> from(count, -1);
+  vector<char> in_tree(count, 0);
+  size_t current = 0;
+  in_tree[0] = 1;
+  for (size_t step = 1; step < count; step++) {
+    int a = representatives[current];
+    span<const float> row(data.row(a), data.cols);
+    size_t next = count;
+    for (size_t j = 0; j < count; j++) {
+      if (in_tree[j]) continue;
+      int b = representatives[j];
+      float dist = pairDistance(pair_distance, a, b,
+                                chordDistance(dot_product(row, span<const float>(data.row(b), data.cols))));
+      float reach = max(dist, max(core[a], core[b]));
+      if (reach < best[j]) {
+        best[j] = reach;
+        best_distance[j] = dist;
+        from[j] = a;
+      }
+      if (next == count || best[j] < best[next]) next = j;
+    }
+    edges.push_back({from[next], representatives[next], best_distance[next], best[next]});
+    in_tree[next] = 1;
+    current = next;
+  }
+  return edges;
+}
+
+// Kruskal-style merge of MST edges into a binary dendrogram. Node n + k is
+// created by the k-th merge.
+vector<LinkageNode> singleLinkage(vector<ReachabilityEdge> edges, size_t n) {
+  TraceSpan trace("single linkage", "hdbscan");
+  stable_sort(edges.begin(), edges.end(), [](const ReachabilityEdge& x, const ReachabilityEdge& y) {
+    return x.weight < y.weight;
+  });
+
+  vector<LinkageNode> tree;
+  tree.reserve(n - 1);
+  vector<int> parent(2 * n - 1);
+  for (size_t i = 0; i < parent.size(); i++) parent[i] = static_cast<int>(i);
+
+  auto size_of = [&](int node) {
+    return node < static_cast<int>(n) ? 1 : tree[node - n].size;
+  };
+  for (const ReachabilityEdge& edge : edges) {
+    int a = findRoot(parent, edge.a);
+    int b = findRoot(parent, edge.b);
+    int merged = static_cast<int>(n + tree.size());
+    tree.push_back({a, b, edge.weight, size_of(a) + size_of(b)});
+    parent[a] = merged;
+    parent[b] = merged;
+  }
+  return tree;
+}
+
+// Collapses the dendrogram so that splits producing a side smaller than
+// min_cluster_size become points leaving the parent cluster. Cluster ids
+// start at n (the root) and children always get larger ids than parents.
+vector<CondensedEdge> condenseTree(const vector<LinkageNode>& tree, size_t n, int min_cluster_size) {
+  TraceSpan trace("condense tree", "hdbscan");
+  int root = static_cast<int>(2 * n - 2);
+  vector<int> relabel(2 * n - 1, -1);
+  vector<char> ignored(2 * n - 1, 0);
+  relabel[root] = static_cast<int>(n);
+  int next_label = static_cast<int>(n) + 1;
+
+  auto size_of = [&](int node) {
+    return node < static_cast<int>(n) ? 1 : tree[node - n].size;
+  };
+
+  vector<CondensedEdge> condensed;
+  vector<int> stack;
+  auto fall_out = [&](int subtree, int cluster, double lambda) {
+    stack.assign(1, subtree);
+    while (!stack.empty()) {
+      int node = stack.back();
+      stack.pop_back();
+      ignored[node] = 1;
+      if (node < static_cast<int>(n)) {
+        condensed.push_back({cluster, node, lambda, 1});
+      } else {
+        stack.push_back(tree[node - n].left);
+        stack.push_back(tree[node - n].right);
+      }
+    }
+  };
+
+  vector<int> order{root};
+  for (size_t i = 0; i < order.size(); i++) {
+    int node = order[i];
+    if (node >= static_cast<int>(n)) {
+      order.push_back(tree[node - n].left);
+      order.push_back(tree[node - n].right);
+    }
+  }
+
+  for (int node : order) {
+    if (node < static_cast<int>(n) || ignored[node]) continue;
+    const LinkageNode& link = tree[node - n];
+    double lambda = link.distance > 0.0f ? min(MAX_LAMBDA, 1.0 / link.distance) : MAX_LAMBDA;
+    int cluster = relabel[node];
+    int left_size = size_of(link.left);
+    int right_size = size_of(link.right);
+
+    if (left_size >= min_cluster_size && right_size >= min_cluster_size) {
+      relabel[link.left] = next_label++;
+      condensed.push_back({cluster, relabel[link.left], lambda, left_size});
+      relabel[link.right] = next_label++;
+      condensed.push_back({cluster, relabel[link.right], lambda, right_size});
+    } else if (left_size < min_cluster_size && right_size < min_cluster_size) {
+      fall_out(link.left, cluster, lambda);
+      fall_out(link.right, cluster, lambda);
+    } else if (left_size < min_cluster_size) {
+      relabel[link.right] = cluster;
+      fall_out(link.left, cluster, lambda);
+    } else {
+      relabel[link.left] = cluster;
+      fall_out(link.right, cluster, lambda);
+    }
+  }
+  return condensed;
+}
+
+// Excess-of-mass selection over the condensed tree. The root is never
+// selected, so data without any split comes back as all noise.
+vector<int> selectClusters(const vector<CondensedEdge>& condensed, size_t n) {
+  TraceSpan trace("select clusters", "hdbscan");
+  int max_label = static_cast<int>(n);
+  for (const CondensedEdge& e : condensed) {
+    max_label = max(max_label, e.child);
+  }
+  size_t num_clusters = max_label - n + 1;
+
+  vector<double> birth(num_clusters, 0.0);
+  vector<int> cluster_parent(num_clusters, -1);
+  vector<vector<int>> children(num_clusters);
+  for (const CondensedEdge& e : condensed) {
+    if (e.child >= static_cast<int>(n)) {
+      birth[e.child - n] = e.lambda;
+      cluster_parent[e.child - n] = e.parent;
+      children[e.parent - n].push_back(e.child);
+    }
+  }
+
+  vector<double> stability(num_clusters, 0.0);
+  for (const CondensedEdge& e : condensed) {
+    stability[e.parent - n] += (e.lambda - birth[e.parent - n]) * e.size;
+  }
+
+  vector<char> selected(num_clusters, 0);
+  for (int c = max_label; c > static_cast<int>(n); c--) {
+    double subtree = 0.0;
+    for (int child : children[c - n]) subtree += stability[child - n];
+    if (!children[c - n].empty() && subtree > stability[c - n]) {
+      stability[c - n] = subtree;
+    } else {
+      selected[c - n] = 1;
+      vector<int> stack(children[c - n]);
+      while (!stack.empty()) {
+        int d = stack.back();
+        stack.pop_back();
+        selected[d - n] = 0;
+        stack.insert(stack.end(), children[d - n].begin(), children[d - n].end());
+      }
+    }
+  }
+
+  vector<int> cluster_label(num_clusters, -1);
+  int next = 0;
+  for (size_t c = 0; c < num_clusters; c++) {
+    if (selected[c]) cluster_label[c] = next++;
+  }
+
+  vector<int> labels(n, -1);
+  for (const CondensedEdge& e : condensed) {
+    if (e.child >= static_cast<int>(n)) continue;
+    int c = e.parent;
+    while (c != static_cast<int>(n) && !selected[c - n]) {
+      c = cluster_parent[c - n];
+    }
+    if (c != static_cast<int>(n)) {
+      labels[e.child] = cluster_label[c - n];
+    }
+  }
+  return labels;
+}
+
+} // namespace
+
+HDBSCANClustering::HDBSCANClustering(int min_cluster_size, int min_pts, size_t exact_limit,
+                                     HNSWOptions ann_options)
+    : min_cluster_size(min_cluster_size), min_pts(min_pts), exact_limit(exact_limit),
+      ann_options(ann_options) {}
 
 HDBSCANClustering::~HDBSCANClustering() {}
 
 void HDBSCANClustering::fit(const vector<vector<float>>& data) {
+  EmbeddingMatrix matrix = EmbeddingMatrix::fromRows(data);
+  matrix.normalizeRows();
+  fit(matrix);
+}
+
+void HDBSCANClustering::fit(const EmbeddingMatrix& data, const HNSWIndex* index) {
   clusters.clear();
   labels.clear();
+  model = {};
 
-  if (data.empty()) {
+  size_t n = data.rows;
+  if (n == 0) {
     return;
   }
 
-  Hdbscan hdbscan("");
+  int cluster_size = max(2, min_cluster_size);
+  if (n < static_cast<size_t>(cluster_size)) {
+    labels.assign(n, -1);
+    collectClusters();
+    return;
+  }
 
-  hdbscan.dataset.resize(data.size());
-  for (size_t i = 0; i < data.size(); i++) {
-    hdbscan.dataset[i].resize(data[i].size());
-    for (size_t j = 0; j < data[i].size(); j++) {
-      hdbscan.dataset[i][j] = static_cast<double>(data[i][j]);
+  size_t k = min(static_cast<size_t>(max(min_pts - 1, 0)), n - 1);
+  model.rows = n;
+  model.k = k;
+  if (!is_approximate(n)) {
+    QuantizedStore store(data, quantization);
+    vector<float> dense = distanceMatrix(store, pair_distance);
+    if (quantization != Quantization::Float32 && rerank) {
+      model.nearest = rerankedNearestDistances(dense, store, pair_distance, k);
+      vector<float> core = coreDistances(model.nearest, n, k);
+      model.mst = mutualReachabilityMST(dense, core);
+      for (ReachabilityEdge& edge : model.mst) {
+        edge.distance = pairDistance(pair_distance, edge.a, edge.b, chordDistance(store.exactSimilarity(edge.a, edge.b)));
+        edge.weight = max(edge.distance, max(core[edge.a], core[edge.b]));
+      }
+    } else {
+      model.nearest = nearestDistances(dense, n, k);
+      model.mst = mutualReachabilityMST(dense, coreDistances(model.nearest, n, k));
     }
+  } else if (index && index->size() == n) {
+    model.mst = knnMutualReachabilityMST(data, *index, pair_distance, k, model.nearest);
+  } else {
+    HNSWIndex own_index(data, ann_options);
+    {
+      TraceSpan trace("HNSW build", "hdbscan");
+      own_index.build();
+    }
+    model.mst = knnMutualReachabilityMST(data, own_index, pair_distance, k, model.nearest);
+  }
+  labelFromModel();
+}
+
+void HDBSCANClustering::fit_precomputed(const vector<float>& distances, size_t n) {
+  clusters.clear();
+  labels.clear();
+  model = {};
+  if (n == 0) {
+    return;
   }
 
-  hdbscan.execute(min_pts, min_cluster_size, "Euclidean");
+  int cluster_size = max(2, min_cluster_size);
+  if (n < static_cast<size_t>(cluster_size)) {
+    labels.assign(n, -1);
+    collectClusters();
+    return;
+  }
 
-  labels = hdbscan.normalizedLabels_;
+  size_t k = min(static_cast<size_t>(max(min_pts - 1, 0)), n - 1);
+  model.rows = n;
+  model.k = k;
+  model.nearest = nearestDistances(distances, n, k);
+  model.mst = mutualReachabilityMST(distances, coreDistances(model.nearest, n, k));
+  labelFromModel();
+}
 
-  std::unordered_map<int, vector<int>> cluster_map;
-  vector<int> noise_points;
+bool HDBSCANClustering::fit_incremental(const EmbeddingMatrix& data, const HDBSCANModel& previous,
+                                        const vector<int>& previous_row, const HNSWIndex* index) {
+  TraceSpan trace("fit_incremental", "hdbscan");
+  size_t n = data.rows;
+  size_t k = n > 0 ? min(static_cast<size_t>(max(min_pts - 1, 0)), n - 1) : 0;
+  bool usable = previous.complete() && previous.k == k && previous_row.size() == n &&
+                n >= static_cast<size_t>(max(2, min_cluster_size));
 
+  // Every previous row must still be present, exactly once
+  vector<int> current_row(usable ? previous.rows : 0, -1);
+  for (size_t i = 0; i < n && usable; i++) {
+    int p = previous_row[i];
+    if (p < 0) continue;
+    if (p >= static_cast<int>(previous.rows) || current_row[p] != -1) {
+      usable = false;
+    } else {
+      current_row[p] = static_cast<int>(i);
+    }
+  }
+  usable = usable && find(current_row.begin(), current_row.end(), -1) == current_row.end();
+  if (!usable) {
+    fit(data, index);
+    return false;
+  }
+
+  // Each touched row costs a full distance row and n candidate edges. Past
+  // what the exact path would hold (exact_limit^2 distances), the k-NN graph
+  // fit() uses above exact_limit is far cheaper.
+  size_t budget = exact_limit * exact_limit;
+  size_t num_added = count(previous_row.begin(), previous_row.end(), -1);
+  if (num_added * n > budget) {
+    fit(data, index);
+    return false;
+  }
+
+  vector<float> nearest(n * k, 0.0f);
+  vector<char> touched(n, 0);
+  vector<int> added;
+  for (size_t i = 0; i < n; i++) {
+    if (previous_row[i] < 0) {
+      touched[i] = 1;
+      added.push_back(static_cast<int>(i));
+    } else {
+      copy_n(previous.nearest.begin() + previous_row[i] * k, k, nearest.begin() + i * k);
+    }
+  }
+
+  // Full distance rows; incremental updates are small enough to skip quantization
+  QuantizedStore store(data, Quantization::Float32);
+  auto distance_row = [&](int i, vector<float>& row) {
+    row.resize(n);
+    store.similarityMany(i, 0, n, row.data());
+    for (float& d : row) d = chordDistance(d);
+    if (pair_distance) pair_distance->adjust(i, 0, n, row.data());
+    row[i] = 0.0f;
+  };
+
+  // A new point can only shrink the core distances of the points it lands near
+  vector<vector<float>> rows(n);
+  for (int i : added) {
+    distance_row(i, rows[i]);
+    if (k > 0) {
+      vector<float> scratch(rows[i]);
+      partial_sort(scratch.begin(), scratch.begin() + k + 1, scratch.end());
+      copy(scratch.begin() + 1, scratch.begin() + k + 1, nearest.begin() + i * k);
+    }
+    for (size_t j = 0; j < n && k > 0; j++) {
+      if (previous_row[j] < 0) continue;
+      float* list = nearest.data() + j * k;
+      float d = rows[i][j];
+      if (d >= list[k - 1]) continue;
+      list[k - 1] = d;
+      for (size_t c = k - 1; c > 0 && list[c] < list[c - 1]; c--) swap(list[c], list[c - 1]);
+      touched[j] = 1;
+    }
+  }
+
+  size_t num_touched = count(touched.begin(), touched.end(), 1);
+  if (2 * num_touched > n || num_touched * n > budget) {
+    fit(data, index);
+    return false;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (touched[i] && rows[i].empty()) distance_row(static_cast<int>(i), rows[i]);
+  }
+
+  // Only edges with a touched endpoint changed weight, so the new MST lies
+  // within the old MST plus those edges
+  vector<float> core = coreDistances(nearest, n, k);
+  vector<ReachabilityEdge> candidates;
+  candidates.reserve(previous.mst.size() + num_touched * n);
+  for (const ReachabilityEdge& edge : previous.mst) {
+    int a = current_row[edge.a];
+    int b = current_row[edge.b];
+    candidates.push_back({a, b, edge.distance, max(edge.distance, max(core[a], core[b]))});
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (!touched[i]) continue;
+    for (size_t j = 0; j < n; j++) {
+      if (j == i) continue;
+      candidates.push_back({static_cast<int>(i), static_cast<int>(j), rows[i][j], max(rows[i][j], max(core[i], core[j]))});
+    }
+  }
+
+  clusters.clear();
+  labels.clear();
+  model.rows = n;
+  model.k = k;
+  model.nearest = std::move(nearest);
+  model.mst = spanningForest(std::move(candidates), n);
+  labelFromModel();
+  return true;
+}
+
+void HDBSCANClustering::labelFromModel() {
+  vector<LinkageNode> tree = singleLinkage(model.mst, model.rows);
+  labels = selectClusters(condenseTree(tree, model.rows, max(2, min_cluster_size)), model.rows);
+  collectClusters();
+}
+
+// Clusters in label order, then every noise point as its own cluster
+void HDBSCANClustering::collectClusters() {
+  int num_clusters = 0;
+  for (int label : labels) {
+    num_clusters = max(num_clusters, label + 1);
+  }
+  clusters.assign(num_clusters, {});
+  vector<int> noise_points;
   for (size_t i = 0; i < labels.size(); i++) {
     if (labels[i] == -1) {
       noise_points.push_back(static_cast<int>(i));
     } else {
-      cluster_map[labels[i]].push_back(static_cast<int>(i));
+      clusters[labels[i]].push_back(static_cast<int>(i));
     }
   }
 
-  for (auto& kv : cluster_map) {
-    clusters.push_back(kv.second);
-  }
-
   for (int noise_idx : noise_points) {
     clusters.push_back({noise_idx});
   }
 }
 
+void HDBSCANClustering::set_quantization(Quantization kind, bool rerank) {
+  quantization = kind;
+  this->rerank = rerank;
+  ann_options.quantization = kind;
+  ann_options.rerank = rerank;
+}
+
 vector<vector<int>> HDBSCANClustering::get_clusters() {
   return clusters;
 }
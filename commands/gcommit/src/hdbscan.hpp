@@ -1,18 +1,83 @@
+#ifndef HDBSCAN_HPP
+#define HDBSCAN_HPP
+
 #include <vector>
+#include "embedding_matrix.hpp"
+#include "hnsw.hpp"
+#include "pair_distance.hpp"
 
 using namespace std;
 
+// Mutual reachability MST edge. distance is the plain pair distance and
+// weight = max(distance, core[a], core[b]).
+struct ReachabilityEdge {
+  int a;
+  int b;
+  float distance;
+  float weight;
+};
+
+// State left behind by fit() that fit_incremental() can extend with new
+// points instead of rebuilding the MST from scratch
+struct HDBSCANModel {
+  size_t rows = 0;
+  size_t k = 0;           // neighbors behind each core distance (min_pts - 1)
+  vector<float> nearest;  // rows x k distances to the nearest other points, ascending
+  vector<ReachabilityEdge> mst;
+
+  bool complete() const { return rows >= 2 && mst.size() + 1 == rows && nearest.size() == rows * k; }
+};
+
+// HDBSCAN over unit-normalized embeddings using the chord distance
+// sqrt(2 - 2 cos), which orders points exactly like cosine distance.
+// Up to exact_limit points the mutual reachability MST is exact; above it,
+// core distances and MST edges come from an approximate k-NN graph.
 class HDBSCANClustering {
 private:
   vector<vector<int>> clusters;
   vector<int> labels;
   int min_cluster_size;
   int min_pts;
+  size_t exact_limit;
+  HNSWOptions ann_options;
+  Quantization quantization = Quantization::Float32;
+  bool rerank = true;
+  const PairDistance* pair_distance = nullptr;
+  HDBSCANModel model;
+
+  void collectClusters();
+  void labelFromModel();
 
 public:
-  HDBSCANClustering(int min_cluster_size = 2, int min_pts = 2);
+  HDBSCANClustering(int min_cluster_size = 2, int min_pts = 2, size_t exact_limit = 4096,
+                    HNSWOptions ann_options = {});
   void fit(const vector<vector<float>>& data);
+  // Rows must already be unit-normalized. A prebuilt index over the same
+  // matrix is reused on the approximate path instead of building one.
+  void fit(const EmbeddingMatrix& data, const HNSWIndex* index = nullptr);
+  // Clusters from an n x n row-major symmetric distance matrix
+  void fit_precomputed(const vector<float>& distances, size_t n);
+  // Extends a previous model with the rows it has not seen. previous_row[i]
+  // is row i's index in the previous model or -1 if it is new. Only the new
+  // rows and the rows whose core distance they shrink get fresh distances;
+  // everything else keeps the distances it was fitted with. Falls back to
+  // fit(data, index) when previous rows are missing, most rows would be
+  // touched, or the touched rows' n distances each would outgrow the
+  // exact_limit^2 the exact path allows. Returns true if the update was
+  // incremental.
+  bool fit_incremental(const EmbeddingMatrix& data, const HDBSCANModel& previous, const vector<int>& previous_row,
+                       const HNSWIndex* index = nullptr);
+  bool is_approximate(size_t num_points) const { return num_points > exact_limit; }
+  // Combine chord distances with extra per-pair terms; the object must
+  // outlive fit(). nullptr restores plain embedding distances.
+  void set_pair_distance(const PairDistance* distance) { pair_distance = distance; }
+  // Compute distances on int8/fp16 codes. With rerank, core distances and
+  // MST edge weights are recomputed at full precision.
+  void set_quantization(Quantization kind, bool rerank = true);
   vector<vector<int>> get_clusters();
   vector<int> get_labels();
+  const HDBSCANModel& get_model() const { return model; }
   ~HDBSCANClustering();
 };
+
+#endif // HDBSCAN_HPP
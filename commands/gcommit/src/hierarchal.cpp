@@ -1,71 +1,230 @@
-// DEPRECATED: Use hdbscan.hpp instead. Kept for reference.
-// This implementation uses single-linkage which causes chaining issues.
-// See .plans/01-hdbscan.md for migration details.
-
 #include "hierarchal.hpp"
+#include "distance.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
 
-void print_dist_mat(vector<vector<float>>& dist_mat) {
-  for (int i = 0; i < dist_mat.size(); i++) {
-    for (int j = 0; j < dist_mat.size(); j++) {
-      cout << dist_mat[i][j] << " ";
-    }
-    cout << endl;
-  }
+Linkage parseLinkage(const string& name) {
+  if (name == "single") return Linkage::Single;
+  if (name == "complete") return Linkage::Complete;
+  if (name == "average") return Linkage::Average;
+  throw invalid_argument("unknown linkage '" + name + "' (expected single, complete or average)");
 }
-HierachicalClustering::HierachicalClustering() {}
-
-void HierachicalClustering::cluster(vector<vector<float>> data, float distance_threshold) {
-  // Initialize distance matrix
-  vector<vector<float>> dist_mat(data.size(), vector<float>(data.size(), -1));
-  
-  for (int i = 0; i < data.size(); i++) {
-    clusters.push_back({i});
+
+string linkageName(Linkage linkage) {
+  switch (linkage) {
+    case Linkage::Single: return "single";
+    case Linkage::Complete: return "complete";
+    default: return "average";
   }
+}
+
+namespace {
 
-  // Calculate initial pairwise distances
-  for (int i = 0; i < data.size(); i++) {
-    for (int j = i + 1; j < data.size(); j++) {
-      dist_mat[i][j] = 1 - cos_sim(data[i], data[j]);
+struct UnionFind {
+  vector<int> parent;
+
+  UnionFind(size_t n) : parent(n) { iota(parent.begin(), parent.end(), 0); }
+  int find(int x) {
+    while (parent[x] != x) {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
     }
+    return x;
+  }
+  int unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    parent[a] = b;
+    return b;
   }
+};
 
-  while (clusters.size() > 1) {
-    float min_dist = numeric_limits<float>::infinity();
-    int min_i = -1;
-    int min_j = -1;
-    
-    // Find closest pair of clusters
-    for (int i = 0; i < clusters.size(); i++) {
-      for (int j = i + 1; j < clusters.size(); j++) {
-        float cluster_dist = numeric_limits<float>::infinity();
-        for (int pi : clusters[i]) {
-          for (int pj : clusters[j]) {
-            if (dist_mat[pi][pj] < cluster_dist) {
-              cluster_dist = dist_mat[pi][pj];
-            }
-          }
-        }
-        if (cluster_dist < min_dist) {
-          min_dist = cluster_dist;
-          min_i = i;
-          min_j = j;
+// Index of (i, j), i < j, in a row-major condensed upper triangle
+inline size_t condensedIndex(size_t n, size_t i, size_t j) {
+  return i * (2 * n - i - 1) / 2 + (j - i - 1);
+}
+
+inline float cosineDistance(float similarity) {
+  return max(0.0f, 1.0f - similarity);
+}
+
+} // namespace
+
+HierachicalClustering::HierachicalClustering(Linkage linkage) : linkage(linkage) {}
+
+void HierachicalClustering::fitNNChain(const EmbeddingMatrix& data) {
+  size_t n = data.rows;
+  vector<float> dist(n * (n - 1) / 2);
+  parallelFor(n - 1, [&](size_t i) {
+    float* out = dist.data() + condensedIndex(n, i, i + 1);
+    size_t count = n - i - 1;
+    dot_product_many(span<const float>(data.row(i), data.cols), data.row(i + 1), count, data.cols, out);
+    for (size_t k = 0; k < count; k++) out[k] = cosineDistance(out[k]);
+  });
+  auto at = [&](int a, int b) -> float& {
+    return a < b ? dist[condensedIndex(n, a, b)] : dist[condensedIndex(n, b, a)];
+  };
+
+  vector<int> sizes(n, 1);
+  vector<int> active(n);
+  iota(active.begin(), active.end(), 0);
+  vector<int> chain;
+  vector<pair<pair<int, int>, float>> merges;
+
+  while (active.size() > 1) {
+    if (chain.empty()) {
+      chain.push_back(active.front());
+    }
+
+    // Grow the chain until its last two clusters are reciprocal nearest neighbors
+    int a, b;
+    float best;
+    while (true) {
+      a = chain.back();
+      int prev = chain.size() >= 2 ? chain[chain.size() - 2] : -1;
+      b = prev;
+      best = prev >= 0 ? at(a, prev) : numeric_limits<float>::infinity();
+      for (int k : active) {
+        if (k != a && at(a, k) < best) {
+          best = at(a, k);
+          b = k;
         }
       }
+      if (b == prev) break;
+      chain.push_back(b);
+    }
+    chain.pop_back();
+    chain.pop_back();
+    merges.push_back({{a, b}, best});
+
+    // Merged cluster lives on in slot b
+    float size_a = sizes[a];
+    float size_b = sizes[b];
+    for (int k : active) {
+      if (k == a || k == b) continue;
+      float da = at(a, k);
+      float& db = at(b, k);
+      switch (linkage) {
+        case Linkage::Complete: db = max(da, db); break;
+        case Linkage::Single: db = min(da, db); break;
+        default: db = (size_a * da + size_b * db) / (size_a + size_b); break;
+      }
     }
+    sizes[b] += sizes[a];
+    active.erase(find(active.begin(), active.end(), a));
+  }
+
+  buildDendrogram(merges);
+}
+
+void HierachicalClustering::fitSingleLinkage(const EmbeddingMatrix& data) {
+  size_t n = data.rows;
+  vector<float> best(n, numeric_limits<float>::infinity());
+  vector<int> nearest(n, -1);
+  vector<char> in_tree(n, 0);
+  vector<float> row(n);
+  vector<pair<pair<int, int>, float>> merges;
+
+  int current = 0;
+  for (size_t step = 1; step < n; step++) {
+    in_tree[current] = 1;
+    dot_product_many(span<const float>(data.row(current), data.cols), data.data.data(), n, data.cols, row.data());
 
-    if (min_dist > distance_threshold) {
-      break;
+    int next = -1;
+    for (size_t k = 0; k < n; k++) {
+      if (in_tree[k]) continue;
+      float d = cosineDistance(row[k]);
+      if (d < best[k]) {
+        best[k] = d;
+        nearest[k] = current;
+      }
+      if (next < 0 || best[k] < best[next]) {
+        next = static_cast<int>(k);
+      }
     }
+    merges.push_back({{nearest[next], next}, best[next]});
+    current = next;
+  }
+
+  buildDendrogram(merges);
+}
+
+// Sorting by distance turns MST edges into single-linkage merges, and puts
+// NN-chain merges (found out of order) into dendrogram order.
+void HierachicalClustering::buildDendrogram(vector<pair<pair<int, int>, float>>& merges) {
+  stable_sort(merges.begin(), merges.end(), [](const auto& x, const auto& y) { return x.second < y.second; });
+
+  UnionFind sets(num_points);
+  vector<int> node_id(num_points);
+  vector<int> node_size(num_points, 1);
+  iota(node_id.begin(), node_id.end(), 0);
+
+  for (const auto& [pair_ab, distance] : merges) {
+    int ra = sets.find(pair_ab.first);
+    int rb = sets.find(pair_ab.second);
+    int size = node_size[ra] + node_size[rb];
+    dendrogram.push_back({min(node_id[ra], node_id[rb]), max(node_id[ra], node_id[rb]), distance, size});
+    int root = sets.unite(ra, rb);
+    node_id[root] = static_cast<int>(num_points + dendrogram.size() - 1);
+    node_size[root] = size;
+  }
+}
+
+void HierachicalClustering::fit(const EmbeddingMatrix& data) {
+  num_points = data.rows;
+  dendrogram.clear();
+  clusters.clear();
+  if (num_points < 2) {
+    return;
+  }
+  if (linkage == Linkage::Single) {
+    fitSingleLinkage(data);
+  } else {
+    fitNNChain(data);
+  }
+}
+
+vector<vector<int>> HierachicalClustering::cut(float distance_threshold) const {
+  UnionFind sets(num_points);
+  // Node id -> a point inside it, so merges can be replayed on points.
+  // Merges are sorted by distance, so the first one above the cut ends it.
+  vector<int> representative(num_points);
+  iota(representative.begin(), representative.end(), 0);
+  for (const DendrogramNode& node : dendrogram) {
+    if (node.distance > distance_threshold) break;
+    sets.unite(representative[node.left], representative[node.right]);
+    representative.push_back(representative[node.left]);
+  }
 
-    for (int point : clusters[min_j]) {
-      clusters[min_i].push_back(point);
+  vector<vector<int>> result;
+  vector<int> cluster_of(num_points, -1);
+  for (size_t i = 0; i < num_points; i++) {
+    int root = sets.find(static_cast<int>(i));
+    if (cluster_of[root] < 0) {
+      cluster_of[root] = static_cast<int>(result.size());
+      result.push_back({});
     }
-    clusters.erase(clusters.begin() + min_j);
+    result[cluster_of[root]].push_back(static_cast<int>(i));
   }
+  return result;
+}
+
+void HierachicalClustering::cluster(const EmbeddingMatrix& data, float distance_threshold) {
+  fit(data);
+  clusters = cut(distance_threshold);
+}
+
+void HierachicalClustering::cluster(const vector<vector<float>>& data, float distance_threshold) {
+  EmbeddingMatrix matrix = EmbeddingMatrix::fromRows(data);
+  matrix.normalizeRows();
+  cluster(matrix, distance_threshold);
 }
 
 HierachicalClustering::~HierachicalClustering() {}
 
 vector<vector<int>> HierachicalClustering::get_clusters() {
   return clusters;
-}
\ No newline at end of file
+}
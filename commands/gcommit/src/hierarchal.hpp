@@ -1,16 +1,57 @@
+#ifndef HIERARCHAL_HPP
+#define HIERARCHAL_HPP
+
+#include <string>
 #include <vector>
-#include <iostream>
-#include <limits>
-#include "utils.hpp"
+#include "embedding_matrix.hpp"
 
 using namespace std;
 
+enum class Linkage { Single, Complete, Average };
+
+// Accepts "single", "complete" or "average"; throws invalid_argument otherwise
+Linkage parseLinkage(const string& name);
+string linkageName(Linkage linkage);
+
+// One merge in SciPy linkage-matrix order: ids below the number of points
+// are leaves, id n + k is the cluster created by merge k.
+struct DendrogramNode {
+  int left;
+  int right;
+  float distance;
+  int size;
+};
+
+// Agglomerative clustering on cosine distance 1 - cos. Average and complete
+// linkage run the nearest-neighbor chain algorithm on a condensed n(n-1)/2
+// matrix updated with Lance-Williams; single linkage is read off a Prim MST
+// computed row by row, so it needs only O(n) memory. Both are O(n^2).
 class HierachicalClustering {
 private:
+  Linkage linkage;
+  size_t num_points = 0;
+  vector<DendrogramNode> dendrogram;
   vector<vector<int>> clusters;
+
+  void fitNNChain(const EmbeddingMatrix& data);
+  void fitSingleLinkage(const EmbeddingMatrix& data);
+  // merges are (representative a, representative b, distance) in any order
+  void buildDendrogram(vector<pair<pair<int, int>, float>>& merges);
+
 public:
-  HierachicalClustering();
-  void cluster(vector<vector<float>> data, float distance_threshold = 0.5);
+  // Single linkage is the original behaviour of cluster(); gcommit's
+  // --strategy hierarchical asks for average linkage explicitly
+  HierachicalClustering(Linkage linkage = Linkage::Single);
+  void cluster(const vector<vector<float>>& data, float distance_threshold = 0.5);
+  // Rows must already be unit-normalized
+  void cluster(const EmbeddingMatrix& data, float distance_threshold = 0.5);
+  // Builds the dendrogram without cutting it
+  void fit(const EmbeddingMatrix& data);
+  // Clusters joined at distance <= threshold, ordered by smallest member
+  vector<vector<int>> cut(float distance_threshold) const;
+  const vector<DendrogramNode>& get_dendrogram() const { return dendrogram; }
   vector<vector<int>> get_clusters();
   ~HierachicalClustering();
 };
+
+#endif // HIERARCHAL_HPP
@@ -0,0 +1,125 @@
+#include "hybrid_distance.hpp"
+#include "hashing.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+HybridDistance::HybridDistance(const vector<DiffChunk>& chunks, HybridWeights weights)
+    : weights(weights), num_chunks(chunks.size()), path_prefixes(MAX_DEPTH * chunks.size()),
+      path_depth(chunks.size(), 0.0f), symbol_id(chunks.size(), 0), scope_id(chunks.size(), 0),
+      position(chunks.size(), 0) {
+  unordered_map<string, int> seen_in_file;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    const DiffChunk& chunk = chunks[i];
+    const ChunkFingerprint& fp = chunk.fingerprint;
+
+    uint64_t prefix = fnv1a64("");
+    size_t depth = 0;
+    size_t begin = 0;
+    while (begin <= chunk.filepath.size() && depth < MAX_DEPTH) {
+      size_t end = chunk.filepath.find('/', begin);
+      if (end == string::npos) end = chunk.filepath.size();
+      prefix = fnv1a64(string_view(chunk.filepath).substr(begin, end - begin), splitmix64(prefix));
+      path_prefixes[depth++ * num_chunks + i] = static_cast<uint32_t>(prefix) | 1;
+      begin = end + 1;
+    }
+    path_depth[i] = static_cast<float>(depth);
+    for (size_t d = depth; d < MAX_DEPTH; d++) {
+      path_prefixes[d * num_chunks + i] = static_cast<uint32_t>(2 * i);
+    }
+
+    // Ids are hashes forced odd so 0 can mean "no declaration"
+    uint64_t scope = fnv1a64(chunk.filepath);
+    for (size_t s = 0; s + 1 < fp.symbols.size(); s++) {
+      scope = fnv1a64(fp.symbols[s], splitmix64(scope));
+    }
+    scope_id[i] = static_cast<uint32_t>(scope) | 1;
+    if (!fp.symbols.empty()) {
+      symbol_id[i] = static_cast<uint32_t>(fnv1a64(fp.symbols.back(), splitmix64(scope))) | 1;
+    }
+    position[i] = seen_in_file[chunk.filepath]++;
+  }
+  buildSharedIdentifiers(chunks);
+}
+
+void HybridDistance::buildSharedIdentifiers(const vector<DiffChunk>& chunks) {
+  size_t n = chunks.size();
+  unordered_map<string_view, vector<int>> postings;
+  for (size_t i = 0; i < n; i++) {
+    for (const string& ident : chunks[i].fingerprint.identifiers) {
+      postings[ident].push_back(static_cast<int>(i));
+    }
+  }
+  size_t max_postings = max<size_t>(2, static_cast<size_t>(weights.boilerplate_fraction * n));
+  vector<int> kept(n, 0);
+  for (const auto& [ident, chunk_ids] : postings) {
+    if (chunk_ids.size() > max_postings) continue;
+    for (int i : chunk_ids) kept[i]++;
+  }
+
+  // Intersection sizes of every pair sharing a kept identifier
+  shared_identifiers.assign(n, {});
+  vector<int> shared(n, 0);
+  vector<int> touched;
+  for (size_t i = 0; i < n; i++) {
+    for (const string& ident : chunks[i].fingerprint.identifiers) {
+      const vector<int>& chunk_ids = postings[ident];
+      if (chunk_ids.size() > max_postings) continue;
+      for (int j : chunk_ids) {
+        if (j == static_cast<int>(i)) continue;
+        if (shared[j]++ == 0) touched.push_back(j);
+      }
+    }
+    sort(touched.begin(), touched.end());
+    for (int j : touched) {
+      float jaccard = static_cast<float>(shared[j]) / (kept[i] + kept[j] - shared[j]);
+      shared_identifiers[i].push_back({j, jaccard});
+      shared[j] = 0;
+    }
+    touched.clear();
+  }
+}
+
+// Dense terms for columns [base, base + WIDTH). WIDTH is a compile-time
+// constant for full tiles so the loops vectorize without a remainder.
+template <size_t WIDTH>
+void HybridDistance::denseTerms(size_t i, size_t base, float* out) const {
+  // Edges between the two files in the directory tree (0 for the same
+  // file); prefix hashes match exactly up to the deepest common directory
+  float common[WIDTH] = {};
+  for (size_t d = 0; d < MAX_DEPTH; d++) {
+    const uint32_t* prefix = path_prefixes.data() + d * num_chunks + base;
+    uint32_t mine = path_prefixes[d * num_chunks + i];
+    for (size_t c = 0; c < WIDTH; c++) common[c] += prefix[c] == mine ? 1.0f : 0.0f;
+  }
+
+  const float* depth = path_depth.data() + base;
+  const uint32_t* symbol = symbol_id.data() + base;
+  const uint32_t* scope = scope_id.data() + base;
+  const int* pos = position.data() + base;
+  for (size_t c = 0; c < WIDTH; c++) {
+    float tree = path_depth[i] + depth[c] - 2.0f * common[c];
+    int gap = pos[c] - position[i];
+    bool adjacent = (symbol_id[i] != 0 && symbol[c] == symbol_id[i]) || (scope[c] == scope_id[i] && gap * gap == 1);
+    out[c] = weights.embedding * out[c] + weights.path * tree / (tree + 2.0f) + weights.identifiers -
+             (adjacent ? weights.adjacency : 0.0f);
+  }
+}
+
+void HybridDistance::adjust(size_t i, size_t j0, size_t count, float* distances) const {
+  const size_t TILE = 64;
+  size_t full = count - count % TILE;
+  for (size_t t0 = 0; t0 < full; t0 += TILE) {
+    denseTerms<TILE>(i, j0 + t0, distances + t0);
+  }
+  for (size_t t0 = full; t0 < count; t0++) {
+    denseTerms<1>(i, j0 + t0, distances + t0);
+  }
+
+  const vector<pair<int, float>>& row = shared_identifiers[i];
+  auto it = lower_bound(row.begin(), row.end(), make_pair(static_cast<int>(j0), 0.0f));
+  for (; it != row.end() && it->first < static_cast<int>(j0 + count); ++it) {
+    distances[it->first - j0] -= weights.identifiers * it->second;
+  }
+
+  for (size_t c = 0; c < count; c++) distances[c] = max(0.0f, distances[c]);
+}
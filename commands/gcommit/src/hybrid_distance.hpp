@@ -0,0 +1,52 @@
+#ifndef HYBRID_DISTANCE_HPP
+#define HYBRID_DISTANCE_HPP
+
+#include <cstdint>
+#include <vector>
+#include "diffreader.hpp"
+#include "pair_distance.hpp"
+
+using namespace std;
+
+struct HybridWeights {
+  float embedding = 1.0f;    // scales the embedding distance
+  float path = 0.2f;         // directory-tree distance between the two files
+  float identifiers = 0.2f;  // 1 - Jaccard of changed identifiers
+  float adjacency = 0.3f;    // subtracted for chunks in the same declaration or neighboring siblings
+  float boilerplate_fraction = 0.1f;
+};
+
+// Embedding distance plus structural terms from each chunk's path and
+// fingerprint. Per-chunk features are stored column-wise so the dense part
+// is a branch-free pass over a tile of columns inside the clustering's
+// blocked distance loop. Identifier overlap is exact Jaccard, precomputed
+// sparsely from an inverted index; identifiers found in more than
+// boilerplate_fraction of the chunks are ignored, since shared boilerplate
+// is what wrongly pulls unrelated chunks together.
+class HybridDistance : public PairDistance {
+private:
+  static const size_t MAX_DEPTH = 8;
+
+  HybridWeights weights;
+  size_t num_chunks;
+  // prefix[d * n + i] = hash of the first d+1 path components of chunk i;
+  // slots past the path's depth hold a value unique to the chunk
+  vector<uint32_t> path_prefixes;
+  vector<float> path_depth;
+  // Nonzero identifier Jaccard similarities of each chunk, sorted by chunk
+  vector<vector<pair<int, float>>> shared_identifiers;
+  vector<uint32_t> symbol_id;  // file + innermost declaration, 0 = none
+  vector<uint32_t> scope_id;   // file + enclosing declarations minus the innermost
+  vector<int> position;        // index among the chunks of the same file
+
+  void buildSharedIdentifiers(const vector<DiffChunk>& chunks);
+  template <size_t WIDTH>
+  void denseTerms(size_t i, size_t base, float* out) const;
+
+public:
+  HybridDistance(const vector<DiffChunk>& chunks, HybridWeights weights = {});
+
+  void adjust(size_t i, size_t j0, size_t count, float* distances) const override;
+};
+
+#endif // HYBRID_DISTANCE_HPP
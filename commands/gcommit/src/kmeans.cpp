@@ -1,49 +1,296 @@
 #include "kmeans.hpp"
+#include "distance.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
 
+namespace {
 
+const size_t ASSIGN_BLOCK = 256;
 
+span<const float> rowSpan(const EmbeddingMatrix& m, size_t i) {
+  return span<const float>(m.row(i), m.cols);
+}
+
+} // namespace
+
+KMeans::KMeans(int k, KMeansOptions options) : k(max(1, k)), options(options) {}
 
-KMeans::KMeans(int k, int max_iter, int dim) : k(k), max_iter(max_iter) {
-  centroids = vector<vector<float>>(k, vector<float>(dim));
+float KMeans::assign(const EmbeddingMatrix& data, const EmbeddingMatrix& centers, vector<int>& out) const {
+  out.resize(data.rows);
+  size_t blocks = (data.rows + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+  vector<double> block_inertia(blocks, 0.0);
+  parallelFor(blocks, [&](size_t b) {
+    vector<float> dist(centers.rows);
+    size_t end = min(data.rows, (b + 1) * ASSIGN_BLOCK);
+    for (size_t i = b * ASSIGN_BLOCK; i < end; i++) {
+      l2_squared_many(rowSpan(data, i), centers.data.data(), centers.rows, centers.cols, dist.data());
+      size_t best = min_element(dist.begin(), dist.end()) - dist.begin();
+      out[i] = static_cast<int>(best);
+      block_inertia[b] += dist[best];
+    }
+  }, options.num_threads);
+  return static_cast<float>(accumulate(block_inertia.begin(), block_inertia.end(), 0.0));
 }
 
-void KMeans::fit(vector<vector<float>> data) {
+// Each new center is drawn with probability proportional to its squared
+// distance from the nearest center chosen so far (Arthur & Vassilvitskii)
+EmbeddingMatrix KMeans::seedPlusPlus(const EmbeddingMatrix& data, uint64_t seed) const {
+  mt19937_64 rng(seed);
+  EmbeddingMatrix centers(k, data.cols);
+  vector<float> nearest(data.rows, numeric_limits<float>::infinity());
+
+  size_t chosen = uniform_int_distribution<size_t>(0, data.rows - 1)(rng);
+  for (int c = 0; c < k; c++) {
+    copy(data.row(chosen), data.row(chosen) + data.cols, centers.row(c));
+    if (c + 1 == k) break;
 
-    random_device rnd_device;
-    mt19937 mersenne_engine {rnd_device()}; 
-    uniform_real_distribution<float> dist{0.0f, 1.0f};
-    
-    auto gen = [&](){
-                   return dist(mersenne_engine);
-               };
+    span<const float> center = rowSpan(centers, c);
+    parallelFor((data.rows + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK, [&](size_t b) {
+      size_t end = min(data.rows, (b + 1) * ASSIGN_BLOCK);
+      for (size_t i = b * ASSIGN_BLOCK; i < end; i++) {
+        nearest[i] = min(nearest[i], l2_squared(center, rowSpan(data, i)));
+      }
+    }, options.num_threads);
 
-    for (int i = 0; i < k; i++) {
-        generate(centroids[i].begin(), centroids[i].end(), gen);
+    double total = accumulate(nearest.begin(), nearest.end(), 0.0);
+    if (total <= 0.0) {
+      // Fewer distinct points than k; duplicates are harmless
+      chosen = uniform_int_distribution<size_t>(0, data.rows - 1)(rng);
+      continue;
     }
-    int curr_iter = 0;
-    while (curr_iter < max_iter) {
-        vector<vector<float>> new_centroids(k, vector<float>(dim));
-        for (int i = 0; i < k; i++) {
-            generate(new_centroids[i].begin(), new_centroids[i].end(), gen);
-        }
-        curr_iter++;
+    double target = uniform_real_distribution<double>(0.0, total)(rng);
+    chosen = data.rows - 1;
+    for (size_t i = 0; i < data.rows; i++) {
+      target -= nearest[i];
+      if (target <= 0.0) {
+        chosen = i;
+        break;
+      }
     }
+  }
+  return centers;
+}
+
+// A point only leaves a cluster that keeps at least one other member, so
+// with data.rows >= k every cluster ends up non-empty
+float KMeans::fillEmptyClusters(const EmbeddingMatrix& data, EmbeddingMatrix& centers, vector<int>& assignment) const {
+  vector<size_t> counts(k, 0);
+  for (int c : assignment) counts[c]++;
+  if (find(counts.begin(), counts.end(), 0) == counts.end()) {
+    return 0.0f;
+  }
+
+  vector<float> dist(data.rows);
+  parallelFor(data.rows, [&](size_t i) {
+    dist[i] = l2_squared(rowSpan(data, i), rowSpan(centers, assignment[i]));
+  }, options.num_threads);
+  vector<size_t> order(data.rows);
+  iota(order.begin(), order.end(), 0);
+  stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return dist[a] > dist[b]; });
+
+  float removed = 0.0f;
+  size_t next = 0;
+  for (int c = 0; c < k && next < order.size(); c++) {
+    if (counts[c] > 0) continue;
+    while (next < order.size() && counts[assignment[order[next]]] < 2) next++;
+    if (next == order.size()) break;
+    size_t i = order[next++];
+    counts[assignment[i]]--;
+    counts[c] = 1;
+    assignment[i] = c;
+    copy(data.row(i), data.row(i) + data.cols, centers.row(c));
+    removed += dist[i];
+  }
+  return removed;
 }
 
-int KMeans::predict(vector<float> data) {
-    // Find closest centroid
-    int closest_cluster = 0;
-    float min_distance = INFINITY;
-    
-    for (int i = 0; i < k; i++) {
-        float distance = 0;
-        for (int j = 0; j < data.size(); j++) {
-            distance += (data[j] - centroids[i][j]) * (data[j] - centroids[i][j]);
-        }
-        if (distance < min_distance) {
-            min_distance = distance;
-            closest_cluster = i;
-        }
+void KMeans::lloyd(const EmbeddingMatrix& data, EmbeddingMatrix& centers) const {
+  vector<int> assignment;
+  for (size_t iter = 0; iter < options.max_iter; iter++) {
+    assign(data, centers, assignment);
+    fillEmptyClusters(data, centers, assignment);
+
+    EmbeddingMatrix sums(k, data.cols);
+    vector<size_t> counts(k, 0);
+    for (size_t i = 0; i < data.rows; i++) {
+      float* sum = sums.row(assignment[i]);
+      const float* x = data.row(i);
+      for (size_t d = 0; d < data.cols; d++) sum[d] += x[d];
+      counts[assignment[i]]++;
+    }
+
+    float max_shift = 0.0f;
+    for (int c = 0; c < k; c++) {
+      if (counts[c] == 0) continue;
+      float* sum = sums.row(c);
+      for (size_t d = 0; d < data.cols; d++) sum[d] /= counts[c];
+      max_shift = max(max_shift, l2_squared(rowSpan(sums, c), rowSpan(centers, c)));
+      copy(sum, sum + data.cols, centers.row(c));
     }
-    return closest_cluster;
-}
\ No newline at end of file
+    if (sqrt(max_shift) <= options.tolerance) {
+      break;
+    }
+  }
+}
+
+// Per-center learning rate 1/count, so every center converges to the mean
+// of the points it has been assigned so far
+void KMeans::miniBatch(const EmbeddingMatrix& data, EmbeddingMatrix& centers, uint64_t seed) const {
+  mt19937_64 rng(seed ^ 0x9e3779b97f4a7c15ULL);
+  uniform_int_distribution<size_t> pick(0, data.rows - 1);
+  vector<size_t> counts(k, 0);
+  EmbeddingMatrix batch(options.batch_size, data.cols);
+  vector<int> assignment;
+
+  for (size_t iter = 0; iter < options.max_iter; iter++) {
+    for (size_t b = 0; b < batch.rows; b++) {
+      size_t i = pick(rng);
+      copy(data.row(i), data.row(i) + data.cols, batch.row(b));
+    }
+    assign(batch, centers, assignment);
+
+    EmbeddingMatrix before = centers;
+    for (size_t b = 0; b < batch.rows; b++) {
+      int c = assignment[b];
+      float eta = 1.0f / ++counts[c];
+      float* center = centers.row(c);
+      const float* x = batch.row(b);
+      for (size_t d = 0; d < data.cols; d++) center[d] += eta * (x[d] - center[d]);
+    }
+
+    float max_shift = 0.0f;
+    for (int c = 0; c < k; c++) {
+      max_shift = max(max_shift, l2_squared(rowSpan(before, c), rowSpan(centers, c)));
+    }
+    if (sqrt(max_shift) <= options.tolerance) {
+      break;
+    }
+  }
+}
+
+void KMeans::fit(const EmbeddingMatrix& data) {
+  labels.clear();
+  inertia = 0.0f;
+  if (data.rows == 0) {
+    centroids = EmbeddingMatrix();
+    return;
+  }
+  k = min<int>(k, data.rows);
+
+  inertia = numeric_limits<float>::infinity();
+  for (size_t run = 0; run < max<size_t>(1, options.n_init); run++) {
+    uint64_t seed = options.seed + run * 0x2545f4914f6cdd1dULL;
+    EmbeddingMatrix centers = seedPlusPlus(data, seed);
+    if (data.rows > options.batch_size && options.batch_size > 0) {
+      miniBatch(data, centers, seed);
+    } else {
+      lloyd(data, centers);
+    }
+
+    vector<int> assignment;
+    float run_inertia = assign(data, centers, assignment);
+    run_inertia -= fillEmptyClusters(data, centers, assignment);
+    if (run_inertia < inertia) {
+      inertia = run_inertia;
+      centroids = std::move(centers);
+      labels = std::move(assignment);
+    }
+  }
+}
+
+int KMeans::predict(span<const float> data) const {
+  if (centroids.rows == 0) {
+    return -1;
+  }
+  vector<float> dist(centroids.rows);
+  l2_squared_many(data, centroids.data.data(), centroids.rows, centroids.cols, dist.data());
+  return static_cast<int>(min_element(dist.begin(), dist.end()) - dist.begin());
+}
+
+vector<vector<int>> KMeans::get_clusters() const {
+  vector<vector<int>> clusters;
+  vector<int> slot(k, -1);
+  for (size_t i = 0; i < labels.size(); i++) {
+    int c = labels[i];
+    if (slot[c] < 0) {
+      slot[c] = static_cast<int>(clusters.size());
+      clusters.push_back({});
+    }
+    clusters[slot[c]].push_back(static_cast<int>(i));
+  }
+  return clusters;
+}
+
+float silhouetteScore(const EmbeddingMatrix& data, const vector<int>& labels, size_t sample_limit, uint64_t seed) {
+  vector<size_t> sample(data.rows);
+  iota(sample.begin(), sample.end(), 0);
+  if (sample.size() > sample_limit) {
+    mt19937_64 rng(seed);
+    shuffle(sample.begin(), sample.end(), rng);
+    sample.resize(sample_limit);
+  }
+  int num_labels = labels.empty() ? 0 : *max_element(labels.begin(), labels.end()) + 1;
+  if (num_labels < 2) {
+    return 0.0f;
+  }
+
+  EmbeddingMatrix points(sample.size(), data.cols);
+  vector<int> point_labels(sample.size());
+  vector<size_t> label_counts(num_labels, 0);
+  for (size_t s = 0; s < sample.size(); s++) {
+    copy(data.row(sample[s]), data.row(sample[s]) + data.cols, points.row(s));
+    point_labels[s] = labels[sample[s]];
+    label_counts[point_labels[s]]++;
+  }
+
+  vector<float> scores(sample.size(), 0.0f);
+  parallelFor(sample.size(), [&](size_t s) {
+    vector<float> dist(sample.size());
+    l2_squared_many(rowSpan(points, s), points.data.data(), points.rows, points.cols, dist.data());
+    vector<double> sums(num_labels, 0.0);
+    for (size_t t = 0; t < sample.size(); t++) {
+      sums[point_labels[t]] += sqrt(max(0.0f, dist[t]));
+    }
+
+    int own = point_labels[s];
+    if (label_counts[own] < 2) {
+      return;  // singletons score 0
+    }
+    double a = sums[own] / (label_counts[own] - 1);
+    double b = numeric_limits<double>::infinity();
+    for (int c = 0; c < num_labels; c++) {
+      if (c != own && label_counts[c] > 0) {
+        b = min(b, sums[c] / label_counts[c]);
+      }
+    }
+    double denom = max(a, b);
+    scores[s] = denom > 0.0 ? static_cast<float>((b - a) / denom) : 0.0f;
+  });
+  return accumulate(scores.begin(), scores.end(), 0.0f) / scores.size();
+}
+
+KMeans selectK(const EmbeddingMatrix& data, int k_min, int k_max, KMeansOptions options, vector<float>* scores) {
+  k_min = max(2, k_min);
+  k_max = min<int>(k_max, static_cast<int>(data.rows) - 1);
+  KMeans best(1, options);
+  float best_score = -numeric_limits<float>::infinity();
+  if (k_max < k_min) {
+    best.fit(data);
+    return best;
+  }
+  for (int k = k_min; k <= k_max; k++) {
+    KMeans model(k, options);
+    model.fit(data);
+    float score = silhouetteScore(data, model.get_labels(), 2000, options.seed);
+    if (scores) scores->push_back(score);
+    if (score > best_score) {
+      best_score = score;
+      best = std::move(model);
+    }
+  }
+  return best;
+}
@@ -1,19 +1,65 @@
+#ifndef KMEANS_HPP
+#define KMEANS_HPP
+
+#include <cstdint>
+#include <span>
 #include <vector>
-#include <algorithm>
-#include <random>
+#include "embedding_matrix.hpp"
 
 using namespace std;
 
+struct KMeansOptions {
+  size_t max_iter = 100;
+  // Points sampled per mini-batch update (Sculley 2010). Data sets no larger
+  // than this run full Lloyd iterations instead.
+  size_t batch_size = 1024;
+  size_t n_init = 3;        // seedings tried; the lowest inertia wins
+  float tolerance = 1e-4f;  // stop when no centroid moves further than this
+  size_t num_threads = 0;   // 0 = one per core
+  uint64_t seed = 42;
+};
+
+// k-means on the rows of an EmbeddingMatrix with k-means++ seeding.
+// Assignment runs in parallel on the SIMD distance kernels.
 class KMeans {
 private:
-    int k;
-    int max_iter;
-    vector<vector<float>> centroids;
-    int dim;
+  int k;
+  KMeansOptions options;
+  EmbeddingMatrix centroids;
+  vector<int> labels;
+  float inertia = 0.0f;
+
+  // Nearest centroid of each row and the summed squared distance
+  float assign(const EmbeddingMatrix& data, const EmbeddingMatrix& centers, vector<int>& out) const;
+  EmbeddingMatrix seedPlusPlus(const EmbeddingMatrix& data, uint64_t seed) const;
+  // Moves the points farthest from their centers into empty clusters. Returns
+  // how much the inertia dropped.
+  float fillEmptyClusters(const EmbeddingMatrix& data, EmbeddingMatrix& centers, vector<int>& assignment) const;
+  void lloyd(const EmbeddingMatrix& data, EmbeddingMatrix& centers) const;
+  void miniBatch(const EmbeddingMatrix& data, EmbeddingMatrix& centers, uint64_t seed) const;
+
 public:
-    KMeans(int k, int max_iter, int dim);
+  KMeans(int k, KMeansOptions options = {});
 
-    void fit(vector<vector<float>> data);
-    int predict(vector<float> data);
-    ~KMeans();
+  // Every one of the k clusters gets at least one row, unless there are
+  // fewer than k rows
+  void fit(const EmbeddingMatrix& data);
+  int predict(span<const float> data) const;
+  vector<int> get_labels() const { return labels; }
+  // Non-empty clusters, ordered by smallest member
+  vector<vector<int>> get_clusters() const;
+  const EmbeddingMatrix& get_centroids() const { return centroids; }
+  float get_inertia() const { return inertia; }
 };
+
+// Mean silhouette in [-1, 1] under Euclidean distance. Above sample_limit
+// rows it is estimated on a seeded random sample.
+float silhouetteScore(const EmbeddingMatrix& data, const vector<int>& labels, size_t sample_limit = 2000,
+                      uint64_t seed = 42);
+
+// Fits k = k_min..k_max and keeps the model with the best silhouette.
+// scores, if given, receives one score per k tried.
+KMeans selectK(const EmbeddingMatrix& data, int k_min, int k_max, KMeansOptions options = {},
+               vector<float>* scores = nullptr);
+
+#endif // KMEANS_HPP
@@ -1,12 +1,33 @@
 #include "ast.hpp"
+#include "tokenizer.hpp"
 #include "async_openai_api.hpp"
+#include "embedding_cache.hpp"
+#include "embedding_provider.hpp"
+#include "projection.hpp"
 #include "utils.hpp"
 #include "hdbscan.hpp"
+#include "hybrid_distance.hpp"
+#include "hierarchal.hpp"
+#include "kmeans.hpp"
+#include "precluster.hpp"
+#include "run_state.hpp"
+#include "daemon.hpp"
+#include "stage_executor.hpp"
+#include "trace.hpp"
 #include "diffreader.hpp"
 #include "umap.hpp"
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <map>
+#include <memory>
 #include <fstream>
+#include <mutex>
+#include <sstream>
 #include <filesystem>
+#include <thread>
 
 using namespace std;
 using json = nlohmann::json;
@@ -25,10 +46,86 @@ struct ClusteredCommit {
   }
 };
 
-int main(int argc, char *argv[]) {
+// Used when no API key is available to generate a message
+string fallbackCommitMessage(vector<string> files) {
+  sort(files.begin(), files.end());
+  files.erase(unique(files.begin(), files.end()), files.end());
+  string message = "Update ";
+  for (size_t i = 0; i < files.size() && i < 3; i++) {
+    if (i > 0) message += ", ";
+    message += filesystem::path(files[i]).filename().string();
+  }
+  if (files.size() > 3) {
+    message += " and " + to_string(files.size() - 3) + " more";
+  }
+  return message;
+}
+
+// In -i mode stdout is NDJSON: one object per line as each stage finishes
+// (chunks, clusters, layout, commit, ...), ending with the full "result".
+// Stages emit from their own threads, so whole lines are written under a lock.
+void emitEvent(const string& name, json event) {
+  static mutex stdout_lock;
+  event["event"] = name;
+  string line = event.dump();
+  lock_guard<mutex> guard(stdout_lock);
+  cout << line << endl;
+}
+
+// Per-repository state (embedding cache, last clustering) lives under the git
+// directory so it never shows up as an untracked file. Empty outside a repo.
+string gcommitStateDir() {
+  string git_dir;
+  FILE* pipe = popen("git rev-parse --git-dir 2>/dev/null", "r");
+  if (pipe) {
+    char c;
+    while ((c = fgetc(pipe)) != EOF && c != '\n') {
+      git_dir += c;
+    }
+    pclose(pipe);
+  }
+  return git_dir.empty() ? "" : git_dir + "/gcommit";
+}
+
+// A daemon serves many runs from one process, so the connection (TLS
+// sessions, resolved hosts) and the embedding caches outlive any single run
+AsyncHTTPSConnection& warmConnection(const string& ca_file, int verbose) {
+  static map<string, unique_ptr<AsyncHTTPSConnection>> connections;
+  unique_ptr<AsyncHTTPSConnection>& conn = connections[ca_file];
+  if (!conn) conn = make_unique<AsyncHTTPSConnection>(verbose);
+  conn->set_verbose(verbose);
+  conn->reset_stats();
+  return *conn;
+}
+
+EmbeddingCache& warmEmbeddingCache(const string& path, const string& tag) {
+  static map<string, unique_ptr<EmbeddingCache>> caches;
+  string absolute_path = filesystem::absolute(path).lexically_normal().string();
+  unique_ptr<EmbeddingCache>& cache = caches[absolute_path + "\n" + tag];
+  if (!cache) {
+    cache = make_unique<EmbeddingCache>(absolute_path, tag);
+    cache->load();
+  }
+  return *cache;
+}
+
+int runGcommit(int argc, char *argv[]) {
   float dist_thresh = 0.5;
   int verbose = 0;
   bool interactive = false;
+  bool precluster = true;
+  bool hybrid = true;
+  bool use_cache = true;
+  bool local_embeddings = false;
+  Quantization quantization = Quantization::Float32;
+  size_t embedding_dims = 256;  // 0 = the model's full width
+  string strategy = "hdbscan";
+  Linkage linkage = Linkage::Average;
+  int num_commits = 0;  // -k; 0 lets k-means pick by silhouette
+  string trace_path;
+  bool show_stats = false;
+  string record_path;
+  string replay_path;
 
   for (int i = 1; i < argc; i++) {
     string arg = argv[i];
@@ -38,6 +135,92 @@ int main(int argc, char *argv[]) {
       verbose = 1;
     } else if (arg == "-i") {
       interactive = true;
+    } else if (arg == "--no-precluster") {
+      precluster = false;
+    } else if (arg == "--no-hybrid") {
+      hybrid = false;
+    } else if (arg == "--no-cache") {
+      use_cache = false;
+    } else if (arg == "--local-embeddings") {
+      local_embeddings = true;
+    } else if (arg == "--quantize") {
+      if (i + 1 < argc) {
+        try {
+          quantization = parseQuantization(argv[++i]);
+        } catch (const invalid_argument& e) {
+          cerr << "Error: " << e.what() << endl;
+          return 1;
+        }
+      } else {
+        cerr << "Error: --quantize requires int8, fp16 or f32" << endl;
+        return 1;
+      }
+    } else if (arg == "--strategy") {
+      string value = i + 1 < argc ? argv[i + 1] : "";
+      if (value == "hdbscan" || value == "hierarchical" || value == "kmeans") {
+        strategy = value;
+        i++;
+      } else {
+        cerr << "Error: --strategy requires hdbscan, hierarchical or kmeans" << endl;
+        return 1;
+      }
+    } else if (arg == "-k") {
+      if (i + 1 < argc) {
+        try {
+          num_commits = stoi(argv[++i]);
+        } catch (...) {
+          cerr << "Error: -k requires a number of commits" << endl;
+          return 1;
+        }
+        if (num_commits < 1) {
+          cerr << "Error: -k must be at least 1" << endl;
+          return 1;
+        }
+        strategy = "kmeans";
+      } else {
+        cerr << "Error: -k requires a number of commits" << endl;
+        return 1;
+      }
+    } else if (arg == "--linkage") {
+      if (i + 1 < argc) {
+        try {
+          linkage = parseLinkage(argv[++i]);
+        } catch (const invalid_argument& e) {
+          cerr << "Error: " << e.what() << endl;
+          return 1;
+        }
+      } else {
+        cerr << "Error: --linkage requires average, complete or single" << endl;
+        return 1;
+      }
+    } else if (arg == "--stats") {
+      show_stats = true;
+    } else if (arg == "--trace") {
+      if (i + 1 < argc) {
+        trace_path = argv[++i];
+      } else {
+        cerr << "Error: --trace requires an output file" << endl;
+        return 1;
+      }
+    } else if (arg == "--record" || arg == "--replay") {
+      if (i + 1 < argc) {
+        (arg == "--record" ? record_path : replay_path) = argv[++i];
+      } else {
+        cerr << "Error: " << arg << " requires an archive file" << endl;
+        return 1;
+      }
+    } else if (arg == "--dims") {
+      if (i + 1 < argc) {
+        try {
+          embedding_dims = stoul(argv[++i]);
+        } catch (...) {
+          cerr << "Error: --dims requires a non-negative integer" << endl;
+          return 1;
+        }
+      } else {
+        cerr << "Error: --dims requires a dimension count" << endl;
+        return 1;
+      }
     } else if (arg == "-d") {
       if (i + 1 < argc) {
         try {
@@ -54,12 +237,20 @@ int main(int argc, char *argv[]) {
       try {
         dist_thresh = stof(arg);
       } catch (...) {
-        cerr << "Usage: " << argv[0] << " [-d threshold] [-i] [-v|-vv]" << endl;
+        cerr << "Usage: " << argv[0] << " [-d threshold] [-i] [-v|-vv] [--no-precluster] [--no-hybrid] [--no-cache] [--local-embeddings] [--quantize int8|fp16] [--dims N] [--strategy hdbscan|hierarchical|kmeans] [--linkage average|complete|single] [-k commits] [--trace out.json] [--stats] [--record file|--replay file] [--daemon [--idle-timeout MIN]|--no-daemon]" << endl;
         return 1;
       }
     }
   }
 
+  if (!record_path.empty() && !replay_path.empty()) {
+    cerr << "Error: --record and --replay cannot be combined" << endl;
+    return 1;
+  }
+  // Archived runs have to send every request and must not depend on state
+  // an earlier run left behind
+  if (!record_path.empty() || !replay_path.empty()) use_cache = false;
+
   const char* api_key_env = getenv("OPENAI_API_KEY");
   string api_key = api_key_env ? api_key_env : "";
 
@@ -74,194 +265,483 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  if (api_key.empty()) {
+  // Replays never reach the network, so they need no key
+  if (api_key.empty() && !replay_path.empty()) api_key = "replay";
+
+  // Local embeddings work fully offline; without a key commit messages
+  // fall back to a summary of the touched files
+  if (api_key.empty() && !local_embeddings) {
     cerr << "Error: OPENAI_API_KEY not found in environment or git config (custom.openaiApiKey)" << endl;
     return 1;
   }
 
-  DiffReader dr(cin);
-  dr.ingestDiff();
-  if (verbose >= 1) cerr << "Parsed " << dr.getChunks().size() << " chunks from git diff" << endl;
-
-  // AST-chunk the diff
-  vector<DiffChunk> all_chunks;
-  for (const DiffChunk& chunk : dr.getChunks()) {
-    // Pure renames have no lines - pass through directly
-    if (chunk.is_rename) {
-      all_chunks.push_back(chunk);
-      continue;
-    }
-
-    string language = detectLanguageFromPath(chunk.filepath);
-    vector<DiffChunk> file_chunks;
-
-    if (language != "text") {
-      string file_content = combineContent(chunk);
-      ts::Tree tree = codeToTree(file_content, language);
-      file_chunks = chunkDiff(tree.getRootNode(), chunk);
-    } else {
-      file_chunks = chunkByLines(chunk);
-    }
-    all_chunks.insert(all_chunks.end(), file_chunks.begin(), file_chunks.end());
+  if (!trace_path.empty()) {
+    clearTrace();
+    enableTracing();
   }
+  // Written on every exit from here on, so failed runs can be diagnosed too
+  struct TraceWriter {
+    const string& path;
+    ~TraceWriter() {
+      if (path.empty()) return;
+      if (!writeTrace(path)) cerr << "Could not write the trace to " << path << endl;
+      trace_enabled.store(false);
+    }
+  } trace_writer{trace_path};
 
-  if (all_chunks.empty()) {
-    cerr << "Error: No chunks to process" << endl;
+  OpenAIEndpoint endpoint;
+  try {
+    endpoint = OpenAIEndpoint::fromEnvironment();
+  } catch (const invalid_argument& e) {
+    cerr << "Error: " << e.what() << endl;
     return 1;
   }
 
-  // Get embeddings
-  AsyncHTTPSConnection conn(verbose);
-  AsyncOpenAIAPI openai_api(conn, api_key);
-  vector<future<HTTPSResponse>> embedding_futures;
-
-  if (verbose >= 1) cerr << "Getting embeddings for " << all_chunks.size() << " chunks..." << endl;
-
-  const size_t MAX_EMBEDDING_CHARS = 16000;
-  for (const auto& chunk : all_chunks) {
-    string content = combineContent(chunk);
-    // For pure renames/empty chunks, use descriptive text for embedding
-    if (chunk.is_rename) {
-      content = "renamed file from " + chunk.old_filepath + " to " + chunk.filepath;
-    } else if (content.empty()) {
-      content = "file: " + chunk.filepath;
-    }
-    if (content.size() > MAX_EMBEDDING_CHARS) {
-      content = content.substr(0, MAX_EMBEDDING_CHARS);
-    }
-    embedding_futures.push_back(openai_api.async_embedding(content));
-  }
+  AsyncHTTPSConnection& conn = warmConnection(endpoint.ca_file, verbose);
+  AsyncOpenAIAPI openai_api(conn, api_key, endpoint);
 
-  openai_api.run_requests();
+  unique_ptr<ApiArchive> archive;
+  try {
+    if (!record_path.empty()) archive = make_unique<ApiArchive>(record_path, ApiArchive::RECORD);
+    if (!replay_path.empty()) archive = make_unique<ApiArchive>(replay_path, ApiArchive::REPLAY);
+  } catch (const runtime_error& e) {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  openai_api.use_archive(archive.get());
 
-  vector<vector<float>> embeddings;
-  for (auto& fut : embedding_futures) {
-    try {
-      embeddings.push_back(parse_embedding(fut.get().body));
-    } catch (...) {
-      embeddings.push_back({});
-    }
-    if (verbose >= 1) cerr << "." << flush;
+  unique_ptr<EmbeddingProvider> embedder;
+  if (local_embeddings) {
+    embedder = make_unique<LocalEmbeddingProvider>(embedding_dims ? embedding_dims : 512);
+  } else {
+    embedder = make_unique<OpenAIEmbeddingProvider>(openai_api, verbose, embedding_dims);
   }
-  if (verbose >= 1) cerr << " done" << endl;
 
   int min_cluster_size = max(2, static_cast<int>(dist_thresh * 5));
   HDBSCANClustering hc(min_cluster_size, 2);
+  hc.set_quantization(quantization);
+  bool hierarchical = strategy == "hierarchical";
+  HierachicalClustering hierarchical_clustering(linkage);
+
+  string state_dir = use_cache ? gcommitStateDir() : "";
+  string state_path = state_dir.empty() ? "" : state_dir + "/clusters.json";
+  string settings = "hdbscan min_cluster_size=" + to_string(min_cluster_size) + " hybrid=" + to_string(hybrid) +
+                    " distances=" + quantizationName(quantization) + " embeddings=" +
+                    (local_embeddings ? "local:" : "openai:") + to_string(embedding_dims);
+
+  // Stage outputs. Each is written by one stage and only read by stages
+  // that depend on it.
+  vector<DiffChunk> all_chunks;
+  vector<vector<int>> must_link;
+  vector<vector<int>> embed_groups;
+  vector<string> group_texts;
+  vector<vector<float>> embeddings;
+  vector<uint64_t> chunk_keys;
+  EmbeddingMatrix embedding_matrix;
+  unique_ptr<HybridDistance> hybrid_distance;
+  RunState previous_state;
+  bool have_previous_state = false;
+  vector<int> previous_row;
+  bool resume = false;
+  unique_ptr<HNSWIndex> ann_index;
+  vector<vector<int>> clusters;
+  vector<int> chunk_to_cluster;
+  json points_json = json::array();
+  vector<string> patches;
+  vector<vector<pair<string, size_t>>> cluster_patches;  // (path, index into patches) per cluster
+  vector<ClusteredCommit> commits;
+  vector<string> diff_contexts;  // one per commit
+  vector<UmapPoint> umap_points;
 
-  if (verbose >= 1) cerr << "Starting HDBSCAN clustering (min_cluster_size=" << min_cluster_size << ")..." << endl;
+  // parse -> group -> embed -> cluster -> plan -> {write patches, messages}
+  // with the structural distance and the previous run's state loaded while
+  // the embedding requests are in flight, and UMAP running alongside the
+  // commit-message requests. embed waits for all of group: pre-grouping and
+  // must-link both look at every chunk before any text is final.
+  StageExecutor pipeline;
+
+  auto parse = pipeline.add("parse", [&]() {
+    DiffReader dr(cin);
+    dr.ingestDiff();
+    vector<DiffChunk> hunks = dr.getChunks();
+    if (verbose >= 1) cerr << "Parsed " << hunks.size() << " chunks from git diff" << endl;
+
+    // AST-chunk the diff
+    for (const DiffChunk& chunk : hunks) {
+      // Pure renames have no lines - pass through directly
+      if (chunk.is_rename) {
+        all_chunks.push_back(chunk);
+        fingerprintChunk(all_chunks.back());
+        continue;
+      }
 
-  hc.fit(embeddings);
-  vector<vector<int>> clusters = hc.get_clusters();
-  if (verbose >= 1) cerr << "Clustering complete. Found " << clusters.size() << " clusters" << endl;
+      string file_content = combineContent(chunk);
+      // Shebangs/modelines are only visible when the hunk starts at the top of the file
+      string language = detectLanguage(chunk.filepath, chunk.start <= 1 ? file_content : "");
+      vector<DiffChunk> file_chunks;
+
+      TraceSpan trace("chunkDiff", "parse", chunk.filepath);
+      if (language != "text") {
+        ts::Tree tree = codeToTree(file_content, language);
+        file_chunks = chunkDiff(tree.getRootNode(), chunk, language);
+      } else {
+        file_chunks = chunkByLines(chunk);
+      }
+      all_chunks.insert(all_chunks.end(), file_chunks.begin(), file_chunks.end());
+    }
 
-  vector<UmapPoint> umap_points;
-  if (interactive) {
-    if (embeddings.size() >= 3) {
-      if (verbose >= 1) cerr << "Running UMAP dimensionality reduction..." << endl;
-      try {
-        umap_points = compute_umap(embeddings);
-        if (verbose >= 1) cerr << "UMAP complete." << endl;
-      } catch (const exception& e) {
-        if (verbose >= 1) cerr << "UMAP failed: " << e.what() << endl;
-        umap_points = {};
+    if (all_chunks.empty()) {
+      throw runtime_error("No chunks to process");
+    }
+    if (interactive) emitEvent("chunks", {{"count", all_chunks.size()}, {"hunks", hunks.size()}});
+  });
+
+  auto group = pipeline.add("group", [&]() {
+    // Obviously related chunks (same function, near-identical identifier sets)
+    // share one embedding of their combined content
+    if (precluster) {
+      embed_groups = preclusterChunks(all_chunks);
+    } else {
+      for (size_t i = 0; i < all_chunks.size(); i++) {
+        embed_groups.push_back({static_cast<int>(i)});
       }
+    }
+    // Chunks whose patches only apply together are embedded together and
+    // re-joined after clustering, whatever the strategy decided
+    must_link = mustLinkGroups(all_chunks);
+    embed_groups = applyMustLink(embed_groups, must_link, all_chunks.size());
+
+    for (size_t g = 0; g < embed_groups.size(); g++) {
+      string content;
+      for (int idx : embed_groups[g]) {
+        const DiffChunk& chunk = all_chunks[idx];
+        string chunk_content = combineContent(chunk);
+        // For pure renames/empty chunks, use descriptive text for embedding
+        if (chunk.is_rename) {
+          chunk_content = "renamed file from " + chunk.old_filepath + " to " + chunk.filepath + "\n";
+        } else if (chunk_content.empty()) {
+          chunk_content = "file: " + chunk.filepath + "\n";
+        }
+        content += chunk_content;
+      }
+      size_t tokens = countTokens(content);
+      if (tokens > embedder->max_input_tokens()) {
+        if (verbose >= 1) cerr << "Truncating group " << g << " (" << tokens << " tokens) in " << all_chunks[embed_groups[g][0]].filepath << endl;
+        content = truncateToTokens(content, embedder->max_input_tokens());
+      }
+      group_texts.push_back(std::move(content));
+    }
+  }, {parse});
+
+  auto embed = pipeline.add("embed", [&]() {
+    if (verbose >= 1) cerr << "Getting embeddings for " << all_chunks.size() << " chunks ("
+                           << embed_groups.size() << " after structural pre-grouping)..." << endl;
+    // Re-runs only embed groups whose text changed
+    vector<vector<float>> group_embeddings;
+    if (!state_dir.empty()) {
+      EmbeddingCache& cache = warmEmbeddingCache(state_dir + "/embeddings.bin",
+                                                 (local_embeddings ? "local:" : "openai:") + to_string(embedding_dims));
+      CachedEmbeddingProvider cached(*embedder, cache);
+      group_embeddings = cached.embed(group_texts);
+      if (verbose >= 1) cerr << "Reused " << cached.cache_hits() << " of " << group_texts.size()
+                             << " embeddings from the cache" << endl;
+      if (!cache.save() && verbose >= 1) cerr << "Could not write the embedding cache in " << state_dir << endl;
     } else {
-      if (verbose >= 1) cerr << "Skipping UMAP (need >= 3 chunks, got " << embeddings.size() << ")" << endl;
+      group_embeddings = embedder->embed(group_texts);
     }
-  }
-
-  vector<int> chunk_to_cluster(all_chunks.size(), -1);
-  for (size_t i = 0; i < clusters.size(); i++) {
-    for (int idx : clusters[i]) {
-      chunk_to_cluster[idx] = static_cast<int>(i);
+    // Older models ignore the dimensions parameter; project whatever comes back
+    reduceDimensions(group_embeddings, embedding_dims);
+    embeddings.assign(all_chunks.size(), {});
+    chunk_keys.assign(all_chunks.size(), 0);
+    for (size_t g = 0; g < embed_groups.size(); g++) {
+      for (int idx : embed_groups[g]) {
+        embeddings[idx] = group_embeddings[g];
+        chunk_keys[idx] = chunkKey(all_chunks[idx], group_texts[g]);
+      }
+    }
+    embedding_matrix = EmbeddingMatrix::fromRows(embeddings);
+    embedding_matrix.normalizeRows();
+  }, {group});
+
+  auto structure = pipeline.add("structure", [&]() {
+    // Embedding distance plus path, shared-identifier and same-declaration terms
+    if (hybrid) hybrid_distance = make_unique<HybridDistance>(all_chunks);
+  }, {parse});
+
+  auto previous = pipeline.add("load state", [&]() {
+    // When the last HDBSCAN run saw a subset of these chunks with the same
+    // settings, the new chunks are inserted into its MST and UMAP layout
+    have_previous_state = strategy == "hdbscan" && !state_path.empty() && previous_state.load(state_path) &&
+                          previous_state.settings == settings;
+  });
+
+  auto cluster = pipeline.add("cluster", [&]() {
+    if (hybrid_distance) hc.set_pair_distance(hybrid_distance.get());
+    if (have_previous_state) {
+      previous_row = matchPreviousRows(chunk_keys, previous_state.chunk_keys);
+      size_t kept = count_if(previous_row.begin(), previous_row.end(), [](int row) { return row >= 0; });
+      resume = kept == previous_state.model.rows && kept > 0;
     }
-  }
 
-  vector<DiffChunk> all_cluster_chunks;
-  vector<size_t> cluster_end_idx;
+    // Large change sets cluster on an approximate k-NN graph; the same index
+    // later feeds UMAP's neighbor search
+    if (strategy == "hdbscan" && !resume && hc.is_approximate(embedding_matrix.rows)) {
+      if (verbose >= 1) cerr << "Building HNSW index over " << embedding_matrix.rows << " chunks..." << endl;
+      HNSWOptions ann_options;
+      ann_options.quantization = quantization;
+      ann_index = make_unique<HNSWIndex>(embedding_matrix, ann_options);
+      TraceSpan trace("HNSW build", "hdbscan");
+      ann_index->build();
+    }
 
-  for (size_t i = 0; i < clusters.size(); i++) {
-    const vector<int>& cluster = clusters[i];
+    if (hierarchical) {
+      // -d is the cosine distance at which the dendrogram is cut
+      if (verbose >= 1) cerr << "Starting hierarchical clustering (linkage=" << linkageName(linkage)
+                             << ", cut=" << dist_thresh << ")..." << endl;
+      hierarchical_clustering.cluster(embedding_matrix, dist_thresh);
+      clusters = hierarchical_clustering.get_clusters();
+    } else if (strategy == "kmeans") {
+      if (num_commits > 0) {
+        if (verbose >= 1) cerr << "Starting k-means clustering (k=" << num_commits << ")..." << endl;
+        KMeans km(num_commits);
+        km.fit(embedding_matrix);
+        clusters = km.get_clusters();
+      } else {
+        int k_max = min(30, max(2, static_cast<int>(sqrt(2.0 * embedding_matrix.rows))));
+        if (verbose >= 1) cerr << "Starting k-means clustering (k chosen by silhouette in 2.." << k_max << ")..." << endl;
+        clusters = selectK(embedding_matrix, 2, k_max).get_clusters();
+      }
+    } else {
+      if (verbose >= 1) cerr << "Starting HDBSCAN clustering (min_cluster_size=" << min_cluster_size
+                             << ", distances=" << quantizationName(quantization) << ")..." << endl;
+      if (resume && hc.fit_incremental(embedding_matrix, previous_state.model, previous_row)) {
+        if (verbose >= 1) cerr << "Inserted " << embedding_matrix.rows - previous_state.model.rows
+                               << " new chunks into the previous clustering" << endl;
+      } else {
+        resume = false;
+        hc.fit(embedding_matrix, ann_index.get());
+      }
+      clusters = hc.get_clusters();
+    }
+    size_t strategy_clusters = clusters.size();
+    clusters = applyMustLink(clusters, must_link, all_chunks.size());
+    if (verbose >= 1 && clusters.size() < strategy_clusters) {
+      cerr << "Merged " << strategy_clusters - clusters.size() << " clusters holding patches that depend on each other" << endl;
+    }
+    if (verbose >= 1) cerr << "Clustering complete. Found " << clusters.size() << " clusters" << endl;
 
-    if (verbose >= 1) cerr << "Cluster " << (i + 1) << ":" << endl;
+    chunk_to_cluster.assign(all_chunks.size(), -1);
+    for (size_t i = 0; i < clusters.size(); i++) {
+      for (int idx : clusters[i]) {
+        chunk_to_cluster[idx] = static_cast<int>(i);
+      }
+    }
 
-    for (int idx: cluster) {
-      all_cluster_chunks.push_back(all_chunks[idx]);
+    // Coordinates are filled in by the layout events and the final result
+    if (interactive) {
+      for (size_t i = 0; i < all_chunks.size(); i++) {
+        string preview = combineContent(all_chunks[i]);
+        if (preview.size() > 100) preview = preview.substr(0, 100) + "...";
+        points_json.push_back({
+          {"id", i},
+          {"cluster_id", chunk_to_cluster[i]},
+          {"filepath", all_chunks[i].filepath},
+          {"preview", preview}
+        });
+      }
+      emitEvent("clusters", {{"count", clusters.size()}, {"points", points_json}});
+    }
+  }, {embed, structure, previous});
+
+  // Patches are rendered in memory here; writing them to disk overlaps the
+  // commit-message requests, which read the same strings
+  auto plan = pipeline.add("plan", [&]() {
+    vector<DiffChunk> all_cluster_chunks;
+    for (size_t i = 0; i < clusters.size(); i++) {
+      if (verbose >= 1) cerr << "Cluster " << (i + 1) << ":" << endl;
+      for (int idx : clusters[i]) {
+        all_cluster_chunks.push_back(all_chunks[idx]);
+      }
+    }
+    {
+      TraceSpan trace("createPatches", "patches");
+      patches = createPatches(all_cluster_chunks);
     }
-    size_t prev_end = cluster_end_idx.empty() ? 0 : cluster_end_idx.back();
-    cluster_end_idx.push_back(prev_end + cluster.size());
-  }
 
-  vector<string> patches = createPatches(all_cluster_chunks);
-  vector<vector<string>> clusters_patch_paths;
+    size_t offset = 0;
+    for (size_t i = 0; i < clusters.size(); i++) {
+      cluster_patches.push_back({});
+      int patch_num = 0;
+      for (size_t j = offset; j < offset + clusters[i].size() && j < patches.size(); j++) {
+        if (patches[j].empty()) {
+          if (verbose >= 1) cerr << "Skipping empty patch at index " << j << endl;
+          continue;
+        }
+        string patch_path = "/tmp/patches/cluster_" + to_string(i) + "/patch_" + to_string(patch_num++) + ".patch";
+        cluster_patches.back().push_back({patch_path, j});
+      }
+      offset += clusters[i].size();
 
-  for (size_t i = 0; i < cluster_end_idx.size(); i++) {
-    clusters_patch_paths.push_back(vector<string>());
-    string cluster_dir = "/tmp/patches/cluster_" + to_string(i);
-    filesystem::create_directories(cluster_dir);
+      if (cluster_patches.back().empty()) {
+        if (verbose >= 1) cerr << "Skipping cluster with no valid patches" << endl;
+        continue;
+      }
+      ClusteredCommit commit{static_cast<int>(i), vector<string>(), "empty commit"};
+      string diff_context = "";
+      for (const auto& [path, index] : cluster_patches.back()) {
+        istringstream patch(patches[index]);
+        string line;
+        while (getline(patch, line)) {
+          if (line[0] == '+') {
+            diff_context += "Insertion: ";
+          }
+          else if (line[0] == '-') {
+            diff_context += "Deletion: ";
+          }
+          diff_context += line + "\n";
+        }
+        diff_context += "\n\n\n";
+        commit.patch_files.push_back(path);
+      }
+      commits.push_back(commit);
+      diff_contexts.push_back(std::move(diff_context));
+    }
+  }, {cluster});
+
+  pipeline.add("write patches", [&]() {
+    for (size_t i = 0; i < cluster_patches.size(); i++) {
+      filesystem::create_directories("/tmp/patches/cluster_" + to_string(i));
+      for (const auto& [path, index] : cluster_patches[i]) {
+        TraceSpan trace("write patch", "patches", path);
+        ofstream patch_file(path);
+        patch_file << patches[index];
+        if (!patch_file) throw runtime_error("could not write " + path);
+        if (verbose >= 1) cerr << "Wrote " << path << endl;
+      }
+    }
+  }, {plan});
 
-    size_t start_idx = (i == 0) ? 0 : cluster_end_idx[i - 1];
-    size_t end_idx = cluster_end_idx[i];
+  pipeline.add("messages", [&]() {
+    auto files_message = [&](const ClusteredCommit& commit) {
+      vector<string> files;
+      for (int idx : clusters[commit.cluster_id]) {
+        files.push_back(all_chunks[idx].filepath);
+      }
+      return fallbackCommitMessage(files);
+    };
 
-    int patch_num = 0;
-    for (size_t j = start_idx; j < end_idx && j < patches.size(); j++) {
-      if (patches[j].empty()) {
-        if (verbose >= 1) cerr << "Skipping empty patch at index " << j << endl;
-        continue;
+    if (api_key.empty()) {
+      for (ClusteredCommit& commit : commits) {
+        commit.message = files_message(commit);
+        if (interactive) emitEvent("commit", commit.to_json());
       }
-      string patch_path = cluster_dir + "/patch_" + to_string(patch_num++) + ".patch";
-      ofstream patch_file(patch_path);
-      patch_file << patches[j];
-      patch_file.close();
-      clusters_patch_paths.back().push_back(patch_path);
-      if (verbose >= 1) cerr << "Wrote " << patch_path << endl;
+      return;
     }
-  }
 
-  vector<future<string>> message_futures;
-  vector<ClusteredCommit> commits;
-  int cluster_idx = 0;
-  for (vector<string>& patch_paths: clusters_patch_paths) {
-    if (patch_paths.empty()) {
-      if (verbose >= 1) cerr << "Skipping cluster with no valid patches" << endl;
-      cluster_idx++;
-      continue;
+    // Each request reports its index when it finishes, so messages are
+    // emitted in completion order without polling every future
+    mutex ready_lock;
+    condition_variable ready_cv;
+    vector<size_t> ready;
+    vector<future<string>> message_futures;
+    for (size_t i = 0; i < diff_contexts.size(); i++) {
+      message_futures.push_back(async_generate_commit_message(openai_api, diff_contexts[i], [&, i]() {
+        lock_guard<mutex> guard(ready_lock);
+        ready.push_back(i);
+        ready_cv.notify_one();
+      }));
     }
-    string diff_context = "";
-    ClusteredCommit commit{cluster_idx, vector<string>(), "empty commit"};
-    for (string path: patch_paths) {
-      ifstream patch_file;
-      patch_file.open(path);
-
-      if (!patch_file.is_open()) {
-        cerr << "Error opening file!" << endl;
-        return 1;
+    // The event loop runs on its own thread; it is joined however this
+    // stage ends so an exception can't reach a joinable std::thread
+    thread requests([&]() { openai_api.run_requests(); });
+    struct JoinOnExit {
+      thread& t;
+      ~JoinOnExit() { if (t.joinable()) t.join(); }
+    } join_requests{requests};
+
+    for (size_t done = 0; done < message_futures.size(); done++) {
+      size_t i;
+      {
+        unique_lock<mutex> guard(ready_lock);
+        ready_cv.wait(guard, [&]() { return !ready.empty(); });
+        i = ready.back();
+        ready.pop_back();
+      }
+      try {
+        commits[i].message = message_futures[i].get();
+      } catch (const exception& e) {
+        // A failed request costs this commit its generated message, not the run
+        if (verbose >= 1) cerr << "Commit message request failed (" << e.what() << "); naming the files instead" << endl;
+        commits[i].message = files_message(commits[i]);
       }
+      if (interactive) emitEvent("commit", commits[i].to_json());
+    }
+  }, {plan});
 
-      string line;
-      while (getline(patch_file, line)) {
-        if (line[0] == '+') {
-          diff_context += "Insertion: ";
-        }
-        else if (line[0] == '-') {
-          diff_context += "Deletion: ";
+  auto layout = pipeline.add("layout", [&]() {
+    auto layout_json = [](const vector<UmapPoint>& points) {
+      json coords = json::array();
+      for (const UmapPoint& point : points) coords.push_back({point.x, point.y});
+      return coords;
+    };
+
+    if (resume && previous_state.umap.size() == previous_state.model.rows) {
+      umap_points = extend_umap(embedding_matrix, previous_state.umap, previous_row);
+      if (interactive) emitEvent("layout", {{"stage", "final"}, {"points", layout_json(umap_points)}});
+    } else if (interactive) {
+      if (embeddings.size() >= 3) {
+        if (verbose >= 1) cerr << "Running UMAP dimensionality reduction..." << endl;
+        UmapProgress progress = [&](int epoch, const vector<UmapPoint>& points) {
+          emitEvent("layout", {{"stage", epoch == 0 ? "coarse" : "refined"}, {"epoch", epoch}, {"points", layout_json(points)}});
+        };
+        try {
+          umap_points = ann_index ? compute_umap(*ann_index, 15, 200, 0, progress)
+                                  : compute_umap(embedding_matrix, 15, 200, 0, progress);
+          if (verbose >= 1) cerr << "UMAP complete." << endl;
+        } catch (const exception& e) {
+          if (verbose >= 1) cerr << "UMAP failed: " << e.what() << endl;
+          umap_points = {};
         }
-        diff_context += line + "\n";
+      } else {
+        if (verbose >= 1) cerr << "Skipping UMAP (need >= 3 chunks, got " << embeddings.size() << ")" << endl;
       }
-      patch_file.close();
-      diff_context += "\n\n\n";
-      commit.patch_files.push_back(path);
     }
+  }, {cluster});
 
-    message_futures.push_back(async_generate_commit_message(openai_api, diff_context));
-    commits.push_back(commit);
-    cluster_idx++;
+  pipeline.add("save state", [&]() {
+    if (strategy == "hdbscan" && !state_path.empty() && hc.get_model().complete()) {
+      RunState state{settings, chunk_keys, hc.get_model(), umap_points};
+      if (!state.save(state_path) && verbose >= 1) cerr << "Could not save the clustering state to " << state_path << endl;
+    }
+  }, {layout});
+
+  bool failed = false;
+  try {
+    pipeline.run();
+  } catch (const exception& e) {
+    cerr << "Error: " << e.what() << endl;
+    failed = true;
   }
-
-  openai_api.run_requests();
-
-  for (size_t i = 0; i < commits.size(); i++) {
-    commits[i].message = message_futures[i].get();
+  // In -i mode the TUI owns the terminal, so the summary travels as an event
+  if (show_stats && interactive) emitEvent("stats", {{"summary", conn.stats().summary()}});
+  if (show_stats && !interactive) cerr << conn.stats().summary();
+  if (archive && archive->mode() == ApiArchive::REPLAY && (verbose >= 1 || archive->misses() > 0)) {
+    cerr << "Replayed " << archive->hits() << " requests from " << replay_path << ", " << archive->misses()
+         << " not in the archive" << endl;
+  }
+  if (archive && archive->mode() == ApiArchive::RECORD && verbose >= 1) {
+    cerr << "Recorded " << archive->size() << " responses to " << record_path << endl;
+  }
+  if (failed) return 1;
+
+  if (verbose >= 1) {
+    for (const StageTiming& stage : pipeline.timings()) {
+      if (!stage.ran) continue;
+      auto ms = [&](chrono::steady_clock::time_point t) {
+        return chrono::duration<double, milli>(t - pipeline.start_time()).count();
+      };
+      cerr << "Stage " << stage.name << ": " << ms(stage.start) << " -> " << ms(stage.end) << " ms" << endl;
+    }
   }
 
   json output;
@@ -272,43 +752,103 @@ int main(int argc, char *argv[]) {
   }
   output["commits"] = commits_json;
 
-  if (interactive) {
-    json viz_output;
-
-    json points_json = json::array();
-    for (size_t i = 0; i < all_chunks.size(); i++) {
-      string preview = combineContent(all_chunks[i]);
-      if (preview.size() > 100) preview = preview.substr(0, 100) + "...";
-
-      double x = (i < umap_points.size()) ? umap_points[i].x : 0.0;
-      double y = (i < umap_points.size()) ? umap_points[i].y : 0.0;
-
-      points_json.push_back({
-        {"id", i},
-        {"x", x},
-        {"y", y},
-        {"cluster_id", chunk_to_cluster[i]},
-        {"filepath", all_chunks[i].filepath},
-        {"preview", preview}
-      });
-    }
-    viz_output["points"] = points_json;
-
-    json clusters_json = json::array();
-    for (size_t i = 0; i < commits.size(); i++) {
-      clusters_json.push_back({
-        {"id", commits[i].cluster_id},
-        {"message", commits[i].message}
-      });
-    }
-    viz_output["clusters"] = clusters_json;
+  if (!interactive) {
+    cout << output.dump() << endl;
+    if (verbose >= 1) cerr << "Output complete." << endl;
+    return 0;
+  }
+
+  json viz_output;
+  for (size_t i = 0; i < points_json.size(); i++) {
+    points_json[i]["x"] = i < umap_points.size() ? umap_points[i].x : 0.0;
+    points_json[i]["y"] = i < umap_points.size() ? umap_points[i].y : 0.0;
+  }
+  viz_output["points"] = points_json;
+
+  json clusters_json = json::array();
+  for (size_t i = 0; i < commits.size(); i++) {
+    clusters_json.push_back({
+      {"id", commits[i].cluster_id},
+      {"message", commits[i].message}
+    });
+  }
+  viz_output["clusters"] = clusters_json;
 
-    output["visualization"] = viz_output;
+  // Leaves are point ids; the TUI re-cuts this to preview other thresholds
+  if (hierarchical) {
+    json merges_json = json::array();
+    for (const DendrogramNode& node : hierarchical_clustering.get_dendrogram()) {
+      merges_json.push_back({node.left, node.right, node.distance, node.size});
+    }
+    viz_output["dendrogram"] = {
+      {"linkage", linkageName(linkage)},
+      {"threshold", dist_thresh},
+      {"merges", merges_json}
+    };
   }
 
-  cout << output.dump() << endl;
+  output["visualization"] = viz_output;
+  emitEvent("result", output);
 
   if (verbose >= 1) cerr << "Output complete." << endl;
 
   return 0;
-}
\ No newline at end of file
+}
+
+// Resolved before the daemon leaves the starting directory; the daemon
+// watches it to notice when it has been rebuilt
+string executablePath(const char* argv0) {
+  error_code ec;
+  filesystem::path self = filesystem::canonical("/proc/self/exe", ec);
+  if (!ec) return self.string();
+  if (string(argv0).find('/') == string::npos) return "";
+  self = filesystem::canonical(argv0, ec);
+  return ec ? "" : self.string();
+}
+
+int runWithArgs(vector<string> args) {
+  vector<char*> argv;
+  for (string& arg : args) argv.push_back(arg.data());
+  argv.push_back(nullptr);
+  return runGcommit(static_cast<int>(args.size()), argv.data());
+}
+
+int main(int argc, char *argv[]) {
+  vector<string> args(argv, argv + argc);
+  if (argc >= 2 && args[1] == "--daemon") {
+    int idle_minutes = 30;
+    if (argc == 4 && args[2] == "--idle-timeout") {
+      try {
+        idle_minutes = stoi(args[3]);
+      } catch (...) {
+        cerr << "Error: --idle-timeout requires a number of minutes" << endl;
+        return 1;
+      }
+    } else if (argc != 2) {
+      cerr << "Usage: " << argv[0] << " --daemon [--idle-timeout MIN]" << endl;
+      return 1;
+    }
+    return runDaemon(runGcommit, executablePath(argv[0]), chrono::minutes(idle_minutes));
+  }
+
+  auto no_daemon = find(args.begin(), args.end(), "--no-daemon");
+  if (no_daemon != args.end()) {
+    args.erase(no_daemon);
+    return runWithArgs(args);
+  }
+
+  int daemon_fd = connectToDaemon();
+  if (daemon_fd < 0) return runWithArgs(args);
+
+  string input((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+  optional<int> exit_code = runViaDaemon(daemon_fd, vector<string>(args.begin() + 1, args.end()), input);
+  if (exit_code) return *exit_code;
+
+  // The daemon was stale or went away; stdin is already consumed, so run
+  // here on the copy that was meant for it
+  istringstream replay(input);
+  streambuf* saved_in = cin.rdbuf(replay.rdbuf());
+  int code = runWithArgs(args);
+  cin.rdbuf(saved_in);
+  return code;
+}
@@ -0,0 +1,18 @@
+#ifndef PAIR_DISTANCE_HPP
+#define PAIR_DISTANCE_HPP
+
+#include <cstddef>
+
+using namespace std;
+
+// Hook for folding pair-specific terms into embedding distances while the
+// clustering code computes them, so no second pass over all pairs is needed.
+class PairDistance {
+public:
+  virtual ~PairDistance() = default;
+  // distances[c] holds the embedding distance between points i and j0 + c;
+  // overwrite each with the combined distance (which must stay >= 0)
+  virtual void adjust(size_t i, size_t j0, size_t count, float* distances) const = 0;
+};
+
+#endif // PAIR_DISTANCE_HPP
@@ -0,0 +1,190 @@
+#include "precluster.hpp"
+#include <algorithm>
+#include <climits>
+#include <numeric>
+#include <unordered_map>
+
+int findRoot(vector<int>& parent, int x) {
+  while (parent[x] != x) {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+
+void unite(vector<int>& parent, int a, int b) {
+  a = findRoot(parent, a);
+  b = findRoot(parent, b);
+  if (a != b) {
+    parent[max(a, b)] = min(a, b);
+  }
+}
+
+// Union-find components in order of their smallest member
+vector<vector<int>> componentsOf(vector<int>& parent) {
+  unordered_map<int, size_t> group_of_root;
+  vector<vector<int>> groups;
+  for (int i = 0; i < static_cast<int>(parent.size()); i++) {
+    int root = findRoot(parent, i);
+    auto [it, inserted] = group_of_root.emplace(root, groups.size());
+    if (inserted) groups.push_back({});
+    groups[it->second].push_back(i);
+  }
+  return groups;
+}
+
+vector<vector<int>> preclusterChunks(const vector<DiffChunk>& chunks, float minhash_threshold,
+                                     size_t min_identifiers) {
+  int n = static_cast<int>(chunks.size());
+  vector<int> parent(n);
+  iota(parent.begin(), parent.end(), 0);
+
+  // Same file and same innermost enclosing symbol
+  unordered_map<string, int> first_in_symbol;
+  for (int i = 0; i < n; i++) {
+    const ChunkFingerprint& fp = chunks[i].fingerprint;
+    if (fp.symbols.empty()) continue;
+    string key = chunks[i].filepath + '\0' + fp.symbols.back();
+    auto [it, inserted] = first_in_symbol.emplace(key, i);
+    if (!inserted) unite(parent, it->second, i);
+  }
+
+  // Near-duplicate identifier sets (the same rename or API change applied in
+  // several places). Candidates are bucketed by MinHash bands so only pairs
+  // sharing a band are compared.
+  const size_t BAND_WIDTH = 4;
+  unordered_map<uint64_t, vector<int>> buckets;
+  for (int i = 0; i < n; i++) {
+    const ChunkFingerprint& fp = chunks[i].fingerprint;
+    if (fp.identifiers.size() < min_identifiers) continue;
+    for (size_t band = 0; band < MINHASH_SIZE / BAND_WIDTH; band++) {
+      uint64_t key = band;
+      for (size_t k = 0; k < BAND_WIDTH; k++) {
+        key = key * 0x100000001b3ULL ^ fp.minhash[band * BAND_WIDTH + k];
+      }
+      buckets[key].push_back(i);
+    }
+  }
+  for (const auto& [key, members] : buckets) {
+    for (size_t a = 0; a < members.size(); a++) {
+      for (size_t b = a + 1; b < members.size(); b++) {
+        int i = members[a];
+        int j = members[b];
+        if (findRoot(parent, i) == findRoot(parent, j)) continue;
+        if (minhashSimilarity(chunks[i].fingerprint, chunks[j].fingerprint) >= minhash_threshold) {
+          unite(parent, i, j);
+        }
+      }
+    }
+  }
+
+  return componentsOf(parent);
+}
+
+namespace {
+
+// Span of changed lines in doubled old-file coordinates: deleting line L is
+// 2L, inserting before line L is 2L - 1. Two spans with a gap of at most 2
+// have no unchanged line between them.
+pair<int, int> changedSpan(const DiffChunk& chunk) {
+  int lo = INT_MAX;
+  int hi = INT_MIN;
+  int old_line = chunk.start;
+  for (const DiffLine& line : chunk.lines) {
+    int mark;
+    if (line.mode == EQ) {
+      old_line++;
+      continue;
+    } else if (line.mode == DELETION) {
+      mark = 2 * old_line++;
+    } else if (line.mode == INSERTION) {
+      mark = 2 * old_line - 1;
+    } else {
+      continue;
+    }
+    lo = min(lo, mark);
+    hi = max(hi, mark);
+  }
+  return {lo, hi};
+}
+
+} // namespace
+
+vector<vector<int>> mustLinkGroups(const vector<DiffChunk>& chunks) {
+  int n = static_cast<int>(chunks.size());
+  vector<int> parent(n);
+  iota(parent.begin(), parent.end(), 0);
+
+  // Whole-file operations: created, deleted or renamed files move as one
+  unordered_map<string, int> first_in_file;
+  unordered_map<string, bool> whole_file;
+  for (int i = 0; i < n; i++) {
+    const DiffChunk& chunk = chunks[i];
+    bool renamed = chunk.old_filepath != chunk.filepath && !chunk.is_new && !chunk.is_deleted;
+    if (chunk.is_new || chunk.is_deleted || renamed || chunk.is_rename) {
+      whole_file[chunk.filepath] = true;
+      whole_file[chunk.old_filepath] = true;
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    for (const string& path : {chunks[i].old_filepath, chunks[i].filepath}) {
+      if (!whole_file.count(path)) continue;
+      auto [it, inserted] = first_in_file.emplace(path, i);
+      if (!inserted) unite(parent, it->second, i);
+    }
+  }
+
+  // Touching or overlapping edits within one file (old-file coordinates)
+  unordered_map<string, vector<pair<pair<int, int>, int>>> spans_by_file;
+  for (int i = 0; i < n; i++) {
+    pair<int, int> span = changedSpan(chunks[i]);
+    if (span.first <= span.second) {
+      spans_by_file[chunks[i].old_filepath].push_back({span, i});
+    }
+  }
+  for (auto& [path, spans] : spans_by_file) {
+    sort(spans.begin(), spans.end());
+    int reach = INT_MIN;
+    int last = -1;
+    for (const auto& [span, i] : spans) {
+      if (last >= 0 && span.first <= reach + 2) {
+        unite(parent, last, i);
+      }
+      if (span.second > reach || last < 0) {
+        reach = max(reach, span.second);
+        last = i;
+      }
+    }
+  }
+
+  return componentsOf(parent);
+}
+
+vector<vector<int>> applyMustLink(const vector<vector<int>>& partition, const vector<vector<int>>& groups,
+                                  size_t num_chunks) {
+  vector<int> parent(partition.size());
+  iota(parent.begin(), parent.end(), 0);
+  vector<int> part_of(num_chunks, -1);
+  for (size_t p = 0; p < partition.size(); p++) {
+    for (int idx : partition[p]) part_of[idx] = static_cast<int>(p);
+  }
+  for (const vector<int>& group : groups) {
+    for (size_t m = 1; m < group.size(); m++) {
+      int a = part_of[group[0]];
+      int b = part_of[group[m]];
+      if (a >= 0 && b >= 0) unite(parent, a, b);
+    }
+  }
+
+  vector<vector<int>> merged;
+  for (const vector<int>& component : componentsOf(parent)) {
+    vector<int> members;
+    for (int p : component) {
+      members.insert(members.end(), partition[p].begin(), partition[p].end());
+    }
+    if (members.empty()) continue;
+    sort(members.begin(), members.end());
+    merged.push_back(std::move(members));
+  }
+  return merged;
+}
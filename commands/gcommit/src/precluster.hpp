@@ -0,0 +1,29 @@
+#ifndef PRECLUSTER_HPP
+#define PRECLUSTER_HPP
+
+#include <vector>
+#include "diffreader.hpp"
+
+using namespace std;
+
+// Groups chunks whose structural fingerprints make the relationship obvious:
+// edits inside the same function of the same file, or chunks whose changed
+// identifiers are near-identical (MinHash similarity >= minhash_threshold).
+// Every chunk appears in exactly one group; singletons are the ambiguous ones
+// that still need an embedding to be placed.
+vector<vector<int>> preclusterChunks(const vector<DiffChunk>& chunks, float minhash_threshold = 0.8f,
+                                     size_t min_identifiers = 8);
+
+// Chunks that must land in the same commit for the patches to apply in
+// order: edits to the same file whose changed lines overlap or touch with
+// no unchanged line between them, every chunk of a new or deleted file, and
+// every chunk of a renamed file together with its rename. Returns the
+// connected components, singletons included, members in diff order.
+vector<vector<int>> mustLinkGroups(const vector<DiffChunk>& chunks);
+
+// Merges parts of `partition` that share a must-link group. Parts keep the
+// order of their first appearance and members are sorted into diff order.
+vector<vector<int>> applyMustLink(const vector<vector<int>>& partition, const vector<vector<int>>& groups,
+                                  size_t num_chunks);
+
+#endif // PRECLUSTER_HPP
@@ -0,0 +1,99 @@
+#include "run_state.hpp"
+#include "hashing.hpp"
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+
+bool RunState::load(const string& path) {
+  ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  try {
+    json state = json::parse(in);
+    settings = state.at("settings").get<string>();
+    chunk_keys = state.at("chunk_keys").get<vector<uint64_t>>();
+    model = {};
+    model.rows = state.at("rows").get<size_t>();
+    model.k = state.at("k").get<size_t>();
+    model.nearest = state.at("nearest").get<vector<float>>();
+    for (const json& edge : state.at("mst")) {
+      model.mst.push_back({edge[0].get<int>(), edge[1].get<int>(), edge[2].get<float>(), edge[3].get<float>()});
+    }
+    umap.clear();
+    for (const json& point : state.at("umap")) {
+      umap.push_back({point[0].get<double>(), point[1].get<double>()});
+    }
+  } catch (const json::exception&) {
+    return false;
+  }
+  // fit_incremental indexes rows by these without further checks
+  for (const ReachabilityEdge& edge : model.mst) {
+    if (edge.a < 0 || edge.b < 0 || static_cast<size_t>(edge.a) >= model.rows ||
+        static_cast<size_t>(edge.b) >= model.rows) {
+      return false;
+    }
+  }
+  return chunk_keys.size() == model.rows && model.nearest.size() == model.rows * model.k;
+}
+
+bool RunState::save(const string& path) const {
+  json mst = json::array();
+  for (const ReachabilityEdge& edge : model.mst) {
+    mst.push_back({edge.a, edge.b, edge.distance, edge.weight});
+  }
+  json points = json::array();
+  for (const UmapPoint& point : umap) {
+    points.push_back({point.x, point.y});
+  }
+  json state = {
+    {"settings", settings},
+    {"chunk_keys", chunk_keys},
+    {"rows", model.rows},
+    {"k", model.k},
+    {"nearest", model.nearest},
+    {"mst", mst},
+    {"umap", points}
+  };
+
+  error_code ec;
+  filesystem::create_directories(filesystem::path(path).parent_path(), ec);
+  string temp_path = path + ".tmp";
+  {
+    ofstream out(temp_path, ios::trunc);
+    if (!out) return false;
+    out << state.dump();
+    if (!out) return false;
+  }
+  filesystem::rename(temp_path, path, ec);
+  return !ec;
+}
+
+uint64_t chunkKey(const DiffChunk& chunk, const string& embedded_text) {
+  uint64_t hash = fnv1a64(chunk.filepath);
+  hash = fnv1a64(chunk.old_filepath, hash ^ 0x2f);
+  for (const DiffLine& line : chunk.lines) {
+    if (line.mode == EQ) continue;
+    hash = fnv1a64(line.content, hash ^ static_cast<uint64_t>(line.mode));
+  }
+  return splitmix64(hash ^ fnv1a64(embedded_text));
+}
+
+vector<int> matchPreviousRows(const vector<uint64_t>& keys, const vector<uint64_t>& previous) {
+  unordered_map<uint64_t, vector<int>> rows_by_key;
+  for (size_t i = previous.size(); i-- > 0;) {
+    rows_by_key[previous[i]].push_back(static_cast<int>(i));
+  }
+  vector<int> rows(keys.size(), -1);
+  for (size_t i = 0; i < keys.size(); i++) {
+    auto it = rows_by_key.find(keys[i]);
+    if (it == rows_by_key.end() || it->second.empty()) continue;
+    rows[i] = it->second.back();
+    it->second.pop_back();
+  }
+  return rows;
+}
@@ -0,0 +1,33 @@
+#ifndef RUN_STATE_HPP
+#define RUN_STATE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "diffreader.hpp"
+#include "hdbscan.hpp"
+#include "umap.hpp"
+
+using namespace std;
+
+// Clustering state saved after each run, so the next run on a slightly
+// different diff can insert the new chunks instead of starting over
+struct RunState {
+  string settings;             // everything that changes distances or cluster selection
+  vector<uint64_t> chunk_keys;  // one per model row
+  HDBSCANModel model;
+  vector<UmapPoint> umap;      // empty when the run was not interactive
+
+  // False if the file is missing or malformed
+  bool load(const string& path);
+  bool save(const string& path) const;
+};
+
+// Identifies a chunk by its file, its changed lines and the text it was
+// embedded with, not by line numbers, so hunks that only moved still match
+uint64_t chunkKey(const DiffChunk& chunk, const string& embedded_text);
+
+// Row of each key in previous, or -1. Repeated keys match in order.
+vector<int> matchPreviousRows(const vector<uint64_t>& keys, const vector<uint64_t>& previous);
+
+#endif // RUN_STATE_HPP
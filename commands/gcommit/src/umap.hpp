@@ -3,9 +3,17 @@
 
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <functional>
 #include <memory>
+#include <thread>
 #include "umappp/umappp.hpp"
 #include "knncolle/knncolle.hpp"
+#include "distance.hpp"
+#include "hashing.hpp"
+#include "hnsw.hpp"
+#include "projection.hpp"
+#include "trace.hpp"
 
 using namespace std;
 
@@ -14,49 +22,166 @@ struct UmapPoint {
   double y;
 };
 
-// Compute UMAP dimensionality reduction on embeddings
-// Input: vector of embedding vectors (each is 1536D or similar)
-// Output: vector of 2D points
-inline vector<UmapPoint> compute_umap(const vector<vector<float>>& embeddings, int num_neighbors = 15, int num_epochs = 200) {
-  if (embeddings.empty() || embeddings[0].empty()) {
-    return {};
+// The optimizer starts from the top two principal components instead of
+// umappp's spectral init, which needs an eigendecomposition of the whole
+// neighbor graph. Scaled to umappp's [-10, 10] init range, with a little
+// jitter so duplicate rows (pre-grouped chunks) don't start on one spot.
+inline vector<float> pca_layout(const EmbeddingMatrix& data) {
+  TraceSpan trace("pca start", "umap");
+  EmbeddingMatrix components = principalComponents(data, 2);
+  float extent = 0.0f;
+  for (float v : components.data) extent = max(extent, abs(v));
+  float scale = extent > 0.0f ? 10.0f / extent : 1.0f;
+
+  vector<float> coords(components.data.size());
+  uint64_t state = 0x5eed;
+  for (size_t i = 0; i < coords.size(); i++) {
+    state = splitmix64(state);
+    float jitter = (static_cast<float>(state >> 40) / (1 << 24) - 0.5f) * 1e-3f;
+    coords[i] = components.data[i] * scale + jitter;
   }
+  return coords;
+}
 
-  size_t nobs = embeddings.size();
-  size_t ndim = embeddings[0].size();
+inline umappp::Options umap_options(size_t nobs, int num_neighbors, int num_epochs, size_t num_threads) {
+  umappp::Options opt;
+  opt.num_neighbors = min(static_cast<int>(nobs) - 1, num_neighbors);
+  opt.num_epochs = num_epochs;
+  opt.initialize_method = umappp::InitializeMethod::NONE;
+  opt.num_threads = static_cast<int>(num_threads ? num_threads : max(1u, thread::hardware_concurrency()));
+  opt.parallel_optimization = opt.num_threads > 1;
+  return opt;
+}
 
-  // Convert embeddings to column-major format for umappp
-  vector<double> data(ndim * nobs);
-  for (size_t i = 0; i < nobs; i++) {
-    for (size_t j = 0; j < ndim && j < embeddings[i].size(); j++) {
-      data[j + i * ndim] = static_cast<double>(embeddings[i][j]);
-    }
+inline vector<UmapPoint> to_umap_points(const vector<float>& coords) {
+  vector<UmapPoint> points(coords.size() / 2);
+  for (size_t i = 0; i < points.size(); i++) {
+    points[i].x = coords[i * 2];
+    points[i].y = coords[i * 2 + 1];
   }
+  return points;
+}
 
-  // Set up neighbor search with Euclidean distance
-  auto metric = std::make_shared<knncolle::EuclideanDistance<double, double>>();
-  knncolle::VptreeBuilder<int, double, double> vp_builder(metric);
+// Called with the epoch reached and the layout at that point. Epoch 0 is
+// the PCA start, before the neighbor search.
+using UmapProgress = function<void(int epoch, const vector<UmapPoint>& layout)>;
 
-  // Initialize UMAP with 2D output
-  size_t out_dim = 2;
-  vector<double> umap_coords(nobs * out_dim);
+// Runs every epoch, stopping every `every` epochs to report progress
+template <class Status>
+void run_umap_epochs(Status& status, vector<float>& coords, const UmapProgress& progress, int every) {
+  TraceSpan trace("umap epochs", "umap");
+  if (!progress) {
+    status.run(coords.data());
+    return;
+  }
+  int total = status.num_epochs();
+  for (int limit = every; ; limit += every) {
+    status.run(coords.data(), min(limit, total));
+    progress(min(limit, total), to_umap_points(coords));
+    if (limit >= total) break;
+  }
+}
 
-  umappp::Options opt;
-  opt.num_neighbors = min(static_cast<int>(nobs) - 1, num_neighbors);
-  opt.num_epochs = num_epochs;
+// 2D UMAP layout of the rows of a unit-normalized matrix. Stays in float32:
+// the row-major matrix is already the observation-major layout umappp
+// reads, so it is passed without a copy. The VP-tree neighbor search and
+// the epochs run on num_threads threads (0 = one per core).
+inline vector<UmapPoint> compute_umap(const EmbeddingMatrix& data, int num_neighbors = 15, int num_epochs = 200,
+                                      size_t num_threads = 0, const UmapProgress& progress = nullptr,
+                                      int progress_every = 50) {
+  if (data.rows == 0 || data.cols == 0) {
+    return {};
+  }
+
+  auto metric = std::make_shared<knncolle::EuclideanDistance<float, float>>();
+  knncolle::VptreeBuilder<int, float, float> vp_builder(metric);
 
-  auto status = umappp::initialize<int, double>(
-    ndim, nobs, data.data(), vp_builder, out_dim, umap_coords.data(), opt
+  vector<float> umap_coords = pca_layout(data);
+  if (progress) progress(0, to_umap_points(umap_coords));
+  auto start = TraceClock::now();
+  auto status = umappp::initialize<int, float>(
+    data.cols, data.rows, data.data.data(), vp_builder, 2, umap_coords.data(),
+    umap_options(data.rows, num_neighbors, num_epochs, num_threads)
   );
-  status.run(umap_coords.data());
+  traceComplete("umap neighbors", "umap", start, TraceClock::now());
+  run_umap_epochs(status, umap_coords, progress, progress_every);
+  return to_umap_points(umap_coords);
+}
 
-  // Convert to UmapPoint vector
-  vector<UmapPoint> points(nobs);
+// Same as above, but takes the k-NN graph from an existing HNSW index instead
+// of running knncolle's exact search. Used for large inputs where the
+// clustering step has already built the index.
+inline vector<UmapPoint> compute_umap(const HNSWIndex& index, int num_neighbors = 15, int num_epochs = 200,
+                                      size_t num_threads = 0, const UmapProgress& progress = nullptr,
+                                      int progress_every = 50) {
+  size_t nobs = index.size();
+  if (nobs == 0) {
+    return {};
+  }
+
+  vector<float> umap_coords = pca_layout(index.matrix());
+  if (progress) progress(0, to_umap_points(umap_coords));
+
+  auto start = TraceClock::now();
+  umappp::Options opt = umap_options(nobs, num_neighbors, num_epochs, num_threads);
+  vector<vector<pair<int, float>>> knn = index.knnAll(opt.num_neighbors);
+  knncolle::NeighborList<int, float> neighbors(nobs);
   for (size_t i = 0; i < nobs; i++) {
-    points[i].x = umap_coords[i * 2];
-    points[i].y = umap_coords[i * 2 + 1];
+    neighbors[i].assign(knn[i].begin(), knn[i].end());
   }
 
+  auto status = umappp::initialize<int, float>(std::move(neighbors), 2, umap_coords.data(), opt);
+  traceComplete("umap neighbors", "umap", start, TraceClock::now());
+  run_umap_epochs(status, umap_coords, progress, progress_every);
+  return to_umap_points(umap_coords);
+}
+
+// Keeps the previous layout and places each row without a position
+// (previous_row[i] == -1) at the weighted mean of its nearest placed rows,
+// the same initialisation umap-learn's transform() starts from. Rows of
+// data must be unit-normalized.
+inline vector<UmapPoint> extend_umap(const EmbeddingMatrix& data, const vector<UmapPoint>& previous,
+                                     const vector<int>& previous_row, int num_neighbors = 15) {
+  TraceSpan trace("extend_umap", "umap");
+  vector<UmapPoint> points(data.rows, UmapPoint{0.0, 0.0});
+  vector<int> placed;
+  for (size_t i = 0; i < data.rows; i++) {
+    int p = previous_row[i];
+    if (p >= 0 && p < static_cast<int>(previous.size())) {
+      points[i] = previous[p];
+      placed.push_back(static_cast<int>(i));
+    }
+  }
+  if (placed.empty()) {
+    return points;
+  }
+
+  size_t k = min(placed.size(), static_cast<size_t>(max(1, num_neighbors)));
+  vector<pair<float, int>> nearest(placed.size());
+  for (size_t i = 0; i < data.rows; i++) {
+    int p = previous_row[i];
+    if (p >= 0 && p < static_cast<int>(previous.size())) continue;
+    span<const float> row(data.row(i), data.cols);
+    for (size_t c = 0; c < placed.size(); c++) {
+      float similarity = dot_product(row, span<const float>(data.row(placed[c]), data.cols));
+      nearest[c] = {sqrt(max(0.0f, 2.0f - 2.0f * similarity)), placed[c]};
+    }
+    partial_sort(nearest.begin(), nearest.begin() + k, nearest.end());
+
+    // Smooth-kNN style weights: the closest neighbor gets 1, the rest decay
+    // with their distance beyond it
+    double rho = nearest[0].first;
+    double sigma = 1e-6;
+    for (size_t c = 0; c < k; c++) sigma += (nearest[c].first - rho) / k;
+    double x = 0.0, y = 0.0, total = 0.0;
+    for (size_t c = 0; c < k; c++) {
+      double w = exp(-(nearest[c].first - rho) / sigma);
+      x += w * points[nearest[c].second].x;
+      y += w * points[nearest[c].second].y;
+      total += w;
+    }
+    points[i] = {x / total, y / total};
+  }
   return points;
 }
 
@@ -8,16 +8,27 @@ import FileTree from './components/FileTree.js';
 import DiffViewer from './components/DiffViewer.js';
 import ScatterPlot from './components/ScatterPlot.js';
 import ClusterLegend from './components/ClusterLegend.js';
-import type { Phase, ProcessingResult, DiffLine } from './types.js';
+import type { Phase, ProcessingResult, DiffLine, GcommitEvent, StreamState } from './types.js';
 import { parseFullContextDiff } from './utils/diffUtils.js';
+import { cutDendrogram, mergeHeights } from './utils/dendrogram.js';
+import { EMPTY_STREAM, applyEvent } from './utils/events.js';
+import { runViaDaemon } from './utils/daemon.js';
 
 type Props = {
   threshold: number;
   verbose: boolean;
   dev: boolean;
+  localEmbeddings: boolean;
+  strategy: string;
+  linkage: string;
+  commits?: number;
+  trace?: string;
+  stats: boolean;
+  record?: string;
+  replay?: string;
 };
 
-function AppContent({ threshold, verbose, dev }: Props) {
+function AppContent({ threshold, verbose, dev, localEmbeddings, strategy, linkage, commits, trace, stats, record, replay }: Props) {
   const { exit } = useApp();
   const git = useGit();
 
@@ -28,6 +39,9 @@ function AppContent({ threshold, verbose, dev }: Props) {
   const [error, setError] = useState<string | null>(null);
   const [statusMessage, setStatusMessage] = useState('Initializing...');
   const [stderr, setStderr] = useState<string>('');
+  const [statsSummary, setStatsSummary] = useState<string>('');
+  // Partial results streamed by gcommit while it is still running
+  const [stream, setStream] = useState<StreamState>(EMPTY_STREAM);
 
   // Visualization state
   const [viewMode, setViewMode] = useState<'scatter' | 'diff'>('diff');
@@ -36,6 +50,9 @@ function AppContent({ threshold, verbose, dev }: Props) {
   const [selectedFilePath, setSelectedFilePath] = useState<string>('');
   const [commitShas, setCommitShas] = useState<string[]>([]);
   const [fileDiffs, setFileDiffs] = useState<Map<string, Map<string, DiffLine[]>>>(new Map());
+  // Dendrogram cut previewed in the scatter view (hierarchical strategy only);
+  // null shows the clusters gcommit actually produced
+  const [cutThreshold, setCutThreshold] = useState<number | null>(null);
 
   // Callback for FileTree selection
   const handleFileSelect = useCallback((_index: number, filepath: string) => {
@@ -110,17 +127,77 @@ function AppContent({ threshold, verbose, dev }: Props) {
       const binaryPath = join(scriptDir, 'git_gcommit.o');
       const args = ['-d', String(threshold), '-i'];
       if (verbose) args.push('-v');
+      if (localEmbeddings) args.push('--local-embeddings');
+      if (strategy === 'hierarchical') args.push('--strategy', strategy, '--linkage', linkage);
+      if (strategy === 'kmeans') args.push('--strategy', strategy);
+      if (commits) args.push('-k', String(commits));
+      if (trace) args.push('--trace', trace);
+      if (stats) args.push('--stats');
+      if (record) args.push('--record', record);
+      if (replay) args.push('--replay', replay);
+
+      // One NDJSON event per line; render each stage as it lands
+      let data: ProcessingResult | undefined;
+      let clusterCount = 0;
+      let messageCount = 0;
+      let strayOutput = '';
+      const handleLine = (line: string) => {
+        if (!line.trim()) return;
+        let event: GcommitEvent | undefined;
+        try {
+          event = JSON.parse(line);
+        } catch {
+          event = undefined;
+        }
+        if (!event || typeof event !== 'object' || typeof event.event !== 'string') {
+          // Not an event: diagnostics that went to stdout. Show them with stderr.
+          strayOutput += line + '\n';
+          return;
+        }
+        setStream(s => applyEvent(s, event));
+        if (event.event === 'chunks') {
+          setStatusMessage(`Clustering ${event.count} chunks...`);
+        } else if (event.event === 'clusters') {
+          clusterCount = event.count;
+          setStatusMessage(`Found ${clusterCount} clusters, writing commit messages...`);
+        } else if (event.event === 'commit') {
+          messageCount++;
+          setStatusMessage(`Writing commit messages (${messageCount}/${clusterCount})...`);
+        } else if (event.event === 'stats') {
+          setStatsSummary(event.summary);
+        } else if (event.event === 'result') {
+          const { event: _event, ...result } = event;
+          data = result;
+        }
+      };
+
+      // A resident `git_gcommit.o --daemon` skips process startup and keeps
+      // connections and caches warm; without one, run the binary directly
+      const viaDaemon = await runViaDaemon(args, diff, handleLine);
+      if (viaDaemon) {
+        if (viaDaemon.exitCode !== 0) {
+          throw new Error(viaDaemon.stderr || `gcommit exited with code ${viaDaemon.exitCode}`);
+        }
+        if (viaDaemon.stderr || strayOutput) {
+          setStderr(strayOutput + viaDaemon.stderr);
+        }
+      } else {
+        const subprocess = execa(binaryPath, args, {
+          input: diff,
+          encoding: 'utf8',
+        });
+        for await (const line of subprocess) {
+          handleLine(line);
+        }
 
-      const result = await execa(binaryPath, args, {
-        input: diff,
-        encoding: 'utf8',
-      });
-
-      if (result.stderr) {
-        setStderr(result.stderr);
+        const finished = await subprocess;
+        if (finished.stderr || strayOutput) {
+          setStderr(strayOutput + finished.stderr);
+        }
+      }
+      if (!data) {
+        throw new Error(strayOutput ? `gcommit exited without a result:\n${strayOutput}` : 'gcommit exited without a result');
       }
-
-      const data: ProcessingResult = JSON.parse(result.stdout);
       setProcessingResult(data);
 
       goToPhase('applying');
@@ -129,7 +206,7 @@ function AppContent({ threshold, verbose, dev }: Props) {
       setPhase('error');
       await performCleanup(false);
     }
-  }, [git.stagedDiff, threshold, verbose, goToPhase, performCleanup]);
+  }, [git.stagedDiff, threshold, verbose, localEmbeddings, strategy, linkage, commits, trace, stats, record, replay, goToPhase, performCleanup]);
 
   const runApplying = useCallback(async () => {
     try {
@@ -260,6 +337,20 @@ function AppContent({ threshold, verbose, dev }: Props) {
         setViewMode(v => (v === 'scatter' ? 'diff' : 'scatter'));
       }
 
+      // Step the dendrogram cut to the previous/next merge height
+      const dendrogram = processingResult?.visualization.dendrogram;
+      if (viewMode === 'scatter' && dendrogram && (input === '[' || input === ']')) {
+        const heights = mergeHeights(dendrogram);
+        const current = cutThreshold ?? dendrogram.threshold;
+        if (input === ']') {
+          const next = heights.find(h => h > current);
+          if (next !== undefined) setCutThreshold(next);
+        } else {
+          const applied = heights.filter(h => h <= current);
+          setCutThreshold(applied.length > 1 ? applied[applied.length - 2]! : -1);
+        }
+      }
+
       // Panel toggle (diff view only)
       if (viewMode === 'diff' && key.tab) {
         setFocusPanel(p => (p === 'tree' ? 'diff' : 'tree'));
@@ -298,8 +389,16 @@ function AppContent({ threshold, verbose, dev }: Props) {
   }
 
   if (phase === 'init' || phase === 'processing' || phase === 'applying') {
+    const layoutNote = stream.layoutStage === 'refined' ? `refining layout, epoch ${stream.epoch}` : `${stream.layoutStage} layout`;
     return (
       <Box flexDirection="column">
+        {phase === 'processing' && stream.layoutStage && (
+          <Box flexDirection="column" marginBottom={1}>
+            <ScatterPlot points={stream.points} />
+            <ClusterLegend clusters={stream.clusters} />
+            <Text dimColor>{layoutNote}</Text>
+          </Box>
+        )}
         <Spinner label={statusMessage} />
         {verbose && stderr && (
           <Box marginTop={1}>
@@ -319,11 +418,27 @@ function AppContent({ threshold, verbose, dev }: Props) {
 
     // Scatter view
     if (viewMode === 'scatter' && processingResult?.visualization) {
+      const { points, clusters, dendrogram } = processingResult.visualization;
+      const previewing = dendrogram !== undefined && cutThreshold !== null;
+      const cutLabels = previewing ? cutDendrogram(dendrogram, points.length, cutThreshold) : [];
+      const shownPoints = previewing ? points.map((p, i) => ({ ...p, cluster_id: cutLabels[i]! })) : points;
+      const cutDisplay = Math.max(0, cutThreshold ?? 0);
+
       return (
         <Box flexDirection="column">
-          <ScatterPlot points={processingResult.visualization.points} />
-          <ClusterLegend clusters={processingResult.visualization.clusters} />
+          <ScatterPlot points={shownPoints} />
+          {previewing ? (
+            <Box marginTop={1}>
+              <Text>
+                Cut at {cutDisplay.toFixed(3)}: {new Set(cutLabels).size} clusters ({dendrogram.linkage} linkage) · rerun
+                with -d {cutDisplay.toFixed(3)} to commit this split
+              </Text>
+            </Box>
+          ) : (
+            <ClusterLegend clusters={clusters} />
+          )}
           <Box marginTop={1}>
+            {dendrogram && <Text dimColor>[/]: move cut · </Text>}
             <Text dimColor>h/l: commits · </Text>
             <Text color="yellow" bold>v</Text>
             <Text dimColor>: diff view · </Text>
@@ -390,6 +505,11 @@ function AppContent({ threshold, verbose, dev }: Props) {
         {commitMessages.map((msg, i) => (
           <Text key={i} dimColor>  - {msg.split('\n')[0]}</Text>
         ))}
+        {statsSummary && (
+          <Box marginTop={1}>
+            <Text dimColor>{statsSummary}</Text>
+          </Box>
+        )}
       </Box>
     );
   }
@@ -12,12 +12,21 @@ const cli = meow(`
     -d, --threshold  Clustering distance threshold (default: 0.5)
     -v, --verbose    Show verbose output from C++ binary
     --dev            Step through phases with confirmation prompts
+    --local-embeddings  Embed chunks offline (no API key needed)
+    --strategy       hdbscan (default), hierarchical or kmeans
+    -k, --commits    Split into this many commits (k-means; dependent chunks may merge some)
+    --linkage        Hierarchical linkage: average (default), complete or single
+    --trace <file>   Write a Chrome trace of the C++ run (open in ui.perfetto.dev)
+    --stats          Show HTTPS latency percentiles and connection counters
+    --record <file>  Save every API request/response to an archive
+    --replay <file>  Answer API requests from an archive, without network
     -h, --help       Show this help message
 
   Examples
     $ git gcommit
     $ git gcommit -d 0.3
     $ git gcommit --threshold 0.7 --verbose
+    $ git gcommit --strategy hierarchical --linkage complete
 `, {
   importMeta: import.meta,
   flags: {
@@ -35,6 +44,37 @@ const cli = meow(`
       type: 'boolean',
       default: false,
     },
+    localEmbeddings: {
+      type: 'boolean',
+      default: false,
+    },
+    strategy: {
+      type: 'string',
+      default: 'hdbscan',
+      choices: ['hdbscan', 'hierarchical', 'kmeans'],
+    },
+    commits: {
+      type: 'number',
+      shortFlag: 'k',
+    },
+    linkage: {
+      type: 'string',
+      default: 'average',
+      choices: ['average', 'complete', 'single'],
+    },
+    trace: {
+      type: 'string',
+    },
+    stats: {
+      type: 'boolean',
+      default: false,
+    },
+    record: {
+      type: 'string',
+    },
+    replay: {
+      type: 'string',
+    },
     help: {
       type: 'boolean',
       shortFlag: 'h',
@@ -70,6 +110,14 @@ async function main() {
       threshold={cli.flags.threshold}
       verbose={cli.flags.verbose}
       dev={cli.flags.dev}
+      localEmbeddings={cli.flags.localEmbeddings}
+      strategy={cli.flags.strategy}
+      linkage={cli.flags.linkage}
+      commits={cli.flags.commits}
+      trace={cli.flags.trace}
+      stats={cli.flags.stats}
+      record={cli.flags.record}
+      replay={cli.flags.replay}
     />
   );
 
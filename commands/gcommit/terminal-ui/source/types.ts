@@ -18,14 +18,42 @@ export type CommitData = {
   patch_files: string[];
 };
 
+// [left, right, distance, size] per merge, sorted by distance. Ids below the
+// number of points are points; id n + k is the cluster made by merge k.
+export type Dendrogram = {
+  linkage: string;
+  threshold: number;
+  merges: Array<[number, number, number, number]>;
+};
+
 export type ProcessingResult = {
   visualization: {
     points: Point[];
     clusters: Cluster[];
+    dendrogram?: Dendrogram;
   };
   commits: CommitData[];
 };
 
+// NDJSON events `git_gcommit.o -i` writes to stdout, one per line, as each
+// stage finishes. 'result' is always last and carries the full output.
+export type GcommitEvent =
+  | { event: 'chunks'; count: number; hunks: number }
+  | { event: 'clusters'; count: number; points: Array<Omit<Point, 'x' | 'y'>> }
+  | { event: 'layout'; stage: 'coarse' | 'refined' | 'final'; epoch?: number; points: Array<[number, number]> }
+  | ({ event: 'commit' } & CommitData)
+  | { event: 'stats'; summary: string }
+  | ({ event: 'result' } & ProcessingResult);
+
+// What the processing screen can show before the result arrives
+export type StreamState = {
+  chunkCount: number;
+  points: Point[];
+  clusters: Cluster[];
+  layoutStage?: 'coarse' | 'refined' | 'final';
+  epoch?: number;
+};
+
 export type Phase =
   | 'init'
   | 'dev-confirm'
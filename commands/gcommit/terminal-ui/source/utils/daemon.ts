@@ -0,0 +1,106 @@
+import fs from 'fs';
+import net from 'net';
+import os from 'os';
+import { join } from 'path';
+
+// Settings gcommit reads from the environment; the daemon has its own
+const FORWARDED_ENV = ['OPENAI_API_KEY', 'OPENAI_BASE_URL', 'CUSTOM_GIT_OPENAI_CA', 'GIT_DIR', 'GIT_WORK_TREE'];
+
+export interface DaemonResult {
+  exitCode: number;
+  stderr: string;
+}
+
+function socketDirectory(): string {
+  const runtimeDir = process.env['XDG_RUNTIME_DIR'];
+  if (runtimeDir) return runtimeDir;
+  return `/tmp/gcommit-${os.userInfo().uid}`;
+}
+
+/** Same path git_gcommit.o --daemon listens on. */
+export function daemonSocketPath(): string {
+  return join(socketDirectory(), 'gcommit.sock');
+}
+
+/**
+ * The directory must be ours and writable by no one else, and the socket
+ * ours too. Node can't read a unix socket peer's credentials, so this is
+ * the whole check on this side; the daemon checks its peers itself.
+ */
+function socketIsTrusted(): boolean {
+  const uid = os.userInfo().uid;
+  try {
+    const dir = fs.lstatSync(socketDirectory());
+    if (!dir.isDirectory() || dir.uid !== uid || (dir.mode & 0o022) !== 0) return false;
+    const socket = fs.lstatSync(daemonSocketPath());
+    return socket.isSocket() && socket.uid === uid;
+  } catch {
+    return false;
+  }
+}
+
+/**
+ * Runs gcommit in a resident `--daemon`, calling onLine for each stdout line.
+ * Resolves null when no trusted daemon is listening or it has been rebuilt
+ * since it started, so the caller can spawn the binary instead.
+ */
+export function runViaDaemon(args: string[], input: string, onLine: (line: string) => void): Promise<DaemonResult | null> {
+  if (!socketIsTrusted()) return Promise.resolve(null);
+  return new Promise((resolve, reject) => {
+    const socket = net.createConnection(daemonSocketPath());
+    socket.setEncoding('utf8');
+    let started = false;
+    let settled = false;
+    let frames = '';
+    let stdout = '';
+    let stderr = '';
+    const finish = (result: DaemonResult | null, error?: Error) => {
+      if (settled) return;
+      settled = true;
+      socket.destroy();
+      if (error) reject(error);
+      else resolve(result);
+    };
+
+    socket.on('connect', () => {
+      const env: Record<string, string> = {};
+      for (const name of FORWARDED_ENV) {
+        const value = process.env[name];
+        if (value !== undefined) env[name] = value;
+      }
+      const request = { args, cwd: process.cwd(), env, stdin: Buffer.byteLength(input) };
+      socket.write(JSON.stringify(request) + '\n');
+      socket.write(input);
+    });
+
+    socket.on('data', (chunk: string) => {
+      frames += chunk;
+      let newline;
+      try {
+        while ((newline = frames.indexOf('\n')) >= 0) {
+          const frame = JSON.parse(frames.slice(0, newline));
+          frames = frames.slice(newline + 1);
+          if (frame.stale) return finish(null);
+          started = true;
+          if (frame.exit !== undefined) {
+            if (stdout) onLine(stdout);
+            return finish({ exitCode: frame.exit, stderr });
+          }
+          if (frame.stream === 'stderr') {
+            stderr += frame.data;
+            continue;
+          }
+          stdout += frame.data;
+          const lines = stdout.split('\n');
+          stdout = lines.pop() ?? '';
+          for (const line of lines) onLine(line);
+        }
+      } catch (err: any) {
+        finish(null, err);
+      }
+    });
+
+    socket.on('error', err => finish(null, started ? err : undefined));
+    socket.on('close', () => finish(null, started ? new Error('the gcommit daemon exited mid-run') : undefined));
+  });
+}
@@ -0,0 +1,37 @@
+import type { Dendrogram } from '../types.js';
+
+/**
+ * Cut a SciPy-style linkage matrix at a cosine distance threshold.
+ * Returns a cluster id per point, numbered in order of each cluster's
+ * smallest member (the same order gcommit uses for its clusters).
+ */
+export function cutDendrogram(dendrogram: Dendrogram, numPoints: number, threshold: number): number[] {
+  const parent = Array.from({ length: numPoints }, (_, i) => i);
+  const find = (x: number): number => {
+    while (parent[x] !== x) {
+      parent[x] = parent[parent[x]!]!;
+      x = parent[x]!;
+    }
+    return x;
+  };
+
+  // Node id -> a point inside it; merges are sorted by distance
+  const representative = Array.from({ length: numPoints }, (_, i) => i);
+  for (const [left, right, distance] of dendrogram.merges) {
+    if (distance > threshold) break;
+    parent[find(representative[left]!)] = find(representative[right]!);
+    representative.push(representative[left]!);
+  }
+
+  const clusterOf = new Map<number, number>();
+  return Array.from({ length: numPoints }, (_, i) => {
+    const root = find(i);
+    if (!clusterOf.has(root)) clusterOf.set(root, clusterOf.size);
+    return clusterOf.get(root)!;
+  });
+}
+
+/** Merge heights, so the cut can step from one merge to the next. */
+export function mergeHeights(dendrogram: Dendrogram): number[] {
+  return [...new Set(dendrogram.merges.map(m => m[2]))];
+}
@@ -0,0 +1,30 @@
+import type { GcommitEvent, StreamState } from '../types.js';
+
+export const EMPTY_STREAM: StreamState = { chunkCount: 0, points: [], clusters: [] };
+
+/** Fold one event into the processing screen state. */
+export function applyEvent(state: StreamState, event: GcommitEvent): StreamState {
+  switch (event.event) {
+    case 'chunks':
+      return { ...state, chunkCount: event.count };
+    case 'clusters': {
+      const clusters = Array.from({ length: event.count }, (_, id) => ({ id, message: '…' }));
+      const points = event.points.map((p, i) => ({ ...p, x: state.points[i]?.x ?? 0, y: state.points[i]?.y ?? 0 }));
+      return { ...state, points, clusters };
+    }
+    case 'layout': {
+      const points = state.points.map((p, i) => {
+        const xy = event.points[i];
+        return xy ? { ...p, x: xy[0], y: xy[1] } : p;
+      });
+      return { ...state, points, layoutStage: event.stage, epoch: event.epoch };
+    }
+    case 'commit': {
+      const clusters = state.clusters.map(c => (c.id === event.cluster_id ? { ...c, message: event.message } : c));
+      return { ...state, clusters };
+    }
+    case 'stats':
+    case 'result':
+      return state;
+  }
+}
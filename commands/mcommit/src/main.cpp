@@ -2,7 +2,18 @@
 #include "utils.hpp"
 using namespace std;
 
-int main() {
+int main(int argc, char* argv[]) {
+    bool show_stats = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--stats") {
+            show_stats = true;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--stats]" << endl;
+            return 1;
+        }
+    }
+
     const char* api_key_env = getenv("OPENAI_API_KEY");
     string api_key = api_key_env ? api_key_env : "";
 
@@ -39,11 +50,20 @@ int main() {
         diff += line + "\n";
     }
 
+    OpenAIEndpoint endpoint;
+    try {
+        endpoint = OpenAIEndpoint::fromEnvironment();
+    } catch (const invalid_argument& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
     AsyncHTTPSConnection conn;
-    AsyncOpenAIAPI openai_api(conn, api_key);
+    AsyncOpenAIAPI openai_api(conn, api_key, endpoint);
 
     future<string> msg_future = async_generate_commit_message(openai_api, diff);
     openai_api.run_requests();
+    if (show_stats) cerr << conn.stats().summary();
 
     string message = msg_future.get();
     cout << message << endl;
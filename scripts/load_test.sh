@@ -0,0 +1,62 @@
+#!/bin/bash
+
+# End-to-end gcommit load test against the local mock OpenAI server
+# Usage: scripts/load_test.sh [diff lines] [extra mock_openai_server args...]
+#   scripts/load_test.sh 150000 --latency lognormal:80,0.6 --rate-limit 0.02 --reset 0.01
+# 150k synthetic lines is roughly 10k chunks. Needs benchmarks/build
+# (synthetic_diff, mock_openai_server) and commands/gcommit/build. Set
+# TRACE_OUT to choose where the Chrome trace goes.
+
+set -e  # Exit on any error
+
+REPO_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BENCH_BUILD="$REPO_ROOT/benchmarks/build"
+GCOMMIT="$REPO_ROOT/commands/gcommit/build/git_gcommit.o"
+
+LINES="${1:-150000}"
+shift || true
+TRACE_OUT="${TRACE_OUT:-$PWD/gcommit-load-trace.json}"
+
+for binary in "$BENCH_BUILD/synthetic_diff" "$BENCH_BUILD/mock_openai_server" "$GCOMMIT"; do
+    if [ ! -x "$binary" ]; then
+        echo "ERROR: $binary not found; build benchmarks/ and commands/gcommit first"
+        exit 1
+    fi
+done
+
+WORK_DIR="$(mktemp -d)"
+SERVER_PID=""
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+        tail -1 "$WORK_DIR/server.log"
+    fi
+    rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+"$BENCH_BUILD/synthetic_diff" --lines "$LINES" -o "$WORK_DIR/load.diff"
+echo "Generated $(grep -c '^@@' "$WORK_DIR/load.diff") hunks in $LINES lines"
+
+"$BENCH_BUILD/mock_openai_server" --port 0 --write-ca "$WORK_DIR/ca.pem" "$@" 2> "$WORK_DIR/server.log" &
+SERVER_PID=$!
+
+# The server prints its address once it is listening
+PORT=""
+for _ in $(seq 1 50); do
+    PORT="$(sed -n 's/^Listening on https:\/\/127.0.0.1:\([0-9]*\)$/\1/p' "$WORK_DIR/server.log")"
+    [ -n "$PORT" ] && break
+    sleep 0.1
+done
+if [ -z "$PORT" ]; then
+    echo "ERROR: mock server did not start"
+    cat "$WORK_DIR/server.log"
+    exit 1
+fi
+
+time OPENAI_API_KEY=mock \
+    OPENAI_BASE_URL="https://127.0.0.1:$PORT/v1" \
+    CUSTOM_GIT_OPENAI_CA="$WORK_DIR/ca.pem" \
+    "$GCOMMIT" --no-cache --stats --trace "$TRACE_OUT" < "$WORK_DIR/load.diff" > /dev/null
+echo "Trace written to $TRACE_OUT"
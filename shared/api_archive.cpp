@@ -0,0 +1,84 @@
+#include "api_archive.hpp"
+#include "hashing.hpp"
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const uint32_t ARCHIVE_MAGIC = 0x47415231;  // "GAR1"
+
+template <typename T>
+bool readValue(ifstream& in, T& value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <typename T>
+void writeValue(ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+bool readString(ifstream& in, string& value, uint32_t length) {
+  value.resize(length);
+  return static_cast<bool>(in.read(value.data(), length));
+}
+
+} // namespace
+
+ApiArchive::ApiArchive(const string& path, Mode mode) : archive_mode(mode), archive_path(path) {
+  if (mode == RECORD) {
+    out.open(path, ios::binary | ios::trunc);
+    if (!out) throw runtime_error("could not create " + path);
+    writeValue(out, ARCHIVE_MAGIC);
+    out.flush();
+    return;
+  }
+
+  ifstream in(path, ios::binary);
+  uint32_t magic = 0;
+  if (!in || !readValue(in, magic) || magic != ARCHIVE_MAGIC) {
+    throw runtime_error(path + " is not a gcommit API archive");
+  }
+  uint64_t key = 0;
+  while (readValue(in, key)) {
+    uint32_t headers_length = 0;
+    uint32_t body_length = 0;
+    RecordedResponse response;
+    if (!readValue(in, headers_length) || !readValue(in, body_length) ||
+        !readString(in, response.headers, headers_length) || !readString(in, response.body, body_length)) {
+      break;  // a record cut off by an interrupted recording
+    }
+    responses[key].push_back(std::move(response));
+    records++;
+  }
+}
+
+uint64_t ApiArchive::requestKey(const string& path, const string& request_body) {
+  return fnv1a64(request_body, fnv1a64(path + '\n'));
+}
+
+void ApiArchive::record(const string& path, const string& request_body, const RecordedResponse& response) {
+  uint64_t key = requestKey(path, request_body);
+  lock_guard<mutex> guard(lock);
+  writeValue(out, key);
+  writeValue(out, static_cast<uint32_t>(response.headers.size()));
+  writeValue(out, static_cast<uint32_t>(response.body.size()));
+  out.write(response.headers.data(), response.headers.size());
+  out.write(response.body.data(), response.body.size());
+  out.flush();
+  records++;
+}
+
+optional<RecordedResponse> ApiArchive::lookup(const string& path, const string& request_body) {
+  lock_guard<mutex> guard(lock);
+  auto found = responses.find(requestKey(path, request_body));
+  if (found == responses.end()) {
+    missed++;
+    return nullopt;
+  }
+  replayed++;
+  deque<RecordedResponse>& queue = found->second;
+  RecordedResponse response = queue.front();
+  if (queue.size() > 1) queue.pop_front();
+  return response;
+}
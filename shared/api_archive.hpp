@@ -0,0 +1,57 @@
+#ifndef API_ARCHIVE_HPP
+#define API_ARCHIVE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+struct RecordedResponse {
+  string headers;
+  string body;
+};
+
+// Request/response pairs keyed by a 64-bit hash of the request path and
+// body, so a run can be replayed without network. Binary format: magic,
+// then key, headers length, body length, headers and body per record.
+// Records are appended and flushed as responses arrive, so an interrupted
+// run still leaves a usable archive.
+class ApiArchive {
+public:
+  enum Mode { RECORD, REPLAY };
+
+private:
+  Mode archive_mode;
+  string archive_path;
+  mutex lock;
+  ofstream out;
+  // Identical requests are answered in the order they were recorded; the
+  // last answer repeats once a key runs out
+  unordered_map<uint64_t, deque<RecordedResponse>> responses;
+  size_t records = 0;
+  size_t replayed = 0;
+  size_t missed = 0;
+
+public:
+  // RECORD truncates the file; REPLAY loads it and throws runtime_error if it
+  // is missing or not an archive. A record cut off at the end is dropped.
+  ApiArchive(const string& path, Mode mode);
+
+  static uint64_t requestKey(const string& path, const string& request_body);
+
+  Mode mode() const { return archive_mode; }
+  const string& path() const { return archive_path; }
+  size_t size() const { return records; }
+  size_t hits() const { return replayed; }
+  size_t misses() const { return missed; }
+
+  void record(const string& path, const string& request_body, const RecordedResponse& response);
+  optional<RecordedResponse> lookup(const string& path, const string& request_body);
+};
+
+#endif // API_ARCHIVE_HPP
@@ -1,12 +1,23 @@
 #include "ast.hpp"
+#include "grammar_registry.hpp"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 
 using namespace std;
-size_t calculateDiffLinesSize(const vector<DiffLine> &lines) {
-  size_t totalSize = 0;
+size_t calculateLineTokens(const DiffLine &line) {
+  // +1 for the newline that joins lines in combineContent
+  return countTokens(line.content) + 1;
+}
+
+size_t calculateDiffLinesTokens(const vector<DiffLine> &lines) {
+  size_t totalTokens = 0;
   for (const DiffLine &line : lines) {
-    totalSize += line.content.length() + 1;
+    totalTokens += calculateLineTokens(line);
   }
-  return totalSize;
+  return totalTokens;
 }
 
 int calculateLineOffset(const vector<DiffLine> &lines, size_t startIdx, size_t endIdx) {
@@ -25,71 +36,158 @@ int calculateLineOffset(const vector<DiffLine> &lines, size_t startIdx, size_t e
   return offset;
 }
 
-vector<DiffChunk> chunkByLines(const DiffChunk &inputChunk, size_t maxChars) {
+// Splits inputChunk before each line index in cuts (sorted, unique, in
+// (0, lines.size())), keeping hunk starts and new/deleted flags consistent.
+vector<DiffChunk> splitAtLines(const DiffChunk &inputChunk, const vector<size_t> &cuts) {
   vector<DiffChunk> chunks;
-
-  if (inputChunk.lines.empty()) {
-    return chunks;
-  }
-
-  size_t totalSize = calculateDiffLinesSize(inputChunk.lines);
-  if (totalSize <= maxChars) {
-    chunks.push_back(inputChunk);
-    return chunks;
-  }
-
   size_t startLineIdx = 0;
   int cumulative_offset = 0;
-  bool is_first = true;
 
-  while (startLineIdx < inputChunk.lines.size()) {
+  for (size_t c = 0; c <= cuts.size(); c++) {
+    size_t endLineIdx = (c < cuts.size()) ? cuts[c] : inputChunk.lines.size();
+
     DiffChunk currentChunk;
     currentChunk.filepath = inputChunk.filepath;
     currentChunk.old_filepath = inputChunk.old_filepath;
     currentChunk.start = inputChunk.start + cumulative_offset;
     // Only first chunk gets is_new (triggers file creation)
-    currentChunk.is_new = is_first && inputChunk.is_new;
-
-    size_t currentSize = 0;
-    size_t currentLineIdx = startLineIdx;
+    currentChunk.is_new = (c == 0) && inputChunk.is_new;
+    // Only last chunk gets is_deleted (triggers file deletion)
+    currentChunk.is_deleted = (c == cuts.size()) && inputChunk.is_deleted;
+    currentChunk.lines.assign(inputChunk.lines.begin() + startLineIdx,
+                              inputChunk.lines.begin() + endLineIdx);
+    chunks.push_back(currentChunk);
 
-    while (currentLineIdx < inputChunk.lines.size()) {
-      const DiffLine &line = inputChunk.lines[currentLineIdx];
-      size_t lineSize = line.content.length() + 1;
+    cumulative_offset += calculateLineOffset(inputChunk.lines, startLineIdx, endLineIdx);
+    startLineIdx = endLineIdx;
+  }
 
-      if (!currentChunk.lines.empty() && currentSize + lineSize > maxChars) {
-        break;
-      }
+  return chunks;
+}
 
-      currentChunk.lines.push_back(line);
-      currentSize += lineSize;
-      currentLineIdx++;
+// Greedily packs lines [begin, end) into pieces of at most maxTokens,
+// appending the resulting cut positions.
+void appendLineCuts(const vector<DiffLine> &lines, size_t begin, size_t end,
+                    size_t maxTokens, vector<size_t> &cuts) {
+  size_t currentTokens = 0;
+  for (size_t i = begin; i < end; i++) {
+    size_t lineTokens = calculateLineTokens(lines[i]);
+    if (i > begin && currentTokens + lineTokens > maxTokens) {
+      cuts.push_back(i);
+      currentTokens = 0;
     }
+    currentTokens += lineTokens;
+  }
+}
 
-    bool is_last = (currentLineIdx >= inputChunk.lines.size());
-    // Only last chunk gets is_deleted (triggers file deletion)
-    currentChunk.is_deleted = is_last && inputChunk.is_deleted;
-
-    chunks.push_back(currentChunk);
+vector<DiffChunk> chunkByLines(const DiffChunk &inputChunk, size_t maxTokens) {
+  vector<DiffChunk> chunks;
 
-    if (is_last) {
-      break;
-    }
+  if (inputChunk.lines.empty()) {
+    return chunks;
+  }
 
-    cumulative_offset += calculateLineOffset(inputChunk.lines, startLineIdx, currentLineIdx);
-    startLineIdx = currentLineIdx;
-    is_first = false;
+  size_t totalTokens = calculateDiffLinesTokens(inputChunk.lines);
+  if (totalTokens <= maxTokens) {
+    chunks.push_back(inputChunk);
+  } else {
+    vector<size_t> cuts;
+    appendLineCuts(inputChunk.lines, 0, inputChunk.lines.size(), maxTokens, cuts);
+    chunks = splitAtLines(inputChunk, cuts);
   }
 
+  for (DiffChunk &chunk : chunks) {
+    fingerprintChunk(chunk);
+  }
   return chunks;
 }
 
-extern "C" {
-TSLanguage *tree_sitter_python();
-TSLanguage *tree_sitter_cpp();
-TSLanguage *tree_sitter_java();
-TSLanguage *tree_sitter_javascript();
-TSLanguage *tree_sitter_go();
+void fingerprintChunk(DiffChunk &chunk, vector<string> symbols) {
+  vector<string_view> changedLines;
+  for (const DiffLine &line : chunk.lines) {
+    if (line.mode == INSERTION || line.mode == DELETION) {
+      changedLines.push_back(line.content);
+    }
+  }
+  chunk.fingerprint = makeFingerprint(chunk.filepath, changedLines, std::move(symbols));
+}
+
+bool isSymbolNodeType(string_view type) {
+  auto endsWith = [&](string_view suffix) {
+    return type.size() >= suffix.size() && type.substr(type.size() - suffix.size()) == suffix;
+  };
+  return endsWith("_definition") || endsWith("_declaration") || endsWith("_item") ||
+         endsWith("_specifier") || type == "method" || type == "singleton_method" ||
+         type == "class" || type == "module";
+}
+
+// Names of the declarations enclosing byte, outermost first (e.g. class, method)
+vector<string> enclosingSymbols(const ts::Node &root, const string &content, uint32_t byte) {
+  vector<string> symbols;
+  TSNode node = ts_node_descendant_for_byte_range(root.impl, byte, byte);
+  while (!ts_node_is_null(node)) {
+    if (isSymbolNodeType(ts_node_type(node))) {
+      TSNode name = ts_node_child_by_field_name(node, "name", 4);
+      if (ts_node_is_null(name)) {
+        // C/C++ functions nest the name in declarator -> function_declarator -> declarator
+        TSNode declarator = ts_node_child_by_field_name(node, "declarator", 10);
+        while (!ts_node_is_null(declarator)) {
+          TSNode inner = ts_node_child_by_field_name(declarator, "declarator", 10);
+          if (ts_node_is_null(inner)) break;
+          declarator = inner;
+        }
+        name = declarator;
+      }
+      if (!ts_node_is_null(name)) {
+        uint32_t start = ts_node_start_byte(name);
+        uint32_t end = min<uint32_t>(ts_node_end_byte(name), content.size());
+        if (start < end && end - start <= 80) {
+          string text = content.substr(start, end - start);
+          if (text.find('\n') == string::npos) {
+            symbols.push_back(text);
+          }
+        }
+      }
+    }
+    node = ts_node_parent(node);
+  }
+  reverse(symbols.begin(), symbols.end());
+  return symbols;
+}
+
+// Fingerprints each chunk, taking enclosing symbols at its first changed line
+void annotateFingerprints(const ts::Node &root, const DiffChunk &diffChunk,
+                          vector<DiffChunk> &chunks) {
+  string content = combineContent(diffChunk);
+  unordered_map<int, size_t> lineStartByNum;
+  size_t currentByte = 0;
+  for (const DiffLine &line : diffChunk.lines) {
+    lineStartByNum[line.line_num] = currentByte;
+    currentByte += line.content.length() + 1;
+  }
+
+  for (DiffChunk &chunk : chunks) {
+    vector<string> symbols;
+    const DiffLine *anchor = nullptr;
+    for (const DiffLine &line : chunk.lines) {
+      if (line.mode == INSERTION || line.mode == DELETION) {
+        anchor = &line;
+        break;
+      }
+    }
+    if (anchor == nullptr && !chunk.lines.empty()) {
+      anchor = &chunk.lines.front();
+    }
+    if (anchor != nullptr) {
+      auto it = lineStartByNum.find(anchor->line_num);
+      if (it != lineStartByNum.end()) {
+        size_t indent = anchor->content.find_first_not_of(" \t");
+        uint32_t byte = it->second + (indent == string::npos ? 0 : indent);
+        symbols = enclosingSymbols(root, content, byte);
+      }
+    }
+    fingerprintChunk(chunk, std::move(symbols));
+  }
 }
 
 vector<DiffLine> extractLinesInRangeUnique(const vector<DiffLine> &diffLines,
@@ -147,13 +245,13 @@ DiffChunk fillGapLines(const DiffChunk &chunk, const vector<DiffLine> &allLines)
 }
 
 vector<DiffChunk> chunkDiffInternal(const ts::Node &node, const DiffChunk &diffChunk,
-                                     set<int> &processedLineNums, size_t maxChars) {
+                                     set<int> &processedLineNums, size_t maxTokens) {
   vector<DiffChunk> newChunks;
   DiffChunk currentChunk;
   currentChunk.filepath = diffChunk.filepath;
   currentChunk.old_filepath = diffChunk.old_filepath;
   currentChunk.start = diffChunk.start;
-  size_t currentChunkSize = 0;
+  size_t currentChunkTokens = 0;
   bool currentChunkStartSet = false;
 
   for (size_t i = 0; i < node.getNumChildren(); i++) {
@@ -162,26 +260,26 @@ vector<DiffChunk> chunkDiffInternal(const ts::Node &node, const DiffChunk &diffC
 
     vector<DiffLine> childLines = extractLinesInRangeUnique(
         diffChunk.lines, byteRange.start, byteRange.end, processedLineNums);
-    size_t childSize = calculateDiffLinesSize(childLines);
+    size_t childTokens = calculateDiffLinesTokens(childLines);
 
-    if (childSize > maxChars) {
+    if (childTokens > maxTokens) {
       if (!currentChunk.lines.empty()) {
         newChunks.push_back(fillGapLines(currentChunk, diffChunk.lines));
         currentChunk = DiffChunk();
         currentChunk.filepath = diffChunk.filepath;
         currentChunk.old_filepath = diffChunk.old_filepath;
-        currentChunkSize = 0;
+        currentChunkTokens = 0;
         currentChunkStartSet = false;
       }
-      auto childChunks = chunkDiffInternal(child, diffChunk, processedLineNums, maxChars);
+      auto childChunks = chunkDiffInternal(child, diffChunk, processedLineNums, maxTokens);
       newChunks.insert(newChunks.end(), childChunks.begin(), childChunks.end());
-    } else if (currentChunkSize + childSize > maxChars) {
+    } else if (currentChunkTokens + childTokens > maxTokens) {
       newChunks.push_back(fillGapLines(currentChunk, diffChunk.lines));
       currentChunk = DiffChunk();
       currentChunk.filepath = diffChunk.filepath;
       currentChunk.old_filepath = diffChunk.old_filepath;
       currentChunk.lines = childLines;
-      currentChunkSize = childSize;
+      currentChunkTokens = childTokens;
 
       if (!childLines.empty()) {
         int firstLineIdx = findLineIndex(diffChunk.lines, childLines[0].line_num);
@@ -196,7 +294,7 @@ vector<DiffChunk> chunkDiffInternal(const ts::Node &node, const DiffChunk &diffC
       }
       currentChunk.lines.insert(currentChunk.lines.end(), childLines.begin(),
                                 childLines.end());
-      currentChunkSize += childSize;
+      currentChunkTokens += childTokens;
     }
   }
 
@@ -214,56 +312,166 @@ vector<DiffChunk> chunkDiffInternal(const ts::Node &node, const DiffChunk &diffC
 }
 
 vector<DiffChunk> chunkDiff(const ts::Node &node, const DiffChunk &diffChunk,
-                            size_t maxChars) {
+                            size_t maxTokens) {
   set<int> processedLineNums;
-  return chunkDiffInternal(node, diffChunk, processedLineNums, maxChars);
+  vector<DiffChunk> chunks = chunkDiffInternal(node, diffChunk, processedLineNums, maxTokens);
+  annotateFingerprints(node, diffChunk, chunks);
+  return chunks;
 }
 
-ts::Tree codeToTree(const string &code, const string &language) {
-  TSLanguage *lang;
-  if (language == "python") {
-    lang = tree_sitter_python();
-  } else if (language == "cpp") {
-    lang = tree_sitter_cpp();
-  } else if (language == "java") {
-    lang = tree_sitter_java();
-  } else if (language == "javascript") {
-    lang = tree_sitter_javascript();
-  } else if (language == "typescript") {
-    lang = tree_sitter_javascript();
-  } else if (language == "go") {
-    lang = tree_sitter_go();
-  } else {
-    lang = tree_sitter_cpp();
+struct QueryDeleter {
+  void operator()(TSQuery *query) const { ts_query_delete(query); }
+};
+
+// Compiles each language's split query once and keeps it for the life of
+// the process. Returns nullptr if the language has no query or it fails to
+// compile against the linked grammar.
+const TSQuery *getChunkQuery(const string &language) {
+  static mutex cacheMutex;
+  static unordered_map<string, unique_ptr<TSQuery, QueryDeleter>> cache;
+
+  lock_guard<mutex> lock(cacheMutex);
+  auto cached = cache.find(language);
+  if (cached != cache.end()) {
+    return cached->second.get();
+  }
+
+  GrammarRegistry &registry = GrammarRegistry::instance();
+  TSQuery *query = nullptr;
+  string source = registry.chunkQuery(language);
+  const TSLanguage *lang = registry.language(language);
+  if (!source.empty() && lang != nullptr) {
+    uint32_t errorOffset = 0;
+    TSQueryError errorType = TSQueryErrorNone;
+    query = ts_query_new(lang, source.data(), source.size(), &errorOffset, &errorType);
+    if (query == nullptr) {
+      cerr << "Warning: chunk query for " << language << " failed to compile at offset "
+           << errorOffset << ", falling back to size-based chunking" << endl;
+    }
   }
-  ts::Parser parser{lang};
-  return parser.parseString(code);
+  cache.emplace(language, unique_ptr<TSQuery, QueryDeleter>(query));
+  return query;
 }
 
-string detectLanguageFromPath(const string &filepath) {
-  size_t lastDot = filepath.find_last_of(".");
-  if (lastDot == string::npos) {
-    return "cpp";
+vector<DiffChunk> chunkAtBoundaries(const DiffChunk &diffChunk, vector<size_t> boundaries, size_t maxTokens) {
+  const vector<DiffLine> &lines = diffChunk.lines;
+  vector<size_t> tokenPrefix(lines.size() + 1, 0);
+  for (size_t i = 0; i < lines.size(); i++) {
+    tokenPrefix[i + 1] = tokenPrefix[i] + calculateLineTokens(lines[i]);
   }
 
-  string extension = filepath.substr(lastDot);
-
-  if (extension == ".py") {
-    return "python";
-  } else if (extension == ".cpp" || extension == ".c" || extension == ".h" ||
-             extension == ".hpp") {
-    return "cpp";
-  } else if (extension == ".java") {
-    return "java";
-  } else if (extension == ".js" || extension == ".jsx") {
-    return "javascript";
-  } else if (extension == ".ts" || extension == ".tsx") {
-    return "typescript";
-  } else if (extension == ".go") {
-    return "go";
-  } else if (extension == ".cpp") {
-    return "cpp";
-  } else {
-    return "text";
+  boundaries.erase(remove_if(boundaries.begin(), boundaries.end(),
+                             [&](size_t b) { return b == 0 || b >= lines.size(); }),
+                   boundaries.end());
+  sort(boundaries.begin(), boundaries.end());
+  boundaries.erase(unique(boundaries.begin(), boundaries.end()), boundaries.end());
+  boundaries.push_back(lines.size());
+
+  vector<size_t> cuts;
+  size_t unitStart = 0;
+  size_t currentTokens = 0;
+  for (size_t boundary : boundaries) {
+    size_t unitTokens = tokenPrefix[boundary] - tokenPrefix[unitStart];
+    if (unitTokens > maxTokens) {
+      if (currentTokens > 0) {
+        cuts.push_back(unitStart);
+      }
+      appendLineCuts(lines, unitStart, boundary, maxTokens, cuts);
+      if (boundary < lines.size()) {
+        cuts.push_back(boundary);
+      }
+      currentTokens = 0;
+    } else if (currentTokens > 0 && currentTokens + unitTokens > maxTokens) {
+      cuts.push_back(unitStart);
+      currentTokens = unitTokens;
+    } else {
+      currentTokens += unitTokens;
+    }
+    unitStart = boundary;
+  }
+
+  return splitAtLines(diffChunk, cuts);
+}
+
+// Single query pass: every @split capture, nested ones included, marks a
+// line where a semantic unit starts; chunkAtBoundaries does the packing.
+vector<DiffChunk> chunkByQuery(const ts::Node &node, const DiffChunk &diffChunk,
+                               const TSQuery *query, size_t maxTokens) {
+  const vector<DiffLine> &lines = diffChunk.lines;
+
+  vector<size_t> lineStarts(lines.size());
+  size_t currentByte = 0;
+  for (size_t i = 0; i < lines.size(); i++) {
+    lineStarts[i] = currentByte;
+    currentByte += lines[i].content.length() + 1;
   }
+
+  vector<size_t> boundaries;
+  TSQueryCursor *cursor = ts_query_cursor_new();
+  ts_query_cursor_exec(cursor, query, node.impl);
+  TSQueryMatch match;
+  uint32_t captureIndex = 0;
+  while (ts_query_cursor_next_capture(cursor, &match, &captureIndex)) {
+    uint32_t startByte = ts_node_start_byte(match.captures[captureIndex].node);
+    size_t lineIdx = upper_bound(lineStarts.begin(), lineStarts.end(), startByte) - lineStarts.begin();
+    if (lineIdx > 1) {
+      boundaries.push_back(lineIdx - 1);
+    }
+  }
+  ts_query_cursor_delete(cursor);
+
+  return chunkAtBoundaries(diffChunk, std::move(boundaries), maxTokens);
+}
+
+vector<DiffChunk> chunkDiff(const ts::Node &node, const DiffChunk &diffChunk,
+                            const string &language, size_t maxTokens) {
+  if (diffChunk.lines.empty()) {
+    return {};
+  }
+  const TSQuery *query = getChunkQuery(language);
+  if (query == nullptr) {
+    return chunkDiff(node, diffChunk, maxTokens);
+  }
+  vector<DiffChunk> chunks = chunkByQuery(node, diffChunk, query, maxTokens);
+  annotateFingerprints(node, diffChunk, chunks);
+  return chunks;
+}
+
+// Parsers are pooled per grammar and reused across calls, threads and (in
+// the daemon) runs, instead of building a fresh one for every hunk
+ts::Tree codeToTree(const string &code, const string &language) {
+  static mutex poolMutex;
+  static unordered_map<const TSLanguage *, vector<unique_ptr<ts::Parser>>> idleParsers;
+
+  GrammarRegistry &registry = GrammarRegistry::instance();
+  const TSLanguage *lang = registry.language(language);
+  if (lang == nullptr) {
+    lang = registry.language("cpp");
+  }
+
+  unique_ptr<ts::Parser> parser;
+  {
+    lock_guard<mutex> lock(poolMutex);
+    vector<unique_ptr<ts::Parser>> &idle = idleParsers[lang];
+    if (!idle.empty()) {
+      parser = std::move(idle.back());
+      idle.pop_back();
+    }
+  }
+  if (!parser) {
+    parser = make_unique<ts::Parser>(lang);
+  }
+  ts::Tree tree = parser->parseString(code);
+
+  lock_guard<mutex> lock(poolMutex);
+  idleParsers[lang].push_back(std::move(parser));
+  return tree;
+}
+
+string detectLanguageFromPath(const string &filepath) {
+  return GrammarRegistry::instance().detect(filepath);
+}
+
+string detectLanguage(const string &filepath, const string &content) {
+  return GrammarRegistry::instance().detect(filepath, content);
 }
@@ -10,13 +10,30 @@
 #include <vector>
 #include <set>
 #include "diffreader.hpp"
+#include "tokenizer.hpp"
 
 using namespace std;
 // Function declarations
-vector<DiffChunk> chunkDiff(const ts::Node& node, const DiffChunk& diffChunk, size_t maxChars = 1500);
+// Chunk budgets are expressed in estimated cl100k tokens (see tokenizer.hpp)
+vector<DiffChunk> chunkDiff(const ts::Node& node, const DiffChunk& diffChunk, size_t maxTokens = 384);
+// Cuts only at the language's preferred split nodes (shared/queries/<language>.scm);
+// falls back to the size-driven chunkDiff above when no query is available
+vector<DiffChunk> chunkDiff(const ts::Node& node, const DiffChunk& diffChunk, const string& language, size_t maxTokens = 384);
 ts::Tree codeToTree(const string& code, const string& language);
 string detectLanguageFromPath(const string& filepath);
-vector<DiffChunk> chunkByLines(const DiffChunk& inputChunk, size_t maxChars = 1000);
+// Like detectLanguageFromPath, but extensionless files are also matched by
+// shebang or modeline in content (the file's leading lines, if known)
+string detectLanguage(const string& filepath, const string& content);
+vector<DiffChunk> chunkByLines(const DiffChunk& inputChunk, size_t maxTokens = 256);
+// Splits before each line index in cuts (sorted, unique, inside the chunk)
+vector<DiffChunk> splitAtLines(const DiffChunk& inputChunk, const vector<size_t>& cuts);
+// Treats each line index in boundaries as the start of a semantic unit.
+// Consecutive units are packed up to maxTokens; a unit that is too large on
+// its own is split by lines. No fingerprints are computed.
+vector<DiffChunk> chunkAtBoundaries(const DiffChunk& diffChunk, vector<size_t> boundaries, size_t maxTokens);
 bool isTextFile(const string& filepath);
+// Computes chunk.fingerprint from its changed lines and path (no AST symbols).
+// chunkDiff and chunkByLines already do this for the chunks they return.
+void fingerprintChunk(DiffChunk& chunk, vector<string> symbols = {});
 
 #endif // AST_HPP 
\ No newline at end of file
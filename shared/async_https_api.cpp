@@ -7,49 +7,108 @@
 
 using namespace std;
 
+static atomic<uint64_t> next_trace_id{1};
+
+static const char* state_span_name(conn_state_t state) {
+    switch (state) {
+        case CONNECTING: return "connect";
+        case TLS_HANDSHAKE: return "tls";
+        case WRITING_REQUEST: return "send";
+        case READING_RESPONSE_HEADERS: return "headers";
+        case READING_RESPONSE: return "body";
+        case DONE: return "done";
+        default: return "error";
+    }
+}
+
+// Resolved addresses are reused for this long
+static const auto DNS_TTL = chrono::minutes(5);
+
 AsyncHTTPSConnection::AsyncHTTPSConnection(int verbose) : verbose(verbose) {
     this->kqueue_fd = kqueue();
     if (kqueue_fd == -1) {
         perror("kqueue");
         throw runtime_error("Failed to create kqueue");
     }
+    SSL_load_error_strings();
+    SSL_library_init();
+    ssl_ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_CLIENT);
 }
 AsyncHTTPSConnection::~AsyncHTTPSConnection() {
+    for (auto& [host, session] : sessions) {
+        SSL_SESSION_free(session);
+    }
+    reqs.clear();
+    SSL_CTX_free(ssl_ctx);
     close(this->kqueue_fd);
 }
 
-void AsyncHTTPSConnection::post_async(const string& host, const string& path, const string& body, const vector<pair<string, string>>& headers, promise<HTTPSResponse> resp) {
-   auto req = make_unique<HTTPSRequest>(host, path);
+void AsyncHTTPSConnection::set_ca_file(const string& path) {
+    ca_loaded = SSL_CTX_load_verify_locations(ssl_ctx, path.c_str(), nullptr) == 1;
+    if (ca_loaded) {
+        SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, nullptr);
+    } else if (verbose >= 1) {
+        cerr << "Could not load CA file " << path << endl;
+    }
+}
+
+void AsyncHTTPSConnection::post_async(const string& host, const string& path, const string& body, const vector<pair<string, string>>& headers, promise<HTTPSResponse> resp, int port, function<void(const HTTPSResponse&)> on_response) {
+   auto req = make_unique<HTTPSRequest>(host, path, ssl_ctx);
+   if (!ca_loaded) {
+       metrics.errors[TLS_HANDSHAKE]++;
+       resp.set_exception(make_exception_ptr(runtime_error("Could not load the CA file")));
+       return;
+   }
+   req->trace_id = next_trace_id++;
+   req->started = TraceClock::now();
+   metrics.requests++;
    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
    
     fcntl(socket_fd, F_SETFL, O_NONBLOCK);
 
-    struct hostent* server = gethostbyname(host.c_str());
-    if (server == nullptr) {
-        if (verbose >= 2) cout << "No such host: " << host << endl;
-        close(socket_fd);
-        return;
+    auto cached = resolved_hosts.find(host);
+    if (cached == resolved_hosts.end() || cached->second.expires < req->started) {
+        struct hostent* server = gethostbyname(host.c_str());
+        auto resolved = TraceClock::now();
+        metrics.dns.record(resolved - req->started);
+        if (tracingEnabled()) traceAsync("dns", "https", req->trace_id, req->started, resolved, host);
+        if (server == nullptr) {
+            if (verbose >= 2) cout << "No such host: " << host << endl;
+            metrics.errors[CONNECTING]++;
+            close(socket_fd);
+            return;
+        }
+        ResolvedHost entry;
+        memcpy(&entry.address, server->h_addr, sizeof(entry.address));
+        entry.expires = resolved + DNS_TTL;
+        cached = resolved_hosts.insert_or_assign(host, entry).first;
+    } else {
+        metrics.dns_cached++;
     }
 
     struct sockaddr_in serv_addr;
     memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
-    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    serv_addr.sin_port = htons(443);
+    serv_addr.sin_addr = cached->second.address;
+    serv_addr.sin_port = htons(port);
 
     int result = connect(socket_fd, (struct sockaddr*)&serv_addr, sizeof(serv_addr));
     if (result == -1 && errno != EINPROGRESS) {
         close(socket_fd);
+        metrics.errors[CONNECTING]++;
         resp.set_exception(make_exception_ptr(runtime_error("Connection failed")));
         return;
     }
 
     req->socket_fd = socket_fd;
     req->state = CONNECTING;
+    req->state_since = TraceClock::now();
     req->resp = std::move(resp);
+    req->on_response = std::move(on_response);
 
     string request = "POST " + path + " HTTP/1.1\r\n";
-    request += "Host: " + host + "\r\n";
+    request += "Host: " + host + (port == 443 ? "" : ":" + to_string(port)) + "\r\n";
     request += "Content-Length: " + to_string(body.size()) + "\r\n";
     for (const auto& header : headers) {
         request += header.first + ": " + header.second + "\r\n";
@@ -62,6 +121,19 @@ void AsyncHTTPSConnection::post_async(const string& host, const string& path, co
     kevent(kqueue_fd, &ev, 1, nullptr, 0, nullptr);
 
     reqs[socket_fd] = std::move(req);
+    metrics.peak_in_flight = max(metrics.peak_in_flight, reqs.size());
+    traceCounter("https in flight", reqs.size());
+}
+
+void AsyncHTTPSConnection::finish_state(HTTPSRequest* req, conn_state_t finished) {
+    auto now = TraceClock::now();
+    if (finished == CONNECTING) metrics.connect.record(now - req->state_since);
+    if (finished == TLS_HANDSHAKE) metrics.tls.record(now - req->state_since);
+    if (finished == TLS_HANDSHAKE && req->state != ERROR && SSL_session_reused(req->conn)) metrics.tls_resumed++;
+    if (finished == WRITING_REQUEST) req->request_sent = now;
+    if (req->state == ERROR) metrics.errors[finished]++;
+    if (tracingEnabled()) traceAsync(state_span_name(finished), "https", req->trace_id, req->state_since, now);
+    req->state_since = now;
 }
 
 void AsyncHTTPSConnection::run_loop(){
@@ -81,6 +153,7 @@ void AsyncHTTPSConnection::run_loop(){
             if (verbose >= 2) cout << "Event: state=" << req->state << " filter=" << filter << endl;
 
             conn_state_t state_before = req->state;
+            auto handling = TraceClock::now();
 
             switch (req->state) {
                 case CONNECTING:
@@ -110,6 +183,8 @@ void AsyncHTTPSConnection::run_loop(){
                     break;
             }
 
+            if (req->state != state_before) finish_state(req, state_before);
+
             if (state_before != DONE && state_before != ERROR) {
                 if (req->state == DONE) {
                     if (verbose >= 2) cout << "State transitioned to DONE, cleaning up" << endl;
@@ -119,6 +194,7 @@ void AsyncHTTPSConnection::run_loop(){
                     this->cleanup(req);
                 }
             }
+            metrics.event_handling.record(TraceClock::now() - handling);
         }
     }
 }
@@ -135,6 +211,15 @@ void AsyncHTTPSConnection::handle_connect(HTTPSRequest* req, int16_t filter) {
                     req->conn = SSL_new(req->ssl_ctx);
                     SSL_set_fd(req->conn, req->socket_fd);
                     SSL_set_tlsext_host_name(req->conn, req->host.c_str());
+                    auto session = sessions.find(req->host);
+                    if (session != sessions.end()) SSL_set_session(req->conn, session->second);
+                    if (SSL_CTX_get_verify_mode(req->ssl_ctx) & SSL_VERIFY_PEER) {
+                        // Check the certificate names this host (or IP, for 127.0.0.1)
+                        X509_VERIFY_PARAM* param = SSL_get0_param(req->conn);
+                        if (X509_VERIFY_PARAM_set1_ip_asc(param, req->host.c_str()) != 1) {
+                            X509_VERIFY_PARAM_set1_host(param, req->host.c_str(), 0);
+                        }
+                    }
                     req->state = TLS_HANDSHAKE;
                 } else {
                     if (verbose >= 2) cout << "Socket connection failed with error: " << error << endl;
@@ -219,6 +304,7 @@ void AsyncHTTPSConnection::handle_write(HTTPSRequest* req, int16_t filter) {
 
                 if (bytes_written > 0) {
                     req->bytes_sent += bytes_written;
+                    metrics.bytes_sent += bytes_written;
                     if (verbose >= 2) cout << "Wrote " << bytes_written << " bytes, total=" << req->bytes_sent << "/" << req->send_buffer.size() << endl;
                     if (req->bytes_sent >= req->send_buffer.size()) {
                         if (verbose >= 2) cout << "Request fully sent, transitioning to READING_RESPONSE_HEADERS" << endl;
@@ -332,6 +418,13 @@ void AsyncHTTPSConnection::handle_read_response_headers(HTTPSRequest* req, int16
                 ssize_t bytes_received = SSL_read(req->conn, &buffer, sizeof(buffer));
                 if (verbose >= 2) cout << "SSL_read (headers) bytes=" << bytes_received << endl;
                 if (bytes_received > 0) {
+                    metrics.bytes_received += bytes_received;
+                    if (req->recv_headers.empty()) {
+                        // Time the provider took to start answering
+                        auto now = TraceClock::now();
+                        metrics.first_byte.record(now - req->request_sent);
+                        if (tracingEnabled()) traceAsync("first byte", "https", req->trace_id, req->request_sent, now);
+                    }
                     req->recv_headers.append(buffer, bytes_received);
                     if (verbose >= 2) cout << "Headers so far (" << req->recv_headers.size() << " bytes)" << endl;
 
@@ -347,6 +440,10 @@ void AsyncHTTPSConnection::handle_read_response_headers(HTTPSRequest* req, int16
 
                         if (verbose >= 2) cout << "=== HEADERS ===\n" << headers_only << "=== END HEADERS ===" << endl;
 
+                        // "http/1.1 429 too many requests"
+                        size_t status_pos = headers_only.find(' ');
+                        if (status_pos != string::npos) metrics.statuses[atoi(headers_only.c_str() + status_pos + 1)]++;
+
                         size_t te_pos = headers_only.find("transfer-encoding:");
                         if (te_pos != string::npos) {
                             size_t line_end = headers_only.find("\r\n", te_pos);
@@ -411,6 +508,7 @@ void AsyncHTTPSConnection::handle_read_response(HTTPSRequest* req, int16_t filte
                 ssize_t bytes_received = SSL_read(req->conn, &buffer, sizeof(buffer));
                 if (verbose >= 2) cout << "SSL_read (body) bytes=" << bytes_received << " transfer_mode=" << req->transfer_mode << endl;
                 if (bytes_received > 0) {
+                    metrics.bytes_received += bytes_received;
                     parse_response(req, buffer, bytes_received);
                     if (verbose >= 2) cout << "After parse_response, state=" << req->state << endl;
                 } else {
@@ -431,8 +529,29 @@ void AsyncHTTPSConnection::handle_read_response(HTTPSRequest* req, int16_t filte
 }
 
 void AsyncHTTPSConnection::cleanup(HTTPSRequest* req) {
+    if (req->state == DONE) {
+        metrics.completed++;
+        metrics.total.record(TraceClock::now() - req->started);
+    }
+    if (tracingEnabled()) {
+        traceAsync(req->state == DONE ? "request" : "request (failed)", "https", req->trace_id, req->started,
+                   TraceClock::now(), req->path);
+    }
+    if (req->state == DONE) {
+        // Taken after the response, since TLS 1.3 servers send session
+        // tickets after the handshake
+        SSL_SESSION* session = SSL_get1_session(req->conn);
+        if (session && SSL_SESSION_is_resumable(session)) {
+            SSL_SESSION*& cached = sessions[req->host];
+            if (cached) SSL_SESSION_free(cached);
+            cached = session;
+        } else if (session) {
+            SSL_SESSION_free(session);
+        }
+    }
     if (req->state == DONE){
         HTTPSResponse resp{req->recv_headers, req->recv_body};
+        if (req->on_response) req->on_response(resp);
         req->resp.set_value(resp);
     } else
     {
@@ -447,4 +566,48 @@ void AsyncHTTPSConnection::cleanup(HTTPSRequest* req) {
     kevent(kqueue_fd, &ev, 1, nullptr, 0, nullptr);
     
     reqs.erase(req->socket_fd);
-}
\ No newline at end of file
+    traceCounter("https in flight", reqs.size());
+}
+
+string ConnectionStats::summary() const {
+    static const char* state_names[] = {"connect", "tls", "send", "headers", "body", "done", "error"};
+    string out;
+    char line[160];
+
+    size_t failed = 0;
+    string failed_in;
+    for (int state = CONNECTING; state <= ERROR; state++) {
+        if (errors[state] == 0) continue;
+        failed += errors[state];
+        failed_in += (failed_in.empty() ? "" : ", ") + string(state_names[state]) + " " + to_string(errors[state]);
+    }
+    snprintf(line, sizeof(line), "HTTPS: %zu requests, %zu completed, %zu failed%s, %zu retried, peak %zu in flight\n",
+             requests, completed, failed, failed_in.empty() ? "" : (" (" + failed_in + ")").c_str(), retries,
+             peak_in_flight);
+    out += line;
+    snprintf(line, sizeof(line), "Sent %.1f KB, received %.1f KB, %zu DNS lookups cached, %zu TLS sessions resumed\n",
+             bytes_sent / 1024.0, bytes_received / 1024.0, dns_cached, tls_resumed);
+    out += line;
+    if (!statuses.empty()) {
+        vector<pair<int, size_t>> sorted(statuses.begin(), statuses.end());
+        sort(sorted.begin(), sorted.end());
+        out += "Status codes:";
+        for (const auto& [status, count] : sorted) out += " " + to_string(status) + " x" + to_string(count);
+        out += "\n";
+    }
+
+    snprintf(line, sizeof(line), "%-16s %7s %9s %9s %9s %9s %9s\n", "(ms)", "count", "mean", "p50", "p90", "p99", "max");
+    out += line;
+    const pair<const char*, const LatencyHistogram*> rows[] = {
+        {"dns", &dns}, {"connect", &connect}, {"tls", &tls},
+        {"first byte", &first_byte}, {"total", &total}, {"event handling", &event_handling},
+    };
+    for (const auto& [name, histogram] : rows) {
+        snprintf(line, sizeof(line), "%-16s %7llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", name,
+                 static_cast<unsigned long long>(histogram->count()), histogram->mean() / 1000.0,
+                 histogram->percentile(50) / 1000.0, histogram->percentile(90) / 1000.0,
+                 histogram->percentile(99) / 1000.0, histogram->max_value() / 1000.0);
+        out += line;
+    }
+    return out;
+}
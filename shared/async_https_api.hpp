@@ -16,6 +16,8 @@
 #include <sys/event.h>
 #include <sys/time.h>
 #include <future>
+#include "latency_histogram.hpp"
+#include "trace.hpp"
 
 using namespace std;
 
@@ -35,13 +37,39 @@ typedef enum {
     CONNECTION_CLOSE,
 } transfer_mode_t;
 
+// Per-connection network metrics, so slow runs can be pinned on DNS, the
+// network path, the provider (time to first byte after the request is
+// sent) or our own event loop (time spent handling each event). Latencies
+// are in microseconds.
+struct ConnectionStats {
+    LatencyHistogram dns;
+    LatencyHistogram connect;
+    LatencyHistogram tls;
+    LatencyHistogram first_byte;
+    LatencyHistogram total;
+    LatencyHistogram event_handling;
+
+    size_t bytes_sent = 0;
+    size_t bytes_received = 0;
+    size_t requests = 0;
+    size_t completed = 0;
+    size_t peak_in_flight = 0;
+    size_t dns_cached = 0;       // lookups answered from the DNS cache
+    size_t tls_resumed = 0;      // handshakes that resumed a cached session
+    size_t retries = 0;          // requests re-sent by a caller after a failure
+    size_t errors[ERROR + 1] = {};  // failed requests by the state they failed in
+    unordered_map<int, size_t> statuses;  // completed requests by HTTP status
+
+    string summary() const;
+};
+
 struct HTTPSResponse {
     string headers;
     string body;
 };
 
 struct HTTPSRequest {
-    int socket_fd;
+    int socket_fd = -1;
     SSL* conn;
     SSL_CTX* ssl_ctx;
 
@@ -60,6 +88,7 @@ struct HTTPSRequest {
     string recv_body;
 
     promise<HTTPSResponse> resp;
+    function<void(const HTTPSResponse&)> on_response;  // called before resp is fulfilled
 
 
     transfer_mode_t transfer_mode = CONNECTION_CLOSE;
@@ -67,10 +96,14 @@ struct HTTPSRequest {
     size_t chunk_size = 0;
     string chunked_buffer;
 
-    HTTPSRequest(const string& h, const string& p) : host(h), path(p) {
-        SSL_load_error_strings();
-        SSL_library_init();
-        ssl_ctx = SSL_CTX_new(TLS_client_method());
+    // Timing for stats and tracing: one async track per request, with a span per state
+    uint64_t trace_id = 0;
+    TraceClock::time_point started;
+    TraceClock::time_point state_since;
+    TraceClock::time_point request_sent;
+
+    // ssl_ctx is the connection's and outlives the request
+    HTTPSRequest(const string& h, const string& p, SSL_CTX* ctx) : ssl_ctx(ctx), host(h), path(p) {
         conn = nullptr;
     }
     ~HTTPSRequest() {
@@ -78,9 +111,6 @@ struct HTTPSRequest {
             SSL_shutdown(conn);
             SSL_free(conn);
         }
-        if (ssl_ctx) {
-            SSL_CTX_free(ssl_ctx);
-        }
         if (socket_fd >= 0) {
             close(socket_fd);
         }
@@ -92,6 +122,18 @@ private:
     int kqueue_fd;
     int verbose;
     unordered_map<int, unique_ptr<HTTPSRequest>> reqs;
+    ConnectionStats metrics;
+    // Shared by every request, with the last TLS session and address per
+    // host, so a long-lived connection object (the gcommit daemon keeps
+    // one) skips DNS and resumes TLS instead of a full handshake
+    SSL_CTX* ssl_ctx;
+    bool ca_loaded = true;
+    unordered_map<string, SSL_SESSION*> sessions;
+    struct ResolvedHost {
+        in_addr address;
+        TraceClock::time_point expires;
+    };
+    unordered_map<string, ResolvedHost> resolved_hosts;
     void handle_connect(HTTPSRequest* req, int16_t filter);
     void handle_tls(HTTPSRequest* req, int16_t filter);
     void handle_write(HTTPSRequest* req, int16_t filter);
@@ -99,10 +141,21 @@ private:
     void handle_read_response_headers(HTTPSRequest* req, int16_t filter);
     void handle_read_response(HTTPSRequest* req, int16_t filter);
     void cleanup(HTTPSRequest* req);
+    void finish_state(HTTPSRequest* req, conn_state_t finished);
 public:
     AsyncHTTPSConnection(int verbose = 0);
-    void post_async(const string& host, const string& path, const string& body, const vector<pair<string, string>>& headers, promise<HTTPSResponse> resp);
+    void post_async(const string& host, const string& path, const string& body, const vector<pair<string, string>>& headers, promise<HTTPSResponse> resp, int port = 443, function<void(const HTTPSResponse&)> on_response = nullptr);
+    // Verify servers against this PEM bundle (e.g. a local test server's
+    // self-signed certificate). Without one, certificates are not checked.
+    // If the file can't be loaded, every request fails.
+    void set_ca_file(const string& path);
+    void set_verbose(int level) { verbose = level; }
     void run_loop();
+    // Read between run_loop() calls, not while one is running
+    const ConnectionStats& stats() const { return metrics; }
+    void reset_stats() { metrics = ConnectionStats(); }
+    // For callers that re-send failed requests themselves
+    void count_retries(size_t n) { metrics.retries += n; }
     ~AsyncHTTPSConnection();
 };
 
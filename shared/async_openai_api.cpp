@@ -3,32 +3,115 @@
 using json = nlohmann::json;
 using namespace std;
 
-AsyncOpenAIAPI::AsyncOpenAIAPI(AsyncHTTPSConnection& api_connection, const string& api_key) : api_connection(api_connection), api_key(api_key) {};
+static string git_config(const string& key) {
+    string value;
+    FILE* pipe = popen(("git config --get " + key + " 2>/dev/null").c_str(), "r");
+    if (pipe) {
+        char c;
+        while ((c = fgetc(pipe)) != EOF && c != '\n') {
+            value += c;
+        }
+        pclose(pipe);
+    }
+    return value;
+}
+
+OpenAIEndpoint OpenAIEndpoint::fromBaseUrl(const string& url) {
+    const string scheme = "https://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        throw invalid_argument("OpenAI base URL must start with https://: " + url);
+    }
+    OpenAIEndpoint endpoint;
+    string rest = url.substr(scheme.size());
+    size_t slash = rest.find('/');
+    string authority = rest.substr(0, slash);
+    endpoint.base_path = slash == string::npos ? "/v1" : rest.substr(slash);
+    while (endpoint.base_path.size() > 1 && endpoint.base_path.back() == '/') endpoint.base_path.pop_back();
+    if (endpoint.base_path == "/") endpoint.base_path = "";
+
+    size_t colon = authority.rfind(':');
+    endpoint.host = authority.substr(0, colon);
+    if (colon != string::npos) {
+        try {
+            endpoint.port = stoi(authority.substr(colon + 1));
+        } catch (const exception& e) {
+            throw invalid_argument("Bad port in OpenAI base URL: " + url);
+        }
+    }
+    if (endpoint.host.empty() || endpoint.port <= 0 || endpoint.port > 65535) {
+        throw invalid_argument("Bad host or port in OpenAI base URL: " + url);
+    }
+    return endpoint;
+}
+
+OpenAIEndpoint OpenAIEndpoint::fromEnvironment() {
+    const char* url_env = getenv("OPENAI_BASE_URL");
+    string url = url_env ? url_env : git_config("custom.openaiBaseUrl");
+    OpenAIEndpoint endpoint = url.empty() ? OpenAIEndpoint() : fromBaseUrl(url);
+
+    const char* ca_env = getenv("CUSTOM_GIT_OPENAI_CA");
+    endpoint.ca_file = ca_env ? ca_env : git_config("custom.openaiCaFile");
+    return endpoint;
+}
+
+AsyncOpenAIAPI::AsyncOpenAIAPI(AsyncHTTPSConnection& api_connection, const string& api_key, const OpenAIEndpoint& endpoint) : api_connection(api_connection), api_key(api_key), endpoint(endpoint) {
+    if (!endpoint.ca_file.empty()) {
+        api_connection.set_ca_file(endpoint.ca_file);
+    }
+}
 
-future<HTTPSResponse> AsyncOpenAIAPI::async_embedding(string text) {
+future<HTTPSResponse> AsyncOpenAIAPI::post(const string& path, const string& body) {
     const vector<pair<string, string>> headers = {
         {"Authorization", "Bearer " + this->api_key},
         {"Content-Type", "application/json"}
     };
 
+    promise<HTTPSResponse> prom;
+    future<HTTPSResponse> fut = prom.get_future();
+    if (archive && archive->mode() == ApiArchive::REPLAY) {
+        optional<RecordedResponse> recorded = archive->lookup(path, body);
+        if (recorded) {
+            prom.set_value({recorded->headers, recorded->body});
+        } else {
+            prom.set_exception(make_exception_ptr(runtime_error("No recorded response for " + path + " in " + archive->path())));
+        }
+        return fut;
+    }
+
+    function<void(const HTTPSResponse&)> on_response;
+    if (archive) {
+        on_response = [archive = this->archive, path, body](const HTTPSResponse& response) {
+            archive->record(path, body, {response.headers, response.body});
+        };
+    }
+    this->api_connection.post_async(endpoint.host, endpoint.base_path + path, body, headers, std::move(prom), endpoint.port, std::move(on_response));
+    return fut;
+}
+
+future<HTTPSResponse> AsyncOpenAIAPI::async_embedding(string text, int dimensions) {
     json request_body = {
         {"model", "text-embedding-3-small"},
         {"input", text}
     };
-    string body = request_body.dump();
-
-    promise<HTTPSResponse> prom;
-    future<HTTPSResponse> fut = prom.get_future();
-    this->api_connection.post_async("api.openai.com", "/v1/embeddings", body, headers, std::move(prom));
-    return fut;
+    if (dimensions > 0) {
+        request_body["dimensions"] = dimensions;
+    }
+    return post("/embeddings", request_body.dump());
 }
 
-future<HTTPSResponse> AsyncOpenAIAPI::async_chat(const nlohmann::json& messages, int max_tokens, float temperature) {
-    const vector<pair<string, string>> headers = {
-        {"Authorization", "Bearer " + this->api_key},
-        {"Content-Type", "application/json"}
+future<HTTPSResponse> AsyncOpenAIAPI::async_embeddings(const vector<string>& texts, int dimensions) {
+    json request_body = {
+        {"model", "text-embedding-3-small"},
+        {"input", texts},
+        {"encoding_format", "base64"}
     };
+    if (dimensions > 0) {
+        request_body["dimensions"] = dimensions;
+    }
+    return post("/embeddings", request_body.dump());
+}
 
+future<HTTPSResponse> AsyncOpenAIAPI::async_chat(const nlohmann::json& messages, int max_tokens, float temperature) {
     json request_body = {
         {"model", "gpt-4o-mini"},
         {"messages", messages},
@@ -36,12 +119,7 @@ future<HTTPSResponse> AsyncOpenAIAPI::async_chat(const nlohmann::json& messages,
         {"temperature", temperature}
     };
 
-    string body = request_body.dump();
-
-    promise<HTTPSResponse> prom;
-    future<HTTPSResponse> fut = prom.get_future();
-    this->api_connection.post_async("api.openai.com", "/v1/chat/completions", body, headers, std::move(prom));
-    return fut;
+    return post("/chat/completions", request_body.dump());
 }
 
 void AsyncOpenAIAPI::run_requests() {
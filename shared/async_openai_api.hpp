@@ -1,6 +1,7 @@
 #ifndef ASYNC_OPENAI_API_HPP
 #define ASYNC_OPENAI_API_HPP
 
+#include "api_archive.hpp"
 #include "async_https_api.hpp"
 #include <string>
 #include <vector>
@@ -9,15 +10,43 @@
 
 using namespace std;
 
+// Where API requests go. Defaults to api.openai.com; tests and load runs
+// point it at a local server with its own CA.
+struct OpenAIEndpoint {
+    string host = "api.openai.com";
+    int port = 443;
+    string base_path = "/v1";
+    string ca_file;  // verify the server against this PEM when set
+
+    // OPENAI_BASE_URL (https://host[:port][/path]) and CUSTOM_GIT_OPENAI_CA,
+    // falling back to git config custom.openaiBaseUrl / custom.openaiCaFile.
+    // Throws invalid_argument for a malformed URL.
+    static OpenAIEndpoint fromEnvironment();
+    static OpenAIEndpoint fromBaseUrl(const string& url);
+};
+
 class AsyncOpenAIAPI {
   private:
     AsyncHTTPSConnection& api_connection;
     string api_key;
+    OpenAIEndpoint endpoint;
+    ApiArchive* archive = nullptr;
+    future<HTTPSResponse> post(const string& path, const string& body);
   public:
-    AsyncOpenAIAPI(AsyncHTTPSConnection& api_connection, const string& api_key);
-    future<HTTPSResponse> async_embedding(string text);
+    AsyncOpenAIAPI(AsyncHTTPSConnection& api_connection, const string& api_key, const OpenAIEndpoint& endpoint = OpenAIEndpoint());
+    // dimensions > 0 asks the API to shorten the vectors (text-embedding-3 only)
+    future<HTTPSResponse> async_embedding(string text, int dimensions = 0);
+    // Embeds several inputs in one request; results come back tagged with their
+    // input index, as base64-encoded little-endian float32 to keep responses small
+    future<HTTPSResponse> async_embeddings(const vector<string>& texts, int dimensions = 0);
     future<HTTPSResponse> async_chat(const nlohmann::json& messages, int max_tokens = 100, float temperature = 0.7);
     void run_requests();
+    // Counted in the connection's stats
+    void count_retries(size_t n) { api_connection.count_retries(n); }
+    // Record every response into the archive, or (in REPLAY mode) answer
+    // from it without touching the network. Requests missing from a replay
+    // archive fail like network errors.
+    void use_archive(ApiArchive* archive) { this->archive = archive; }
 };
 
 #endif // ASYNC_OPENAI_API_HPP
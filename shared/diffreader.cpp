@@ -1,4 +1,5 @@
 #include "diffreader.hpp"
+#include "trace.hpp"
 #include <vector>
 #include <fstream>
 #include <set>
@@ -122,6 +123,7 @@ void DiffReader::ingestDiffLine(string line) {
 }
 
 void DiffReader::ingestDiff() {
+    TraceSpan trace("DiffReader::ingestDiff", "parse");
     string line;
     while (getline(this->in, line)) {
         this->ingestDiffLine(line);
@@ -248,7 +250,8 @@ vector<string> createPatches(vector<DiffChunk> chunks) {
 
         int adjustment = 0;
         auto& cumulative_deltas = file_cumulative_deltas[filepath];
-        auto it_delta = cumulative_deltas.lower_bound(original_start);
+        // A chunk already emitted at the same start inserted lines above this one
+        auto it_delta = cumulative_deltas.upper_bound(original_start);
         if (it_delta != cumulative_deltas.begin()) {
             --it_delta;
             adjustment = it_delta->second;
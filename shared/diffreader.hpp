@@ -7,6 +7,7 @@
 #include <vector>
 #include <unordered_map>
 #include <algorithm>
+#include "fingerprint.hpp"
 using namespace std;
 enum DiffMode {
     EQ = 0,
@@ -27,6 +28,7 @@ struct DiffChunk {
     bool is_deleted = false;  // File is being deleted (whole file removal)
     bool is_new = false;      // File is being created (new file)
     bool is_rename = false;   // Pure rename (no content changes)
+    ChunkFingerprint fingerprint;  // Filled in by chunkDiff/chunkByLines (ast.hpp)
 };
 
 
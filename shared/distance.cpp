@@ -0,0 +1,620 @@
+#include "distance.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define DISTANCE_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DISTANCE_NEON 1
+#endif
+
+using namespace std;
+
+namespace {
+
+using PairKernel = float (*)(const float*, const float*, size_t);
+using Int8Kernel = int32_t (*)(const int8_t*, const int8_t*, size_t);
+using HalfKernel = float (*)(const uint16_t*, const uint16_t*, size_t);
+// One query against `count` rows `stride` floats apart, n floats each
+using ManyKernel = void (*)(const float*, const float*, size_t, size_t, size_t, float*);
+
+// The one-to-many kernels below read each chunk of the query once per block
+// of rows instead of once per row. Every row keeps the accumulators and
+// summation order of the matching pair kernel, so results are bit-identical
+// to calling it row by row; leftover rows go through the pair kernel. The
+// row loops are unrolled so the accumulator arrays stay in registers.
+
+float dotScalar(const float* a, const float* b, size_t n) {
+  float acc[4] = {};
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    for (int l = 0; l < 4; l++) acc[l] += a[i + l] * b[i + l];
+  }
+  float sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  for (; i < n; i++) sum += a[i] * b[i];
+  return sum;
+}
+
+float l2Scalar(const float* a, const float* b, size_t n) {
+  float acc[4] = {};
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    for (int l = 0; l < 4; l++) {
+      float d = a[i + l] - b[i + l];
+      acc[l] += d * d;
+    }
+  }
+  float sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  for (; i < n; i++) {
+    float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+void dotManyScalar(const float* a, const float* rows, size_t count, size_t stride, size_t n, float* out) {
+  for (size_t r = 0; r < count; r++) out[r] = dotScalar(a, rows + r * stride, n);
+}
+
+void l2ManyScalar(const float* a, const float* rows, size_t count, size_t stride, size_t n, float* out) {
+  for (size_t r = 0; r < count; r++) out[r] = l2Scalar(a, rows + r * stride, n);
+}
+
+int32_t dotI8Scalar(const int8_t* a, const int8_t* b, size_t n) {
+  int32_t sum = 0;
+  for (size_t i = 0; i < n; i++) sum += static_cast<int32_t>(a[i]) * b[i];
+  return sum;
+}
+
+float dotF16Scalar(const uint16_t* a, const uint16_t* b, size_t n) {
+  float sum = 0.0f;
+  for (size_t i = 0; i < n; i++) sum += half_to_float(a[i]) * half_to_float(b[i]);
+  return sum;
+}
+
+#ifdef DISTANCE_X86
+
+__attribute__((target("avx2,fma")))
+inline float hsumAVX2(__m256 v) {
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+  return _mm_cvtss_f32(lo);
+}
+
+__attribute__((target("avx2,fma")))
+float dotAVX2(const float* a, const float* b, size_t n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  __m256 acc2 = _mm256_setzero_ps();
+  __m256 acc3 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+    acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+  }
+  float sum = hsumAVX2(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+  for (; i < n; i++) sum += a[i] * b[i];
+  return sum;
+}
+
+__attribute__((target("avx2,fma")))
+float l2AVX2(const float* a, const float* b, size_t n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+    acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    acc0 = _mm256_fmadd_ps(d, d, acc0);
+  }
+  float sum = hsumAVX2(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) {
+    float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+// Three rows of four accumulators plus the query chunk fill the 16 ymm registers
+__attribute__((target("avx2,fma")))
+void dotManyAVX2(const float* a, const float* rows, size_t count, size_t stride, size_t n, float* out) {
+  size_t r = 0;
+  for (; r + 3 <= count; r += 3) {
+    const float* b[3] = {rows + r * stride, rows + (r + 1) * stride, rows + (r + 2) * stride};
+    __m256 acc[3][4];
+    #pragma GCC unroll 4
+    for (int k = 0; k < 3; k++) {
+      #pragma GCC unroll 4
+      for (int l = 0; l < 4; l++) acc[k][l] = _mm256_setzero_ps();
+    }
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      #pragma GCC unroll 4
+      for (int l = 0; l < 4; l++) {
+        __m256 q = _mm256_loadu_ps(a + i + 8 * l);
+        #pragma GCC unroll 4
+        for (int k = 0; k < 3; k++) acc[k][l] = _mm256_fmadd_ps(q, _mm256_loadu_ps(b[k] + i + 8 * l), acc[k][l]);
+      }
+    }
+    for (; i + 8 <= n; i += 8) {
+      __m256 q = _mm256_loadu_ps(a + i);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 3; k++) acc[k][0] = _mm256_fmadd_ps(q, _mm256_loadu_ps(b[k] + i), acc[k][0]);
+    }
+    #pragma GCC unroll 4
+    for (int k = 0; k < 3; k++) {
+      float sum = hsumAVX2(_mm256_add_ps(_mm256_add_ps(acc[k][0], acc[k][1]), _mm256_add_ps(acc[k][2], acc[k][3])));
+      for (size_t j = i; j < n; j++) sum += a[j] * b[k][j];
+      out[r + k] = sum;
+    }
+  }
+  for (; r < count; r++) out[r] = dotAVX2(a, rows + r * stride, n);
+}
+
+__attribute__((target("avx2,fma")))
+void l2ManyAVX2(const float* a, const float* rows, size_t count, size_t stride, size_t n, float* out) {
+  size_t r = 0;
+  for (; r + 4 <= count; r += 4) {
+    const float* b[4] = {rows + r * stride, rows + (r + 1) * stride, rows + (r + 2) * stride, rows + (r + 3) * stride};
+    __m256 acc[4][2];
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) acc[k][0] = acc[k][1] = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m256 q0 = _mm256_loadu_ps(a + i);
+      __m256 q1 = _mm256_loadu_ps(a + i + 8);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 4; k++) {
+        __m256 d0 = _mm256_sub_ps(q0, _mm256_loadu_ps(b[k] + i));
+        __m256 d1 = _mm256_sub_ps(q1, _mm256_loadu_ps(b[k] + i + 8));
+        acc[k][0] = _mm256_fmadd_ps(d0, d0, acc[k][0]);
+        acc[k][1] = _mm256_fmadd_ps(d1, d1, acc[k][1]);
+      }
+    }
+    for (; i + 8 <= n; i += 8) {
+      __m256 q = _mm256_loadu_ps(a + i);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 4; k++) {
+        __m256 d = _mm256_sub_ps(q, _mm256_loadu_ps(b[k] + i));
+        acc[k][0] = _mm256_fmadd_ps(d, d, acc[k][0]);
+      }
+    }
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) {
+      float sum = hsumAVX2(_mm256_add_ps(acc[k][0], acc[k][1]));
+      for (size_t j = i; j < n; j++) {
+        float d = a[j] - b[k][j];
+        sum += d * d;
+      }
+      out[r + k] = sum;
+    }
+  }
+  for (; r < count; r++) out[r] = l2AVX2(a, rows + r * stride, n);
+}
+
+__attribute__((target("avx2")))
+int32_t dotI8AVX2(const int8_t* a, const int8_t* b, size_t n) {
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  size_t i = 0;
+  // Sign-extend 16 codes to int16, then madd multiplies and adds pairs into int32 lanes
+  for (; i + 32 <= n; i += 32) {
+    __m256i a0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+    __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+    __m256i a1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)));
+    __m256i b1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+    acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+    acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(a1, b1));
+  }
+  for (; i + 16 <= n; i += 16) {
+    __m256i a0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+    __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+    acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+  }
+  __m256i acc = _mm256_add_epi32(acc0, acc1);
+  __m128i sum4 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(2, 3, 0, 1)));
+  int32_t sum = _mm_cvtsi128_si32(sum4);
+  for (; i < n; i++) sum += static_cast<int32_t>(a[i]) * b[i];
+  return sum;
+}
+
+// Every AVX2 CPU also has F16C, so this shares the AVX2 dispatch
+__attribute__((target("avx2,fma,f16c")))
+float dotF16AVX2(const uint16_t* a, const uint16_t* b, size_t n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256 a0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+    __m256 b0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+    __m256 a1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 8)));
+    __m256 b1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 8)));
+    acc0 = _mm256_fmadd_ps(a0, b0, acc0);
+    acc1 = _mm256_fmadd_ps(a1, b1, acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    __m256 a0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+    __m256 b0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+    acc0 = _mm256_fmadd_ps(a0, b0, acc0);
+  }
+  float sum = hsumAVX2(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) sum += half_to_float(a[i]) * half_to_float(b[i]);
+  return sum;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+int32_t dotI8AVX512(const int8_t* a, const int8_t* b, size_t n) {
+  __m512i acc = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m512i a0 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+    __m512i b0 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+    acc = _mm512_add_epi32(acc, _mm512_madd_epi16(a0, b0));
+  }
+  int32_t sum = _mm512_reduce_add_epi32(acc);
+  for (; i < n; i++) sum += static_cast<int32_t>(a[i]) * b[i];
+  return sum;
+}
+
+__attribute__((target("avx512f")))
+float dotAVX512(const float* a, const float* b, size_t n) {
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+  }
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+  }
+  if (i < n) {
+    __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+    acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc1);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f")))
+float l2AVX512(const float* a, const float* b, size_t n) {
+  __m512 acc = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+    acc = _mm512_fmadd_ps(d, d, acc);
+  }
+  if (i < n) {
+    __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+    __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+    acc = _mm512_fmadd_ps(d, d, acc);
+  }
+  return _mm512_reduce_add_ps(acc);
+}
+
+__attribute__((target("avx512f")))
+void dotManyAVX512(const float* a, const float* rows, size_t count, size_t stride, size_t n, float* out) {
+  size_t r = 0;
+  for (; r + 4 <= count; r += 4) {
+    const float* b[4] = {rows + r * stride, rows + (r + 1) * stride, rows + (r + 2) * stride, rows + (r + 3) * stride};
+    __m512 acc[4][2];
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) acc[k][0] = acc[k][1] = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      __m512 q0 = _mm512_loadu_ps(a + i);
+      __m512 q1 = _mm512_loadu_ps(a + i + 16);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 4; k++) {
+        acc[k][0] = _mm512_fmadd_ps(q0, _mm512_loadu_ps(b[k] + i), acc[k][0]);
+        acc[k][1] = _mm512_fmadd_ps(q1, _mm512_loadu_ps(b[k] + i + 16), acc[k][1]);
+      }
+    }
+    for (; i + 16 <= n; i += 16) {
+      __m512 q = _mm512_loadu_ps(a + i);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 4; k++) acc[k][0] = _mm512_fmadd_ps(q, _mm512_loadu_ps(b[k] + i), acc[k][0]);
+    }
+    if (i < n) {
+      __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+      __m512 q = _mm512_maskz_loadu_ps(mask, a + i);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 4; k++) acc[k][1] = _mm512_fmadd_ps(q, _mm512_maskz_loadu_ps(mask, b[k] + i), acc[k][1]);
+    }
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) out[r + k] = _mm512_reduce_add_ps(_mm512_add_ps(acc[k][0], acc[k][1]));
+  }
+  for (; r < count; r++) out[r] = dotAVX512(a, rows + r * stride, n);
+}
+
+__attribute__((target("avx512f")))
+void l2ManyAVX512(const float* a, const float* rows, size_t count, size_t stride, size_t n, float* out) {
+  size_t r = 0;
+  for (; r + 4 <= count; r += 4) {
+    const float* b[4] = {rows + r * stride, rows + (r + 1) * stride, rows + (r + 2) * stride, rows + (r + 3) * stride};
+    __m512 acc[4];
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) acc[k] = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m512 q = _mm512_loadu_ps(a + i);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 4; k++) {
+        __m512 d = _mm512_sub_ps(q, _mm512_loadu_ps(b[k] + i));
+        acc[k] = _mm512_fmadd_ps(d, d, acc[k]);
+      }
+    }
+    if (i < n) {
+      __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+      __m512 q = _mm512_maskz_loadu_ps(mask, a + i);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 4; k++) {
+        __m512 d = _mm512_sub_ps(q, _mm512_maskz_loadu_ps(mask, b[k] + i));
+        acc[k] = _mm512_fmadd_ps(d, d, acc[k]);
+      }
+    }
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) out[r + k] = _mm512_reduce_add_ps(acc[k]);
+  }
+  for (; r < count; r++) out[r] = l2AVX512(a, rows + r * stride, n);
+}
+
+#endif // DISTANCE_X86
+
+#ifdef DISTANCE_NEON
+
+float dotNEON(const float* a, const float* b, size_t n) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  float32x4_t acc2 = vdupq_n_f32(0.0f);
+  float32x4_t acc3 = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    acc2 = vfmaq_f32(acc2, vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+    acc3 = vfmaq_f32(acc3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+  }
+  for (; i + 4 <= n; i += 4) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  float sum = vaddvq_f32(vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3)));
+  for (; i < n; i++) sum += a[i] * b[i];
+  return sum;
+}
+
+int32_t dotI8NEON(const int8_t* a, const int8_t* b, size_t n) {
+  int32x4_t acc0 = vdupq_n_s32(0);
+  int32x4_t acc1 = vdupq_n_s32(0);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    int8x16_t va = vld1q_s8(a + i);
+    int8x16_t vb = vld1q_s8(b + i);
+    acc0 = vpadalq_s16(acc0, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+    acc1 = vpadalq_s16(acc1, vmull_high_s8(va, vb));
+  }
+  int32_t sum = vaddvq_s32(vaddq_s32(acc0, acc1));
+  for (; i < n; i++) sum += static_cast<int32_t>(a[i]) * b[i];
+  return sum;
+}
+
+float dotF16NEON(const uint16_t* a, const uint16_t* b, size_t n) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    float16x8_t va = vreinterpretq_f16_u16(vld1q_u16(a + i));
+    float16x8_t vb = vreinterpretq_f16_u16(vld1q_u16(b + i));
+    acc0 = vfmaq_f32(acc0, vcvt_f32_f16(vget_low_f16(va)), vcvt_f32_f16(vget_low_f16(vb)));
+    acc1 = vfmaq_f32(acc1, vcvt_high_f32_f16(va), vcvt_high_f32_f16(vb));
+  }
+  float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+  for (; i < n; i++) sum += half_to_float(a[i]) * half_to_float(b[i]);
+  return sum;
+}
+
+float l2NEON(const float* a, const float* b, size_t n) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+    float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    acc0 = vfmaq_f32(acc0, d0, d0);
+    acc1 = vfmaq_f32(acc1, d1, d1);
+  }
+  float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+  for (; i < n; i++) {
+    float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+}
+
+void dotManyNEON(const float* a, const float* rows, size_t count, size_t stride, size_t n, float* out) {
+  size_t r = 0;
+  for (; r + 4 <= count; r += 4) {
+    const float* b[4] = {rows + r * stride, rows + (r + 1) * stride, rows + (r + 2) * stride, rows + (r + 3) * stride};
+    float32x4_t acc[4][4];
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) {
+      #pragma GCC unroll 4
+      for (int l = 0; l < 4; l++) acc[k][l] = vdupq_n_f32(0.0f);
+    }
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      #pragma GCC unroll 4
+      for (int l = 0; l < 4; l++) {
+        float32x4_t q = vld1q_f32(a + i + 4 * l);
+        #pragma GCC unroll 4
+        for (int k = 0; k < 4; k++) acc[k][l] = vfmaq_f32(acc[k][l], q, vld1q_f32(b[k] + i + 4 * l));
+      }
+    }
+    for (; i + 4 <= n; i += 4) {
+      float32x4_t q = vld1q_f32(a + i);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 4; k++) acc[k][0] = vfmaq_f32(acc[k][0], q, vld1q_f32(b[k] + i));
+    }
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) {
+      float sum = vaddvq_f32(vaddq_f32(vaddq_f32(acc[k][0], acc[k][1]), vaddq_f32(acc[k][2], acc[k][3])));
+      for (size_t j = i; j < n; j++) sum += a[j] * b[k][j];
+      out[r + k] = sum;
+    }
+  }
+  for (; r < count; r++) out[r] = dotNEON(a, rows + r * stride, n);
+}
+
+void l2ManyNEON(const float* a, const float* rows, size_t count, size_t stride, size_t n, float* out) {
+  size_t r = 0;
+  for (; r + 4 <= count; r += 4) {
+    const float* b[4] = {rows + r * stride, rows + (r + 1) * stride, rows + (r + 2) * stride, rows + (r + 3) * stride};
+    float32x4_t acc[4][2];
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) acc[k][0] = acc[k][1] = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      float32x4_t q0 = vld1q_f32(a + i);
+      float32x4_t q1 = vld1q_f32(a + i + 4);
+      #pragma GCC unroll 4
+      for (int k = 0; k < 4; k++) {
+        float32x4_t d0 = vsubq_f32(q0, vld1q_f32(b[k] + i));
+        float32x4_t d1 = vsubq_f32(q1, vld1q_f32(b[k] + i + 4));
+        acc[k][0] = vfmaq_f32(acc[k][0], d0, d0);
+        acc[k][1] = vfmaq_f32(acc[k][1], d1, d1);
+      }
+    }
+    #pragma GCC unroll 4
+    for (int k = 0; k < 4; k++) {
+      float sum = vaddvq_f32(vaddq_f32(acc[k][0], acc[k][1]));
+      for (size_t j = i; j < n; j++) {
+        float d = a[j] - b[k][j];
+        sum += d * d;
+      }
+      out[r + k] = sum;
+    }
+  }
+  for (; r < count; r++) out[r] = l2NEON(a, rows + r * stride, n);
+}
+
+#endif // DISTANCE_NEON
+
+struct Kernels {
+  PairKernel dot;
+  PairKernel l2;
+  ManyKernel dot_many;
+  ManyKernel l2_many;
+  Int8Kernel dot_i8;
+  HalfKernel dot_f16;
+  const char* name;
+};
+
+Kernels selectKernels() {
+#ifdef DISTANCE_X86
+  __builtin_cpu_init();
+  bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if (__builtin_cpu_supports("avx512f") && avx2) {
+    Int8Kernel dot_i8 = __builtin_cpu_supports("avx512bw") ? dotI8AVX512 : dotI8AVX2;
+    return {dotAVX512, l2AVX512, dotManyAVX512, l2ManyAVX512, dot_i8, dotF16AVX2, "avx512"};
+  }
+  if (avx2) {
+    return {dotAVX2, l2AVX2, dotManyAVX2, l2ManyAVX2, dotI8AVX2, dotF16AVX2, "avx2"};
+  }
+#endif
+#ifdef DISTANCE_NEON
+  return {dotNEON, l2NEON, dotManyNEON, l2ManyNEON, dotI8NEON, dotF16NEON, "neon"};
+#endif
+  return {dotScalar, l2Scalar, dotManyScalar, l2ManyScalar, dotI8Scalar, dotF16Scalar, "scalar"};
+}
+
+const Kernels& kernels() {
+  static const Kernels selected = selectKernels();
+  return selected;
+}
+
+} // namespace
+
+float dot_product(span<const float> a, span<const float> b) {
+  return kernels().dot(a.data(), b.data(), min(a.size(), b.size()));
+}
+
+float l2_squared(span<const float> a, span<const float> b) {
+  return kernels().l2(a.data(), b.data(), min(a.size(), b.size()));
+}
+
+void dot_product_many(span<const float> query, const float* rows, size_t count, size_t stride, float* out) {
+  kernels().dot_many(query.data(), rows, count, stride, min(query.size(), stride), out);
+}
+
+void l2_squared_many(span<const float> query, const float* rows, size_t count, size_t stride, float* out) {
+  kernels().l2_many(query.data(), rows, count, stride, min(query.size(), stride), out);
+}
+
+int32_t dot_product_i8(span<const int8_t> a, span<const int8_t> b) {
+  return kernels().dot_i8(a.data(), b.data(), min(a.size(), b.size()));
+}
+
+float dot_product_f16(span<const uint16_t> a, span<const uint16_t> b) {
+  return kernels().dot_f16(a.data(), b.data(), min(a.size(), b.size()));
+}
+
+uint16_t float_to_half(float value) {
+  uint32_t bits = bit_cast<uint32_t>(value);
+  uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  uint32_t magnitude = bits & 0x7fffffff;
+  if (magnitude >= 0x7f800000) {
+    // Infinity stays infinity, NaN stays a quiet NaN
+    return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+  }
+  if (magnitude >= 0x477ff000) {
+    return sign | 0x7c00;
+  }
+  if (magnitude < 0x38800000) {
+    // Below the smallest normal half: encode as a subnormal
+    float scaled = bit_cast<float>(magnitude) * 16777216.0f;
+    return sign | static_cast<uint16_t>(lrintf(scaled));
+  }
+  // Round to nearest even on the 13 dropped mantissa bits
+  uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+  return sign | static_cast<uint16_t>((rounded - 0x38000000) >> 13);
+}
+
+float half_to_float(uint16_t bits) {
+  uint32_t sign = static_cast<uint32_t>(bits & 0x8000) << 16;
+  uint32_t exponent = (bits >> 10) & 0x1f;
+  uint32_t mantissa = bits & 0x3ff;
+  if (exponent == 0) {
+    float magnitude = ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -magnitude : magnitude;
+  }
+  if (exponent == 31) {
+    return bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+  }
+  return bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+float cos_sim(span<const float> a, span<const float> b) {
+  // assuming vectors are normalized
+  return dot_product(a, b);
+}
+
+string simd_level() {
+  return kernels().name;
+}
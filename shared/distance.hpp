@@ -0,0 +1,38 @@
+#ifndef DISTANCE_HPP
+#define DISTANCE_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+using namespace std;
+
+// Vector kernels used by all clustering code. The implementation is picked
+// once at startup from what the CPU supports (AVX-512, AVX2+FMA, NEON or
+// portable scalar code). Mismatched lengths use the shorter of the two.
+
+float dot_product(span<const float> a, span<const float> b);
+float l2_squared(span<const float> a, span<const float> b);
+
+// One query against `count` rows of a row-major block whose rows start
+// `stride` floats apart; writes count results to out. Faster than calling
+// the pair functions per row, with bit-identical results.
+void dot_product_many(span<const float> query, const float* rows, size_t count, size_t stride, float* out);
+void l2_squared_many(span<const float> query, const float* rows, size_t count, size_t stride, float* out);
+
+// Integer dot product of int8 codes, accumulated in int32
+int32_t dot_product_i8(span<const int8_t> a, span<const int8_t> b);
+// Dot product of IEEE half-precision values stored as raw bits
+float dot_product_f16(span<const uint16_t> a, span<const uint16_t> b);
+
+// Round-to-nearest-even float <-> half conversion
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t bits);
+
+// Cosine similarity of unit-normalized vectors (a plain dot product)
+float cos_sim(span<const float> a, span<const float> b);
+
+// Name of the selected kernel set, e.g. "avx2"
+string simd_level();
+
+#endif // DISTANCE_HPP
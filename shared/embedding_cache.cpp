@@ -0,0 +1,124 @@
+#include "embedding_cache.hpp"
+#include "hashing.hpp"
+#include <filesystem>
+#include <fstream>
+
+using namespace std;
+
+namespace {
+
+const uint32_t CACHE_MAGIC = 0x47454331;  // "GEC1"
+
+template <typename T>
+bool readValue(ifstream& in, T& value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <typename T>
+void writeValue(ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+EmbeddingCache::EmbeddingCache(string path, const string& tag, size_t max_entries)
+  : path(std::move(path)), salt(fnv1a64(tag)), max_entries(max_entries) {}
+
+uint64_t EmbeddingCache::key(const string& text) const {
+  return fnv1a64(text, salt);
+}
+
+bool EmbeddingCache::load() {
+  ifstream in(path, ios::binary);
+  uint32_t magic = 0;
+  uint64_t count = 0;
+  if (!in || !readValue(in, magic) || magic != CACHE_MAGIC || !readValue(in, count)) {
+    return false;
+  }
+  error_code ec;
+  uintmax_t file_size = filesystem::file_size(path, ec);
+  if (ec) return false;
+  for (uint64_t e = 0; e < count; e++) {
+    uint64_t k = 0;
+    uint32_t width = 0;
+    if (!readValue(in, k) || !readValue(in, width)) return false;
+    // A corrupt width must not become a huge allocation
+    uintmax_t remaining = file_size - static_cast<uintmax_t>(in.tellg());
+    if (width > remaining / sizeof(float)) return false;
+    vector<float> values(width);
+    if (!in.read(reinterpret_cast<char*>(values.data()), width * sizeof(float))) return false;
+    entries[k] = std::move(values);
+  }
+  return true;
+}
+
+bool EmbeddingCache::save() const {
+  vector<uint64_t> order;
+  for (const auto& [k, values] : entries) {
+    if (used.count(k)) order.push_back(k);
+  }
+  for (const auto& [k, values] : entries) {
+    if (order.size() >= max_entries) break;
+    if (!used.count(k)) order.push_back(k);
+  }
+
+  // Written next to the target and renamed, so a crash never leaves a torn cache
+  error_code ec;
+  filesystem::create_directories(filesystem::path(path).parent_path(), ec);
+  string temp_path = path + ".tmp";
+  {
+    ofstream out(temp_path, ios::binary | ios::trunc);
+    if (!out) return false;
+    writeValue(out, CACHE_MAGIC);
+    writeValue(out, static_cast<uint64_t>(order.size()));
+    for (uint64_t k : order) {
+      const vector<float>& values = entries.at(k);
+      writeValue(out, k);
+      writeValue(out, static_cast<uint32_t>(values.size()));
+      out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+    }
+    if (!out) return false;
+  }
+  filesystem::rename(temp_path, path, ec);
+  return !ec;
+}
+
+const vector<float>* EmbeddingCache::find(const string& text) {
+  uint64_t k = key(text);
+  auto it = entries.find(k);
+  if (it == entries.end()) return nullptr;
+  used.insert(k);
+  return &it->second;
+}
+
+void EmbeddingCache::store(const string& text, vector<float> embedding) {
+  uint64_t k = key(text);
+  entries[k] = std::move(embedding);
+  used.insert(k);
+}
+
+vector<vector<float>> CachedEmbeddingProvider::embed(const vector<string>& texts) {
+  vector<vector<float>> result(texts.size());
+  vector<string> missing;
+  vector<size_t> missing_index;
+  for (size_t i = 0; i < texts.size(); i++) {
+    if (const vector<float>* cached = cache.find(texts[i])) {
+      result[i] = *cached;
+      hits++;
+    } else {
+      missing.push_back(texts[i]);
+      missing_index.push_back(i);
+    }
+  }
+  if (missing.empty()) {
+    return result;
+  }
+
+  vector<vector<float>> fresh = inner.embed(missing);
+  for (size_t m = 0; m < missing.size() && m < fresh.size(); m++) {
+    // Failed inputs stay uncached so the next run retries them
+    if (!fresh[m].empty()) cache.store(missing[m], fresh[m]);
+    result[missing_index[m]] = std::move(fresh[m]);
+  }
+  return result;
+}
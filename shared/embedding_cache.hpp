@@ -0,0 +1,55 @@
+#ifndef EMBEDDING_CACHE_HPP
+#define EMBEDDING_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "embedding_provider.hpp"
+
+using namespace std;
+
+// Embeddings keyed by a hash of the input text, persisted between runs so
+// re-running on a slightly changed diff only embeds what is new. The tag
+// (model, width) is mixed into every key, so switching providers never
+// returns vectors from another space. Binary format: magic, entry count,
+// then key, width and float32 values per entry.
+class EmbeddingCache {
+private:
+  string path;
+  uint64_t salt;
+  size_t max_entries;
+  unordered_map<uint64_t, vector<float>> entries;
+  unordered_set<uint64_t> used;  // looked up or stored this run
+
+  uint64_t key(const string& text) const;
+
+public:
+  EmbeddingCache(string path, const string& tag, size_t max_entries = 50000);
+
+  // False if the file is missing or unreadable; the cache then starts empty
+  bool load();
+  // Entries used this run are kept first, then older ones up to max_entries
+  bool save() const;
+
+  const vector<float>* find(const string& text);
+  void store(const string& text, vector<float> embedding);
+  size_t size() const { return entries.size(); }
+};
+
+// Serves repeated inputs from an EmbeddingCache and forwards only the misses
+class CachedEmbeddingProvider : public EmbeddingProvider {
+private:
+  EmbeddingProvider& inner;
+  EmbeddingCache& cache;
+  size_t hits = 0;
+
+public:
+  CachedEmbeddingProvider(EmbeddingProvider& inner, EmbeddingCache& cache) : inner(inner), cache(cache) {}
+  vector<vector<float>> embed(const vector<string>& texts) override;
+  size_t max_input_tokens() const override { return inner.max_input_tokens(); }
+  size_t cache_hits() const { return hits; }
+};
+
+#endif // EMBEDDING_CACHE_HPP
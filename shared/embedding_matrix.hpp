@@ -0,0 +1,49 @@
+#ifndef EMBEDDING_MATRIX_HPP
+#define EMBEDDING_MATRIX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// Row-major float32 matrix holding one embedding per row. Rows are stored
+// contiguously so distance kernels can stream through them.
+struct EmbeddingMatrix {
+  size_t rows = 0;
+  size_t cols = 0;
+  vector<float> data;
+
+  EmbeddingMatrix() = default;
+  EmbeddingMatrix(size_t rows, size_t cols) : rows(rows), cols(cols), data(rows * cols, 0.0f) {}
+
+  // Missing or short rows (e.g. failed embedding requests) are zero-filled
+  static EmbeddingMatrix fromRows(const vector<vector<float>>& vectors) {
+    size_t width = 0;
+    for (const vector<float>& v : vectors) {
+      width = max(width, v.size());
+    }
+    EmbeddingMatrix matrix(vectors.size(), width);
+    for (size_t i = 0; i < vectors.size(); i++) {
+      copy(vectors[i].begin(), vectors[i].end(), matrix.row(i));
+    }
+    return matrix;
+  }
+
+  float* row(size_t i) { return data.data() + i * cols; }
+  const float* row(size_t i) const { return data.data() + i * cols; }
+
+  void normalizeRows() {
+    for (size_t i = 0; i < rows; i++) {
+      float* r = row(i);
+      float norm = 0.0f;
+      for (size_t j = 0; j < cols; j++) norm += r[j] * r[j];
+      if (norm > 0.0f) {
+        float inv = 1.0f / sqrt(norm);
+        for (size_t j = 0; j < cols; j++) r[j] *= inv;
+      }
+    }
+  }
+};
+
+#endif // EMBEDDING_MATRIX_HPP
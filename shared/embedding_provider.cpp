@@ -0,0 +1,203 @@
+#include "embedding_provider.hpp"
+#include "distance.hpp"
+#include "hashing.hpp"
+#include "parallel.hpp"
+#include "tokenizer.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <unordered_map>
+
+using namespace std;
+
+OpenAIEmbeddingProvider::OpenAIEmbeddingProvider(AsyncOpenAIAPI& api, int verbose, size_t dimensions,
+                                                 size_t max_batch_tokens, size_t max_batch_inputs)
+  : api(api), verbose(verbose), max_batch_tokens(max_batch_tokens), max_batch_inputs(max_batch_inputs),
+    dimensions(dimensions) {}
+
+vector<vector<float>> OpenAIEmbeddingProvider::embed(const vector<string>& texts) {
+  vector<vector<size_t>> batch_indices;
+  vector<vector<string>> batch_texts;
+  size_t batch_tokens = 0;
+  for (size_t i = 0; i < texts.size(); i++) {
+    size_t tokens = countTokens(texts[i]);
+    if (batch_texts.empty() || batch_tokens + tokens > max_batch_tokens ||
+        batch_texts.back().size() >= max_batch_inputs) {
+      batch_indices.push_back({});
+      batch_texts.push_back({});
+      batch_tokens = 0;
+    }
+    batch_indices.back().push_back(i);
+    batch_texts.back().push_back(texts[i]);
+    batch_tokens += tokens;
+  }
+
+  vector<future<HTTPSResponse>> futures;
+  for (const vector<string>& batch : batch_texts) {
+    futures.push_back(api.async_embeddings(batch, static_cast<int>(dimensions)));
+  }
+  if (verbose >= 1) cerr << "Packed into " << batch_texts.size() << " embedding requests" << endl;
+
+  api.run_requests();
+
+  vector<vector<float>> embeddings(texts.size());
+  vector<size_t> retry;
+  for (size_t b = 0; b < futures.size(); b++) {
+    vector<vector<float>> batch;
+    try {
+      batch = parse_embeddings(futures[b].get().body, batch_indices[b].size());
+    } catch (...) {
+      batch.assign(batch_indices[b].size(), {});
+    }
+    for (size_t k = 0; k < batch_indices[b].size(); k++) {
+      if (batch[k].empty() && batch_indices[b].size() > 1) retry.push_back(batch_indices[b][k]);
+      embeddings[batch_indices[b][k]] = std::move(batch[k]);
+    }
+    if (verbose >= 1) cerr << "." << flush;
+  }
+  if (verbose >= 1) cerr << " done" << endl;
+
+  // One input over the model limit (or a transient error) rejects its whole
+  // batch, so failed batches are re-sent an input at a time and only the
+  // inputs that fail on their own come back empty
+  if (!retry.empty()) {
+    if (verbose >= 1) cerr << "Retrying " << retry.size() << " inputs from failed batches one at a time" << endl;
+    api.count_retries(retry.size());
+    vector<future<HTTPSResponse>> singles;
+    for (size_t i : retry) {
+      singles.push_back(api.async_embeddings({texts[i]}, static_cast<int>(dimensions)));
+    }
+    api.run_requests();
+    for (size_t k = 0; k < retry.size(); k++) {
+      string error = "no embedding in the response";
+      try {
+        embeddings[retry[k]] = std::move(parse_embeddings(singles[k].get().body, 1)[0]);
+      } catch (const exception& e) {
+        error = e.what();
+      }
+      // Callers treat an empty vector as "no embedding", so this is the
+      // only place the reason is visible
+      if (embeddings[retry[k]].empty() && verbose >= 1) {
+        cerr << "Embedding input " << retry[k] << " failed on its own: " << error << endl;
+      }
+    }
+  }
+  return embeddings;
+}
+
+namespace {
+
+// Each feature lands in this many buckets so that collisions rarely cancel
+// out a feature entirely
+const int HASHES_PER_FEATURE = 4;
+
+const uint64_t UNIGRAM = 0x756e69;
+const uint64_t BIGRAM = 0x626967;
+const uint64_t TRIGRAM = 0x747269;
+const uint64_t IDENTIFIER = 0x696465;
+
+// Splits text into lowercase words, breaking identifiers on '_' and on
+// camelCase boundaries ("parseHTTPResponse" -> parse, http, response).
+// Every word is tagged with the identifier it came from.
+void splitWords(const string& text, vector<string>& words, vector<size_t>& word_identifier,
+                vector<string>& identifiers) {
+  size_t i = 0;
+  while (i < text.size()) {
+    if (!isalnum(static_cast<unsigned char>(text[i])) && text[i] != '_') {
+      i++;
+      continue;
+    }
+    size_t start = i;
+    while (i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_')) i++;
+    string_view ident(text.data() + start, i - start);
+
+    string lower_ident;
+    string current;
+    auto flush_word = [&]() {
+      if (!current.empty()) {
+        words.push_back(current);
+        word_identifier.push_back(identifiers.size());
+        current.clear();
+      }
+    };
+    for (size_t j = 0; j < ident.size(); j++) {
+      unsigned char c = ident[j];
+      lower_ident += static_cast<char>(tolower(c));
+      if (c == '_') {
+        flush_word();
+        continue;
+      }
+      if (isupper(c) && !current.empty()) {
+        bool prev_lower = islower(static_cast<unsigned char>(ident[j - 1])) || isdigit(static_cast<unsigned char>(ident[j - 1]));
+        bool next_lower = j + 1 < ident.size() && islower(static_cast<unsigned char>(ident[j + 1]));
+        if (prev_lower || (isupper(static_cast<unsigned char>(ident[j - 1])) && next_lower)) {
+          flush_word();
+        }
+      }
+      current += static_cast<char>(tolower(c));
+    }
+    flush_word();
+    identifiers.push_back(std::move(lower_ident));
+  }
+}
+
+} // namespace
+
+LocalEmbeddingProvider::LocalEmbeddingProvider(size_t dim, size_t num_threads, uint64_t seed)
+  : dim(dim), num_threads(num_threads), seed(seed) {}
+
+vector<float> LocalEmbeddingProvider::embed_one(const string& text) const {
+  vector<string> words;
+  vector<size_t> word_identifier;
+  vector<string> identifiers;
+  splitWords(text, words, word_identifier, identifiers);
+
+  unordered_map<uint64_t, float> features;
+  for (size_t i = 0; i < words.size(); i++) {
+    uint64_t word_hash = fnv1a64(words[i]);
+    features[splitmix64(word_hash ^ UNIGRAM)] += 1.0f;
+    // Bigrams only span words of the same identifier or adjacent identifiers
+    if (i + 1 < words.size() && word_identifier[i + 1] - word_identifier[i] <= 1) {
+      features[splitmix64(fnv1a64(words[i + 1], word_hash) ^ BIGRAM)] += 0.5f;
+    }
+    string padded = "^" + words[i] + "$";
+    for (size_t j = 0; j + 3 <= padded.size(); j++) {
+      features[splitmix64(fnv1a64(string_view(padded).substr(j, 3)) ^ TRIGRAM)] += 0.25f;
+    }
+  }
+  for (const string& ident : identifiers) {
+    if (ident.size() > 1) {
+      features[splitmix64(fnv1a64(ident) ^ IDENTIFIER)] += 0.5f;
+    }
+  }
+
+  vector<float> embedding(dim, 0.0f);
+  if (dim == 0) {
+    return embedding;
+  }
+  for (const auto& [feature, count] : features) {
+    float weight = 1.0f + log1p(count);
+    uint64_t h = feature ^ seed;
+    for (int k = 0; k < HASHES_PER_FEATURE; k++) {
+      h = splitmix64(h);
+      float sign = (h >> 63) ? 1.0f : -1.0f;
+      embedding[h % dim] += sign * weight;
+    }
+  }
+
+  float norm = dot_product(embedding, embedding);
+  if (norm > 0.0f) {
+    float inv = 1.0f / sqrt(norm);
+    for (float& v : embedding) v *= inv;
+  }
+  return embedding;
+}
+
+vector<vector<float>> LocalEmbeddingProvider::embed(const vector<string>& texts) {
+  vector<vector<float>> embeddings(texts.size());
+  parallelFor(texts.size(), [&](size_t i) {
+    embeddings[i] = embed_one(texts[i]);
+  }, num_threads);
+  return embeddings;
+}
@@ -0,0 +1,61 @@
+#ifndef EMBEDDING_PROVIDER_HPP
+#define EMBEDDING_PROVIDER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "async_openai_api.hpp"
+
+using namespace std;
+
+// Source of fixed-dimension, unit-normalized text embeddings.
+class EmbeddingProvider {
+public:
+  virtual ~EmbeddingProvider() = default;
+  // One vector per input, in order. Inputs that fail to embed come back empty.
+  virtual vector<vector<float>> embed(const vector<string>& texts) = 0;
+  // Inputs longer than this (in estimated tokens) should be truncated by the caller
+  virtual size_t max_input_tokens() const = 0;
+};
+
+// text-embedding-3-small via /v1/embeddings. Inputs are packed into batched
+// requests by token count and all requests run concurrently. The API
+// shortens vectors server-side (Matryoshka truncation), so asking for fewer
+// dimensions costs nothing in tokens and shrinks every downstream distance.
+class OpenAIEmbeddingProvider : public EmbeddingProvider {
+private:
+  AsyncOpenAIAPI& api;
+  int verbose;
+  size_t max_batch_tokens;
+  size_t max_batch_inputs;
+  size_t dimensions;
+
+public:
+  // dimensions = 0 keeps the model's native 1536
+  OpenAIEmbeddingProvider(AsyncOpenAIAPI& api, int verbose = 0, size_t dimensions = 256,
+                          size_t max_batch_tokens = 64000, size_t max_batch_inputs = 2048);
+  vector<vector<float>> embed(const vector<string>& texts) override;
+  // The model accepts 8191; the rest is headroom for estimation error
+  size_t max_input_tokens() const override { return 7000; }
+};
+
+// CPU-only embeddings for machines without network access. Word unigrams,
+// word bigrams and character trigrams (identifiers are split on camelCase
+// and snake_case) are feature-hashed with random signs into `dim` buckets,
+// which is a sparse random projection of the n-gram count vector. Counts are
+// log-scaled and the result is L2-normalized. Deterministic for a given seed.
+class LocalEmbeddingProvider : public EmbeddingProvider {
+private:
+  size_t dim;
+  size_t num_threads;
+  uint64_t seed;
+
+  vector<float> embed_one(const string& text) const;
+
+public:
+  LocalEmbeddingProvider(size_t dim = 512, size_t num_threads = 0, uint64_t seed = 0x5eed);
+  vector<vector<float>> embed(const vector<string>& texts) override;
+  size_t max_input_tokens() const override { return 1 << 20; }
+};
+
+#endif // EMBEDDING_PROVIDER_HPP
@@ -0,0 +1,117 @@
+#include "fingerprint.hpp"
+#include "hashing.hpp"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <unordered_set>
+
+using namespace std;
+
+// Keywords and ubiquitous names across the supported languages carry no
+// signal about which change a chunk belongs to.
+const unordered_set<string_view> IDENTIFIER_STOPLIST = {
+    "and", "as", "async", "auto", "await", "bool", "break", "case", "catch", "char",
+    "class", "const", "continue", "def", "default", "defer", "del", "do", "double", "elif",
+    "else", "end", "enum", "except", "export", "extends", "false", "final", "finally", "float",
+    "fn", "for", "from", "func", "function", "if", "impl", "import", "in", "include",
+    "int", "interface", "is", "let", "long", "match", "mod", "module", "mut", "namespace",
+    "new", "nil", "none", "not", "null", "nullptr", "or", "override", "package", "pass",
+    "private", "protected", "pub", "public", "raise", "return", "self", "size_t", "static", "std",
+    "string", "struct", "super", "switch", "then", "this", "throw", "true", "try", "type",
+    "typedef", "unsigned", "use", "using", "val", "var", "vector", "virtual", "void", "while",
+    "with", "yield",
+};
+
+void extractIdentifiers(string_view line, vector<string>& out) {
+  size_t i = 0;
+  while (i < line.size()) {
+    unsigned char c = line[i];
+    if (isalpha(c) || c == '_') {
+      size_t start = i;
+      while (i < line.size() && (isalnum(static_cast<unsigned char>(line[i])) || line[i] == '_')) i++;
+      string_view ident = line.substr(start, i - start);
+      if (ident.size() >= 3) {
+        string lower(ident);
+        transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (!IDENTIFIER_STOPLIST.count(lower)) {
+          out.emplace_back(ident);
+        }
+      }
+    } else if (isdigit(c)) {
+      while (i < line.size() && isalnum(static_cast<unsigned char>(line[i]))) i++;
+    } else {
+      i++;
+    }
+  }
+}
+
+vector<string> tokenizePath(const string& filepath) {
+  vector<string> tokens;
+  string current;
+  for (char c : filepath) {
+    if (c == '/' || c == '.' || c == '_' || c == '-') {
+      if (!current.empty()) tokens.push_back(current);
+      current.clear();
+    } else {
+      current += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+  }
+  if (!current.empty()) tokens.push_back(current);
+  return tokens;
+}
+
+ChunkFingerprint makeFingerprint(const string& filepath, const vector<string_view>& changed_lines,
+                                 vector<string> symbols) {
+  ChunkFingerprint fp;
+  fp.symbols = std::move(symbols);
+  fp.path_tokens = tokenizePath(filepath);
+
+  for (string_view line : changed_lines) {
+    extractIdentifiers(line, fp.identifiers);
+  }
+  sort(fp.identifiers.begin(), fp.identifiers.end());
+  fp.identifiers.erase(unique(fp.identifiers.begin(), fp.identifiers.end()), fp.identifiers.end());
+
+  fp.minhash.fill(numeric_limits<uint32_t>::max());
+  for (const string& ident : fp.identifiers) {
+    uint64_t base = fnv1a64(ident);
+    for (size_t k = 0; k < MINHASH_SIZE; k++) {
+      uint32_t h = static_cast<uint32_t>(splitmix64(base ^ (k * 0x9e3779b97f4a7c15ULL)));
+      fp.minhash[k] = min(fp.minhash[k], h);
+    }
+  }
+  fp.computed = true;
+  return fp;
+}
+
+float minhashSimilarity(const ChunkFingerprint& a, const ChunkFingerprint& b) {
+  if (a.identifiers.empty() || b.identifiers.empty()) {
+    return 0.0f;
+  }
+  size_t matches = 0;
+  for (size_t k = 0; k < MINHASH_SIZE; k++) {
+    matches += (a.minhash[k] == b.minhash[k]);
+  }
+  return static_cast<float>(matches) / MINHASH_SIZE;
+}
+
+float jaccard(const vector<string>& a, const vector<string>& b) {
+  if (a.empty() && b.empty()) {
+    return 0.0f;
+  }
+  size_t shared = 0;
+  auto ia = a.begin();
+  auto ib = b.begin();
+  while (ia != a.end() && ib != b.end()) {
+    if (*ia < *ib) {
+      ia++;
+    } else if (*ib < *ia) {
+      ib++;
+    } else {
+      shared++;
+      ia++;
+      ib++;
+    }
+  }
+  return static_cast<float>(shared) / (a.size() + b.size() - shared);
+}
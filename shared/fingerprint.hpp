@@ -0,0 +1,34 @@
+#ifndef FINGERPRINT_HPP
+#define FINGERPRINT_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+const size_t MINHASH_SIZE = 64;
+
+// Cheap structural signal computed locally for every chunk, used to group
+// obviously related chunks before (or instead of) requesting embeddings.
+struct ChunkFingerprint {
+  vector<string> identifiers;  // sorted, unique identifiers on changed lines
+  vector<string> symbols;      // enclosing declaration names, outermost first
+  vector<string> path_tokens;  // lowercase components of the file path
+  array<uint32_t, MINHASH_SIZE> minhash{};
+  bool computed = false;
+};
+
+ChunkFingerprint makeFingerprint(const string& filepath, const vector<string_view>& changed_lines,
+                                 vector<string> symbols = {});
+
+// Fraction of matching MinHash slots, an unbiased estimate of the Jaccard
+// similarity of the two identifier sets. 0 when either set is empty.
+float minhashSimilarity(const ChunkFingerprint& a, const ChunkFingerprint& b);
+
+// Exact Jaccard similarity of two sorted, unique token lists.
+float jaccard(const vector<string>& a, const vector<string>& b);
+
+#endif // FINGERPRINT_HPP
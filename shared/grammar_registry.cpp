@@ -0,0 +1,317 @@
+#include "grammar_registry.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+
+using namespace std;
+
+extern "C" {
+TSLanguage *tree_sitter_python();
+TSLanguage *tree_sitter_cpp();
+TSLanguage *tree_sitter_java();
+TSLanguage *tree_sitter_javascript();
+TSLanguage *tree_sitter_go();
+#ifdef CUSTOM_GIT_EXTRA_GRAMMARS
+TSLanguage *tree_sitter_typescript();
+TSLanguage *tree_sitter_tsx();
+TSLanguage *tree_sitter_rust();
+TSLanguage *tree_sitter_c_sharp();
+TSLanguage *tree_sitter_ruby();
+TSLanguage *tree_sitter_kotlin();
+#endif
+}
+
+// Split-point queries from shared/queries/*.scm, embedded at configure time
+const unordered_map<string, string_view> CHUNK_QUERY_SOURCES = {
+#include "chunk_queries.inc"
+};
+
+string embeddedQuery(const string &name) {
+  auto it = CHUNK_QUERY_SOURCES.find(name);
+  return it != CHUNK_QUERY_SOURCES.end() ? string(it->second) : "";
+}
+
+GrammarRegistry::GrammarRegistry() {
+  registerBuiltins();
+  loadPluginsFromEnvironment();
+}
+
+GrammarRegistry &GrammarRegistry::instance() {
+  static GrammarRegistry registry;
+  return registry;
+}
+
+void GrammarRegistry::registerBuiltins() {
+  registerGrammar({"python", tree_sitter_python(), {".py", ".pyi", ".pyw"}, {"SConstruct", "SConscript"},
+                   {"python", "python2", "python3", "pypy", "pypy3"}, embeddedQuery("python")});
+  registerGrammar({"cpp", tree_sitter_cpp(),
+                   {".cpp", ".cc", ".cxx", ".c++", ".c", ".h", ".hpp", ".hh", ".hxx", ".inl", ".ipp"},
+                   {}, {}, embeddedQuery("cpp")});
+  registerGrammar({"java", tree_sitter_java(), {".java"}, {}, {}, embeddedQuery("java")});
+  registerGrammar({"go", tree_sitter_go(), {".go"}, {}, {}, embeddedQuery("go")});
+
+#ifdef CUSTOM_GIT_EXTRA_GRAMMARS
+  registerGrammar({"javascript", tree_sitter_javascript(), {".js", ".jsx", ".mjs", ".cjs"}, {},
+                   {"node", "nodejs", "bun"}, embeddedQuery("javascript")});
+  registerGrammar({"typescript", tree_sitter_typescript(), {".ts", ".mts", ".cts"}, {},
+                   {"deno", "ts-node", "tsx"}, embeddedQuery("typescript")});
+  // The tsx grammar shares node types with typescript, so it reuses its query
+  registerGrammar({"tsx", tree_sitter_tsx(), {".tsx"}, {}, {}, embeddedQuery("typescript")});
+  registerGrammar({"rust", tree_sitter_rust(), {".rs"}, {}, {}, embeddedQuery("rust")});
+  registerGrammar({"c_sharp", tree_sitter_c_sharp(), {".cs", ".csx"}, {}, {}, embeddedQuery("c_sharp")});
+  registerGrammar({"ruby", tree_sitter_ruby(), {".rb", ".rake", ".gemspec", ".ru"},
+                   {"Rakefile", "Gemfile", "Guardfile", "Vagrantfile", "Podfile", "Fastfile"},
+                   {"ruby", "jruby"}, embeddedQuery("ruby")});
+  registerGrammar({"kotlin", tree_sitter_kotlin(), {".kt", ".kts"}, {}, {"kotlin", "kscript"},
+                   embeddedQuery("kotlin")});
+#else
+  // Without the extra grammars TypeScript falls back to the JavaScript parser
+  registerGrammar({"javascript", tree_sitter_javascript(),
+                   {".js", ".jsx", ".mjs", ".cjs", ".ts", ".tsx", ".mts", ".cts"}, {},
+                   {"node", "nodejs", "bun", "deno", "ts-node"}, embeddedQuery("javascript")});
+  aliases["typescript"] = "javascript";
+#endif
+
+  // Names accepted in modelines (vim ft=, emacs mode:) besides grammar names
+  const pair<const char *, const char *> modeline_aliases[] = {
+      {"py", "python"},     {"python3", "python"}, {"c", "cpp"},       {"c++", "cpp"},
+      {"cc", "cpp"},        {"h", "cpp"},          {"js", "javascript"}, {"jsx", "javascript"},
+      {"node", "javascript"}, {"ts", "typescript"}, {"typescriptreact", "tsx"}, {"rs", "rust"},
+      {"cs", "c_sharp"},    {"csharp", "c_sharp"}, {"c#", "c_sharp"},   {"rb", "ruby"},
+      {"kt", "kotlin"},     {"golang", "go"},
+  };
+  for (const auto &[alias, name] : modeline_aliases) {
+    aliases.emplace(alias, name);
+  }
+}
+
+void GrammarRegistry::registerGrammar(Grammar grammar) {
+  lock_guard<mutex> lock(registry_mutex);
+  size_t idx;
+  auto existing = by_name.find(grammar.name);
+  if (existing != by_name.end()) {
+    // Later registrations (plugins) replace the grammar but keep its mappings
+    idx = existing->second;
+    if (grammar.chunk_query.empty()) {
+      grammar.chunk_query = grammars[idx].chunk_query;
+    }
+    grammars[idx] = grammar;
+  } else {
+    idx = grammars.size();
+    grammars.push_back(grammar);
+    by_name[grammar.name] = idx;
+  }
+  for (const string &ext : grammar.extensions) by_extension[ext] = idx;
+  for (const string &filename : grammar.filenames) by_filename[filename] = idx;
+  for (const string &interpreter : grammar.interpreters) by_interpreter[interpreter] = idx;
+}
+
+string readFile(const filesystem::path &path) {
+  ifstream in(path);
+  if (!in.is_open()) return "";
+  stringstream buffer;
+  buffer << in.rdbuf();
+  return buffer.str();
+}
+
+bool GrammarRegistry::loadPlugin(const string &library_path) {
+  filesystem::path path(library_path);
+  string stem = path.stem().string();
+  if (stem.rfind("lib", 0) == 0) stem = stem.substr(3);
+  if (stem.rfind("tree-sitter-", 0) == 0) stem = stem.substr(12);
+  string name = stem;
+  replace(name.begin(), name.end(), '-', '_');
+  if (name.empty()) return false;
+
+  void *handle = dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr) {
+    cerr << "Warning: could not load grammar plugin " << library_path << ": " << dlerror() << endl;
+    return false;
+  }
+
+  string symbol = "tree_sitter_" + name;
+  auto entry = reinterpret_cast<const TSLanguage *(*)()>(dlsym(handle, symbol.c_str()));
+  if (entry == nullptr) {
+    cerr << "Warning: grammar plugin " << library_path << " does not export " << symbol << endl;
+    dlclose(handle);
+    return false;
+  }
+
+  const TSLanguage *lang = entry();
+  uint32_t version = ts_language_version(lang);
+  if (version < TREE_SITTER_MIN_COMPATIBLE_LANGUAGE_VERSION || version > TREE_SITTER_LANGUAGE_VERSION) {
+    cerr << "Warning: grammar plugin " << library_path << " has ABI version " << version
+         << ", expected " << TREE_SITTER_MIN_COMPATIBLE_LANGUAGE_VERSION << "-"
+         << TREE_SITTER_LANGUAGE_VERSION << endl;
+    dlclose(handle);
+    return false;
+  }
+
+  // The handle is intentionally never closed: trees built from the language
+  // may outlive the registry during static destruction.
+  Grammar grammar;
+  grammar.name = name;
+  grammar.language = lang;
+
+  filesystem::path dir = path.parent_path();
+  istringstream extensions(readFile(dir / (name + ".extensions")));
+  string ext;
+  while (extensions >> ext) {
+    grammar.extensions.push_back(ext[0] == '.' ? ext : "." + ext);
+  }
+  if (grammar.extensions.empty() && !has(name)) {
+    grammar.extensions.push_back("." + name);
+  }
+  grammar.chunk_query = readFile(dir / (name + ".scm"));
+
+  registerGrammar(grammar);
+  return true;
+}
+
+void GrammarRegistry::loadPluginsFromDir(const string &dir) {
+  error_code ec;
+  if (!filesystem::is_directory(dir, ec)) return;
+  for (const auto &entry : filesystem::directory_iterator(dir, ec)) {
+    string ext = entry.path().extension().string();
+    if (entry.is_regular_file(ec) && (ext == ".so" || ext == ".dylib")) {
+      loadPlugin(entry.path().string());
+    }
+  }
+}
+
+void GrammarRegistry::loadPluginsFromEnvironment() {
+  const char *grammar_path = getenv("CUSTOM_GIT_GRAMMAR_PATH");
+  if (grammar_path != nullptr) {
+    istringstream dirs(grammar_path);
+    string dir;
+    while (getline(dirs, dir, ':')) {
+      if (!dir.empty()) loadPluginsFromDir(dir);
+    }
+    return;
+  }
+  const char *home = getenv("HOME");
+  if (home != nullptr) {
+    loadPluginsFromDir(string(home) + "/.config/custom-git/grammars");
+  }
+}
+
+const Grammar *GrammarRegistry::findLocked(const string &name) const {
+  string resolved = name;
+  // Aliases may point at other aliases (ts -> typescript -> javascript)
+  for (int hops = 0; hops < 3; hops++) {
+    auto it = by_name.find(resolved);
+    if (it != by_name.end()) return &grammars[it->second];
+    auto alias = aliases.find(resolved);
+    if (alias == aliases.end()) return nullptr;
+    resolved = alias->second;
+  }
+  return nullptr;
+}
+
+const TSLanguage *GrammarRegistry::language(const string &name) const {
+  lock_guard<mutex> lock(registry_mutex);
+  const Grammar *grammar = findLocked(name);
+  return grammar ? grammar->language : nullptr;
+}
+
+string GrammarRegistry::chunkQuery(const string &name) const {
+  lock_guard<mutex> lock(registry_mutex);
+  const Grammar *grammar = findLocked(name);
+  return grammar ? grammar->chunk_query : "";
+}
+
+bool GrammarRegistry::has(const string &name) const {
+  lock_guard<mutex> lock(registry_mutex);
+  return findLocked(name) != nullptr;
+}
+
+// "#!/usr/bin/env -S python3 -u" -> "python3"
+string shebangInterpreter(string_view first_line) {
+  if (first_line.substr(0, 2) != "#!") return "";
+  istringstream words{string(first_line.substr(2))};
+  string word;
+  if (!(words >> word)) return "";
+  string program = filesystem::path(word).filename().string();
+  if (program == "env") {
+    while (words >> word) {
+      if (word[0] != '-' && word.find('=') == string::npos) return word;
+    }
+    return "";
+  }
+  return program;
+}
+
+string modelineLanguage(string_view line) {
+  static const regex vim_regex(R"((?:^|\s)(?:vi|vim|ex):.*\b(?:ft|filetype|syntax)=([\w+#-]+))");
+  static const regex emacs_mode_regex(R"(-\*-.*\bmode:\s*([\w+#-]+))");
+  static const regex emacs_short_regex(R"(-\*-\s*([\w+#-]+)\s*-\*-)");
+
+  string text(line);
+  smatch match;
+  if (regex_search(text, match, vim_regex) || regex_search(text, match, emacs_mode_regex) ||
+      regex_search(text, match, emacs_short_regex)) {
+    string name = match[1].str();
+    transform(name.begin(), name.end(), name.begin(), ::tolower);
+    return name;
+  }
+  return "";
+}
+
+string GrammarRegistry::detect(const string &filepath, string_view content) const {
+  lock_guard<mutex> lock(registry_mutex);
+
+  filesystem::path path(filepath);
+  auto by_file = by_filename.find(path.filename().string());
+  if (by_file != by_filename.end()) {
+    return grammars[by_file->second].name;
+  }
+
+  string ext = path.extension().string();
+  if (!ext.empty()) {
+    transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    auto by_ext = by_extension.find(ext);
+    if (by_ext != by_extension.end()) return grammars[by_ext->second].name;
+  }
+
+  // Extensionless files and unknown extensions (tool.cgi, Makefile.in):
+  // shebang, then modelines in the first/last 5 lines
+  vector<string_view> lines;
+  size_t pos = 0;
+  while (pos < content.size()) {
+    size_t end = content.find('\n', pos);
+    if (end == string_view::npos) end = content.size();
+    lines.push_back(content.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  if (lines.empty()) return "text";
+
+  string interpreter = shebangInterpreter(lines[0]);
+  if (!interpreter.empty()) {
+    auto it = by_interpreter.find(interpreter);
+    if (it == by_interpreter.end()) {
+      // python3.11 -> python3 -> python
+      string trimmed = interpreter;
+      while (it == by_interpreter.end() && !trimmed.empty() &&
+             (isdigit(static_cast<unsigned char>(trimmed.back())) || trimmed.back() == '.')) {
+        trimmed.pop_back();
+        it = by_interpreter.find(trimmed);
+      }
+    }
+    if (it != by_interpreter.end()) return grammars[it->second].name;
+  }
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (i >= 5 && i + 5 < lines.size()) continue;
+    string name = modelineLanguage(lines[i]);
+    if (name.empty()) continue;
+    const Grammar *grammar = findLocked(name);
+    if (grammar != nullptr) return grammar->name;
+  }
+
+  return "text";
+}
@@ -0,0 +1,64 @@
+#ifndef GRAMMAR_REGISTRY_HPP
+#define GRAMMAR_REGISTRY_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cpp-tree-sitter.h>
+
+using namespace std;
+
+struct Grammar {
+  string name;                   // language id used throughout gcommit, e.g. "rust"
+  const TSLanguage* language = nullptr;
+  vector<string> extensions;     // ".rs"
+  vector<string> filenames;      // exact basenames, e.g. "Rakefile"
+  vector<string> interpreters;   // shebang interpreters, e.g. "ruby"
+  string chunk_query;            // tree-sitter query with @split captures
+};
+
+// Maps files to tree-sitter grammars. Built-in grammars are linked
+// statically; extra ones are loaded with dlopen from
+// $CUSTOM_GIT_GRAMMAR_PATH (colon separated) or ~/.config/custom-git/grammars.
+// A plugin is a shared library named libtree-sitter-<name>.{so,dylib}
+// exporting tree_sitter_<name>(), optionally next to <name>.extensions
+// (whitespace separated, e.g. ".zig .zon") and <name>.scm (split query).
+class GrammarRegistry {
+private:
+  vector<Grammar> grammars;
+  unordered_map<string, size_t> by_name;
+  unordered_map<string, size_t> by_extension;
+  unordered_map<string, size_t> by_filename;
+  unordered_map<string, size_t> by_interpreter;
+  unordered_map<string, string> aliases;
+  mutable mutex registry_mutex;
+
+  GrammarRegistry();
+  void registerBuiltins();
+  void loadPluginsFromEnvironment();
+  const Grammar* findLocked(const string& name) const;
+
+public:
+  static GrammarRegistry& instance();
+
+  void registerGrammar(Grammar grammar);
+  bool loadPlugin(const string& library_path);
+  void loadPluginsFromDir(const string& dir);
+
+  const TSLanguage* language(const string& name) const;
+  string chunkQuery(const string& name) const;
+  bool has(const string& name) const;
+
+  // Returns a registered grammar name, or "text" when nothing matches.
+  // Checks exact filename, extension, then (when neither matched) the
+  // shebang on the first line of content and any vim/emacs modeline in its
+  // first or last five lines.
+  string detect(const string& filepath, string_view content = "") const;
+
+  GrammarRegistry(const GrammarRegistry&) = delete;
+  GrammarRegistry& operator=(const GrammarRegistry&) = delete;
+};
+
+#endif // GRAMMAR_REGISTRY_HPP
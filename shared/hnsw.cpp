@@ -0,0 +1,258 @@
+#include "hnsw.hpp"
+#include "distance.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <random>
+
+using namespace std;
+
+namespace {
+
+const int MAX_LEVEL = 16;
+
+// Per-thread visited marks, cleared in O(1) by bumping the epoch
+struct VisitedList {
+  vector<uint32_t> marks;
+  uint32_t epoch = 0;
+
+  void reset(size_t n) {
+    if (marks.size() < n) {
+      marks.assign(n, 0);
+      epoch = 0;
+    }
+    if (++epoch == 0) {
+      fill(marks.begin(), marks.end(), 0);
+      epoch = 1;
+    }
+  }
+  bool visit(int i) {
+    if (marks[i] == epoch) return false;
+    marks[i] = epoch;
+    return true;
+  }
+};
+
+VisitedList& threadVisited(size_t n) {
+  thread_local VisitedList visited;
+  visited.reset(n);
+  return visited;
+}
+
+inline float chordDistance(float cosine_distance) {
+  return sqrt(max(0.0f, 2.0f * cosine_distance));
+}
+
+} // namespace
+
+HNSWIndex::HNSWIndex(const EmbeddingMatrix& data, HNSWOptions options)
+    : data(data), options(options), store(data, options.quantization), levels(data.rows), links(data.rows),
+      node_locks(make_unique<mutex[]>(data.rows)) {
+  this->options.M = max<size_t>(2, options.M);
+  double level_mult = 1.0 / log(static_cast<double>(this->options.M));
+  mt19937_64 rng(options.seed);
+  uniform_real_distribution<double> uniform(0.0, 1.0);
+  for (size_t i = 0; i < data.rows; i++) {
+    double u = 1.0 - uniform(rng);
+    levels[i] = min(MAX_LEVEL, static_cast<int>(-log(u) * level_mult));
+    links[i].resize(levels[i] + 1);
+  }
+}
+
+// 1 - cos, which orders neighbors the same way as the chord distance
+float HNSWIndex::distance(const Query& query, int node) const {
+  return 1.0f - store.similarity(query, node);
+}
+
+float HNSWIndex::distance(int a, int b) const {
+  return 1.0f - store.similarity(a, b);
+}
+
+int HNSWIndex::greedyDescend(const Query& query, int start, int from_level, int to_level) const {
+  int current = start;
+  float best = distance(query, current);
+  vector<int> neighbors;
+  for (int level = from_level; level > to_level; level--) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      {
+        lock_guard<mutex> guard(node_locks[current]);
+        neighbors = links[current][level];
+      }
+      for (int candidate : neighbors) {
+        float d = distance(query, candidate);
+        if (d < best) {
+          best = d;
+          current = candidate;
+          changed = true;
+        }
+      }
+    }
+  }
+  return current;
+}
+
+// Best-first search on one layer. Returns up to ef (distance, node) pairs, closest first.
+vector<pair<float, int>> HNSWIndex::searchLayer(const Query& query, int start, size_t ef, int level) const {
+  VisitedList& visited = threadVisited(data.rows);
+  priority_queue<pair<float, int>, vector<pair<float, int>>, greater<>> candidates;
+  priority_queue<pair<float, int>> results;
+
+  float d = distance(query, start);
+  candidates.push({d, start});
+  results.push({d, start});
+  visited.visit(start);
+
+  vector<int> neighbors;
+  while (!candidates.empty()) {
+    auto [dist, node] = candidates.top();
+    if (results.size() >= ef && dist > results.top().first) {
+      break;
+    }
+    candidates.pop();
+
+    {
+      lock_guard<mutex> guard(node_locks[node]);
+      neighbors = links[node][level];
+    }
+    for (int neighbor : neighbors) {
+      if (!visited.visit(neighbor)) continue;
+      float nd = distance(query, neighbor);
+      if (results.size() < ef || nd < results.top().first) {
+        candidates.push({nd, neighbor});
+        results.push({nd, neighbor});
+        if (results.size() > ef) results.pop();
+      }
+    }
+  }
+
+  vector<pair<float, int>> sorted(results.size());
+  for (size_t i = sorted.size(); i-- > 0;) {
+    sorted[i] = results.top();
+    results.pop();
+  }
+  return sorted;
+}
+
+// Keeps a candidate only if it is closer to the query than to every
+// neighbor already kept, which spreads links across directions.
+// Candidates must be sorted closest first.
+vector<int> HNSWIndex::selectNeighbors(const vector<pair<float, int>>& candidates, size_t max_links) const {
+  vector<int> selected;
+  for (const auto& [dist, candidate] : candidates) {
+    if (selected.size() >= max_links) break;
+    bool keep = true;
+    for (int s : selected) {
+      if (distance(candidate, s) < dist) {
+        keep = false;
+        break;
+      }
+    }
+    if (keep) selected.push_back(candidate);
+  }
+  return selected;
+}
+
+void HNSWIndex::insert(int node) {
+  Query query = store.encode(span<const float>(data.row(node), data.cols));
+  int level = levels[node];
+
+  int start;
+  int top;
+  {
+    lock_guard<mutex> guard(entry_lock);
+    if (entry_point < 0) {
+      entry_point = node;
+      max_level = level;
+      return;
+    }
+    start = entry_point;
+    top = max_level;
+  }
+
+  int current = greedyDescend(query, start, top, level);
+  for (int l = min(level, top); l >= 0; l--) {
+    vector<pair<float, int>> candidates = searchLayer(query, current, options.ef_construction, l);
+    size_t max_links = l == 0 ? 2 * options.M : options.M;
+    vector<int> neighbors = selectNeighbors(candidates, options.M);
+    {
+      lock_guard<mutex> guard(node_locks[node]);
+      links[node][l] = neighbors;
+    }
+
+    for (int neighbor : neighbors) {
+      lock_guard<mutex> guard(node_locks[neighbor]);
+      vector<int>& back_links = links[neighbor][l];
+      back_links.push_back(node);
+      if (back_links.size() > max_links) {
+        vector<pair<float, int>> pruned;
+        for (int b : back_links) pruned.push_back({distance(neighbor, b), b});
+        sort(pruned.begin(), pruned.end());
+        back_links = selectNeighbors(pruned, max_links);
+      }
+    }
+    current = candidates.front().second;
+  }
+
+  if (level > top) {
+    lock_guard<mutex> guard(entry_lock);
+    if (level > max_level) {
+      entry_point = node;
+      max_level = level;
+    }
+  }
+}
+
+void HNSWIndex::build() {
+  if (data.rows == 0) {
+    return;
+  }
+  insert(0);
+  parallelFor(data.rows - 1, [&](size_t i) {
+    insert(static_cast<int>(i + 1));
+  }, options.num_threads);
+}
+
+vector<pair<int, float>> HNSWIndex::search(span<const float> query, size_t k, size_t ef) const {
+  int start;
+  int top;
+  {
+    lock_guard<mutex> guard(entry_lock);
+    start = entry_point;
+    top = max_level;
+  }
+  if (start < 0 || k == 0) {
+    return {};
+  }
+
+  Query encoded = store.encode(query);
+  int current = greedyDescend(encoded, start, top, 0);
+  vector<pair<float, int>> found = searchLayer(encoded, current, max(k, ef ? ef : options.ef_search), 0);
+  if (options.rerank && options.quantization != Quantization::Float32) {
+    for (auto& [dist, node] : found) {
+      dist = 1.0f - dot_product(query, span<const float>(data.row(node), data.cols));
+    }
+    sort(found.begin(), found.end());
+  }
+
+  vector<pair<int, float>> result;
+  for (size_t i = 0; i < found.size() && i < k; i++) {
+    result.push_back({found[i].second, chordDistance(found[i].first)});
+  }
+  return result;
+}
+
+vector<vector<pair<int, float>>> HNSWIndex::knnAll(size_t k, size_t ef) const {
+  vector<vector<pair<int, float>>> neighbors(data.rows);
+  parallelFor(data.rows, [&](size_t i) {
+    vector<pair<int, float>> found = search(span<const float>(data.row(i), data.cols), k + 1, ef);
+    for (const auto& [node, dist] : found) {
+      if (node == static_cast<int>(i)) continue;
+      if (neighbors[i].size() == k) break;
+      neighbors[i].push_back({node, dist});
+    }
+  }, options.num_threads);
+  return neighbors;
+}
@@ -0,0 +1,70 @@
+#ifndef HNSW_HPP
+#define HNSW_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+#include "embedding_matrix.hpp"
+#include "quantized_store.hpp"
+
+using namespace std;
+
+struct HNSWOptions {
+  size_t M = 16;                 // links per node on upper layers, 2*M on layer 0
+  size_t ef_construction = 128;  // candidate list size while inserting
+  size_t ef_search = 64;         // candidate list size while querying; higher = better recall
+  size_t num_threads = 0;        // 0 = one per core
+  uint64_t seed = 42;
+  // Distances on quantized codes; rerank re-sorts query results on the
+  // full-precision rows
+  Quantization quantization = Quantization::Float32;
+  bool rerank = true;
+};
+
+// Hierarchical navigable small world graph over the rows of a unit-normalized
+// EmbeddingMatrix (Malkov & Yashunin). Distances are chord distances
+// sqrt(2 - 2 cos), the same metric the clustering code uses. The matrix is
+// borrowed and must outlive the index.
+class HNSWIndex {
+private:
+  const EmbeddingMatrix& data;
+  HNSWOptions options;
+  QuantizedStore store;
+  vector<int> levels;
+  // links[i][l] = neighbors of node i on layer l
+  vector<vector<vector<int>>> links;
+  unique_ptr<mutex[]> node_locks;
+  mutable mutex entry_lock;
+  int entry_point = -1;
+  int max_level = -1;
+
+  using Query = QuantizedStore::Query;
+
+  float distance(const Query& query, int node) const;
+  float distance(int a, int b) const;
+  int greedyDescend(const Query& query, int start, int from_level, int to_level) const;
+  vector<pair<float, int>> searchLayer(const Query& query, int start, size_t ef, int level) const;
+  vector<int> selectNeighbors(const vector<pair<float, int>>& candidates, size_t max_links) const;
+  void insert(int node);
+
+public:
+  HNSWIndex(const EmbeddingMatrix& data, HNSWOptions options = {});
+
+  // Inserts every row, in parallel
+  void build();
+
+  // Up to k nearest rows as (row, chord distance), closest first.
+  // ef = 0 uses options.ef_search.
+  vector<pair<int, float>> search(span<const float> query, size_t k, size_t ef = 0) const;
+
+  // k nearest other rows of every row, computed in parallel
+  vector<vector<pair<int, float>>> knnAll(size_t k, size_t ef = 0) const;
+
+  size_t size() const { return data.rows; }
+  const EmbeddingMatrix& matrix() const { return data; }
+};
+
+#endif // HNSW_HPP
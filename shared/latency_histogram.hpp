@@ -0,0 +1,93 @@
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+using namespace std;
+
+// Microsecond latencies in log-linear buckets, the HdrHistogram layout:
+// values below 64us are counted exactly, and every power of two above that
+// is split into 32 linear steps. Percentiles are therefore within ~3% of
+// the true value, recording is O(1), and memory is fixed (~9 KB) no matter
+// how many values are recorded. Values beyond ~25 days are clamped.
+class LatencyHistogram {
+private:
+  static constexpr int SUB_BUCKET_BITS = 5;
+  static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static constexpr uint64_t EXACT = 2 * SUB_BUCKETS;
+  static constexpr int MAX_EXPONENT = 40;
+  static constexpr size_t NUM_BUCKETS = EXACT + (MAX_EXPONENT - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+  array<uint64_t, NUM_BUCKETS> counts{};
+  uint64_t total = 0;
+  uint64_t smallest = numeric_limits<uint64_t>::max();
+  uint64_t largest = 0;
+  double sum = 0.0;
+
+  static size_t bucketOf(uint64_t value) {
+    if (value < EXACT) return value;
+    int exponent = min(static_cast<int>(bit_width(value)) - 1, MAX_EXPONENT);
+    int shift = exponent - SUB_BUCKET_BITS;
+    uint64_t sub = min((value >> shift) - SUB_BUCKETS, SUB_BUCKETS - 1);
+    return EXACT + (exponent - SUB_BUCKET_BITS - 1) * SUB_BUCKETS + sub;
+  }
+
+  // Largest value that lands in the bucket
+  static uint64_t bucketMax(size_t bucket) {
+    if (bucket < EXACT) return bucket;
+    size_t offset = bucket - EXACT;
+    int shift = static_cast<int>(offset / SUB_BUCKETS) + 1;
+    uint64_t sub = offset % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+  }
+
+public:
+  void record(uint64_t micros) {
+    counts[bucketOf(micros)]++;
+    total++;
+    smallest = min(smallest, micros);
+    largest = max(largest, micros);
+    sum += static_cast<double>(micros);
+  }
+
+  void record(chrono::steady_clock::duration elapsed) {
+    auto micros = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+    record(static_cast<uint64_t>(max<int64_t>(0, micros)));
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (size_t b = 0; b < NUM_BUCKETS; b++) counts[b] += other.counts[b];
+    total += other.total;
+    smallest = min(smallest, other.smallest);
+    largest = max(largest, other.largest);
+    sum += other.sum;
+  }
+
+  uint64_t count() const { return total; }
+  uint64_t min_value() const { return total ? smallest : 0; }
+  uint64_t max_value() const { return largest; }
+  double mean() const { return total ? sum / total : 0.0; }
+
+  // Smallest recorded bucket bound that at least p percent of values fall
+  // under, capped at the largest value seen. p in [0, 100].
+  uint64_t percentile(double p) const {
+    if (total == 0) return 0;
+    uint64_t target = max<uint64_t>(1, static_cast<uint64_t>(ceil(p / 100.0 * total)));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < NUM_BUCKETS; b++) {
+      seen += counts[b];
+      if (seen < target) continue;
+      // The last bucket also holds every clamped value
+      return b == NUM_BUCKETS - 1 ? largest : clamp(bucketMax(b), smallest, largest);
+    }
+    return largest;
+  }
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
@@ -0,0 +1,34 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Runs body(i) for every i in [0, count) on up to num_threads threads
+// (0 = one per core). Items are handed out one at a time, so uneven work
+// balances itself; the calling thread takes part.
+template <typename F>
+void parallelFor(size_t count, F&& body, size_t num_threads = 0) {
+  size_t threads = num_threads ? num_threads : max(1u, thread::hardware_concurrency());
+  threads = min(threads, count);
+  atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      body(i);
+    }
+  };
+  vector<thread> pool;
+  for (size_t t = 1; t < threads; t++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (thread& t : pool) {
+    t.join();
+  }
+}
+
+#endif // PARALLEL_HPP
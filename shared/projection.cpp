@@ -0,0 +1,148 @@
+#include "projection.hpp"
+#include "distance.hpp"
+#include "hashing.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+RandomProjection::RandomProjection(size_t in_dim, size_t out_dim, uint64_t seed)
+    : in_dim(in_dim), out_dim(out_dim), matrix(in_dim * out_dim) {
+  // Output is renormalized, so the usual 1/sqrt(out_dim) scale is omitted
+  uint64_t state = splitmix64(seed);
+  for (size_t k = 0; k < matrix.size(); k += 64) {
+    state = splitmix64(state);
+    for (size_t bit = 0; bit < 64 && k + bit < matrix.size(); bit++) {
+      matrix[k + bit] = (state >> bit) & 1 ? 1.0f : -1.0f;
+    }
+  }
+}
+
+vector<float> RandomProjection::project(span<const float> input) const {
+  vector<float> output(out_dim);
+  span<const float> v = input.first(min(input.size(), in_dim));
+  dot_product_many(v, matrix.data(), out_dim, in_dim, output.data());
+  float norm = dot_product(output, output);
+  if (norm > 0.0f) {
+    float inv = 1.0f / sqrt(norm);
+    for (float& x : output) x *= inv;
+  }
+  return output;
+}
+
+EmbeddingMatrix RandomProjection::project(const EmbeddingMatrix& input) const {
+  EmbeddingMatrix output(input.rows, out_dim);
+  parallelFor(input.rows, [&](size_t i) {
+    vector<float> row = project(span<const float>(input.row(i), input.cols));
+    copy(row.begin(), row.end(), output.row(i));
+  });
+  return output;
+}
+
+void reduceDimensions(vector<vector<float>>& vectors, size_t dims, uint64_t seed) {
+  if (dims == 0) {
+    return;
+  }
+  size_t width = 0;
+  for (const vector<float>& v : vectors) {
+    width = max(width, v.size());
+  }
+  if (width <= dims) {
+    return;
+  }
+
+  RandomProjection projection(width, dims, seed);
+  parallelFor(vectors.size(), [&](size_t i) {
+    if (vectors[i].size() > dims) {
+      vectors[i] = projection.project(vectors[i]);
+    }
+  });
+}
+
+EmbeddingMatrix principalComponents(const EmbeddingMatrix& data, size_t components, size_t iterations,
+                                    uint64_t seed) {
+  size_t n = data.rows;
+  size_t d = data.cols;
+  size_t c = min(components, d);
+  EmbeddingMatrix scores(n, components);
+  if (n == 0 || c == 0) {
+    return scores;
+  }
+
+  vector<float> mean(d, 0.0f);
+  for (size_t i = 0; i < n; i++) {
+    const float* row = data.row(i);
+    for (size_t j = 0; j < d; j++) mean[j] += row[j];
+  }
+  for (float& m : mean) m /= n;
+
+  // basis holds c vectors of length d, one per row
+  vector<float> basis(c * d);
+  uint64_t state = splitmix64(seed);
+  for (size_t k = 0; k < basis.size(); k += 64) {
+    state = splitmix64(state);
+    for (size_t bit = 0; bit < 64 && k + bit < basis.size(); bit++) {
+      basis[k + bit] = (state >> bit) & 1 ? 1.0f : -1.0f;
+    }
+  }
+
+  // Projections of the centered rows onto the current basis
+  auto project_rows = [&](EmbeddingMatrix& out) {
+    vector<float> offset(c);
+    dot_product_many(mean, basis.data(), c, d, offset.data());
+    parallelFor(n, [&](size_t i) {
+      float* o = out.row(i);
+      dot_product_many(span<const float>(data.row(i), d), basis.data(), c, d, o);
+      for (size_t k = 0; k < c; k++) o[k] -= offset[k];
+    });
+  };
+
+  for (size_t it = 0; it < iterations; it++) {
+    project_rows(scores);
+    // basis = orthonormalized X_c^T (X_c basis)
+    fill(basis.begin(), basis.end(), 0.0f);
+    for (size_t i = 0; i < n; i++) {
+      const float* row = data.row(i);
+      for (size_t k = 0; k < c; k++) {
+        float s = scores.row(i)[k];
+        float* b = basis.data() + k * d;
+        for (size_t j = 0; j < d; j++) b[j] += s * (row[j] - mean[j]);
+      }
+    }
+    for (size_t k = 0; k < c; k++) {
+      span<float> b(basis.data() + k * d, d);
+      for (size_t prev = 0; prev < k; prev++) {
+        span<const float> p(basis.data() + prev * d, d);
+        float overlap = dot_product(b, p);
+        for (size_t j = 0; j < d; j++) b[j] -= overlap * p[j];
+      }
+      float norm = sqrt(dot_product(b, b));
+      // Rank-deficient data: any unit vector is as good as another
+      for (size_t j = 0; j < d; j++) b[j] = norm > 0.0f ? b[j] / norm : (j == k ? 1.0f : 0.0f);
+    }
+  }
+  project_rows(scores);
+
+  // Subspace iteration converges to the span of the top axes; order the
+  // columns by the variance they explain
+  vector<double> variance(c, 0.0);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t k = 0; k < c; k++) variance[k] += static_cast<double>(scores.row(i)[k]) * scores.row(i)[k];
+  }
+  vector<size_t> order(c);
+  for (size_t k = 0; k < c; k++) order[k] = k;
+  stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return variance[a] > variance[b]; });
+
+  EmbeddingMatrix sorted(n, components);
+  for (size_t k = 0; k < c; k++) {
+    float low = 0.0f, high = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+      low = min(low, scores.row(i)[order[k]]);
+      high = max(high, scores.row(i)[order[k]]);
+    }
+    float sign = -low > high ? -1.0f : 1.0f;
+    for (size_t i = 0; i < n; i++) sorted.row(i)[k] = sign * scores.row(i)[order[k]];
+  }
+  return sorted;
+}
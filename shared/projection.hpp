@@ -0,0 +1,44 @@
+#ifndef PROJECTION_HPP
+#define PROJECTION_HPP
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "embedding_matrix.hpp"
+
+using namespace std;
+
+// Seeded Johnson-Lindenstrauss projection with a dense +-1 matrix. Pairwise
+// cosines are preserved to within roughly 1/sqrt(out_dim), so clustering
+// can run on short vectors when the embedding source can't shorten them
+// itself. The matrix is generated from splitmix64, so the same seed gives
+// the same projection on every platform.
+class RandomProjection {
+private:
+  size_t in_dim;
+  size_t out_dim;
+  vector<float> matrix;  // out_dim x in_dim, row-major
+
+public:
+  RandomProjection(size_t in_dim, size_t out_dim, uint64_t seed = 0x5eed);
+
+  // Projected and L2-normalized
+  vector<float> project(span<const float> vector) const;
+  EmbeddingMatrix project(const EmbeddingMatrix& input) const;
+
+  size_t input_dimensions() const { return in_dim; }
+  size_t output_dimensions() const { return out_dim; }
+};
+
+// Projects every vector longer than dims down to dims in place; shorter and
+// empty vectors are left alone. dims = 0 disables the reduction.
+void reduceDimensions(vector<vector<float>>& vectors, size_t dims, uint64_t seed = 0x5eed);
+
+// Scores of the rows on their top `components` principal axes (rows x
+// components), by randomized subspace iteration: a +-1 random start, then
+// `iterations` multiplications by the centered covariance. Columns come out
+// ordered by variance, signs fixed so the largest score is positive.
+EmbeddingMatrix principalComponents(const EmbeddingMatrix& data, size_t components, size_t iterations = 4,
+                                    uint64_t seed = 0x5eed);
+
+#endif // PROJECTION_HPP
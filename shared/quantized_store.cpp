@@ -0,0 +1,118 @@
+#include "quantized_store.hpp"
+#include "distance.hpp"
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+Quantization parseQuantization(const string& name) {
+  if (name == "f32" || name == "none") return Quantization::Float32;
+  if (name == "fp16" || name == "f16") return Quantization::Float16;
+  if (name == "int8") return Quantization::Int8;
+  throw invalid_argument("unknown quantization '" + name + "' (expected int8, fp16 or f32)");
+}
+
+string quantizationName(Quantization kind) {
+  switch (kind) {
+    case Quantization::Float16: return "fp16";
+    case Quantization::Int8: return "int8";
+    default: return "f32";
+  }
+}
+
+namespace {
+
+float encodeInt8(span<const float> values, int8_t* codes) {
+  float max_abs = 0.0f;
+  for (float v : values) max_abs = max(max_abs, fabs(v));
+  float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+  float inv = 1.0f / scale;
+  for (size_t k = 0; k < values.size(); k++) {
+    codes[k] = static_cast<int8_t>(lrintf(clamp(values[k] * inv, -127.0f, 127.0f)));
+  }
+  return scale;
+}
+
+} // namespace
+
+QuantizedStore::QuantizedStore(const EmbeddingMatrix& source, Quantization kind)
+    : source_matrix(source), quantization(kind) {
+  size_t n = source.rows;
+  size_t d = source.cols;
+  if (kind == Quantization::Int8) {
+    int8_codes.resize(n * d);
+    scales.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      scales[i] = encodeInt8(span<const float>(source.row(i), d), int8_codes.data() + i * d);
+    }
+  } else if (kind == Quantization::Float16) {
+    half_codes.resize(n * d);
+    for (size_t k = 0; k < n * d; k++) {
+      half_codes[k] = float_to_half(source.data[k]);
+    }
+  }
+}
+
+span<const int8_t> QuantizedStore::int8Row(size_t i) const {
+  return span<const int8_t>(int8_codes.data() + i * cols(), cols());
+}
+
+span<const uint16_t> QuantizedStore::halfRow(size_t i) const {
+  return span<const uint16_t>(half_codes.data() + i * cols(), cols());
+}
+
+size_t QuantizedStore::bytes() const {
+  return int8_codes.size() * sizeof(int8_t) + half_codes.size() * sizeof(uint16_t) +
+         scales.size() * sizeof(float);
+}
+
+QuantizedStore::Query QuantizedStore::encode(span<const float> vector) const {
+  Query query;
+  query.full = vector;
+  if (quantization == Quantization::Int8) {
+    query.int8_codes.resize(vector.size());
+    query.scale = encodeInt8(vector, query.int8_codes.data());
+  } else if (quantization == Quantization::Float16) {
+    query.half_codes.resize(vector.size());
+    for (size_t k = 0; k < vector.size(); k++) {
+      query.half_codes[k] = float_to_half(vector[k]);
+    }
+  }
+  return query;
+}
+
+float QuantizedStore::similarity(size_t i, size_t j) const {
+  switch (quantization) {
+    case Quantization::Int8:
+      return scales[i] * scales[j] * static_cast<float>(dot_product_i8(int8Row(i), int8Row(j)));
+    case Quantization::Float16:
+      return dot_product_f16(halfRow(i), halfRow(j));
+    default:
+      return exactSimilarity(i, j);
+  }
+}
+
+float QuantizedStore::similarity(const Query& query, size_t j) const {
+  switch (quantization) {
+    case Quantization::Int8:
+      return query.scale * scales[j] * static_cast<float>(dot_product_i8(query.int8_codes, int8Row(j)));
+    case Quantization::Float16:
+      return dot_product_f16(query.half_codes, halfRow(j));
+    default:
+      return dot_product(query.full, span<const float>(source_matrix.row(j), cols()));
+  }
+}
+
+void QuantizedStore::similarityMany(size_t i, size_t begin, size_t count, float* out) const {
+  if (quantization == Quantization::Float32) {
+    dot_product_many(span<const float>(source_matrix.row(i), cols()), source_matrix.row(begin), count, cols(), out);
+    return;
+  }
+  for (size_t t = 0; t < count; t++) {
+    out[t] = similarity(i, begin + t);
+  }
+}
+
+float QuantizedStore::exactSimilarity(size_t i, size_t j) const {
+  return dot_product(span<const float>(source_matrix.row(i), cols()), span<const float>(source_matrix.row(j), cols()));
+}
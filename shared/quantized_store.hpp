@@ -0,0 +1,61 @@
+#ifndef QUANTIZED_STORE_HPP
+#define QUANTIZED_STORE_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include "embedding_matrix.hpp"
+
+using namespace std;
+
+enum class Quantization { Float32, Float16, Int8 };
+
+// "f32"/"none", "fp16"/"f16" or "int8"; throws invalid_argument otherwise
+Quantization parseQuantization(const string& name);
+string quantizationName(Quantization kind);
+
+// Compact copy of a unit-normalized EmbeddingMatrix for distance-heavy
+// work. Int8 keeps one symmetric scale per row (max |x| / 127) and codes in
+// a single arena; Float16 keeps IEEE half-precision values. Similarities
+// are approximate; the source matrix is borrowed for full-precision
+// reranking and must outlive the store.
+class QuantizedStore {
+public:
+  struct Query {
+    vector<int8_t> int8_codes;
+    vector<uint16_t> half_codes;
+    span<const float> full;
+    float scale = 1.0f;
+  };
+
+private:
+  const EmbeddingMatrix& source_matrix;
+  Quantization quantization;
+  vector<int8_t> int8_codes;
+  vector<uint16_t> half_codes;
+  vector<float> scales;
+
+  span<const int8_t> int8Row(size_t i) const;
+  span<const uint16_t> halfRow(size_t i) const;
+
+public:
+  QuantizedStore(const EmbeddingMatrix& source, Quantization kind);
+
+  Quantization kind() const { return quantization; }
+  size_t rows() const { return source_matrix.rows; }
+  size_t cols() const { return source_matrix.cols; }
+  const EmbeddingMatrix& source() const { return source_matrix; }
+  // Bytes used by the codes and scales, excluding the source matrix
+  size_t bytes() const;
+
+  Query encode(span<const float> vector) const;
+  float similarity(size_t i, size_t j) const;
+  float similarity(const Query& query, size_t j) const;
+  // similarity(i, begin + t) for t in [0, count)
+  void similarityMany(size_t i, size_t begin, size_t count, float* out) const;
+  // Full-precision similarity from the source matrix
+  float exactSimilarity(size_t i, size_t j) const;
+};
+
+#endif // QUANTIZED_STORE_HPP
@@ -0,0 +1,11 @@
+; Preferred chunk boundaries for C#.
+(compilation_unit (_) @split)
+(namespace_declaration) @split
+(class_declaration) @split
+(interface_declaration) @split
+(struct_declaration) @split
+(enum_declaration) @split
+(record_declaration) @split
+(method_declaration) @split
+(constructor_declaration) @split
+(property_declaration) @split
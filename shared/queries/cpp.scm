@@ -0,0 +1,9 @@
+; Preferred chunk boundaries for C and C++.
+(translation_unit (_) @split)
+(function_definition) @split
+(template_declaration) @split
+(namespace_definition) @split
+(class_specifier body: (_)) @split
+(struct_specifier body: (_)) @split
+(enum_specifier body: (_)) @split
+(field_declaration_list (access_specifier) @split)
@@ -0,0 +1,5 @@
+; Preferred chunk boundaries for Go.
+(source_file (_) @split)
+(function_declaration) @split
+(method_declaration) @split
+(type_declaration) @split
@@ -0,0 +1,8 @@
+; Preferred chunk boundaries for Java.
+(program (_) @split)
+(class_declaration) @split
+(interface_declaration) @split
+(enum_declaration) @split
+(record_declaration) @split
+(method_declaration) @split
+(constructor_declaration) @split
@@ -0,0 +1,7 @@
+; Preferred chunk boundaries for JavaScript.
+(program (_) @split)
+(function_declaration) @split
+(generator_function_declaration) @split
+(class_declaration) @split
+(method_definition) @split
+(export_statement) @split
@@ -0,0 +1,5 @@
+; Preferred chunk boundaries for Kotlin.
+(source_file (_) @split)
+(class_declaration) @split
+(object_declaration) @split
+(function_declaration) @split
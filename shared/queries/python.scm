@@ -0,0 +1,8 @@
+; Preferred chunk boundaries for Python. Every @split capture, nested ones
+; (methods inside classes) included, starts a new semantic unit. Adjacent
+; units are packed up to the token budget, so a class that fits usually
+; stays in one chunk, but a cut can land between its methods.
+(module (_) @split)
+(decorated_definition) @split
+(function_definition) @split
+(class_definition) @split
@@ -0,0 +1,6 @@
+; Preferred chunk boundaries for Ruby.
+(program (_) @split)
+(module) @split
+(class) @split
+(method) @split
+(singleton_method) @split
@@ -0,0 +1,9 @@
+; Preferred chunk boundaries for Rust.
+(source_file (_) @split)
+(function_item) @split
+(impl_item) @split
+(trait_item) @split
+(struct_item) @split
+(enum_item) @split
+(mod_item) @split
+(macro_definition) @split
@@ -0,0 +1,11 @@
+; Preferred chunk boundaries for TypeScript (also used for TSX).
+(program (_) @split)
+(function_declaration) @split
+(generator_function_declaration) @split
+(class_declaration) @split
+(abstract_class_declaration) @split
+(interface_declaration) @split
+(type_alias_declaration) @split
+(enum_declaration) @split
+(method_definition) @split
+(export_statement) @split
@@ -0,0 +1,83 @@
+#include "stage_executor.hpp"
+#include "trace.hpp"
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+StageExecutor::Stage StageExecutor::add(string name, function<void()> body, vector<Stage> dependencies) {
+  for (Stage dependency : dependencies) {
+    if (dependency >= nodes.size()) {
+      throw invalid_argument("stage " + name + " depends on a stage that hasn't been added");
+    }
+  }
+  nodes.push_back({std::move(body), std::move(dependencies)});
+  timing.push_back({std::move(name), {}, {}, false});
+  return nodes.size() - 1;
+}
+
+void StageExecutor::run() {
+  size_t n = nodes.size();
+  vector<size_t> waiting_on(n, 0);
+  vector<vector<Stage>> dependents(n);
+  for (Stage s = 0; s < n; s++) {
+    waiting_on[s] = nodes[s].dependencies.size();
+    for (Stage dependency : nodes[s].dependencies) dependents[dependency].push_back(s);
+  }
+
+  mutex lock;
+  condition_variable changed;
+  vector<Stage> ready;
+  vector<thread> threads;
+  size_t launched = 0;
+  size_t finished = 0;
+  exception_ptr error;
+
+  for (Stage s = 0; s < n; s++) {
+    if (waiting_on[s] == 0) ready.push_back(s);
+  }
+
+  started = chrono::steady_clock::now();
+  unique_lock<mutex> guard(lock);
+  while (true) {
+    if (error) ready.clear();
+    while (!ready.empty()) {
+      Stage s = ready.back();
+      ready.pop_back();
+      launched++;
+      threads.emplace_back([&, s]() {
+        auto start = chrono::steady_clock::now();
+        exception_ptr failure;
+        try {
+          nodes[s].body();
+        } catch (...) {
+          failure = current_exception();
+        }
+        auto end = chrono::steady_clock::now();
+        traceComplete(timing[s].name, "stage", start, end);
+
+        lock_guard<mutex> done(lock);
+        timing[s].start = start;
+        timing[s].end = end;
+        timing[s].ran = true;
+        if (failure && !error) error = failure;
+        if (!error) {
+          for (Stage dependent : dependents[s]) {
+            if (--waiting_on[dependent] == 0) ready.push_back(dependent);
+          }
+        }
+        finished++;
+        changed.notify_all();
+      });
+    }
+    if (finished == launched) break;
+    changed.wait(guard);
+  }
+  guard.unlock();
+
+  for (thread& t : threads) t.join();
+  if (error) rethrow_exception(error);
+}
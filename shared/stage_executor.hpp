@@ -0,0 +1,51 @@
+#ifndef STAGE_EXECUTOR_HPP
+#define STAGE_EXECUTOR_HPP
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// When one stage ran, for profiling
+struct StageTiming {
+  string name;
+  chrono::steady_clock::time_point start;
+  chrono::steady_clock::time_point end;
+  bool ran = false;  // false if skipped because an earlier stage failed
+};
+
+// Runs a DAG of named stages. Each stage starts on its own thread as soon as
+// all of its dependencies have finished, so network-bound and CPU-bound
+// stages overlap wherever the graph allows. Stages hand results to each
+// other through variables captured by reference; the dependency edge is
+// what makes reading another stage's output safe. Dependencies must be
+// added first, which keeps the graph acyclic.
+//
+// If a stage throws, stages that have not started yet are skipped and run()
+// rethrows the first exception once the running ones have finished.
+class StageExecutor {
+public:
+  using Stage = size_t;
+
+private:
+  struct Node {
+    function<void()> body;
+    vector<Stage> dependencies;
+  };
+  vector<Node> nodes;
+  vector<StageTiming> timing;
+  chrono::steady_clock::time_point started;
+
+public:
+  // Throws invalid_argument for a dependency that hasn't been added yet
+  Stage add(string name, function<void()> body, vector<Stage> dependencies = {});
+  void run();
+
+  // One entry per stage, in the order they were added
+  const vector<StageTiming>& timings() const { return timing; }
+  chrono::steady_clock::time_point start_time() const { return started; }
+};
+
+#endif // STAGE_EXECUTOR_HPP
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "api_archive.hpp"
+
+namespace {
+
+std::string tempArchivePath(const std::string& name) {
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "api_archive_test";
+    std::filesystem::create_directories(dir);
+    std::filesystem::remove(dir / name);
+    return (dir / name).string();
+}
+
+}
+
+TEST(ApiArchiveTest, ReplaysRecordedResponses) {
+    std::string path = tempArchivePath("roundtrip.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/embeddings", R"({"input":["a"]})", {"http/1.1 200 ok\r\n\r\n", "first"});
+        archive.record("/chat/completions", R"({"messages":[]})", {"http/1.1 200 ok\r\n\r\n", std::string("bin\0ary", 7)});
+        EXPECT_EQ(archive.size(), 2u);
+    }
+
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    EXPECT_EQ(replay.size(), 2u);
+    std::optional<RecordedResponse> embedding = replay.lookup("/embeddings", R"({"input":["a"]})");
+    ASSERT_TRUE(embedding);
+    EXPECT_EQ(embedding->headers, "http/1.1 200 ok\r\n\r\n");
+    EXPECT_EQ(embedding->body, "first");
+    std::optional<RecordedResponse> chat = replay.lookup("/chat/completions", R"({"messages":[]})");
+    ASSERT_TRUE(chat);
+    EXPECT_EQ(chat->body, std::string("bin\0ary", 7));
+    EXPECT_EQ(replay.hits(), 2u);
+}
+
+TEST(ApiArchiveTest, KeyCoversPathAndBody) {
+    std::string path = tempArchivePath("keys.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/embeddings", "body", {"", "embeddings"});
+    }
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    EXPECT_FALSE(replay.lookup("/chat/completions", "body"));
+    EXPECT_FALSE(replay.lookup("/embeddings", "body "));
+    EXPECT_TRUE(replay.lookup("/embeddings", "body"));
+    EXPECT_EQ(replay.misses(), 2u);
+    EXPECT_NE(ApiArchive::requestKey("/a", "b"), ApiArchive::requestKey("/ab", ""));
+}
+
+TEST(ApiArchiveTest, RepeatedRequestsReplayInOrder) {
+    std::string path = tempArchivePath("repeats.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/chat/completions", "same", {"", "one"});
+        archive.record("/chat/completions", "same", {"", "two"});
+    }
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    EXPECT_EQ(replay.lookup("/chat/completions", "same")->body, "one");
+    EXPECT_EQ(replay.lookup("/chat/completions", "same")->body, "two");
+    // The last answer repeats once the recorded ones run out
+    EXPECT_EQ(replay.lookup("/chat/completions", "same")->body, "two");
+}
+
+TEST(ApiArchiveTest, DropsRecordCutOffAtTheEnd) {
+    std::string path = tempArchivePath("truncated.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/embeddings", "kept", {"", "complete"});
+        archive.record("/embeddings", "lost", {"", std::string(100, 'x')});
+    }
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 10);
+
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    EXPECT_EQ(replay.size(), 1u);
+    EXPECT_TRUE(replay.lookup("/embeddings", "kept"));
+    EXPECT_FALSE(replay.lookup("/embeddings", "lost"));
+}
+
+TEST(ApiArchiveTest, RejectsMissingOrForeignFiles) {
+    std::string missing = tempArchivePath("missing.bin");
+    EXPECT_THROW(ApiArchive(missing, ApiArchive::REPLAY), std::runtime_error);
+
+    std::string foreign = tempArchivePath("foreign.bin");
+    std::ofstream(foreign) << "not an archive";
+    EXPECT_THROW(ApiArchive(foreign, ApiArchive::REPLAY), std::runtime_error);
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "ast.hpp"
+
+namespace {
+
+DiffChunk makeChunk(const std::vector<std::string>& contents, DiffMode mode = INSERTION) {
+    DiffChunk chunk;
+    chunk.filepath = "example.py";
+    chunk.old_filepath = chunk.filepath;
+    int line_num = 1;
+    for (const std::string& content : contents) {
+        chunk.lines.push_back({mode, content, line_num++});
+    }
+    return chunk;
+}
+
+std::string joinLines(const DiffChunk& chunk) {
+    std::string content;
+    for (const DiffLine& line : chunk.lines) {
+        content += line.content + "\n";
+    }
+    return content;
+}
+
+std::vector<std::string> firstLines(const std::vector<DiffChunk>& chunks) {
+    std::vector<std::string> firsts;
+    for (const DiffChunk& chunk : chunks) {
+        firsts.push_back(chunk.lines.front().content);
+    }
+    return firsts;
+}
+
+size_t totalLines(const std::vector<DiffChunk>& chunks) {
+    size_t total = 0;
+    for (const DiffChunk& chunk : chunks) {
+        total += chunk.lines.size();
+    }
+    return total;
+}
+
+}
+
+TEST(AstTest, SplitAtLinesKeepsHunkStartsAndFileFlags) {
+    DiffChunk chunk = makeChunk({"a", "b", "c", "d"});
+    chunk.lines[0].mode = EQ;
+    chunk.lines[1].mode = DELETION;
+    chunk.start = 10;
+    chunk.is_new = true;
+    chunk.is_deleted = true;
+
+    std::vector<DiffChunk> pieces = splitAtLines(chunk, {2, 3});
+    ASSERT_EQ(pieces.size(), 3u);
+    EXPECT_EQ(pieces[0].lines.size(), 2u);
+    EXPECT_EQ(pieces[1].lines.front().content, "c");
+    // Old-file lines (context and deletions) advance the start; insertions don't
+    EXPECT_EQ(pieces[0].start, 10);
+    EXPECT_EQ(pieces[1].start, 12);
+    EXPECT_EQ(pieces[2].start, 12);
+    EXPECT_TRUE(pieces[0].is_new);
+    EXPECT_FALSE(pieces[1].is_new);
+    EXPECT_FALSE(pieces[1].is_deleted);
+    EXPECT_TRUE(pieces[2].is_deleted);
+}
+
+TEST(AstTest, ChunkAtBoundariesPacksAdjacentUnits) {
+    DiffChunk chunk = makeChunk({"alpha", "beta", "gamma", "delta", "epsilon", "zeta"});
+    size_t unitTokens = countTokens("alpha") + countTokens("beta") + 2;
+
+    // Everything fits: the units are packed into one chunk
+    std::vector<DiffChunk> whole = chunkAtBoundaries(chunk, {2, 4}, 1000);
+    ASSERT_EQ(whole.size(), 1u);
+    EXPECT_EQ(whole[0].lines.size(), 6u);
+
+    // Room for about two units: cuts only fall on unit boundaries
+    std::vector<DiffChunk> packed = chunkAtBoundaries(chunk, {2, 4}, 2 * unitTokens + 1);
+    ASSERT_EQ(packed.size(), 2u);
+    EXPECT_EQ(firstLines(packed), std::vector<std::string>({"alpha", "epsilon"}));
+    EXPECT_EQ(totalLines(packed), 6u);
+}
+
+TEST(AstTest, ChunkAtBoundariesSplitsAnOversizedUnitByLines) {
+    std::vector<std::string> contents = {"header"};
+    for (int i = 0; i < 10; i++) {
+        contents.push_back("body line number " + std::to_string(i));
+    }
+    contents.push_back("footer");
+    DiffChunk chunk = makeChunk(contents);
+    size_t maxTokens = 3 * (countTokens("body line number 0") + 1);
+
+    // Units: [header], [10 body lines], [footer]
+    std::vector<DiffChunk> pieces = chunkAtBoundaries(chunk, {1, 11}, maxTokens);
+    ASSERT_GE(pieces.size(), 4u);
+    EXPECT_EQ(pieces.front().lines.front().content, "header");
+    EXPECT_EQ(pieces.back().lines.front().content, "footer");
+    EXPECT_EQ(pieces.back().lines.size(), 1u);
+    EXPECT_EQ(totalLines(pieces), contents.size());
+    for (size_t i = 1; i + 1 < pieces.size(); i++) {
+        size_t tokens = 0;
+        for (const DiffLine& line : pieces[i].lines) {
+            tokens += countTokens(line.content) + 1;
+        }
+        EXPECT_LE(tokens, maxTokens);
+    }
+}
+
+TEST(AstTest, ChunkAtBoundariesIgnoresOutOfRangeBoundaries) {
+    DiffChunk chunk = makeChunk({"a", "b", "c"});
+    std::vector<DiffChunk> pieces = chunkAtBoundaries(chunk, {0, 3, 7, 1, 1}, 1);
+    EXPECT_EQ(firstLines(pieces), std::vector<std::string>({"a", "b", "c"}));
+}
+
+TEST(AstTest, PythonQueryCutsAtDefinitions) {
+    DiffChunk chunk = makeChunk({
+        "import os",
+        "",
+        "def first(path):",
+        "    return os.path.basename(path)",
+        "",
+        "class Second:",
+        "    def method(self):",
+        "        return 2",
+    });
+    ts::Tree tree = codeToTree(joinLines(chunk), "python");
+
+    // Too small to pack any two units together
+    std::vector<DiffChunk> pieces = chunkDiff(tree.getRootNode(), chunk, "python", 12);
+    std::vector<std::string> firsts = firstLines(pieces);
+    EXPECT_NE(std::find(firsts.begin(), firsts.end(), "def first(path):"), firsts.end());
+    EXPECT_NE(std::find(firsts.begin(), firsts.end(), "class Second:"), firsts.end());
+    EXPECT_EQ(totalLines(pieces), chunk.lines.size());
+
+    // A budget that fits everything keeps the hunk whole
+    std::vector<DiffChunk> whole = chunkDiff(tree.getRootNode(), chunk, "python", 1000);
+    EXPECT_EQ(whole.size(), 1u);
+}
+
+TEST(AstTest, PythonQueryCutsBetweenMethodsOfAClassThatDoesNotFit) {
+    std::vector<std::string> contents = {"class Big:"};
+    for (int m = 0; m < 4; m++) {
+        contents.push_back("    def method_" + std::to_string(m) + "(self):");
+        for (int i = 0; i < 4; i++) {
+            contents.push_back("        value_" + std::to_string(i) + " = self.compute(" + std::to_string(i) + ")");
+        }
+    }
+    DiffChunk chunk = makeChunk(contents);
+    ts::Tree tree = codeToTree(joinLines(chunk), "python");
+
+    size_t methodTokens = 0;
+    for (size_t i = 1; i <= 5; i++) {
+        methodTokens += countTokens(contents[i]) + 1;
+    }
+    std::vector<DiffChunk> pieces = chunkDiff(tree.getRootNode(), chunk, "python", methodTokens + 4);
+    ASSERT_GT(pieces.size(), 1u);
+    for (size_t i = 1; i < pieces.size(); i++) {
+        EXPECT_EQ(pieces[i].lines.front().content.rfind("    def method_", 0), 0u) << pieces[i].lines.front().content;
+    }
+}
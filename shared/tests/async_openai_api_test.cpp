@@ -5,6 +5,7 @@
  * - Embedding endpoint functionality
  * - Chat completion endpoint functionality
  * - Concurrent request handling
+ * - Reduced-dimension, base64-encoded batch embeddings
  *
  * Note: These are LIVE integration tests that require:
  * - Internet connectivity
@@ -12,6 +13,7 @@
  */
 
 #include "async_openai_api.hpp"
+#include "utils.hpp"
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <thread>
@@ -64,6 +66,9 @@ string load_api_key() {
 class AsyncOpenAIAPITest : public ::testing::Test {
 protected:
     string api_key;
+    // OPENAI_BASE_URL and CUSTOM_GIT_OPENAI_CA point the suite at
+    // benchmarks/mock_openai_server instead of the real API
+    OpenAIEndpoint endpoint = OpenAIEndpoint::fromEnvironment();
 
     void SetUp() override {
         api_key = load_api_key();
@@ -82,7 +87,7 @@ protected:
 
 TEST_F(AsyncOpenAIAPITest, EmbeddingEndpointWorks) {
     AsyncHTTPSConnection conn;
-    AsyncOpenAIAPI api(conn, api_key);
+    AsyncOpenAIAPI api(conn, api_key, endpoint);
 
     // Queue an embedding request
     future<HTTPSResponse> fut = api.async_embedding(
@@ -120,7 +125,7 @@ TEST_F(AsyncOpenAIAPITest, EmbeddingEndpointWorks) {
 
 TEST_F(AsyncOpenAIAPITest, ChatEndpointWorks) {
     AsyncHTTPSConnection conn;
-    AsyncOpenAIAPI api(conn, api_key);
+    AsyncOpenAIAPI api(conn, api_key, endpoint);
 
     // Create chat messages
     json messages = {
@@ -177,7 +182,7 @@ TEST_F(AsyncOpenAIAPITest, ConcurrentRequestsWork) {
     const int num_requests = 3;
 
     AsyncHTTPSConnection conn;
-    AsyncOpenAIAPI api(conn, api_key);
+    AsyncOpenAIAPI api(conn, api_key, endpoint);
 
     // Queue multiple embedding requests concurrently
     vector<string> test_texts = {
@@ -237,6 +242,60 @@ TEST_F(AsyncOpenAIAPITest, ConcurrentRequestsWork) {
     event_loop.join();
 }
 
+// ============================================================================
+// TEST 4: Reduced-Dimension Batch Embeddings
+// ============================================================================
+
+TEST_F(AsyncOpenAIAPITest, BatchEmbeddingsHonorDimensions) {
+    AsyncHTTPSConnection conn;
+    AsyncOpenAIAPI api(conn, api_key, endpoint);
+
+    vector<string> texts = {"First test text for embedding", "Second test text for embedding"};
+    future<HTTPSResponse> fut = api.async_embeddings(texts, 256);
+
+    thread event_loop([&api]() {
+        api.run_requests();
+    });
+
+    auto status = fut.wait_for(chrono::seconds(30));
+    ASSERT_EQ(status, future_status::ready) << "Embedding request timed out";
+
+    // Embeddings come back base64-encoded and are decoded by parse_embeddings
+    vector<vector<float>> embeddings = parse_embeddings(fut.get().body, texts.size());
+    ASSERT_EQ(embeddings.size(), 2u);
+    EXPECT_EQ(embeddings[0].size(), 256u) << "Embedding should be shortened to 256 dimensions";
+    EXPECT_EQ(embeddings[1].size(), 256u) << "Embedding should be shortened to 256 dimensions";
+    EXPECT_NE(embeddings[0], embeddings[1]) << "Different texts should produce different embeddings";
+
+    event_loop.join();
+}
+
+TEST(OpenAIEndpointTest, ParsesBaseUrls) {
+    OpenAIEndpoint defaults;
+    EXPECT_EQ(defaults.host, "api.openai.com");
+    EXPECT_EQ(defaults.port, 443);
+    EXPECT_EQ(defaults.base_path, "/v1");
+
+    OpenAIEndpoint local = OpenAIEndpoint::fromBaseUrl("https://127.0.0.1:8443/v1/");
+    EXPECT_EQ(local.host, "127.0.0.1");
+    EXPECT_EQ(local.port, 8443);
+    EXPECT_EQ(local.base_path, "/v1");
+
+    OpenAIEndpoint proxy = OpenAIEndpoint::fromBaseUrl("https://proxy.internal");
+    EXPECT_EQ(proxy.host, "proxy.internal");
+    EXPECT_EQ(proxy.port, 443);
+    EXPECT_EQ(proxy.base_path, "/v1");
+
+    EXPECT_EQ(OpenAIEndpoint::fromBaseUrl("https://gateway/openai/v1").base_path, "/openai/v1");
+}
+
+TEST(OpenAIEndpointTest, RejectsMalformedUrls) {
+    EXPECT_THROW(OpenAIEndpoint::fromBaseUrl("http://localhost:8443/v1"), invalid_argument);
+    EXPECT_THROW(OpenAIEndpoint::fromBaseUrl("https://localhost:port/v1"), invalid_argument);
+    EXPECT_THROW(OpenAIEndpoint::fromBaseUrl("https://:8443"), invalid_argument);
+    EXPECT_THROW(OpenAIEndpoint::fromBaseUrl("https://localhost:70000"), invalid_argument);
+}
+
 // Main function
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
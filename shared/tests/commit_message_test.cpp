@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+#include "api_archive.hpp"
+#include "async_openai_api.hpp"
+#include "utils.hpp"
+
+// Requests are answered from a replay archive, so nothing reaches the network
+namespace {
+
+std::string tempArchivePath(const std::string& name) {
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "commit_message_test";
+    std::filesystem::create_directories(dir);
+    std::filesystem::remove(dir / name);
+    return (dir / name).string();
+}
+
+// Same body async_generate_commit_message sends through AsyncOpenAIAPI::async_chat
+std::string chatRequest(const std::string& code_changes) {
+    nlohmann::json body = {
+        {"model", "gpt-4o-mini"},
+        {"messages", commit_message_prompt(code_changes)},
+        {"max_tokens", 50},
+        {"temperature", 0.3f}
+    };
+    return body.dump();
+}
+
+RecordedResponse chatResponse(const std::string& content) {
+    nlohmann::json body = {{"choices", {{{"message", {{"role", "assistant"}, {"content", content}}}}}}};
+    return {"HTTP/1.1 200 OK\r\n\r\n", body.dump()};
+}
+
+}
+
+TEST(AsyncCommitMessageTest, FutureBecomesReadyWithoutBeingWaitedOn) {
+    std::string path = tempArchivePath("ready.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/chat/completions", chatRequest("+int x;"), chatResponse("\"add x\"\n"));
+    }
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    AsyncHTTPSConnection conn;
+    AsyncOpenAIAPI api(conn, "replay");
+    api.use_archive(&replay);
+
+    std::future<std::string> message = async_generate_commit_message(api, "+int x;");
+    // The gcommit messages stage polls with wait_for; a deferred future
+    // would answer future_status::deferred here forever
+    ASSERT_EQ(message.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(message.get(), "add x");
+    EXPECT_EQ(replay.hits(), 1u);
+}
+
+TEST(AsyncCommitMessageTest, MessagesCanBeCollectedOutOfOrder) {
+    std::string path = tempArchivePath("order.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/chat/completions", chatRequest("+a"), chatResponse("first"));
+        archive.record("/chat/completions", chatRequest("+b"), chatResponse("second"));
+    }
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    AsyncHTTPSConnection conn;
+    AsyncOpenAIAPI api(conn, "replay");
+    api.use_archive(&replay);
+
+    std::future<std::string> first = async_generate_commit_message(api, "+a");
+    std::future<std::string> second = async_generate_commit_message(api, "+b");
+    ASSERT_EQ(second.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(second.get(), "second");
+    ASSERT_EQ(first.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(first.get(), "first");
+}
+
+TEST(AsyncCommitMessageTest, RequestErrorsReachTheCaller) {
+    std::string path = tempArchivePath("missing.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+    }
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    AsyncHTTPSConnection conn;
+    AsyncOpenAIAPI api(conn, "replay");
+    api.use_archive(&replay);
+
+    std::future<std::string> message = async_generate_commit_message(api, "+unrecorded");
+    ASSERT_EQ(message.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_THROW(message.get(), std::runtime_error);
+    EXPECT_EQ(replay.misses(), 1u);
+}
+
+TEST(AsyncCommitMessageTest, OnReadyRunsForSuccessAndFailure) {
+    std::string path = tempArchivePath("notify.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/chat/completions", chatRequest("+ok"), chatResponse("ok"));
+    }
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    AsyncHTTPSConnection conn;
+    AsyncOpenAIAPI api(conn, "replay");
+    api.use_archive(&replay);
+
+    std::atomic<int> notified{0};
+    std::future<std::string> ok = async_generate_commit_message(api, "+ok", [&] { notified++; });
+    std::future<std::string> failed = async_generate_commit_message(api, "+unrecorded", [&] { notified++; });
+    EXPECT_EQ(ok.get(), "ok");
+    EXPECT_THROW(failed.get(), std::runtime_error);
+    EXPECT_EQ(notified.load(), 2);
+}
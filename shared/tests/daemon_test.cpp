@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "daemon.hpp"
+
+namespace {
+
+// Echoes what a run can see: its arguments, directory, key and stdin
+int echoRun(int argc, char* argv[]) {
+    std::string input((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+    for (int i = 1; i < argc; i++) std::cout << argv[i] << " ";
+    std::cout << std::endl;
+    const char* key = std::getenv("OPENAI_API_KEY");
+    std::cout << std::filesystem::current_path().string() << " " << (key ? key : "-") << std::endl;
+    std::thread([] { std::cerr << "from a stage thread" << std::endl; }).join();
+    std::cout << input.size();
+    return argc;
+}
+
+class DaemonTest : public ::testing::Test {
+protected:
+    std::filesystem::path dir;
+    std::filesystem::path binary;
+    pid_t daemon_pid = -1;
+
+    void SetUp() override {
+        dir = std::filesystem::temp_directory_path() / ("daemon_test_" + std::to_string(getpid()));
+        std::filesystem::create_directories(dir);
+        std::filesystem::permissions(dir, std::filesystem::perms::owner_all);
+        binary = dir / "gcommit";
+        std::ofstream(binary) << "v1";
+        setenv("XDG_RUNTIME_DIR", dir.c_str(), 1);
+
+        daemon_pid = fork();
+        if (daemon_pid == 0) {
+            std::cerr.rdbuf(nullptr);
+            _exit(runDaemon(echoRun, binary.string(), std::chrono::minutes(1)));
+        }
+        for (int i = 0; i < 100 && !std::filesystem::exists(daemonSocketPath()); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    void TearDown() override {
+        if (daemon_pid > 0) {
+            kill(daemon_pid, SIGTERM);
+            waitpid(daemon_pid, nullptr, 0);
+        }
+        std::filesystem::remove_all(dir);
+    }
+
+    std::optional<int> run(const std::vector<std::string>& args, const std::string& input,
+                           std::string& out, std::string& err) {
+        int fd = connectToDaemon();
+        if (fd < 0) return std::nullopt;
+        std::ostringstream captured_out, captured_err;
+        std::streambuf* saved_out = std::cout.rdbuf(captured_out.rdbuf());
+        std::streambuf* saved_err = std::cerr.rdbuf(captured_err.rdbuf());
+        std::optional<int> code = runViaDaemon(fd, args, input);
+        std::cout.rdbuf(saved_out);
+        std::cerr.rdbuf(saved_err);
+        out = captured_out.str();
+        err = captured_err.str();
+        return code;
+    }
+};
+
+}
+
+TEST_F(DaemonTest, SocketIsPrivateToTheUser) {
+    std::filesystem::perms perms = std::filesystem::status(daemonSocketPath()).permissions();
+    EXPECT_EQ(perms & std::filesystem::perms::all, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+}
+
+TEST_F(DaemonTest, FallbackSocketIsInAPerUserDirectory) {
+    unsetenv("XDG_RUNTIME_DIR");
+    EXPECT_EQ(daemonSocketPath(), "/tmp/gcommit-" + std::to_string(getuid()) + "/gcommit.sock");
+    setenv("XDG_RUNTIME_DIR", dir.c_str(), 1);
+}
+
+TEST_F(DaemonTest, RefusesADirectoryOthersCanWrite) {
+    std::filesystem::permissions(dir, std::filesystem::perms::others_write, std::filesystem::perm_options::add);
+    EXPECT_LT(connectToDaemon(), 0);
+    std::filesystem::permissions(dir, std::filesystem::perms::others_write, std::filesystem::perm_options::remove);
+    int fd = connectToDaemon();
+    EXPECT_GE(fd, 0);
+    if (fd >= 0) close(fd);
+}
+
+TEST_F(DaemonTest, LeavesOtherFilesAtTheSocketPathAlone) {
+    std::filesystem::path other = dir / "other";
+    std::filesystem::create_directories(other);
+    std::ofstream(other / "gcommit.sock") << "not a socket";
+    setenv("XDG_RUNTIME_DIR", other.c_str(), 1);
+    std::streambuf* saved_err = std::cerr.rdbuf(nullptr);
+    int code = runDaemon(echoRun, "", std::chrono::minutes(1));
+    std::cerr.rdbuf(saved_err);
+    setenv("XDG_RUNTIME_DIR", dir.c_str(), 1);
+    EXPECT_EQ(code, 1);
+    EXPECT_TRUE(std::filesystem::is_regular_file(other / "gcommit.sock"));
+}
+
+TEST_F(DaemonTest, RelaysOutputExitCodeAndInput) {
+    std::string out, err;
+    std::string diff(200000, 'x');
+    std::optional<int> code = run({"-d", "0.3", "-i"}, diff, out, err);
+    ASSERT_TRUE(code);
+    EXPECT_EQ(*code, 4);
+    EXPECT_EQ(out.substr(0, out.find('\n')), "-d 0.3 -i ");
+    EXPECT_EQ(out.substr(out.rfind('\n') + 1), "200000");
+    EXPECT_EQ(err, "from a stage thread\n");
+}
+
+TEST_F(DaemonTest, RunsInTheClientDirectoryAndEnvironment) {
+    std::filesystem::path cwd = std::filesystem::current_path();
+    std::filesystem::current_path(dir);
+    setenv("OPENAI_API_KEY", "client-key", 1);
+    std::string out, err;
+    std::optional<int> code = run({}, "", out, err);
+    std::filesystem::current_path(cwd);
+    ASSERT_TRUE(code);
+
+    std::istringstream lines(out);
+    std::string args_line, location_line;
+    std::getline(lines, args_line);
+    std::getline(lines, location_line);
+    EXPECT_EQ(location_line, std::filesystem::canonical(dir).string() + " client-key");
+
+    unsetenv("OPENAI_API_KEY");
+    ASSERT_TRUE(run({}, "", out, err));
+    EXPECT_NE(out.find(" -\n"), std::string::npos);
+}
+
+TEST_F(DaemonTest, ReportsADirectoryItCannotEnter) {
+    int fd = connectToDaemon();
+    ASSERT_GE(fd, 0);
+    std::string request = R"({"args":[],"cwd":")" + (dir / "missing").string() + R"(","env":{},"stdin":0})" "\n";
+    ASSERT_EQ(write(fd, request.data(), request.size()), static_cast<ssize_t>(request.size()));
+    std::string reply;
+    char chunk[4096];
+    ssize_t got;
+    while ((got = read(fd, chunk, sizeof(chunk))) > 0) reply.append(chunk, got);
+    close(fd);
+    EXPECT_NE(reply.find("cannot enter"), std::string::npos) << reply;
+    EXPECT_NE(reply.find(R"({"exit":1})"), std::string::npos) << reply;
+
+    // The next run still starts from a clean slate
+    std::string out, err;
+    std::optional<int> code = run({"again"}, "", out, err);
+    ASSERT_TRUE(code);
+    EXPECT_EQ(*code, 2);
+}
+
+TEST_F(DaemonTest, ServesRequestsBackToBack) {
+    std::string out, err;
+    for (int i = 0; i < 5; i++) {
+        std::optional<int> code = run({std::to_string(i)}, "diff", out, err);
+        ASSERT_TRUE(code);
+        EXPECT_EQ(*code, 2);
+        EXPECT_EQ(out.substr(0, out.find('\n')), std::to_string(i) + " ");
+    }
+}
+
+TEST_F(DaemonTest, RebuiltBinaryMakesTheDaemonStepAside) {
+    std::filesystem::last_write_time(binary, std::filesystem::last_write_time(binary) + std::chrono::seconds(5));
+    std::string out, err;
+    EXPECT_FALSE(run({}, "diff", out, err));
+    EXPECT_TRUE(out.empty());
+
+    int status = 0;
+    waitpid(daemon_pid, &status, 0);
+    daemon_pid = -1;
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_FALSE(std::filesystem::exists(daemonSocketPath()));
+    EXPECT_LT(connectToDaemon(), 0);
+}
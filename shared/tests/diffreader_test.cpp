@@ -50,7 +50,7 @@ TEST_F(DiffReaderTest, ParsesSimpleDiff) {
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     ASSERT_EQ(files.size(), 1);
     EXPECT_EQ(files[0].filepath, "foo.cpp");
 }
@@ -60,7 +60,7 @@ TEST_F(DiffReaderTest, ParsesMultiFileDiff) {
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     ASSERT_EQ(files.size(), 2);
     EXPECT_EQ(files[0].filepath, "foo.cpp");
     EXPECT_EQ(files[1].filepath, "bar.cpp");
@@ -71,7 +71,7 @@ TEST_F(DiffReaderTest, DetectsInsertions) {
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     ASSERT_EQ(files.size(), 1);
 
     int insertion_count = 0;
@@ -89,7 +89,7 @@ TEST_F(DiffReaderTest, DetectsDeletions) {
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     ASSERT_EQ(files.size(), 1);
 
     int deletion_count = 0;
@@ -106,7 +106,7 @@ TEST_F(DiffReaderTest, DetectsContextLines) {
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     ASSERT_EQ(files.size(), 1);
 
     int eq_count = 0;
@@ -123,63 +123,57 @@ TEST_F(DiffReaderTest, EmptyDiff) {
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     EXPECT_EQ(files.size(), 0);
 }
 
-// Tests for getDiffContent
-TEST_F(DiffReaderTest, GetDiffContentFiltersInsertions) {
+// Tests for per-mode line counts within a chunk
+TEST_F(DiffReaderTest, ChunkInsertionsBelongToTheirFile) {
     std::istringstream input(multi_file_diff);
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     ASSERT_GE(files.size(), 1);
+    EXPECT_EQ(files[0].filepath, "foo.cpp");
 
-    DiffChunk insertions = getDiffContent(files[0], {INSERTION});
-    EXPECT_EQ(insertions.filepath, "foo.cpp");
-
-    for (const auto& line : insertions.lines) {
-        EXPECT_EQ(line.mode, INSERTION);
+    int insertion_count = 0;
+    for (const auto& line : files[0].lines) {
+        if (line.mode == INSERTION) {
+            insertion_count++;
+            EXPECT_EQ(line.content, "added_line");
+        }
     }
+    EXPECT_EQ(insertion_count, 1);
 }
 
-TEST_F(DiffReaderTest, GetDiffContentFiltersDeletions) {
+TEST_F(DiffReaderTest, ChunkCountsDeletionsAndContext) {
     std::istringstream input(deletion_diff);
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     ASSERT_EQ(files.size(), 1);
-
-    DiffChunk deletions = getDiffContent(files[0], {DELETION});
-
-    for (const auto& line : deletions.lines) {
-        EXPECT_EQ(line.mode, DELETION);
-    }
-    EXPECT_EQ(deletions.lines.size(), 2);
+    ASSERT_EQ(files[0].lines.size(), 4);
+    EXPECT_EQ(files[0].lines[1].mode, DELETION);
+    EXPECT_EQ(files[0].lines[2].mode, DELETION);
 }
 
-TEST_F(DiffReaderTest, GetDiffContentMultipleTypes) {
+TEST_F(DiffReaderTest, ChunkKeepsInsertionsAndDeletions) {
     std::istringstream input(multi_file_diff);
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
-    DiffChunk both = getDiffContent(files[1], {INSERTION, DELETION});
-
-    EXPECT_EQ(both.lines.size(), 2);
-}
-
-TEST_F(DiffReaderTest, GetDiffContentEmptyTypesReturnsAll) {
-    std::istringstream input(simple_diff);
-    DiffReader dr(input);
-    dr.ingestDiff();
-
-    std::vector<DiffFile> files = dr.getFiles();
-    DiffChunk all = getDiffContent(files[0], {});
+    std::vector<DiffChunk> files = dr.getChunks();
+    ASSERT_EQ(files.size(), 2);
 
-    EXPECT_EQ(all.lines.size(), files[0].lines.size());
+    int changed = 0;
+    for (const auto& line : files[1].lines) {
+        if (line.mode == INSERTION || line.mode == DELETION) {
+            changed++;
+        }
+    }
+    EXPECT_EQ(changed, 2);
 }
 
 // Tests for combineContent
@@ -210,10 +204,9 @@ TEST_F(DiffReaderTest, ParsesHunkHeaderLineNumbers) {
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     ASSERT_EQ(files.size(), 1);
-    EXPECT_EQ(files[0].old_start, 1);
-    EXPECT_EQ(files[0].new_start, 1);
+    EXPECT_EQ(files[0].start, 1);
 }
 
 TEST_F(DiffReaderTest, ParsesHunkHeaderNonOneStart) {
@@ -230,96 +223,34 @@ TEST_F(DiffReaderTest, ParsesHunkHeaderNonOneStart) {
     DiffReader dr(input);
     dr.ingestDiff();
 
-    std::vector<DiffFile> files = dr.getFiles();
+    std::vector<DiffChunk> files = dr.getChunks();
     ASSERT_EQ(files.size(), 1);
-    EXPECT_EQ(files[0].old_start, 10);
-    EXPECT_EQ(files[0].new_start, 15);
-}
-
-TEST_F(DiffReaderTest, GetDiffContentCopiesStartPositions) {
-    const std::string diff_at_line_10 = R"(diff --git a/foo.cpp b/foo.cpp
---- a/foo.cpp
-+++ b/foo.cpp
-@@ -10,3 +15,4 @@
- context
-+added
- context
- context
-)";
-    std::istringstream input(diff_at_line_10);
-    DiffReader dr(input);
-    dr.ingestDiff();
-
-    std::vector<DiffFile> files = dr.getFiles();
-    DiffChunk chunk = getDiffContent(files[0], {});
-
-    EXPECT_EQ(chunk.old_start, 10);
-    EXPECT_EQ(chunk.new_start, 15);
+    EXPECT_EQ(files[0].start, 10);
 }
 
-// Tests for createPatch
-TEST_F(DiffReaderTest, CreatePatchBasicFormat) {
-    std::istringstream input(simple_diff);
-    DiffReader dr(input);
-    dr.ingestDiff();
-
-    std::vector<DiffFile> files = dr.getFiles();
-    DiffChunk chunk = getDiffContent(files[0], {});
-
-    std::string patch = createPatch(chunk);
-
-    // Check header
-    EXPECT_NE(patch.find("--- a/foo.cpp"), std::string::npos);
-    EXPECT_NE(patch.find("+++ b/foo.cpp"), std::string::npos);
-
-    // Check hunk header exists
-    EXPECT_NE(patch.find("@@ -"), std::string::npos);
-
-    // Check line prefixes
-    EXPECT_NE(patch.find("+#include <string>"), std::string::npos);
-    EXPECT_NE(patch.find(" #include <iostream>"), std::string::npos);
-}
-
-TEST_F(DiffReaderTest, CreatePatchCorrectCounts) {
-    std::istringstream input(deletion_diff);
-    DiffReader dr(input);
-    dr.ingestDiff();
-
-    std::vector<DiffFile> files = dr.getFiles();
-    DiffChunk chunk = getDiffContent(files[0], {});
-
-    std::string patch = createPatch(chunk);
-
-    // deletion_diff: 2 context (EQ), 2 deletions
-    // old_count = 4 (2 EQ + 2 DEL), new_count = 2 (2 EQ)
-    EXPECT_NE(patch.find("@@ -1,4 +1,2 @@"), std::string::npos);
-}
-
-TEST_F(DiffReaderTest, CreatePatchRoundTrip) {
-    // Parse a diff, create a patch, verify it looks like a valid patch
-    const std::string original = R"(diff --git a/test.cpp b/test.cpp
---- a/test.cpp
-+++ b/test.cpp
-@@ -5,4 +5,5 @@
- line1
- line2
-+new_line
- line3
- line4
-)";
-    std::istringstream input(original);
-    DiffReader dr(input);
-    dr.ingestDiff();
-
-    std::vector<DiffFile> files = dr.getFiles();
-    DiffChunk chunk = getDiffContent(files[0], {});
+// Tests for createPatches
+TEST_F(DiffReaderTest, CreatePatchesCarriesDeltaForSameStart) {
+    DiffChunk first;
+    first.filepath = first.old_filepath = "foo.cpp";
+    first.start = 5;
+    first.lines = {
+        {EQ, "a", 5},
+        {INSERTION, "x", 6},
+        {INSERTION, "y", 7},
+        {EQ, "b", 8}
+    };
 
-    std::string patch = createPatch(chunk);
+    DiffChunk second = first;
+    second.lines = {
+        {EQ, "a", 5},
+        {INSERTION, "z", 6},
+        {EQ, "b", 7}
+    };
 
-    // Verify structure
-    EXPECT_NE(patch.find("--- a/test.cpp"), std::string::npos);
-    EXPECT_NE(patch.find("+++ b/test.cpp"), std::string::npos);
-    EXPECT_NE(patch.find("@@ -5,4 +5,5 @@"), std::string::npos);
-    EXPECT_NE(patch.find(" line1"), std::string::npos);
-    EXPECT_NE(patch.find("+new_line"), std::string::npos);
+    std::vector<std::string> patches = createPatches({first, second});
+    ASSERT_EQ(patches.size(), 2);
+    EXPECT_NE(patches[0].find("@@ -5,2 +5,4 @@"), std::string::npos);
+    // The first patch inserted two lines above the shared start, so the
+    // second one has to be applied two lines further down
+    EXPECT_NE(patches[1].find("@@ -7,2 +7,3 @@"), std::string::npos);
 }
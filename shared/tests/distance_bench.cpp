@@ -0,0 +1,81 @@
+// Microbenchmark: dispatched distance kernels vs the old by-value scalar cos_sim.
+// Not registered with ctest; run ./distance_bench [dim] [vectors].
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "distance.hpp"
+
+using namespace std;
+
+// The previous utils.cpp implementation, copies included
+float legacy_cos_sim(vector<float> a, vector<float> b) {
+  float dot = 0.0;
+  for (size_t i = 0; i < a.size(); i++) {
+    dot += a[i] * b[i];
+  }
+  return dot;
+}
+
+template <typename F>
+double timePairs(const vector<vector<float>>& data, F&& sim, float& checksum) {
+  auto start = chrono::steady_clock::now();
+  for (size_t i = 0; i < data.size(); i++) {
+    for (size_t j = i + 1; j < data.size(); j++) {
+      checksum += sim(data[i], data[j]);
+    }
+  }
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+  size_t dim = argc > 1 ? stoul(argv[1]) : 1536;
+  size_t n = argc > 2 ? stoul(argv[2]) : 1000;
+
+  mt19937 rng(42);
+  normal_distribution<float> gauss;
+  vector<vector<float>> data(n, vector<float>(dim));
+  for (auto& row : data) {
+    for (float& v : row) v = gauss(rng);
+  }
+
+  float checksum = 0.0f;
+  double pairs = n * (n - 1) / 2.0;
+  double legacy = timePairs(data, legacy_cos_sim, checksum);
+  double current = timePairs(data, [](const vector<float>& a, const vector<float>& b) {
+    return cos_sim(a, b);
+  }, checksum);
+
+  vector<float> flat;
+  for (const auto& row : data) flat.insert(flat.end(), row.begin(), row.end());
+  vector<float> out(n);
+  auto start = chrono::steady_clock::now();
+  for (size_t i = 0; i < n; i++) {
+    dot_product_many(data[i], flat.data(), n, dim, out.data());
+    checksum += out[0];
+  }
+  double many = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  // Same pairs on per-row int8 codes, as stored by QuantizedStore
+  vector<int8_t> codes(flat.size());
+  for (size_t k = 0; k < flat.size(); k++) {
+    codes[k] = static_cast<int8_t>(max(-127.0f, min(127.0f, flat[k] * 32.0f)));
+  }
+  start = chrono::steady_clock::now();
+  int64_t int_checksum = 0;
+  for (size_t i = 0; i < n; i++) {
+    span<const int8_t> a(codes.data() + i * dim, dim);
+    for (size_t j = i + 1; j < n; j++) {
+      int_checksum += dot_product_i8(a, span<const int8_t>(codes.data() + j * dim, dim));
+    }
+  }
+  double int8 = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << "kernel: " << simd_level() << ", dim=" << dim << ", vectors=" << n << endl;
+  cout << "legacy cos_sim:   " << legacy / pairs * 1e9 << " ns/pair" << endl;
+  cout << "cos_sim:          " << current / pairs * 1e9 << " ns/pair (" << legacy / current << "x)" << endl;
+  cout << "dot_product_many: " << many / (double(n) * n) * 1e9 << " ns/pair" << endl;
+  cout << "dot_product_i8:   " << int8 / pairs * 1e9 << " ns/pair (" << current / int8 << "x vs cos_sim)" << endl;
+  cout << "(checksum " << checksum << " " << int_checksum << ")" << endl;
+  return 0;
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include "distance.hpp"
+
+namespace {
+
+std::vector<float> randomVector(size_t n, std::mt19937& rng) {
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> v(n);
+    for (float& x : v) x = dist(rng);
+    return v;
+}
+
+double referenceDot(const std::vector<float>& a, const std::vector<float>& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); i++) sum += static_cast<double>(a[i]) * b[i];
+    return sum;
+}
+
+double referenceL2(const std::vector<float>& a, const std::vector<float>& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); i++) sum += (static_cast<double>(a[i]) - b[i]) * (a[i] - b[i]);
+    return sum;
+}
+
+}
+
+TEST(DistanceTest, ReportsKernel) {
+    std::string level = simd_level();
+    EXPECT_TRUE(level == "scalar" || level == "avx2" || level == "avx512" || level == "neon") << level;
+}
+
+TEST(DistanceTest, MatchesReferenceForAllTailLengths) {
+    std::mt19937 rng(1);
+    // Every remainder modulo the widest vector width, plus embedding sizes
+    std::vector<size_t> sizes;
+    for (size_t n = 0; n <= 70; n++) sizes.push_back(n);
+    sizes.push_back(256);
+    sizes.push_back(1536);
+
+    for (size_t n : sizes) {
+        std::vector<float> a = randomVector(n, rng);
+        std::vector<float> b = randomVector(n, rng);
+        double tolerance = 1e-4 * (n + 1);
+        EXPECT_NEAR(dot_product(a, b), referenceDot(a, b), tolerance) << "n=" << n;
+        EXPECT_NEAR(l2_squared(a, b), referenceL2(a, b), tolerance) << "n=" << n;
+    }
+}
+
+TEST(DistanceTest, MismatchedLengthsUseShorter) {
+    std::vector<float> a = {1.0f, 2.0f, 3.0f};
+    std::vector<float> b = {4.0f, 5.0f};
+    EXPECT_FLOAT_EQ(dot_product(a, b), 14.0f);
+    EXPECT_FLOAT_EQ(l2_squared(a, b), 18.0f);
+}
+
+TEST(DistanceTest, OneToManyMatchesPairwise) {
+    std::mt19937 rng(2);
+    // Row counts around the kernels' row blocks, dims around their SIMD widths
+    for (size_t dim : {5, 37, 100}) {
+        for (size_t count : {1, 3, 4, 9}) {
+            std::vector<float> query = randomVector(dim, rng);
+            std::vector<float> rows = randomVector(dim * count, rng);
+
+            std::vector<float> dots(count);
+            std::vector<float> l2s(count);
+            dot_product_many(query, rows.data(), count, dim, dots.data());
+            l2_squared_many(query, rows.data(), count, dim, l2s.data());
+            for (size_t i = 0; i < count; i++) {
+                std::span<const float> row(rows.data() + i * dim, dim);
+                EXPECT_FLOAT_EQ(dots[i], dot_product(query, row)) << "dim " << dim << ", row " << i;
+                EXPECT_FLOAT_EQ(l2s[i], l2_squared(query, row)) << "dim " << dim << ", row " << i;
+            }
+        }
+    }
+}
+
+TEST(DistanceTest, CosineOfUnitVectors) {
+    std::vector<float> x = {1.0f, 0.0f};
+    std::vector<float> y = {0.0f, 1.0f};
+    std::vector<float> d = {std::sqrt(0.5f), std::sqrt(0.5f)};
+    EXPECT_FLOAT_EQ(cos_sim(x, x), 1.0f);
+    EXPECT_FLOAT_EQ(cos_sim(x, y), 0.0f);
+    EXPECT_NEAR(cos_sim(x, d), std::sqrt(0.5f), 1e-6);
+}
+
+TEST(DistanceTest, Int8DotMatchesReference) {
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> code(-127, 127);
+    for (size_t n : {0, 1, 15, 16, 17, 31, 32, 33, 100, 1536}) {
+        std::vector<int8_t> a(n);
+        std::vector<int8_t> b(n);
+        int32_t expected = 0;
+        for (size_t i = 0; i < n; i++) {
+            a[i] = static_cast<int8_t>(code(rng));
+            b[i] = static_cast<int8_t>(code(rng));
+            expected += a[i] * b[i];
+        }
+        EXPECT_EQ(dot_product_i8(a, b), expected) << "n=" << n;
+    }
+}
+
+TEST(DistanceTest, HalfConversionRoundTrips) {
+    EXPECT_EQ(float_to_half(0.0f), 0x0000);
+    EXPECT_EQ(float_to_half(-0.0f), 0x8000);
+    EXPECT_EQ(float_to_half(1.0f), 0x3c00);
+    EXPECT_EQ(float_to_half(-2.0f), 0xc000);
+    EXPECT_EQ(float_to_half(65504.0f), 0x7bff);
+    EXPECT_EQ(float_to_half(1e6f), 0x7c00);
+    EXPECT_EQ(float_to_half(std::ldexp(1.0f, -24)), 0x0001);
+    EXPECT_TRUE(std::isnan(half_to_float(float_to_half(NAN))));
+
+    std::mt19937 rng(6);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (int i = 0; i < 1000; i++) {
+        float x = dist(rng);
+        EXPECT_NEAR(half_to_float(float_to_half(x)), x, std::fabs(x) * 1e-3 + 1e-7);
+    }
+}
+
+TEST(DistanceTest, HalfDotMatchesReference) {
+    std::mt19937 rng(7);
+    for (size_t n : {0, 3, 8, 17, 1536}) {
+        std::vector<float> a = randomVector(n, rng);
+        std::vector<float> b = randomVector(n, rng);
+        std::vector<uint16_t> ha(n);
+        std::vector<uint16_t> hb(n);
+        double expected = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            ha[i] = float_to_half(a[i]);
+            hb[i] = float_to_half(b[i]);
+            expected += static_cast<double>(half_to_float(ha[i])) * half_to_float(hb[i]);
+        }
+        EXPECT_NEAR(dot_product_f16(ha, hb), expected, 1e-4 * (n + 1)) << "n=" << n;
+    }
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include "embedding_cache.hpp"
+
+namespace {
+
+// Returns a vector derived from the text and counts what it was asked for
+class CountingProvider : public EmbeddingProvider {
+public:
+    std::vector<std::string> requested;
+
+    std::vector<std::vector<float>> embed(const std::vector<std::string>& texts) override {
+        std::vector<std::vector<float>> out;
+        for (const std::string& text : texts) {
+            requested.push_back(text);
+            out.push_back(text == "fail" ? std::vector<float>{} : std::vector<float>{static_cast<float>(text.size()), 1.0f});
+        }
+        return out;
+    }
+    size_t max_input_tokens() const override { return 100; }
+};
+
+std::string tempCachePath(const std::string& name) {
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "embedding_cache_test";
+    std::filesystem::remove_all(dir / name);
+    return (dir / name / "embeddings.bin").string();
+}
+
+}
+
+TEST(EmbeddingCacheTest, OnlyMissesReachTheProvider) {
+    EmbeddingCache cache(tempCachePath("misses"), "test:2");
+    CountingProvider provider;
+    CachedEmbeddingProvider cached(provider, cache);
+
+    cached.embed({"alpha", "beta"});
+    std::vector<std::vector<float>> result = cached.embed({"beta", "gamma", "alpha"});
+
+    EXPECT_EQ(provider.requested, (std::vector<std::string>{"alpha", "beta", "gamma"}));
+    EXPECT_EQ(cached.cache_hits(), 2u);
+    ASSERT_EQ(result.size(), 3u);
+    EXPECT_EQ(result[0], (std::vector<float>{4.0f, 1.0f}));
+    EXPECT_EQ(result[2], (std::vector<float>{5.0f, 1.0f}));
+}
+
+TEST(EmbeddingCacheTest, FailedEmbeddingsAreRetried) {
+    EmbeddingCache cache(tempCachePath("failed"), "test:2");
+    CountingProvider provider;
+    CachedEmbeddingProvider cached(provider, cache);
+
+    EXPECT_TRUE(cached.embed({"fail"})[0].empty());
+    cached.embed({"fail"});
+    EXPECT_EQ(provider.requested.size(), 2u);
+}
+
+TEST(EmbeddingCacheTest, SurvivesSaveAndLoad) {
+    std::string path = tempCachePath("roundtrip");
+    {
+        EmbeddingCache cache(path, "test:2");
+        EXPECT_FALSE(cache.load());
+        cache.store("alpha", {0.25f, -1.5f});
+        cache.store("beta", {3.0f});
+        ASSERT_TRUE(cache.save());
+    }
+
+    EmbeddingCache reloaded(path, "test:2");
+    ASSERT_TRUE(reloaded.load());
+    EXPECT_EQ(reloaded.size(), 2u);
+    ASSERT_NE(reloaded.find("alpha"), nullptr);
+    EXPECT_EQ(*reloaded.find("alpha"), (std::vector<float>{0.25f, -1.5f}));
+    EXPECT_EQ(reloaded.find("gamma"), nullptr);
+
+    // Another provider configuration never sees these vectors
+    EmbeddingCache other(path, "test:3");
+    ASSERT_TRUE(other.load());
+    EXPECT_EQ(other.find("alpha"), nullptr);
+}
+
+TEST(EmbeddingCacheTest, RejectsAWidthLargerThanTheFile) {
+    std::string path = tempCachePath("corrupt");
+    {
+        EmbeddingCache cache(path, "test:2");
+        cache.store("alpha", {0.25f, -1.5f});
+        ASSERT_TRUE(cache.save());
+    }
+    // Header is magic (4) + count (8), then key (8) and width (4)
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(20);
+        uint32_t width = 0xffffffffu;
+        file.write(reinterpret_cast<const char*>(&width), sizeof(width));
+    }
+    EmbeddingCache reloaded(path, "test:2");
+    EXPECT_FALSE(reloaded.load());
+}
+
+TEST(EmbeddingCacheTest, SaveKeepsEntriesUsedThisRunFirst) {
+    std::string path = tempCachePath("eviction");
+    {
+        EmbeddingCache cache(path, "test");
+        for (int i = 0; i < 10; i++) cache.store("old" + std::to_string(i), {static_cast<float>(i)});
+        ASSERT_TRUE(cache.save());
+    }
+    EmbeddingCache cache(path, "test", 3);
+    ASSERT_TRUE(cache.load());
+    cache.find("old7");
+    cache.store("new", {1.0f});
+    ASSERT_TRUE(cache.save());
+
+    EmbeddingCache reloaded(path, "test");
+    ASSERT_TRUE(reloaded.load());
+    EXPECT_EQ(reloaded.size(), 3u);
+    EXPECT_NE(reloaded.find("old7"), nullptr);
+    EXPECT_NE(reloaded.find("new"), nullptr);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include "api_archive.hpp"
+#include "async_openai_api.hpp"
+#include "embedding_provider.hpp"
+
+// Requests are answered from a replay archive, so nothing reaches the network
+namespace {
+
+std::string tempArchivePath(const std::string& name) {
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "embedding_provider_test";
+    std::filesystem::create_directories(dir);
+    std::filesystem::remove(dir / name);
+    return (dir / name).string();
+}
+
+// Same body AsyncOpenAIAPI::async_embeddings sends
+std::string embeddingsRequest(const std::vector<std::string>& texts, int dimensions) {
+    nlohmann::json body = {
+        {"model", "text-embedding-3-small"},
+        {"input", texts},
+        {"encoding_format", "base64"},
+        {"dimensions", dimensions}
+    };
+    return body.dump();
+}
+
+RecordedResponse embeddingsResponse(const std::vector<std::vector<float>>& vectors) {
+    nlohmann::json data = nlohmann::json::array();
+    for (size_t i = 0; i < vectors.size(); i++) {
+        data.push_back({{"index", i}, {"embedding", vectors[i]}});
+    }
+    return {"HTTP/1.1 200 OK\r\n\r\n", nlohmann::json{{"data", data}}.dump()};
+}
+
+}
+
+TEST(OpenAIEmbeddingProviderTest, EmbedsABatchInOneRequest) {
+    std::string path = tempArchivePath("batch.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/embeddings", embeddingsRequest({"a", "b"}, 2), embeddingsResponse({{1, 0}, {0, 1}}));
+    }
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    AsyncHTTPSConnection conn;
+    AsyncOpenAIAPI api(conn, "replay");
+    api.use_archive(&replay);
+    OpenAIEmbeddingProvider provider(api, 0, 2);
+
+    std::vector<std::vector<float>> embeddings = provider.embed({"a", "b"});
+    ASSERT_EQ(embeddings.size(), 2u);
+    EXPECT_EQ(embeddings[0], std::vector<float>({1, 0}));
+    EXPECT_EQ(embeddings[1], std::vector<float>({0, 1}));
+    EXPECT_EQ(replay.hits(), 1u);
+    EXPECT_EQ(replay.misses(), 0u);
+    EXPECT_EQ(conn.stats().retries, 0u);
+}
+
+TEST(OpenAIEmbeddingProviderTest, RetriesAFailedBatchOneInputAtATime) {
+    std::string path = tempArchivePath("retry.bin");
+    {
+        // The batch request itself was never answered
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/embeddings", embeddingsRequest({"a"}, 2), embeddingsResponse({{1, 0}}));
+        archive.record("/embeddings", embeddingsRequest({"c"}, 2), embeddingsResponse({{0, 1}}));
+        archive.record("/embeddings", embeddingsRequest({"b"}, 2), {"HTTP/1.1 400 Bad Request\r\n\r\n", R"({"error":{"message":"too long"}})"});
+    }
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    AsyncHTTPSConnection conn;
+    AsyncOpenAIAPI api(conn, "replay");
+    api.use_archive(&replay);
+    OpenAIEmbeddingProvider provider(api, 0, 2);
+
+    std::vector<std::vector<float>> embeddings = provider.embed({"a", "b", "c"});
+    ASSERT_EQ(embeddings.size(), 3u);
+    EXPECT_EQ(embeddings[0], std::vector<float>({1, 0}));
+    EXPECT_TRUE(embeddings[1].empty());
+    EXPECT_EQ(embeddings[2], std::vector<float>({0, 1}));
+    EXPECT_EQ(replay.misses(), 1u);
+    EXPECT_EQ(replay.hits(), 3u);
+    EXPECT_EQ(conn.stats().retries, 3u);
+}
+
+TEST(OpenAIEmbeddingProviderTest, LogsInputsThatFailOnTheirOwn) {
+    std::string path = tempArchivePath("retry_log.bin");
+    {
+        ApiArchive archive(path, ApiArchive::RECORD);
+        archive.record("/embeddings", embeddingsRequest({"a"}, 2), embeddingsResponse({{1, 0}}));
+        archive.record("/embeddings", embeddingsRequest({"b"}, 2), {"HTTP/1.1 400 Bad Request\r\n\r\n", R"({"error":{"message":"too long"}})"});
+    }
+    ApiArchive replay(path, ApiArchive::REPLAY);
+    AsyncHTTPSConnection conn;
+    AsyncOpenAIAPI api(conn, "replay");
+    api.use_archive(&replay);
+    OpenAIEmbeddingProvider provider(api, 1, 2);
+
+    testing::internal::CaptureStderr();
+    std::vector<std::vector<float>> embeddings = provider.embed({"a", "b"});
+    std::string log = testing::internal::GetCapturedStderr();
+    ASSERT_EQ(embeddings.size(), 2u);
+    EXPECT_TRUE(embeddings[1].empty());
+    EXPECT_NE(log.find("Embedding input 1 failed on its own"), std::string::npos);
+    EXPECT_EQ(log.find("Embedding input 0 failed"), std::string::npos);
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "fingerprint.hpp"
+#include "precluster.hpp"
+
+namespace {
+
+DiffChunk makeChunk(const std::string& filepath, const std::vector<std::string>& inserted,
+                    std::vector<std::string> symbols = {}) {
+    DiffChunk chunk;
+    chunk.filepath = filepath;
+    chunk.old_filepath = filepath;
+    std::vector<std::string_view> changed;
+    int line_num = 0;
+    for (const auto& content : inserted) {
+        chunk.lines.push_back({INSERTION, content, line_num++});
+    }
+    for (const auto& line : chunk.lines) {
+        changed.push_back(line.content);
+    }
+    chunk.fingerprint = makeFingerprint(filepath, changed, std::move(symbols));
+    return chunk;
+}
+
+// One line per character of `modes`: ' ' context, '-' deletion, '+' insertion
+DiffChunk makeHunk(const std::string& filepath, int start, const std::string& modes) {
+    DiffChunk chunk;
+    chunk.filepath = filepath;
+    chunk.old_filepath = filepath;
+    chunk.start = start;
+    for (char m : modes) {
+        DiffMode mode = m == '-' ? DELETION : m == '+' ? INSERTION : EQ;
+        chunk.lines.push_back({mode, "line", 0});
+    }
+    return chunk;
+}
+
+}
+
+TEST(FingerprintTest, ExtractsIdentifiersAndPathTokens) {
+    std::vector<std::string_view> lines = {"int total = computeTotal(items, 42);"};
+    ChunkFingerprint fp = makeFingerprint("src/billing/Invoice.cpp", lines);
+
+    EXPECT_EQ(fp.identifiers, (std::vector<std::string>{"computeTotal", "items", "total"}));
+    EXPECT_EQ(fp.path_tokens, (std::vector<std::string>{"src", "billing", "invoice", "cpp"}));
+    EXPECT_TRUE(fp.computed);
+}
+
+TEST(FingerprintTest, IdenticalIdentifierSetsHaveFullSimilarity) {
+    std::vector<std::string_view> a = {"renderWidget(widgetState, themeColors)"};
+    std::vector<std::string_view> b = {"themeColors = renderWidget(widgetState)"};
+    ChunkFingerprint fa = makeFingerprint("a.js", a);
+    ChunkFingerprint fb = makeFingerprint("b.js", b);
+
+    EXPECT_FLOAT_EQ(minhashSimilarity(fa, fb), 1.0f);
+}
+
+TEST(FingerprintTest, DisjointIdentifierSetsHaveLowSimilarity) {
+    std::vector<std::string_view> a = {"alpha beta gamma delta epsilon"};
+    std::vector<std::string_view> b = {"zeta theta iota kappa lambda"};
+
+    EXPECT_LT(minhashSimilarity(makeFingerprint("a", a), makeFingerprint("b", b)), 0.2f);
+}
+
+TEST(FingerprintTest, JaccardOnSortedLists) {
+    std::vector<std::string> a = {"a", "b", "c"};
+    std::vector<std::string> b = {"b", "c", "d"};
+
+    EXPECT_FLOAT_EQ(jaccard(a, b), 0.5f);
+    EXPECT_FLOAT_EQ(jaccard({}, {}), 0.0f);
+}
+
+TEST(PreclusterTest, GroupsChunksInSameFunction) {
+    std::vector<DiffChunk> chunks = {
+        makeChunk("main.cpp", {"parseArgs(argc);"}, {"main"}),
+        makeChunk("main.cpp", {"runPipeline();"}, {"main"}),
+        makeChunk("main.cpp", {"helperThing();"}, {"helper"}),
+    };
+
+    std::vector<std::vector<int>> groups = preclusterChunks(chunks);
+
+    ASSERT_EQ(groups.size(), 2u);
+    EXPECT_EQ(groups[0], (std::vector<int>{0, 1}));
+    EXPECT_EQ(groups[1], (std::vector<int>{2}));
+}
+
+TEST(PreclusterTest, GroupsNearDuplicateChangesAcrossFiles) {
+    std::vector<std::string> edit = {
+        "oldClientName newClientName configureRetries timeoutMillis",
+        "requestBuilder responseParser connectionPool backoffPolicy",
+    };
+    std::vector<DiffChunk> chunks = {
+        makeChunk("a/service.go", edit),
+        makeChunk("b/service.go", edit),
+        makeChunk("c/other.go", {"completelyDifferentChange unrelatedSymbol anotherThing yetAnother",
+                                 "moreUnrelated identifiersHere forPadding enoughOfThem"}),
+    };
+
+    std::vector<std::vector<int>> groups = preclusterChunks(chunks);
+
+    ASSERT_EQ(groups.size(), 2u);
+    EXPECT_EQ(groups[0], (std::vector<int>{0, 1}));
+}
+
+TEST(MustLinkTest, TouchingEditsInOneFileAreLinked) {
+    std::vector<DiffChunk> chunks = {
+        makeHunk("a.cpp", 10, " --"),   // deletes 11-12
+        makeHunk("a.cpp", 13, "+ "),    // inserts before 13, right after the deletion
+        makeHunk("a.cpp", 20, "- "),    // deletes 20; 14-19 untouched in between
+        makeHunk("a.cpp", 22, " -"),    // deletes 23; line 21-22 untouched
+        makeHunk("b.cpp", 13, "+"),     // same lines, different file
+    };
+
+    std::vector<std::vector<int>> groups = mustLinkGroups(chunks);
+
+    ASSERT_EQ(groups.size(), 4u);
+    EXPECT_EQ(groups[0], (std::vector<int>{0, 1}));
+    EXPECT_EQ(groups[1], (std::vector<int>{2}));
+    EXPECT_EQ(groups[2], (std::vector<int>{3}));
+    EXPECT_EQ(groups[3], (std::vector<int>{4}));
+}
+
+TEST(MustLinkTest, OverlappingEditsAreLinked) {
+    std::vector<DiffChunk> chunks = {
+        makeHunk("a.cpp", 1, "----"),  // deletes 1-4
+        makeHunk("a.cpp", 40, "-"),
+        makeHunk("a.cpp", 3, "-"),     // inside the first deletion
+    };
+
+    std::vector<std::vector<int>> groups = mustLinkGroups(chunks);
+
+    ASSERT_EQ(groups.size(), 2u);
+    EXPECT_EQ(groups[0], (std::vector<int>{0, 2}));
+}
+
+TEST(MustLinkTest, WholeFileOperationsStayTogether) {
+    DiffChunk created_a = makeHunk("new.cpp", 1, "++");
+    DiffChunk created_b = makeHunk("new.cpp", 40, "++");
+    created_a.is_new = created_b.is_new = true;
+    DiffChunk deleted_a = makeHunk("gone.cpp", 1, "--");
+    DiffChunk deleted_b = makeHunk("gone.cpp", 50, "--");
+    deleted_a.is_deleted = deleted_b.is_deleted = true;
+    DiffChunk rename;
+    rename.old_filepath = "old.cpp";
+    rename.filepath = "renamed.cpp";
+    rename.is_rename = true;
+    DiffChunk edit_after_rename = makeHunk("renamed.cpp", 30, "+");
+    edit_after_rename.old_filepath = "old.cpp";
+
+    std::vector<DiffChunk> chunks = {created_a, deleted_a, rename, created_b, deleted_b, edit_after_rename,
+                                     makeHunk("other.cpp", 1, "+")};
+    std::vector<std::vector<int>> groups = mustLinkGroups(chunks);
+
+    ASSERT_EQ(groups.size(), 4u);
+    EXPECT_EQ(groups[0], (std::vector<int>{0, 3}));
+    EXPECT_EQ(groups[1], (std::vector<int>{1, 4}));
+    EXPECT_EQ(groups[2], (std::vector<int>{2, 5}));
+    EXPECT_EQ(groups[3], (std::vector<int>{6}));
+}
+
+TEST(MustLinkTest, ApplyMergesSplitGroupsAndKeepsOrder) {
+    std::vector<std::vector<int>> clusters = {{4, 0}, {2}, {1, 3}, {5}};
+    std::vector<std::vector<int>> groups = {{0}, {1, 2}, {3}, {4}, {5}};
+
+    std::vector<std::vector<int>> merged = applyMustLink(clusters, groups, 6);
+
+    ASSERT_EQ(merged.size(), 3u);
+    EXPECT_EQ(merged[0], (std::vector<int>{0, 4}));
+    EXPECT_EQ(merged[1], (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(merged[2], (std::vector<int>{5}));
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "grammar_registry.hpp"
+
+namespace {
+
+std::string detect(const std::string& path, const std::string& content = "") {
+    return GrammarRegistry::instance().detect(path, content);
+}
+
+}
+
+TEST(GrammarRegistryTest, DetectsByExtension) {
+    EXPECT_EQ(detect("src/main.py"), "python");
+    EXPECT_EQ(detect("include/widget.hpp"), "cpp");
+    EXPECT_EQ(detect("include/WIDGET.HPP"), "cpp");
+    EXPECT_EQ(detect("lib/server.go"), "go");
+    EXPECT_EQ(detect("App.java"), "java");
+    EXPECT_EQ(detect("index.js"), "javascript");
+}
+
+TEST(GrammarRegistryTest, DetectsByExactFilename) {
+    EXPECT_EQ(detect("SConstruct"), "python");
+    EXPECT_EQ(detect("build/SConscript"), "python");
+}
+
+TEST(GrammarRegistryTest, UnknownFilesAreText) {
+    EXPECT_EQ(detect("README.md"), "text");
+    EXPECT_EQ(detect("Makefile"), "text");
+    EXPECT_EQ(detect("LICENSE", "MIT License\n\nCopyright"), "text");
+    EXPECT_EQ(detect("notes.txt", "Remember to vim: the config\n"), "text");
+}
+
+TEST(GrammarRegistryTest, DetectsExtensionlessFilesByShebang) {
+    EXPECT_EQ(detect("bin/tool", "#!/usr/bin/python3\nprint('hi')\n"), "python");
+    EXPECT_EQ(detect("bin/tool", "#!/usr/bin/env python3\n"), "python");
+    EXPECT_EQ(detect("bin/tool", "#!/usr/bin/env -S python3 -u\n"), "python");
+    EXPECT_EQ(detect("bin/tool", "#!/usr/bin/env PYTHONPATH=lib python3\n"), "python");
+    // Versioned interpreters fall back to their base name
+    EXPECT_EQ(detect("bin/tool", "#!/usr/local/bin/python3.11\n"), "python");
+    EXPECT_EQ(detect("bin/tool", "#!/bin/sh\nexec python3 \"$@\"\n"), "text");
+    EXPECT_EQ(detect("bin/tool", "#!\n"), "text");
+}
+
+TEST(GrammarRegistryTest, DetectsExtensionlessFilesByModeline) {
+    EXPECT_EQ(detect("tool", "# vim: set ft=python :\nx = 1\n"), "python");
+    EXPECT_EQ(detect("tool", "// vi: filetype=cpp\n"), "cpp");
+    EXPECT_EQ(detect("tool", "// -*- mode: c++ -*-\nint x;\n"), "cpp");
+    EXPECT_EQ(detect("tool", "// -*- go -*-\n"), "go");
+    // Modeline aliases resolve to grammar names
+    EXPECT_EQ(detect("tool", "# vim: ft=py\n"), "python");
+    EXPECT_EQ(detect("tool", "# vim: ft=cobol\n"), "text");
+}
+
+TEST(GrammarRegistryTest, UnknownExtensionsFallBackToContent) {
+    EXPECT_EQ(detect("cgi-bin/tool.cgi", "#!/usr/bin/env python\nprint('hi')\n"), "python");
+    EXPECT_EQ(detect("build.in", "x = 1\n# vim: set ft=python :\n"), "python");
+    // A known extension still wins over the content
+    EXPECT_EQ(detect("main.go", "#!/usr/bin/env python3\n"), "go");
+}
+
+TEST(GrammarRegistryTest, ModelinesAreOnlyReadNearTheEnds) {
+    std::string head = "# vim: ft=python\n";
+    std::string middle;
+    for (int i = 0; i < 20; i++) {
+        middle += (i == 10 ? "# vim: ft=python" : "line " + std::to_string(i)) + "\n";
+    }
+    EXPECT_EQ(detect("tool", head + middle), "python");
+    EXPECT_EQ(detect("tool", middle), "text");
+    EXPECT_EQ(detect("tool", middle + "# vim: ft=go\n"), "go");
+}
+
+TEST(GrammarRegistryTest, FailedPluginLoadsAreRejected) {
+    GrammarRegistry& registry = GrammarRegistry::instance();
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "grammar_registry_test";
+    std::filesystem::create_directories(dir);
+
+    EXPECT_FALSE(registry.loadPlugin((dir / "libtree-sitter-missing.so").string()));
+
+    std::filesystem::path bogus = dir / "libtree-sitter-bogus.so";
+    std::ofstream(bogus) << "not a shared library";
+    std::ofstream(dir / "bogus.extensions") << ".bogus";
+    EXPECT_FALSE(registry.loadPlugin(bogus.string()));
+
+    EXPECT_FALSE(registry.has("missing"));
+    EXPECT_FALSE(registry.has("bogus"));
+    EXPECT_EQ(detect("file.bogus"), "text");
+    std::filesystem::remove_all(dir);
+}
+
+TEST(GrammarRegistryTest, ChunkQueriesAreEmbedded) {
+    GrammarRegistry& registry = GrammarRegistry::instance();
+    EXPECT_NE(registry.chunkQuery("python").find("@split"), std::string::npos);
+    EXPECT_NE(registry.language("python"), nullptr);
+    EXPECT_EQ(registry.language("cobol"), nullptr);
+}
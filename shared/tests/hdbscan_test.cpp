@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include "hdbscan.hpp"
+
+namespace {
+
+// `per_blob` noisy copies of each of `blobs` random directions in `dim` dimensions
+std::vector<std::vector<float>> makeBlobs(int blobs, int per_blob, int dim, float noise, unsigned seed = 7) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    std::vector<std::vector<float>> data;
+    for (int b = 0; b < blobs; b++) {
+        std::vector<float> center(dim);
+        for (float& v : center) v = gauss(rng);
+        for (int p = 0; p < per_blob; p++) {
+            std::vector<float> point(center);
+            for (float& v : point) v += noise * gauss(rng);
+            data.push_back(point);
+        }
+    }
+    return data;
+}
+
+// Cluster numbering depends on tree order, so compare memberships only
+std::set<std::vector<int>> partition(std::vector<std::vector<int>> clusters) {
+    for (auto& cluster : clusters) std::sort(cluster.begin(), cluster.end());
+    return std::set<std::vector<int>>(clusters.begin(), clusters.end());
+}
+
+}
+
+TEST(HDBSCANTest, EmptyInput) {
+    HDBSCANClustering hc(2, 2);
+    hc.fit(std::vector<std::vector<float>>{});
+    EXPECT_TRUE(hc.get_clusters().empty());
+    EXPECT_TRUE(hc.get_labels().empty());
+}
+
+TEST(HDBSCANTest, TooFewPointsAreNoise) {
+    HDBSCANClustering hc(3, 2);
+    hc.fit({{1.0f, 0.0f}, {0.0f, 1.0f}});
+    EXPECT_EQ(hc.get_labels(), (std::vector<int>{-1, -1}));
+    // Noise points come back as singleton clusters
+    EXPECT_EQ(hc.get_clusters().size(), 2u);
+}
+
+TEST(HDBSCANTest, SeparatesWellSeparatedBlobs) {
+    std::vector<std::vector<float>> data = makeBlobs(3, 8, 64, 0.05f);
+    HDBSCANClustering hc(3, 2);
+    hc.fit(data);
+
+    std::vector<int> labels = hc.get_labels();
+    ASSERT_EQ(labels.size(), data.size());
+    for (int b = 0; b < 3; b++) {
+        std::set<int> blob_labels(labels.begin() + b * 8, labels.begin() + (b + 1) * 8);
+        ASSERT_EQ(blob_labels.size(), 1u) << "blob " << b << " was split";
+        EXPECT_NE(*blob_labels.begin(), -1);
+    }
+    EXPECT_NE(labels[0], labels[8]);
+    EXPECT_NE(labels[8], labels[16]);
+    EXPECT_EQ(hc.get_clusters().size(), 3u);
+}
+
+TEST(HDBSCANTest, ScaleInvariantBecauseRowsAreNormalized) {
+    std::vector<std::vector<float>> data = makeBlobs(2, 6, 16, 0.05f);
+    HDBSCANClustering a(3, 2);
+    a.fit(data);
+    for (auto& row : data) {
+        for (float& v : row) v *= 10.0f;
+    }
+    HDBSCANClustering b(3, 2);
+    b.fit(data);
+    EXPECT_EQ(a.get_labels(), b.get_labels());
+}
+
+TEST(HDBSCANTest, OutlierIsNoise) {
+    // Two nearby blobs in the xy-plane and one point along z, far from both
+    std::mt19937 rng(3);
+    std::normal_distribution<float> gauss(0.0f, 0.02f);
+    std::vector<std::vector<float>> data;
+    for (const auto& center : {std::vector<float>{1.0f, 0.0f, 0.0f}, std::vector<float>{0.8f, 0.6f, 0.0f}}) {
+        for (int p = 0; p < 6; p++) {
+            data.push_back({center[0] + gauss(rng), center[1] + gauss(rng), center[2] + gauss(rng)});
+        }
+    }
+    data.push_back({0.0f, 0.0f, 1.0f});
+
+    HDBSCANClustering hc(3, 3);
+    hc.fit(data);
+    std::vector<int> labels = hc.get_labels();
+    EXPECT_EQ(labels.back(), -1);
+    EXPECT_NE(labels[0], -1);
+    EXPECT_NE(labels[6], -1);
+    EXPECT_NE(labels[0], labels[6]);
+}
+
+TEST(HDBSCANTest, DuplicatePointsClusterTogether) {
+    std::vector<std::vector<float>> data(4, {0.0f, 1.0f, 0.0f});
+    for (int i = 0; i < 4; i++) data.push_back({1.0f, 0.0f, 0.0f});
+
+    HDBSCANClustering hc(2, 2);
+    hc.fit(data);
+    std::vector<int> labels = hc.get_labels();
+    EXPECT_EQ(std::set<int>(labels.begin(), labels.begin() + 4).size(), 1u);
+    EXPECT_EQ(std::set<int>(labels.begin() + 4, labels.end()).size(), 1u);
+    EXPECT_NE(labels[0], labels[4]);
+}
+
+TEST(HDBSCANTest, ApproximatePathMatchesExactOnSeparatedBlobs) {
+    std::vector<std::vector<float>> data = makeBlobs(5, 40, 32, 0.1f);
+    HDBSCANClustering exact(5, 3);
+    exact.fit(data);
+
+    // exact_limit = 0 forces the HNSW k-NN graph path
+    HDBSCANClustering approximate(5, 3, 0);
+    approximate.fit(data);
+    EXPECT_TRUE(approximate.is_approximate(data.size()));
+
+    EXPECT_EQ(exact.get_clusters().size(), 5u);
+    EXPECT_EQ(partition(approximate.get_clusters()), partition(exact.get_clusters()));
+}
+
+TEST(HDBSCANTest, ApproximatePathReusesPrebuiltIndex) {
+    std::vector<std::vector<float>> data = makeBlobs(3, 30, 16, 0.05f);
+    EmbeddingMatrix matrix = EmbeddingMatrix::fromRows(data);
+    matrix.normalizeRows();
+    HNSWIndex index(matrix);
+    index.build();
+
+    HDBSCANClustering hc(5, 3, 0);
+    hc.fit(matrix, &index);
+    EXPECT_EQ(hc.get_clusters().size(), 3u);
+}
+
+TEST(HDBSCANTest, QuantizedDistancesKeepClusters) {
+    std::vector<std::vector<float>> data = makeBlobs(4, 12, 256, 0.3f);
+    HDBSCANClustering exact(4, 3);
+    exact.fit(data);
+    ASSERT_EQ(exact.get_clusters().size(), 4u);
+
+    for (Quantization kind : {Quantization::Int8, Quantization::Float16}) {
+        for (bool rerank : {true, false}) {
+            HDBSCANClustering quantized(4, 3);
+            quantized.set_quantization(kind, rerank);
+            quantized.fit(data);
+            EXPECT_EQ(partition(quantized.get_clusters()), partition(exact.get_clusters()))
+                << quantizationName(kind) << (rerank ? " with rerank" : "");
+        }
+    }
+}
+
+TEST(HDBSCANTest, IncrementalInsertMatchesFullFit) {
+    std::vector<std::vector<float>> data = makeBlobs(4, 20, 32, 0.4f, 11);
+    std::mt19937 rng(5);
+    std::shuffle(data.begin(), data.end(), rng);
+
+    // The first 72 points were seen by the previous run, in a different order
+    std::vector<std::vector<float>> before(data.begin(), data.begin() + 72);
+    std::reverse(before.begin(), before.end());
+    HDBSCANClustering previous(4, 3);
+    previous.fit(before);
+
+    std::vector<int> previous_row(data.size(), -1);
+    for (int i = 0; i < 72; i++) previous_row[i] = 71 - i;
+    EmbeddingMatrix matrix = EmbeddingMatrix::fromRows(data);
+    matrix.normalizeRows();
+
+    HDBSCANClustering incremental(4, 3);
+    EXPECT_TRUE(incremental.fit_incremental(matrix, previous.get_model(), previous_row));
+    HDBSCANClustering full(4, 3);
+    full.fit(matrix);
+
+    auto total_weight = [](const HDBSCANModel& model) {
+        double total = 0.0;
+        for (const ReachabilityEdge& edge : model.mst) total += edge.weight;
+        return total;
+    };
+    EXPECT_EQ(incremental.get_model().mst.size(), data.size() - 1);
+    EXPECT_NEAR(total_weight(incremental.get_model()), total_weight(full.get_model()), 1e-4);
+    EXPECT_EQ(incremental.get_model().nearest, full.get_model().nearest);
+    EXPECT_EQ(partition(incremental.get_clusters()), partition(full.get_clusters()));
+}
+
+TEST(HDBSCANTest, IncrementalFallsBackPastTheExactBudget) {
+    std::vector<std::vector<float>> data = makeBlobs(4, 20, 32, 0.4f, 11);
+    std::vector<std::vector<float>> before(data.begin(), data.begin() + 72);
+    HDBSCANClustering previous(4, 3);
+    previous.fit(before);
+
+    std::vector<int> previous_row(data.size(), -1);
+    for (int i = 0; i < 72; i++) previous_row[i] = i;
+    EmbeddingMatrix matrix = EmbeddingMatrix::fromRows(data);
+    matrix.normalizeRows();
+
+    // 8 new rows x 80 distances each is more than 20^2
+    HDBSCANClustering tight(4, 3, 20);
+    EXPECT_FALSE(tight.fit_incremental(matrix, previous.get_model(), previous_row));
+    HDBSCANClustering full(4, 3, 20);
+    full.fit(matrix);
+    EXPECT_EQ(tight.get_labels(), full.get_labels());
+
+    HDBSCANClustering roomy(4, 3, 40);
+    EXPECT_TRUE(roomy.fit_incremental(matrix, previous.get_model(), previous_row));
+}
+
+TEST(HDBSCANTest, IncrementalFallsBackWhenRowsDisappear) {
+    std::vector<std::vector<float>> data = makeBlobs(3, 8, 16, 0.05f);
+    HDBSCANClustering previous(3, 2);
+    previous.fit(data);
+
+    // Row 0 of the previous run is gone
+    std::vector<std::vector<float>> after(data.begin() + 1, data.end());
+    std::vector<int> previous_row(after.size());
+    for (size_t i = 0; i < after.size(); i++) previous_row[i] = static_cast<int>(i + 1);
+    EmbeddingMatrix matrix = EmbeddingMatrix::fromRows(after);
+    matrix.normalizeRows();
+
+    HDBSCANClustering incremental(3, 2);
+    EXPECT_FALSE(incremental.fit_incremental(matrix, previous.get_model(), previous_row));
+    HDBSCANClustering full(3, 2);
+    full.fit(matrix);
+    EXPECT_EQ(incremental.get_labels(), full.get_labels());
+}
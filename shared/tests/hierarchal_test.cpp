@@ -1,4 +1,8 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
 #include "hierarchal.hpp"
 
 class HierarchicalClusteringTest : public ::testing::Test {
@@ -16,7 +20,7 @@ TEST_F(HierarchicalClusteringTest, EmptyInput) {
     hc->cluster(embeddings, 0.5f);
     std::vector<std::vector<int>> clusters = hc->get_clusters();
 
-    EXPECT_EQ(clusters.size(), 0);
+    EXPECT_EQ(clusters.size(), 0u);
 }
 
 TEST_F(HierarchicalClusteringTest, SingleElement) {
@@ -27,8 +31,8 @@ TEST_F(HierarchicalClusteringTest, SingleElement) {
     hc->cluster(embeddings, 0.5f);
     std::vector<std::vector<int>> clusters = hc->get_clusters();
 
-    ASSERT_EQ(clusters.size(), 1);
-    EXPECT_EQ(clusters[0].size(), 1);
+    ASSERT_EQ(clusters.size(), 1u);
+    EXPECT_EQ(clusters[0].size(), 1u);
     EXPECT_EQ(clusters[0][0], 0);
 }
 
@@ -42,8 +46,8 @@ TEST_F(HierarchicalClusteringTest, TwoIdenticalVectorsMerge) {
     std::vector<std::vector<int>> clusters = hc->get_clusters();
 
     // Identical vectors should merge into one cluster
-    ASSERT_EQ(clusters.size(), 1);
-    EXPECT_EQ(clusters[0].size(), 2);
+    ASSERT_EQ(clusters.size(), 1u);
+    EXPECT_EQ(clusters[0].size(), 2u);
 }
 
 TEST_F(HierarchicalClusteringTest, TwoOrthogonalVectorsStaySeparate) {
@@ -56,7 +60,7 @@ TEST_F(HierarchicalClusteringTest, TwoOrthogonalVectorsStaySeparate) {
     hc->cluster(embeddings, 0.5f);
     std::vector<std::vector<int>> clusters = hc->get_clusters();
 
-    EXPECT_EQ(clusters.size(), 2);
+    EXPECT_EQ(clusters.size(), 2u);
 }
 
 TEST_F(HierarchicalClusteringTest, ThreeVectorsTwoSimilar) {
@@ -70,7 +74,7 @@ TEST_F(HierarchicalClusteringTest, ThreeVectorsTwoSimilar) {
     std::vector<std::vector<int>> clusters = hc->get_clusters();
 
     // First two should cluster, third stays separate
-    EXPECT_EQ(clusters.size(), 2);
+    EXPECT_EQ(clusters.size(), 2u);
 }
 
 TEST_F(HierarchicalClusteringTest, HighThresholdMergesAll) {
@@ -84,8 +88,8 @@ TEST_F(HierarchicalClusteringTest, HighThresholdMergesAll) {
     hc->cluster(embeddings, 2.0f);
     std::vector<std::vector<int>> clusters = hc->get_clusters();
 
-    ASSERT_EQ(clusters.size(), 1);
-    EXPECT_EQ(clusters[0].size(), 3);
+    ASSERT_EQ(clusters.size(), 1u);
+    EXPECT_EQ(clusters[0].size(), 3u);
 }
 
 TEST_F(HierarchicalClusteringTest, ZeroThresholdKeepsSeparate) {
@@ -98,7 +102,7 @@ TEST_F(HierarchicalClusteringTest, ZeroThresholdKeepsSeparate) {
     hc->cluster(embeddings, 0.0f);
     std::vector<std::vector<int>> clusters = hc->get_clusters();
 
-    EXPECT_EQ(clusters.size(), 2);
+    EXPECT_EQ(clusters.size(), 2u);
 }
 
 TEST_F(HierarchicalClusteringTest, ClusterIndicesAreCorrect) {
@@ -119,8 +123,120 @@ TEST_F(HierarchicalClusteringTest, ClusterIndicesAreCorrect) {
         }
     }
 
-    EXPECT_EQ(all_indices.size(), 3);
+    EXPECT_EQ(all_indices.size(), 3u);
     EXPECT_TRUE(all_indices.count(0));
     EXPECT_TRUE(all_indices.count(1));
     EXPECT_TRUE(all_indices.count(2));
 }
+
+namespace {
+
+EmbeddingMatrix randomUnitMatrix(size_t rows, size_t cols, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    EmbeddingMatrix m(rows, cols);
+    for (float& v : m.data) v = gauss(rng);
+    m.normalizeRows();
+    return m;
+}
+
+// Textbook O(n^3) agglomeration that recomputes every linkage from member
+// pairs; returns merge heights in the order they happen.
+std::vector<float> naiveMergeHeights(const EmbeddingMatrix& m, Linkage linkage) {
+    auto dist = [&](int a, int b) {
+        float dot = 0.0f;
+        for (size_t d = 0; d < m.cols; d++) dot += m.row(a)[d] * m.row(b)[d];
+        return std::max(0.0f, 1.0f - dot);
+    };
+    std::vector<std::vector<int>> clusters;
+    for (size_t i = 0; i < m.rows; i++) clusters.push_back({static_cast<int>(i)});
+
+    std::vector<float> heights;
+    while (clusters.size() > 1) {
+        float best = INFINITY;
+        size_t bi = 0, bj = 0;
+        for (size_t i = 0; i < clusters.size(); i++) {
+            for (size_t j = i + 1; j < clusters.size(); j++) {
+                float lo = INFINITY, hi = 0.0f, sum = 0.0f;
+                for (int p : clusters[i]) {
+                    for (int q : clusters[j]) {
+                        float d = dist(p, q);
+                        lo = std::min(lo, d);
+                        hi = std::max(hi, d);
+                        sum += d;
+                    }
+                }
+                float d = linkage == Linkage::Single ? lo
+                        : linkage == Linkage::Complete ? hi
+                        : sum / (clusters[i].size() * clusters[j].size());
+                if (d < best) {
+                    best = d;
+                    bi = i;
+                    bj = j;
+                }
+            }
+        }
+        heights.push_back(best);
+        clusters[bi].insert(clusters[bi].end(), clusters[bj].begin(), clusters[bj].end());
+        clusters.erase(clusters.begin() + bj);
+    }
+    return heights;
+}
+
+}
+
+TEST(HierarchicalLinkageTest, ParsesNames) {
+    EXPECT_EQ(parseLinkage("single"), Linkage::Single);
+    EXPECT_EQ(parseLinkage("complete"), Linkage::Complete);
+    EXPECT_EQ(parseLinkage("average"), Linkage::Average);
+    EXPECT_THROW(parseLinkage("ward"), std::invalid_argument);
+    EXPECT_EQ(linkageName(Linkage::Complete), "complete");
+}
+
+TEST(HierarchicalLinkageTest, MatchesNaiveAgglomeration) {
+    EmbeddingMatrix m = randomUnitMatrix(40, 16, 7);
+    for (Linkage linkage : {Linkage::Single, Linkage::Complete, Linkage::Average}) {
+        HierachicalClustering hc(linkage);
+        hc.fit(m);
+        const std::vector<DendrogramNode>& dendrogram = hc.get_dendrogram();
+        std::vector<float> expected = naiveMergeHeights(m, linkage);
+        ASSERT_EQ(dendrogram.size(), expected.size()) << linkageName(linkage);
+        for (size_t k = 0; k < expected.size(); k++) {
+            EXPECT_NEAR(dendrogram[k].distance, expected[k], 1e-4f) << linkageName(linkage) << " merge " << k;
+        }
+    }
+}
+
+TEST(HierarchicalLinkageTest, DendrogramUsesLinkageMatrixIds) {
+    EmbeddingMatrix m = randomUnitMatrix(25, 8, 3);
+    HierachicalClustering hc(Linkage::Average);
+    hc.fit(m);
+    const std::vector<DendrogramNode>& dendrogram = hc.get_dendrogram();
+    ASSERT_EQ(dendrogram.size(), 24u);
+
+    std::set<int> used;
+    for (size_t k = 0; k < dendrogram.size(); k++) {
+        const DendrogramNode& node = dendrogram[k];
+        EXPECT_LT(node.left, node.right);
+        EXPECT_LT(node.right, static_cast<int>(25 + k)) << "children must exist before their parent";
+        EXPECT_TRUE(used.insert(node.left).second);
+        EXPECT_TRUE(used.insert(node.right).second);
+        if (k > 0) {
+            EXPECT_GE(node.distance, dendrogram[k - 1].distance);
+        }
+    }
+    EXPECT_EQ(dendrogram.back().size, 25);
+}
+
+TEST(HierarchicalLinkageTest, CutMatchesCluster) {
+    EmbeddingMatrix m = randomUnitMatrix(30, 8, 5);
+    HierachicalClustering hc(Linkage::Complete);
+    hc.fit(m);
+    for (float threshold : {0.2f, 0.6f, 1.0f, 2.0f}) {
+        HierachicalClustering fresh(Linkage::Complete);
+        fresh.cluster(m, threshold);
+        EXPECT_EQ(hc.cut(threshold), fresh.get_clusters());
+    }
+    EXPECT_EQ(hc.cut(2.0f).size(), 1u);
+    EXPECT_EQ(hc.cut(-1.0f).size(), 30u);
+}
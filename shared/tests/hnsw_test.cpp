@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <set>
+#include "hnsw.hpp"
+#include "distance.hpp"
+
+namespace {
+
+EmbeddingMatrix randomUnitMatrix(size_t rows, size_t cols, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    EmbeddingMatrix m(rows, cols);
+    for (float& v : m.data) v = gauss(rng);
+    m.normalizeRows();
+    return m;
+}
+
+std::vector<int> bruteForce(const EmbeddingMatrix& m, size_t query, size_t k) {
+    std::vector<std::pair<float, int>> all;
+    std::span<const float> q(m.row(query), m.cols);
+    for (size_t i = 0; i < m.rows; i++) {
+        if (i == query) continue;
+        all.push_back({-dot_product(q, std::span<const float>(m.row(i), m.cols)), static_cast<int>(i)});
+    }
+    std::partial_sort(all.begin(), all.begin() + k, all.end());
+    std::vector<int> ids;
+    for (size_t i = 0; i < k; i++) ids.push_back(all[i].second);
+    return ids;
+}
+
+double recall(const EmbeddingMatrix& m, const std::vector<std::vector<std::pair<int, float>>>& knn, size_t k) {
+    size_t hits = 0;
+    for (size_t i = 0; i < m.rows; i++) {
+        std::vector<int> truth = bruteForce(m, i, k);
+        std::set<int> expected(truth.begin(), truth.end());
+        for (const auto& [id, dist] : knn[i]) hits += expected.count(id);
+    }
+    return static_cast<double>(hits) / (m.rows * k);
+}
+
+}
+
+TEST(HNSWTest, EmptyIndex) {
+    EmbeddingMatrix m(0, 8);
+    HNSWIndex index(m);
+    index.build();
+    std::vector<float> q(8, 0.5f);
+    EXPECT_TRUE(index.search(q, 5).empty());
+    EXPECT_TRUE(index.knnAll(5).empty());
+}
+
+TEST(HNSWTest, SingleRowHasNoOtherNeighbors) {
+    EmbeddingMatrix m = randomUnitMatrix(1, 8, 1);
+    HNSWIndex index(m);
+    index.build();
+    std::vector<std::vector<std::pair<int, float>>> knn = index.knnAll(3);
+    ASSERT_EQ(knn.size(), 1u);
+    EXPECT_TRUE(knn[0].empty());
+    ASSERT_EQ(index.search(std::span<const float>(m.row(0), m.cols), 1).size(), 1u);
+}
+
+TEST(HNSWTest, FindsExactMatchWithZeroDistance) {
+    EmbeddingMatrix m = randomUnitMatrix(500, 16, 2);
+    HNSWIndex index(m);
+    index.build();
+    std::vector<std::pair<int, float>> found = index.search(std::span<const float>(m.row(123), m.cols), 1);
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(found[0].first, 123);
+    EXPECT_NEAR(found[0].second, 0.0f, 1e-3);
+}
+
+TEST(HNSWTest, KnnAllHasHighRecallAndExcludesSelf) {
+    EmbeddingMatrix m = randomUnitMatrix(2000, 24, 3);
+    HNSWOptions options;
+    options.num_threads = 4;
+    HNSWIndex index(m, options);
+    index.build();
+
+    const size_t k = 10;
+    std::vector<std::vector<std::pair<int, float>>> knn = index.knnAll(k);
+    for (size_t i = 0; i < knn.size(); i++) {
+        ASSERT_EQ(knn[i].size(), k);
+        for (size_t j = 0; j < k; j++) {
+            EXPECT_NE(knn[i][j].first, static_cast<int>(i));
+            if (j > 0) {
+                EXPECT_LE(knn[i][j - 1].second, knn[i][j].second);
+            }
+        }
+    }
+    EXPECT_GT(recall(m, knn, k), 0.9);
+}
+
+TEST(HNSWTest, LargerEfImprovesRecall) {
+    EmbeddingMatrix m = randomUnitMatrix(1500, 32, 4);
+    HNSWOptions options;
+    options.M = 4;
+    options.ef_construction = 16;
+    HNSWIndex index(m, options);
+    index.build();
+
+    double low = recall(m, index.knnAll(10, 10), 10);
+    double high = recall(m, index.knnAll(10, 200), 10);
+    EXPECT_GE(high, low);
+    EXPECT_GT(high, 0.9);
+}
+
+TEST(HNSWTest, QuantizedIndexWithRerankKeepsRecall) {
+    EmbeddingMatrix m = randomUnitMatrix(1500, 64, 5);
+    for (Quantization kind : {Quantization::Int8, Quantization::Float16}) {
+        HNSWOptions options;
+        options.quantization = kind;
+        HNSWIndex index(m, options);
+        index.build();
+        EXPECT_GT(recall(m, index.knnAll(10), 10), 0.9) << quantizationName(kind);
+    }
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include "hybrid_distance.hpp"
+#include "hdbscan.hpp"
+
+namespace {
+
+DiffChunk makeChunk(const std::string& filepath, const std::string& changed, std::vector<std::string> symbols = {}) {
+    DiffChunk chunk;
+    chunk.filepath = filepath;
+    chunk.old_filepath = filepath;
+    chunk.lines.push_back({INSERTION, changed, 1});
+    std::vector<std::string_view> lines = {changed};
+    chunk.fingerprint = makeFingerprint(filepath, lines, std::move(symbols));
+    return chunk;
+}
+
+float combined(const HybridDistance& distance, size_t i, size_t j, float embedding = 1.0f) {
+    distance.adjust(i, j, 1, &embedding);
+    return embedding;
+}
+
+}
+
+TEST(HybridDistanceTest, CloserDirectoriesAreCloser) {
+    std::vector<DiffChunk> chunks = {
+        makeChunk("src/net/socket.cpp", "alpha"),
+        makeChunk("src/net/socket.cpp", "bravo"),
+        makeChunk("src/net/http.cpp", "charlie"),
+        makeChunk("docs/guide/intro.md", "delta"),
+    };
+    HybridDistance distance(chunks);
+
+    float same_file = combined(distance, 0, 1);
+    float same_dir = combined(distance, 0, 2);
+    float far = combined(distance, 0, 3);
+    EXPECT_LT(same_file, same_dir);
+    EXPECT_LT(same_dir, far);
+    EXPECT_FLOAT_EQ(combined(distance, 3, 0), far);
+}
+
+TEST(HybridDistanceTest, SharedIdentifiersReduceDistance) {
+    std::vector<DiffChunk> chunks = {
+        makeChunk("a.cpp", "retryPolicy backoffMillis maxAttempts"),
+        makeChunk("b.cpp", "retryPolicy backoffMillis maxAttempts"),
+        makeChunk("c.cpp", "renderFrame swapBuffers vsyncEnabled"),
+    };
+    HybridWeights weights;
+    weights.boilerplate_fraction = 1.0f;
+    HybridDistance distance(chunks, weights);
+
+    EXPECT_NEAR(combined(distance, 0, 2) - combined(distance, 0, 1), weights.identifiers, 1e-6f);
+}
+
+TEST(HybridDistanceTest, BoilerplateIdentifiersAreIgnored) {
+    std::vector<DiffChunk> chunks;
+    for (int i = 0; i < 20; i++) {
+        chunks.push_back(makeChunk("f" + std::to_string(i) + ".cpp", "loggerInstance unique" + std::to_string(i)));
+    }
+    HybridDistance distance(chunks);
+
+    // loggerInstance is in every chunk, so it doesn't count as shared
+    EXPECT_FLOAT_EQ(combined(distance, 0, 1), combined(distance, 0, 2));
+    EXPECT_FLOAT_EQ(combined(distance, 0, 1), 1.0f + HybridWeights().path * 2.0f / 4.0f + HybridWeights().identifiers);
+}
+
+TEST(HybridDistanceTest, SameDeclarationAndNeighboringSiblingsAreAdjacent) {
+    std::vector<DiffChunk> chunks = {
+        makeChunk("a.cpp", "one", {"Parser", "parseHeader"}),
+        makeChunk("a.cpp", "two", {"Parser", "parseBody"}),
+        makeChunk("a.cpp", "three", {"Lexer", "nextToken"}),
+        makeChunk("a.cpp", "four", {"Parser", "parseHeader"}),
+    };
+    HybridDistance distance(chunks);
+    float adjacency = HybridWeights().adjacency;
+
+    EXPECT_NEAR(combined(distance, 2, 3) - combined(distance, 0, 3), adjacency, 1e-6f);  // same declaration
+    EXPECT_NEAR(combined(distance, 1, 3) - combined(distance, 0, 1), adjacency, 1e-6f);  // neighboring siblings
+    EXPECT_FLOAT_EQ(combined(distance, 1, 2), combined(distance, 1, 3));  // different scope, not adjacent
+}
+
+TEST(HybridDistanceTest, TiledAdjustMatchesSinglePairs) {
+    std::vector<DiffChunk> chunks;
+    for (int i = 0; i < 150; i++) {
+        chunks.push_back(makeChunk("dir" + std::to_string(i % 7) + "/file" + std::to_string(i % 11) + ".cpp",
+                                   "shared" + std::to_string(i % 9) + " token" + std::to_string(i % 5),
+                                   {"fn" + std::to_string(i % 13)}));
+    }
+    HybridDistance distance(chunks);
+
+    std::vector<float> row(150, 0.7f);
+    distance.adjust(3, 5, 145, row.data() + 5);
+    for (size_t j = 5; j < 150; j++) {
+        EXPECT_FLOAT_EQ(row[j], combined(distance, 3, j, 0.7f)) << "column " << j;
+    }
+}
+
+TEST(HybridDistanceTest, HDBSCANUsesCombinedDistance) {
+    // Identical embeddings: only the structure can separate the two files
+    std::vector<DiffChunk> chunks;
+    for (int i = 0; i < 6; i++) chunks.push_back(makeChunk("left/a.cpp", "x" + std::to_string(i), {"f"}));
+    for (int i = 0; i < 6; i++) chunks.push_back(makeChunk("right/deep/b.cpp", "y" + std::to_string(i), {"g"}));
+    EmbeddingMatrix data(12, 4);
+    for (size_t i = 0; i < 12; i++) data.row(i)[0] = 1.0f;
+
+    HybridDistance distance(chunks);
+    HDBSCANClustering hc(3, 2);
+    hc.set_pair_distance(&distance);
+    hc.fit(data);
+
+    std::vector<int> labels = hc.get_labels();
+    EXPECT_EQ(std::set<int>(labels.begin(), labels.begin() + 6).size(), 1u);
+    EXPECT_EQ(std::set<int>(labels.begin() + 6, labels.end()).size(), 1u);
+    EXPECT_NE(labels[0], labels[6]);
+    EXPECT_NE(labels[0], -1);
+}
+
+TEST(HybridDistanceTest, FitPrecomputedMatchesFit) {
+    std::mt19937 rng(4);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    EmbeddingMatrix data(30, 8);
+    for (size_t i = 0; i < 30; i++) {
+        for (size_t d = 0; d < 8; d++) data.row(i)[d] = (d == i % 3 ? 4.0f : 0.0f) + gauss(rng) * 0.2f;
+    }
+    data.normalizeRows();
+
+    std::vector<float> dense(30 * 30);
+    for (size_t i = 0; i < 30; i++) {
+        for (size_t j = 0; j < 30; j++) {
+            float dot = 0.0f;
+            for (size_t d = 0; d < 8; d++) dot += data.row(i)[d] * data.row(j)[d];
+            dense[i * 30 + j] = i == j ? 0.0f : std::sqrt(std::max(0.0f, 2.0f - 2.0f * dot));
+        }
+    }
+
+    HDBSCANClustering a(3, 2);
+    HDBSCANClustering b(3, 2);
+    a.fit(data);
+    b.fit_precomputed(dense, 30);
+    EXPECT_EQ(a.get_labels(), b.get_labels());
+}
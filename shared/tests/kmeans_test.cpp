@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <set>
+#include "kmeans.hpp"
+
+namespace {
+
+// `per_blob` noisy copies of each of `blobs` random directions, unit-normalized
+EmbeddingMatrix makeBlobs(int blobs, int per_blob, int dim, float noise, unsigned seed = 7) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    EmbeddingMatrix data(blobs * per_blob, dim);
+    for (int b = 0; b < blobs; b++) {
+        std::vector<float> center(dim);
+        for (float& v : center) v = gauss(rng);
+        for (int p = 0; p < per_blob; p++) {
+            float* row = data.row(b * per_blob + p);
+            for (int d = 0; d < dim; d++) row[d] = center[d] + noise * gauss(rng);
+        }
+    }
+    data.normalizeRows();
+    return data;
+}
+
+// Points of the same blob share a label and blobs don't share labels
+void expectBlobsRecovered(const std::vector<int>& labels, int blobs, int per_blob) {
+    ASSERT_EQ(labels.size(), static_cast<size_t>(blobs * per_blob));
+    std::set<int> seen;
+    for (int b = 0; b < blobs; b++) {
+        std::set<int> blob_labels(labels.begin() + b * per_blob, labels.begin() + (b + 1) * per_blob);
+        ASSERT_EQ(blob_labels.size(), 1u) << "blob " << b << " was split";
+        EXPECT_TRUE(seen.insert(*blob_labels.begin()).second) << "blob " << b << " was merged";
+    }
+}
+
+}
+
+TEST(KMeansTest, EmptyInput) {
+    KMeans km(3);
+    km.fit(EmbeddingMatrix());
+    EXPECT_TRUE(km.get_labels().empty());
+    EXPECT_TRUE(km.get_clusters().empty());
+}
+
+TEST(KMeansTest, MoreClustersThanPoints) {
+    EmbeddingMatrix data = makeBlobs(1, 3, 8, 0.5f);
+    KMeans km(10);
+    km.fit(data);
+    EXPECT_EQ(km.get_clusters().size(), 3u);
+    EXPECT_NEAR(km.get_inertia(), 0.0f, 1e-5f);
+}
+
+TEST(KMeansTest, DuplicatePointsStillFillEveryCluster) {
+    // Two distinct points for four clusters: seeding has to repeat a center
+    EmbeddingMatrix data(12, 4);
+    for (size_t i = 0; i < data.rows; i++) data.row(i)[i < 10 ? 0 : 1] = 1.0f;
+    for (size_t batch_size : {size_t(1024), size_t(4)}) {
+        KMeansOptions options;
+        options.batch_size = batch_size;
+        KMeans km(4, options);
+        km.fit(data);
+        EXPECT_EQ(km.get_clusters().size(), 4u) << "batch_size " << batch_size;
+    }
+}
+
+TEST(KMeansTest, ReturnsKClustersWhenKExceedsBlobCount) {
+    EmbeddingMatrix data = makeBlobs(2, 30, 16, 0.05f);
+    for (size_t k = 2; k <= 12; k++) {
+        KMeans km(static_cast<int>(k));
+        km.fit(data);
+        EXPECT_EQ(km.get_clusters().size(), k);
+    }
+}
+
+TEST(KMeansTest, LloydRecoversBlobs) {
+    EmbeddingMatrix data = makeBlobs(4, 20, 32, 0.1f);
+    KMeans km(4);
+    km.fit(data);
+    expectBlobsRecovered(km.get_labels(), 4, 20);
+    EXPECT_EQ(km.get_clusters().size(), 4u);
+}
+
+TEST(KMeansTest, MiniBatchRecoversBlobs) {
+    EmbeddingMatrix data = makeBlobs(5, 400, 32, 0.1f);
+    KMeansOptions options;
+    options.batch_size = 256;
+    KMeans km(5, options);
+    km.fit(data);
+    expectBlobsRecovered(km.get_labels(), 5, 400);
+}
+
+TEST(KMeansTest, PredictMatchesFitLabels) {
+    EmbeddingMatrix data = makeBlobs(3, 10, 16, 0.1f);
+    KMeans km(3);
+    km.fit(data);
+    std::vector<int> labels = km.get_labels();
+    for (size_t i = 0; i < data.rows; i++) {
+        EXPECT_EQ(km.predict(std::span<const float>(data.row(i), data.cols)), labels[i]);
+    }
+}
+
+TEST(KMeansTest, DeterministicForSeed) {
+    EmbeddingMatrix data = makeBlobs(3, 30, 16, 0.4f);
+    KMeans a(5);
+    KMeans b(5);
+    a.fit(data);
+    b.fit(data);
+    EXPECT_EQ(a.get_labels(), b.get_labels());
+}
+
+TEST(KMeansTest, SilhouettePrefersTrueLabels) {
+    EmbeddingMatrix data = makeBlobs(3, 15, 16, 0.1f);
+    std::vector<int> truth(data.rows);
+    std::vector<int> shuffled(data.rows);
+    for (size_t i = 0; i < data.rows; i++) {
+        truth[i] = static_cast<int>(i / 15);
+        shuffled[i] = static_cast<int>(i % 3);
+    }
+    EXPECT_GT(silhouetteScore(data, truth), 0.5f);
+    EXPECT_LT(silhouetteScore(data, shuffled), 0.0f);
+    EXPECT_EQ(silhouetteScore(data, std::vector<int>(data.rows, 0)), 0.0f);
+}
+
+TEST(KMeansTest, SelectKFindsBlobCount) {
+    EmbeddingMatrix data = makeBlobs(4, 12, 16, 0.1f);
+    std::vector<float> scores;
+    KMeans km = selectK(data, 2, 8, {}, &scores);
+    EXPECT_EQ(scores.size(), 7u);
+    expectBlobsRecovered(km.get_labels(), 4, 12);
+}
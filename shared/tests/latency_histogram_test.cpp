@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "latency_histogram.hpp"
+
+TEST(LatencyHistogramTest, EmptyHistogramReportsZero) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.count(), 0u);
+    EXPECT_EQ(histogram.percentile(50), 0u);
+    EXPECT_EQ(histogram.min_value(), 0u);
+    EXPECT_EQ(histogram.max_value(), 0u);
+    EXPECT_EQ(histogram.mean(), 0.0);
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+    LatencyHistogram histogram;
+    for (uint64_t v = 1; v <= 50; v++) histogram.record(v);
+    EXPECT_EQ(histogram.count(), 50u);
+    EXPECT_EQ(histogram.min_value(), 1u);
+    EXPECT_EQ(histogram.max_value(), 50u);
+    EXPECT_EQ(histogram.percentile(50), 25u);
+    EXPECT_EQ(histogram.percentile(100), 50u);
+    EXPECT_DOUBLE_EQ(histogram.mean(), 25.5);
+}
+
+TEST(LatencyHistogramTest, PercentilesWithinBucketPrecision) {
+    std::mt19937_64 rng(11);
+    std::lognormal_distribution<double> latency(std::log(50000.0), 1.0);
+    LatencyHistogram histogram;
+    std::vector<uint64_t> values;
+    for (int i = 0; i < 20000; i++) {
+        uint64_t v = static_cast<uint64_t>(latency(rng));
+        values.push_back(v);
+        histogram.record(v);
+    }
+    std::sort(values.begin(), values.end());
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        uint64_t exact = values[static_cast<size_t>(std::ceil(p / 100.0 * values.size())) - 1];
+        double error = std::abs(static_cast<double>(histogram.percentile(p)) - exact) / exact;
+        EXPECT_LT(error, 1.0 / 32) << "p" << p;
+    }
+    EXPECT_EQ(histogram.max_value(), values.back());
+}
+
+TEST(LatencyHistogramTest, HugeValuesAreClampedNotLost) {
+    LatencyHistogram histogram;
+    histogram.record(UINT64_MAX / 2);
+    histogram.record(10);
+    EXPECT_EQ(histogram.count(), 2u);
+    EXPECT_EQ(histogram.percentile(100), UINT64_MAX / 2);
+}
+
+TEST(LatencyHistogramTest, MergeMatchesRecordingEverything) {
+    LatencyHistogram a, b, both;
+    for (uint64_t v = 100; v < 5000; v += 7) {
+        (v % 2 ? a : b).record(v);
+        both.record(v);
+    }
+    a.merge(b);
+    EXPECT_EQ(a.count(), both.count());
+    EXPECT_EQ(a.min_value(), both.min_value());
+    EXPECT_EQ(a.max_value(), both.max_value());
+    for (double p : {10.0, 50.0, 95.0}) EXPECT_EQ(a.percentile(p), both.percentile(p));
+}
+
+TEST(LatencyHistogramTest, RecordsDurationsInMicroseconds) {
+    LatencyHistogram histogram;
+    histogram.record(std::chrono::steady_clock::duration(std::chrono::milliseconds(3)));
+    EXPECT_EQ(histogram.max_value(), 3000u);
+}
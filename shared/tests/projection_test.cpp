@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include "projection.hpp"
+#include "distance.hpp"
+
+namespace {
+
+EmbeddingMatrix randomUnitMatrix(size_t rows, size_t cols, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    EmbeddingMatrix m(rows, cols);
+    for (float& v : m.data) v = gauss(rng);
+    m.normalizeRows();
+    return m;
+}
+
+}
+
+TEST(ProjectionTest, SameSeedGivesSameProjection) {
+    EmbeddingMatrix m = randomUnitMatrix(5, 1536, 1);
+    RandomProjection a(1536, 256, 7);
+    RandomProjection b(1536, 256, 7);
+    RandomProjection c(1536, 256, 8);
+    std::span<const float> row(m.row(0), m.cols);
+    EXPECT_EQ(a.project(row), b.project(row));
+    EXPECT_NE(a.project(row), c.project(row));
+}
+
+TEST(ProjectionTest, OutputIsUnitLength) {
+    EmbeddingMatrix m = randomUnitMatrix(10, 1536, 2);
+    EmbeddingMatrix projected = RandomProjection(1536, 128).project(m);
+    ASSERT_EQ(projected.rows, 10u);
+    ASSERT_EQ(projected.cols, 128u);
+    for (size_t i = 0; i < projected.rows; i++) {
+        std::span<const float> row(projected.row(i), projected.cols);
+        EXPECT_NEAR(dot_product(row, row), 1.0f, 1e-4f);
+    }
+}
+
+TEST(ProjectionTest, ApproximatelyPreservesCosine) {
+    // Pairs with a spread of similarities: a base vector mixed with noise
+    std::mt19937 rng(3);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    EmbeddingMatrix m(40, 1536);
+    std::vector<float> base(1536);
+    for (float& v : base) v = gauss(rng);
+    for (size_t i = 0; i < m.rows; i++) {
+        float mix = static_cast<float>(i) / m.rows;
+        for (size_t d = 0; d < m.cols; d++) {
+            m.row(i)[d] = (1.0f - mix) * base[d] + mix * gauss(rng);
+        }
+    }
+    m.normalizeRows();
+
+    EmbeddingMatrix projected = RandomProjection(1536, 256).project(m);
+    float worst = 0.0f;
+    for (size_t i = 0; i < m.rows; i++) {
+        for (size_t j = i + 1; j < m.rows; j++) {
+            float exact = dot_product(std::span<const float>(m.row(i), m.cols), std::span<const float>(m.row(j), m.cols));
+            float approx = dot_product(std::span<const float>(projected.row(i), projected.cols),
+                                       std::span<const float>(projected.row(j), projected.cols));
+            worst = std::max(worst, std::abs(exact - approx));
+        }
+    }
+    EXPECT_LT(worst, 0.2f);
+}
+
+TEST(ProjectionTest, ReduceLeavesShortAndEmptyRowsAlone) {
+    EmbeddingMatrix m = randomUnitMatrix(2, 1536, 4);
+    std::vector<std::vector<float>> vectors = {
+        std::vector<float>(m.row(0), m.row(0) + m.cols),
+        {},
+        {0.6f, 0.8f},
+    };
+    reduceDimensions(vectors, 256);
+    EXPECT_EQ(vectors[0].size(), 256u);
+    EXPECT_TRUE(vectors[1].empty());
+    EXPECT_EQ(vectors[2], (std::vector<float>{0.6f, 0.8f}));
+
+    std::vector<std::vector<float>> unchanged = {std::vector<float>(m.row(1), m.row(1) + m.cols)};
+    reduceDimensions(unchanged, 0);
+    EXPECT_EQ(unchanged[0].size(), 1536u);
+}
+
+TEST(ProjectionTest, PrincipalComponentsRecoverDominantAxes) {
+    // Variance 25 along one direction, 4 along another, small noise elsewhere
+    std::mt19937 rng(3);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    EmbeddingMatrix m(400, 64);
+    std::vector<float> first(400), second(400);
+    for (size_t i = 0; i < 400; i++) {
+        first[i] = 5.0f * gauss(rng);
+        second[i] = 2.0f * gauss(rng);
+        for (size_t j = 0; j < 64; j++) m.row(i)[j] = 0.05f * gauss(rng) + 1.0f;
+        m.row(i)[3] += first[i];
+        m.row(i)[17] += second[i];
+    }
+
+    EmbeddingMatrix pcs = principalComponents(m, 2);
+    ASSERT_EQ(pcs.rows, 400u);
+    ASSERT_EQ(pcs.cols, 2u);
+
+    auto correlation = [&](size_t column, const std::vector<float>& truth) {
+        double xy = 0.0, xx = 0.0, yy = 0.0;
+        for (size_t i = 0; i < 400; i++) {
+            xy += pcs.row(i)[column] * truth[i];
+            xx += pcs.row(i)[column] * pcs.row(i)[column];
+            yy += truth[i] * truth[i];
+        }
+        return std::abs(xy) / std::sqrt(xx * yy);
+    };
+    EXPECT_GT(correlation(0, first), 0.99);
+    EXPECT_GT(correlation(1, second), 0.99);
+}
+
+TEST(ProjectionTest, PrincipalComponentsAreDeterministic) {
+    EmbeddingMatrix m = randomUnitMatrix(50, 32, 9);
+    EmbeddingMatrix a = principalComponents(m, 2);
+    EmbeddingMatrix b = principalComponents(m, 2);
+    EXPECT_EQ(a.data, b.data);
+    EXPECT_EQ(principalComponents(EmbeddingMatrix(), 2).rows, 0u);
+}
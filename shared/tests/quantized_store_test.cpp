@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "quantized_store.hpp"
+
+namespace {
+
+EmbeddingMatrix randomUnitMatrix(size_t rows, size_t cols, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    EmbeddingMatrix m(rows, cols);
+    for (float& v : m.data) v = gauss(rng);
+    m.normalizeRows();
+    return m;
+}
+
+}
+
+TEST(QuantizedStoreTest, ParsesNames) {
+    EXPECT_EQ(parseQuantization("int8"), Quantization::Int8);
+    EXPECT_EQ(parseQuantization("fp16"), Quantization::Float16);
+    EXPECT_EQ(parseQuantization("none"), Quantization::Float32);
+    EXPECT_THROW(parseQuantization("int4"), std::invalid_argument);
+    EXPECT_EQ(quantizationName(Quantization::Int8), "int8");
+}
+
+TEST(QuantizedStoreTest, CodesUseAQuarterAndHalfOfFloatMemory) {
+    EmbeddingMatrix m = randomUnitMatrix(100, 1536, 1);
+    size_t float_bytes = m.data.size() * sizeof(float);
+
+    QuantizedStore int8_store(m, Quantization::Int8);
+    QuantizedStore half_store(m, Quantization::Float16);
+    EXPECT_EQ(int8_store.bytes(), float_bytes / 4 + 100 * sizeof(float));
+    EXPECT_EQ(half_store.bytes(), float_bytes / 2);
+    EXPECT_EQ(QuantizedStore(m, Quantization::Float32).bytes(), 0u);
+}
+
+TEST(QuantizedStoreTest, SimilaritiesStayCloseToExact) {
+    EmbeddingMatrix m = randomUnitMatrix(50, 1536, 2);
+    QuantizedStore int8_store(m, Quantization::Int8);
+    QuantizedStore half_store(m, Quantization::Float16);
+
+    for (size_t i = 0; i < m.rows; i++) {
+        for (size_t j = 0; j < m.rows; j++) {
+            float exact = int8_store.exactSimilarity(i, j);
+            EXPECT_NEAR(int8_store.similarity(i, j), exact, 0.01f);
+            EXPECT_NEAR(half_store.similarity(i, j), exact, 0.001f);
+        }
+    }
+}
+
+TEST(QuantizedStoreTest, EncodedQueriesMatchStoredRows) {
+    EmbeddingMatrix m = randomUnitMatrix(20, 64, 3);
+    QuantizedStore store(m, Quantization::Int8);
+    QuantizedStore::Query query = store.encode(std::span<const float>(m.row(4), m.cols));
+    for (size_t j = 0; j < m.rows; j++) {
+        EXPECT_FLOAT_EQ(store.similarity(query, j), store.similarity(4, j));
+    }
+
+    std::vector<float> many(m.rows);
+    store.similarityMany(4, 0, m.rows, many.data());
+    for (size_t j = 0; j < m.rows; j++) {
+        EXPECT_FLOAT_EQ(many[j], store.similarity(4, j));
+    }
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "stage_executor.hpp"
+
+using namespace std::chrono_literals;
+
+TEST(StageExecutorTest, RunsStagesAfterTheirDependencies) {
+    StageExecutor executor;
+    std::vector<int> order;
+    std::mutex lock;
+    auto record = [&](int id) {
+        std::lock_guard<std::mutex> guard(lock);
+        order.push_back(id);
+    };
+    auto a = executor.add("a", [&] { record(0); });
+    auto b = executor.add("b", [&] { record(1); }, {a});
+    auto c = executor.add("c", [&] { record(2); }, {a});
+    executor.add("d", [&] { record(3); }, {b, c});
+    executor.run();
+
+    ASSERT_EQ(order.size(), 4u);
+    EXPECT_EQ(order.front(), 0);
+    EXPECT_EQ(order.back(), 3);
+}
+
+TEST(StageExecutorTest, IndependentStagesOverlap) {
+    StageExecutor executor;
+    std::atomic<int> running{0};
+    std::atomic<int> peak{0};
+    auto body = [&] {
+        int now = ++running;
+        int seen = peak.load();
+        while (now > seen && !peak.compare_exchange_weak(seen, now)) {}
+        std::this_thread::sleep_for(50ms);
+        running--;
+    };
+    executor.add("network", body);
+    executor.add("cpu", body);
+    executor.run();
+    EXPECT_EQ(peak.load(), 2);
+
+    const auto& timings = executor.timings();
+    ASSERT_EQ(timings.size(), 2u);
+    EXPECT_EQ(timings[0].name, "network");
+    EXPECT_TRUE(timings[0].ran && timings[1].ran);
+    EXPECT_LT(timings[0].start, timings[1].end);
+    EXPECT_LT(timings[1].start, timings[0].end);
+}
+
+TEST(StageExecutorTest, FailureSkipsDependentsAndRethrows) {
+    StageExecutor executor;
+    bool dependent_ran = false;
+    bool sibling_ran = false;
+    auto fail = executor.add("fail", [] { throw std::runtime_error("boom"); });
+    executor.add("after", [&] { dependent_ran = true; }, {fail});
+    executor.add("sibling", [&] { sibling_ran = true; });
+
+    EXPECT_THROW(executor.run(), std::runtime_error);
+    EXPECT_FALSE(dependent_ran);
+    EXPECT_TRUE(sibling_ran);
+    EXPECT_FALSE(executor.timings()[1].ran);
+}
+
+TEST(StageExecutorTest, RejectsDependenciesNotYetAdded) {
+    StageExecutor executor;
+    EXPECT_THROW(executor.add("early", [] {}, {3}), std::invalid_argument);
+}
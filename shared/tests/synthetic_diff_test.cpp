@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include "diffreader.hpp"
+#include "../../benchmarks/synthetic_diff.hpp"
+
+static std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line);) lines.push_back(line);
+    return lines;
+}
+
+TEST(SyntheticDiffTest, SameSeedSameDiff) {
+    SyntheticDiffOptions options;
+    options.lines = 5000;
+    std::string first = syntheticDiff(options);
+    EXPECT_EQ(first, syntheticDiff(options));
+    options.seed = 2;
+    EXPECT_NE(first, syntheticDiff(options));
+}
+
+TEST(SyntheticDiffTest, HonorsRequestedSize) {
+    SyntheticDiffOptions options;
+    options.lines = 20000;
+    size_t lines = splitLines(syntheticDiff(options)).size();
+    EXPECT_GE(lines, 20000u);
+    // Only the last file may run past the budget, and a whole new or
+    // deleted file is at most a couple hundred lines
+    EXPECT_LT(lines, 20500u);
+}
+
+TEST(SyntheticDiffTest, HunkHeadersMatchTheirLines) {
+    SyntheticDiffOptions options;
+    options.lines = 20000;
+    std::vector<std::string> lines = splitLines(syntheticDiff(options));
+    std::regex hunk_header(R"(^@@ -(\d+),(\d+) \+(\d+),(\d+) @@)");
+    size_t hunks = 0;
+    for (size_t i = 0; i < lines.size(); i++) {
+        std::smatch match;
+        if (!std::regex_search(lines[i], match, hunk_header)) continue;
+        hunks++;
+        int old_count = std::stoi(match[2]);
+        int new_count = std::stoi(match[4]);
+        size_t j = i + 1;
+        for (; j < lines.size() && (old_count > 0 || new_count > 0); j++) {
+            char marker = lines[j].empty() ? ' ' : lines[j][0];
+            ASSERT_TRUE(marker == ' ' || marker == '+' || marker == '-') << lines[j];
+            if (marker != '+') old_count--;
+            if (marker != '-') new_count--;
+        }
+        EXPECT_EQ(old_count, 0) << lines[i];
+        EXPECT_EQ(new_count, 0) << lines[i];
+        if (j < lines.size()) {
+            EXPECT_TRUE(lines[j].starts_with("@@") || lines[j].starts_with("diff --git")) << lines[j];
+        }
+    }
+    EXPECT_GT(hunks, 100u);
+}
+
+TEST(SyntheticDiffTest, CoversEveryKindOfFileChange) {
+    SyntheticDiffOptions options;
+    options.lines = 50000;
+    options.max_hunks_per_file = 20;
+    std::string diff = syntheticDiff(options);
+    EXPECT_NE(diff.find("new file mode"), std::string::npos);
+    EXPECT_NE(diff.find("deleted file mode"), std::string::npos);
+    EXPECT_NE(diff.find("similarity index 100%"), std::string::npos);
+    EXPECT_NE(diff.find("rename to"), std::string::npos);
+    EXPECT_NE(diff.find("Binary files"), std::string::npos);
+
+    std::set<std::string> extensions;
+    for (const std::string& line : splitLines(diff)) {
+        if (!line.starts_with("+++ b/")) continue;
+        extensions.insert(line.substr(line.rfind('.')));
+    }
+    EXPECT_EQ(extensions, (std::set<std::string>{".py", ".cpp", ".go", ".js", ".java", ".rs", ".md"}));
+}
+
+TEST(SyntheticDiffTest, ManyHunksPerFile) {
+    SyntheticDiffOptions options;
+    options.lines = 100000;
+    options.languages = {"cpp"};
+    options.new_files = options.deleted_files = options.renames = options.binary_files = 0.0;
+    std::istringstream in(syntheticDiff(options));
+    DiffReader reader(in);
+    reader.ingestDiff();
+
+    std::map<std::string, size_t> hunks_per_file;
+    for (const DiffChunk& chunk : reader.getChunks()) hunks_per_file[chunk.filepath]++;
+    size_t most = 0;
+    for (const auto& [path, count] : hunks_per_file) most = std::max(most, count);
+    EXPECT_GT(most, 500u);
+}
+
+TEST(SyntheticDiffTest, DiffReaderParsesEveryFile) {
+    SyntheticDiffOptions options;
+    options.lines = 20000;
+    std::string diff = syntheticDiff(options);
+    std::istringstream in(diff);
+    DiffReader reader(in);
+    reader.ingestDiff();
+    std::vector<DiffChunk> chunks = reader.getChunks();
+
+    size_t hunk_headers = 0;
+    std::set<std::string> text_files;
+    for (const std::string& line : splitLines(diff)) {
+        if (line.starts_with("@@")) hunk_headers++;
+        if (line.starts_with("diff --git") && line.find("assets/") == std::string::npos) {
+            text_files.insert(line.substr(line.rfind(" b/") + 3));
+        }
+    }
+    std::set<std::string> parsed_files;
+    size_t content_chunks = 0;
+    for (const DiffChunk& chunk : chunks) {
+        parsed_files.insert(chunk.filepath);
+        if (!chunk.is_rename && !chunk.lines.empty()) content_chunks++;
+    }
+    EXPECT_EQ(content_chunks, hunk_headers);
+    for (const std::string& file : text_files) EXPECT_TRUE(parsed_files.count(file)) << file;
+}
+
+TEST(SyntheticDiffTest, UnknownLanguageThrows) {
+    SyntheticDiffOptions options;
+    options.languages = {"cobol"};
+    EXPECT_THROW(syntheticDiff(options), std::invalid_argument);
+    options.languages.clear();
+    EXPECT_THROW(syntheticDiff(options), std::invalid_argument);
+}
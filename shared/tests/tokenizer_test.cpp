@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include "tokenizer.hpp"
+
+TEST(TokenizerTest, EmptyStringHasNoTokens) {
+    EXPECT_EQ(countTokens(""), 0u);
+}
+
+TEST(TokenizerTest, CommonWordsAreSingleTokens) {
+    // cl100k: "hello", " world"
+    EXPECT_EQ(countTokens("hello world"), 2u);
+    // cl100k: "I", "'m", " here"
+    EXPECT_EQ(countTokens("I'm here"), 3u);
+}
+
+TEST(TokenizerTest, NumbersSplitIntoThreeDigitGroups) {
+    EXPECT_EQ(countTokens("123"), 1u);
+    EXPECT_EQ(countTokens("1234567"), 3u);
+}
+
+TEST(TokenizerTest, CamelCaseIdentifiersSplit) {
+    EXPECT_GE(countTokens("calculateDiffLinesSize"), 4u);
+    EXPECT_GT(countTokens("calculateDiffLinesSize"), countTokens("calculate"));
+}
+
+TEST(TokenizerTest, NeverUnderestimatesBytesPerToken) {
+    // Real cl100k averages ~3-4 bytes per token on source code; the estimate
+    // should land at or above that density so budgets stay safe
+    std::string code = "int main(int argc, char *argv[]) {\n    return 0;\n}\n";
+    size_t tokens = countTokens(code);
+    EXPECT_GE(tokens, code.size() / 4);
+    EXPECT_LE(tokens, code.size());
+}
+
+TEST(TokenizerTest, TruncateRespectsBudget) {
+    std::string text;
+    for (int i = 0; i < 200; i++) {
+        text += "word" + std::to_string(i) + " ";
+    }
+
+    std::string truncated = truncateToTokens(text, 50);
+    EXPECT_LE(countTokens(truncated), 50u);
+    EXPECT_LT(truncated.size(), text.size());
+    EXPECT_EQ(text.compare(0, truncated.size(), truncated), 0);
+}
+
+TEST(TokenizerTest, TruncateKeepsShortText) {
+    std::string text = "short text";
+    EXPECT_EQ(truncateToTokens(text, 100), text);
+}
+
+TEST(TokenizerTest, HighEntropyTextIsChargedDensely) {
+    // cl100k has no long merges for hashes, base64 or minified names and
+    // splits them every 2-3 characters
+    std::string hex = "3f786850e387550fdab836ed7e6dc881de23001bcafebabedeadbeef";
+    std::string base64 = "QmFzZTY0IGVuY29kZWQgYmxvYiBvZiBzb21lIGJpbmFyeSBkYXRh";
+    std::string consonants = "xkqzjvbwrtplmnghdfcsxkqzjvbwrtplmnghdfcs";
+    EXPECT_GE(countTokens(hex), hex.size() / 3);
+    EXPECT_GE(countTokens(base64), base64.size() / 3);
+    EXPECT_GE(countTokens(consonants), consonants.size() / 2);
+    // Ordinary words keep their cheaper estimate
+    EXPECT_LE(countTokens("internationalization"), 4u);
+}
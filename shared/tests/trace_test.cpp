@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "trace.hpp"
+
+using json = nlohmann::json;
+using namespace std::chrono_literals;
+
+namespace {
+
+json writeAndRead() {
+    std::string path = testing::TempDir() + "trace_test.json";
+    EXPECT_TRUE(writeTrace(path));
+    std::ifstream file(path);
+    json trace = json::parse(file);
+    std::remove(path.c_str());
+    return trace;
+}
+
+} // namespace
+
+TEST(TraceTest, RecordsNothingUntilEnabled) {
+    trace_enabled = false;
+    clearTrace();
+    {
+        TraceSpan span("ignored");
+        traceCounter("ignored", 1.0);
+    }
+    EXPECT_TRUE(writeAndRead()["traceEvents"].empty());
+}
+
+TEST(TraceTest, SpanBecomesCompleteEvent) {
+    enableTracing();
+    clearTrace();
+    {
+        TraceSpan span("ingest", "parse", "src/\"quoted\".cpp");
+        std::this_thread::sleep_for(2ms);
+    }
+    json events = writeAndRead()["traceEvents"];
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0]["name"], "ingest");
+    EXPECT_EQ(events[0]["cat"], "parse");
+    EXPECT_EQ(events[0]["ph"], "X");
+    EXPECT_GE(events[0]["dur"].get<double>(), 2000.0);
+    EXPECT_EQ(events[0]["args"]["detail"], "src/\"quoted\".cpp");
+}
+
+TEST(TraceTest, AsyncSpansAndCounters) {
+    enableTracing();
+    clearTrace();
+    auto start = TraceClock::now();
+    traceAsync("connect", "https", 7, start, start + 3ms);
+    traceCounter("https in flight", 2);
+    json events = writeAndRead()["traceEvents"];
+    ASSERT_EQ(events.size(), 3u);
+    EXPECT_EQ(events[0]["ph"], "b");
+    EXPECT_EQ(events[1]["ph"], "e");
+    EXPECT_EQ(events[0]["id"], events[1]["id"]);
+    EXPECT_NEAR(events[1]["ts"].get<double>() - events[0]["ts"].get<double>(), 3000.0, 1.0);
+    EXPECT_EQ(events[2]["ph"], "C");
+    EXPECT_EQ(events[2]["args"]["https in flight"], 2);
+}
+
+TEST(TraceTest, ThreadsGetSeparateTracks) {
+    enableTracing();
+    clearTrace();
+    auto work = [] { TraceSpan span("work"); };
+    std::thread a(work);
+    std::thread b(work);
+    a.join();
+    b.join();
+    json events = writeAndRead()["traceEvents"];
+    ASSERT_EQ(events.size(), 2u);
+    std::set<int> tids;
+    for (const json& event : events) tids.insert(event["tid"].get<int>());
+    EXPECT_EQ(tids.size(), 2u);
+}
+
+TEST(TraceTest, EventsOutliveTheirThread) {
+    enableTracing();
+    clearTrace();
+    for (int i = 0; i < 100; i++) {
+        std::thread([] { TraceSpan span("short-lived"); }).join();
+    }
+    json events = writeAndRead()["traceEvents"];
+    ASSERT_EQ(events.size(), 100u);
+    std::set<int> tids;
+    for (const json& event : events) tids.insert(event["tid"].get<int>());
+    EXPECT_EQ(tids.size(), 100u);
+
+    clearTrace();
+    EXPECT_TRUE(writeAndRead()["traceEvents"].empty());
+}
@@ -0,0 +1,207 @@
+#include "tokenizer.hpp"
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+namespace {
+
+bool isNewline(unsigned char c) {
+  return c == '\n' || c == '\r';
+}
+
+bool isSpace(unsigned char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool isDigit(unsigned char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Non-ASCII bytes are treated as letters, matching \p{L} for the scripts
+// that show up in source code and commit text.
+bool isLetter(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+bool isUpper(unsigned char c) {
+  return c >= 'A' && c <= 'Z';
+}
+
+bool isPunct(unsigned char c) {
+  return !isSpace(c) && !isLetter(c) && !isDigit(c);
+}
+
+size_t contractionLength(string_view text, size_t pos) {
+  static const char* suffixes[] = {"s", "t", "re", "ve", "m", "ll", "d"};
+  if (text[pos] != '\'') return 0;
+  for (const char* suffix : suffixes) {
+    size_t len = char_traits<char>::length(suffix);
+    if (pos + 1 + len > text.size()) continue;
+    bool match = true;
+    for (size_t k = 0; k < len; k++) {
+      if (tolower(static_cast<unsigned char>(text[pos + 1 + k])) != suffix[k]) {
+        match = false;
+        break;
+      }
+    }
+    if (match) return len + 1;
+  }
+  return 0;
+}
+
+bool isVowel(unsigned char c) {
+  c = static_cast<unsigned char>(tolower(c));
+  return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u' || c == 'y';
+}
+
+// Words and identifiers mix vowels in regularly; hex, base64 and minified
+// names don't, and cl100k has no long merges for them
+bool looksLikeWord(string_view segment) {
+  if (segment.size() <= 4) return true;
+  size_t vowels = 0;
+  size_t consonantRun = 0;
+  for (unsigned char c : segment) {
+    if (isVowel(c)) {
+      vowels++;
+      consonantRun = 0;
+    } else if (++consonantRun > 4) {
+      return false;
+    }
+  }
+  return vowels * 5 >= segment.size();
+}
+
+// Cost of an ASCII word segment. Common words and short identifiers are a
+// single cl100k token; longer runs split roughly every six characters and
+// all-caps runs split more aggressively. Anything that doesn't read like a
+// word is charged a token per two characters, the densest cl100k gets on
+// random letters.
+size_t asciiWordCost(string_view segment, bool allUpper) {
+  size_t len = segment.size();
+  if (len == 0) return 0;
+  if (!looksLikeWord(segment)) return (len + 1) / 2;
+  if (allUpper) return max<size_t>(1, (len + 2) / 3);
+  return max<size_t>(1, (len + 5) / 6);
+}
+
+size_t letterRunCost(string_view run) {
+  size_t cost = 0;
+  size_t segStart = 0;
+  bool segUpper = true;
+  size_t i = 0;
+
+  auto flush = [&](size_t end) {
+    cost += asciiWordCost(run.substr(segStart, end - segStart), segUpper && end - segStart > 1);
+  };
+
+  while (i < run.size()) {
+    unsigned char c = run[i];
+    if (c >= 0x80) {
+      flush(i);
+      size_t width = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : 2;
+      cost += width - 1;
+      i = min(run.size(), i + width);
+      segStart = i;
+      segUpper = true;
+      continue;
+    }
+    // camelCase boundary: lower followed by upper starts a new segment
+    if (i > segStart && isUpper(c) && !isUpper(static_cast<unsigned char>(run[i - 1]))) {
+      flush(i);
+      segStart = i;
+      segUpper = true;
+    }
+    if (!isUpper(c)) segUpper = false;
+    i++;
+  }
+  flush(run.size());
+  return cost;
+}
+
+// Scans one cl100k pre-tokenization piece starting at pos, returning its
+// end offset and writing its estimated token cost.
+size_t nextPiece(string_view text, size_t pos, size_t& cost) {
+  const size_t n = text.size();
+  unsigned char c = text[pos];
+
+  size_t contraction = contractionLength(text, pos);
+  if (contraction) {
+    cost = 1;
+    return pos + contraction;
+  }
+
+  // [^\r\n\p{L}\p{N}]?\p{L}+
+  size_t letterStart = pos;
+  if (!isLetter(c) && !isDigit(c) && !isNewline(c) && pos + 1 < n &&
+      isLetter(static_cast<unsigned char>(text[pos + 1]))) {
+    letterStart = pos + 1;
+  }
+  if (isLetter(static_cast<unsigned char>(text[letterStart]))) {
+    size_t end = letterStart;
+    while (end < n && isLetter(static_cast<unsigned char>(text[end]))) end++;
+    cost = letterRunCost(text.substr(letterStart, end - letterStart));
+    return end;
+  }
+
+  // \p{N}{1,3}
+  if (isDigit(c)) {
+    size_t end = pos;
+    while (end < n && end - pos < 3 && isDigit(static_cast<unsigned char>(text[end]))) end++;
+    cost = 1;
+    return end;
+  }
+
+  // ' ?[^\s\p{L}\p{N}]+[\r\n]*'
+  size_t punctStart = (c == ' ' && pos + 1 < n && isPunct(static_cast<unsigned char>(text[pos + 1]))) ? pos + 1 : pos;
+  if (isPunct(static_cast<unsigned char>(text[punctStart]))) {
+    size_t end = punctStart;
+    while (end < n && isPunct(static_cast<unsigned char>(text[end]))) end++;
+    cost = max<size_t>(1, (end - punctStart + 1) / 2);
+    while (end < n && isNewline(static_cast<unsigned char>(text[end]))) end++;
+    return end;
+  }
+
+  // Whitespace: '\s*[\r\n]+', then '\s+(?!\S)', then '\s+'
+  size_t end = pos;
+  size_t lastNewline = string_view::npos;
+  while (end < n && isSpace(static_cast<unsigned char>(text[end]))) {
+    if (isNewline(static_cast<unsigned char>(text[end]))) lastNewline = end;
+    end++;
+  }
+  if (lastNewline != string_view::npos) {
+    end = lastNewline + 1;
+  } else if (end < n && end - pos > 1) {
+    // Leave the last space to prefix the following word
+    end--;
+  }
+  cost = 1 + (end - pos) / 16;
+  return end;
+}
+
+} // namespace
+
+size_t countTokens(string_view text) {
+  size_t total = 0;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t cost = 0;
+    pos = nextPiece(text, pos, cost);
+    total += cost;
+  }
+  return total;
+}
+
+string truncateToTokens(const string& text, size_t maxTokens) {
+  string_view view(text);
+  size_t total = 0;
+  size_t pos = 0;
+  while (pos < view.size()) {
+    size_t cost = 0;
+    size_t end = nextPiece(view, pos, cost);
+    if (total + cost > maxTokens) break;
+    total += cost;
+    pos = end;
+  }
+  return text.substr(0, pos);
+}
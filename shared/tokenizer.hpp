@@ -0,0 +1,22 @@
+#ifndef TOKENIZER_HPP
+#define TOKENIZER_HPP
+
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Fast local estimate of cl100k_base token counts (the encoding used by
+// text-embedding-3-* and gpt-4o-mini). Text is split with the same
+// pre-tokenization rules as cl100k, then each piece is costed from its
+// shape instead of running the full BPE merge table. Estimates err on the
+// high side (random-looking letter runs are charged a token per two
+// characters), but they are still estimates: keep hard model limits a
+// margin above any budget computed from them.
+size_t countTokens(string_view text);
+
+// Returns the longest prefix of text (cut on a piece boundary) whose
+// estimated token count fits in maxTokens.
+string truncateToTokens(const string& text, size_t maxTokens);
+
+#endif // TOKENIZER_HPP
@@ -0,0 +1,199 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+atomic<bool> trace_enabled{false};
+
+namespace {
+
+struct TraceEvent {
+  string name;
+  const char* category;
+  char phase;  // 'X' complete, 'b'/'e' async begin/end, 'C' counter
+  double timestamp;  // microseconds since enableTracing()
+  double duration;
+  uint64_t id;
+  double value;
+  string detail;
+};
+
+// Each thread appends to its own buffer; the lock is only contended while
+// writeTrace() copies it out
+struct ThreadBuffer {
+  mutex lock;
+  uint32_t tid;
+  vector<TraceEvent> events;
+};
+
+// Events of threads that have exited, kept until written or cleared
+struct RetiredEvents {
+  uint32_t tid;
+  vector<TraceEvent> events;
+};
+
+mutex registry_lock;
+vector<shared_ptr<ThreadBuffer>> buffers;  // threads still running
+vector<RetiredEvents> retired;
+uint32_t next_tid = 1;
+// TraceClock::time_point of enableTracing() as a tick count, so enabling
+// doesn't race threads still timestamping events
+atomic<TraceClock::rep> origin{TraceClock::now().time_since_epoch().count()};
+
+// Registers the thread's buffer on first use. When the thread exits its
+// events move to retired and the buffer is dropped, so short-lived threads
+// don't leave one behind each.
+struct BufferOwner {
+  shared_ptr<ThreadBuffer> buffer;
+
+  ~BufferOwner() {
+    if (!buffer) return;
+    lock_guard<mutex> guard(registry_lock);
+    {
+      lock_guard<mutex> buffer_guard(buffer->lock);
+      if (!buffer->events.empty()) retired.push_back({buffer->tid, std::move(buffer->events)});
+    }
+    buffers.erase(find(buffers.begin(), buffers.end(), buffer));
+  }
+};
+
+ThreadBuffer& threadBuffer() {
+  thread_local BufferOwner owner;
+  if (!owner.buffer) {
+    owner.buffer = make_shared<ThreadBuffer>();
+    lock_guard<mutex> guard(registry_lock);
+    owner.buffer->tid = next_tid++;
+    buffers.push_back(owner.buffer);
+  }
+  return *owner.buffer;
+}
+
+double micros(TraceClock::time_point t) {
+  TraceClock::time_point start{TraceClock::duration(origin.load(memory_order_relaxed))};
+  return chrono::duration<double, micro>(t - start).count();
+}
+
+void record(TraceEvent event) {
+  ThreadBuffer& buffer = threadBuffer();
+  lock_guard<mutex> guard(buffer.lock);
+  buffer.events.push_back(std::move(event));
+}
+
+void appendEscaped(string& out, const string& text) {
+  out += '"';
+  for (char c : text) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out += escaped;
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+void appendEvent(string& out, const TraceEvent& event, uint32_t tid) {
+  char number[64];
+  out += "{\"name\":";
+  appendEscaped(out, event.name);
+  out += ",\"cat\":";
+  appendEscaped(out, event.category);
+  out += ",\"ph\":\"";
+  out += event.phase;
+  snprintf(number, sizeof(number), "\",\"ts\":%.3f,\"pid\":1,\"tid\":%u", event.timestamp, tid);
+  out += number;
+  if (event.phase == 'X') {
+    snprintf(number, sizeof(number), ",\"dur\":%.3f", event.duration);
+    out += number;
+  }
+  if (event.phase == 'b' || event.phase == 'e') {
+    snprintf(number, sizeof(number), ",\"id\":\"0x%llx\"", static_cast<unsigned long long>(event.id));
+    out += number;
+  }
+  if (event.phase == 'C') {
+    out += ",\"args\":{";
+    appendEscaped(out, event.name);
+    snprintf(number, sizeof(number), ":%.17g}", event.value);
+    out += number;
+  } else if (!event.detail.empty()) {
+    out += ",\"args\":{\"detail\":";
+    appendEscaped(out, event.detail);
+    out += '}';
+  }
+  out += '}';
+}
+
+} // namespace
+
+void enableTracing() {
+  origin.store(TraceClock::now().time_since_epoch().count(), memory_order_relaxed);
+  trace_enabled.store(true);
+}
+
+void traceComplete(const string& name, const char* category, TraceClock::time_point start,
+                   TraceClock::time_point end, const string& detail) {
+  if (!tracingEnabled()) return;
+  record({name, category, 'X', micros(start), chrono::duration<double, micro>(end - start).count(), 0, 0.0, detail});
+}
+
+void traceAsync(const string& name, const char* category, uint64_t id, TraceClock::time_point start,
+                TraceClock::time_point end, const string& detail) {
+  if (!tracingEnabled()) return;
+  record({name, category, 'b', micros(start), 0.0, id, 0.0, detail});
+  record({name, category, 'e', micros(end), 0.0, id, 0.0, ""});
+}
+
+void traceCounter(const char* name, double value) {
+  if (!tracingEnabled()) return;
+  record({name, "counter", 'C', micros(TraceClock::now()), 0.0, 0, value, ""});
+}
+
+bool writeTrace(const string& path) {
+  string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  {
+    lock_guard<mutex> guard(registry_lock);
+    for (const RetiredEvents& thread : retired) {
+      for (const TraceEvent& event : thread.events) {
+        if (!first) out += ",\n";
+        first = false;
+        appendEvent(out, event, thread.tid);
+      }
+    }
+    for (const shared_ptr<ThreadBuffer>& buffer : buffers) {
+      lock_guard<mutex> buffer_guard(buffer->lock);
+      for (const TraceEvent& event : buffer->events) {
+        if (!first) out += ",\n";
+        first = false;
+        appendEvent(out, event, buffer->tid);
+      }
+    }
+  }
+  out += "]}\n";
+
+  ofstream file(path, ios::binary | ios::trunc);
+  file << out;
+  return static_cast<bool>(file);
+}
+
+void clearTrace() {
+  lock_guard<mutex> guard(registry_lock);
+  retired.clear();
+  for (const shared_ptr<ThreadBuffer>& buffer : buffers) {
+    lock_guard<mutex> buffer_guard(buffer->lock);
+    buffer->events.clear();
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Chrome trace event recording, viewable in chrome://tracing or
+// ui.perfetto.dev. Nothing is recorded until enableTracing() is called, so
+// instrumented code pays one relaxed atomic load per span when it is off.
+// Events are buffered per thread and only serialized by writeTrace().
+
+using TraceClock = chrono::steady_clock;
+
+extern atomic<bool> trace_enabled;
+
+inline bool tracingEnabled() {
+  return trace_enabled.load(memory_order_relaxed);
+}
+
+void enableTracing();
+
+// A complete span on the calling thread's track. detail is shown as the
+// span's "detail" argument when non-empty.
+void traceComplete(const string& name, const char* category, TraceClock::time_point start,
+                   TraceClock::time_point end, const string& detail = "");
+
+// Work that isn't bound to one thread (an HTTPS request moving through the
+// event loop). Spans sharing an id are drawn on one async track.
+void traceAsync(const string& name, const char* category, uint64_t id, TraceClock::time_point start,
+                TraceClock::time_point end, const string& detail = "");
+
+void traceCounter(const char* name, double value);
+
+// Writes {"traceEvents": [...]} with every event recorded so far.
+// Returns false if the file can't be written.
+bool writeTrace(const string& path);
+
+// Drops recorded events; for tests and between runs of a daemon
+void clearTrace();
+
+// Records a span from construction to destruction
+class TraceSpan {
+private:
+  const char* name;
+  const char* category;
+  string detail;
+  TraceClock::time_point start;
+  bool active;
+
+public:
+  TraceSpan(const char* name, const char* category = "gcommit", string detail = "")
+      : name(name), category(category), active(tracingEnabled()) {
+    if (active) {
+      this->detail = std::move(detail);
+      start = TraceClock::now();
+    }
+  }
+  ~TraceSpan() {
+    if (active) traceComplete(name, category, start, TraceClock::now(), detail);
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+#endif // TRACE_HPP
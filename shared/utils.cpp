@@ -1,27 +1,77 @@
 #include "utils.hpp"
+#include "trace.hpp"
+#include <array>
+#include <cstring>
 
 using json = nlohmann::json;
 
-float cos_sim(vector<float> a, vector<float> b) {
-  float dot = 0.0;
-  for (size_t i = 0; i < a.size(); i++) {
-    dot += a[i] * b[i];
-  }
-  //assuming vectors are normalized
-  return dot; 
+namespace {
+
+// Decodes base64 little-endian float32 data, as returned with encoding_format=base64
+vector<float> decode_base64_floats(const string& encoded) {
+    static const auto table = [] {
+        array<int8_t, 256> t;
+        t.fill(-1);
+        const string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (size_t i = 0; i < alphabet.size(); i++) {
+            t[static_cast<unsigned char>(alphabet[i])] = static_cast<int8_t>(i);
+        }
+        return t;
+    }();
+
+    string bytes;
+    bytes.reserve(encoded.size() / 4 * 3);
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char c : encoded) {
+        int8_t value = table[static_cast<unsigned char>(c)];
+        if (value < 0) continue;  // padding and whitespace
+        buffer = (buffer << 6) | static_cast<uint32_t>(value);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            bytes.push_back(static_cast<char>((buffer >> bits) & 0xff));
+        }
+    }
+
+    vector<float> values(bytes.size() / sizeof(float));
+    memcpy(values.data(), bytes.data(), values.size() * sizeof(float));
+    return values;
 }
 
+} // namespace
+
 vector<float> parse_embedding(const string& response) {
+    TraceSpan trace("parse embedding", "json");
     try {
         json j = json::parse(response);
         vector<float> embedding = j["data"][0]["embedding"].get<vector<float>>();
         return embedding;
     } catch (json::exception& e) {
-        cout << "JSON parsing error with response: " << response << endl;
+        cerr << "JSON parsing error with response: " << response << endl;
         return vector<float>();
     }
 }
 
+vector<vector<float>> parse_embeddings(const string& response, size_t expected) {
+    TraceSpan trace("parse embeddings", "json", to_string(expected) + " inputs");
+    vector<vector<float>> embeddings(expected);
+    try {
+        json j = json::parse(response);
+        for (const json& item : j["data"]) {
+            size_t index = item["index"].get<size_t>();
+            if (index < expected) {
+                const json& embedding = item["embedding"];
+                embeddings[index] = embedding.is_string() ? decode_base64_floats(embedding.get<string>())
+                                                          : embedding.get<vector<float>>();
+            }
+        }
+    } catch (json::exception& e) {
+        cerr << "JSON parsing error with response: " << response << endl;
+    }
+    return embeddings;
+}
+
 string generate_commit_message(OpenAIAPI& chat_api, const string& code_changes) {
     // TODO: This function is currently non-functional since post_chat is commented out
     // It uses the chat API which requires a different endpoint than embeddings
@@ -44,6 +94,7 @@ string generate_commit_message(OpenAIAPI& chat_api, const string& code_changes)
 }
 
 string parse_chat_response(const string& response) {
+    TraceSpan trace("parse chat response", "json");
     try {
         json j = json::parse(response);
         string message = j["choices"][0]["message"]["content"].get<string>();
@@ -56,13 +107,13 @@ string parse_chat_response(const string& response) {
 
         return message.substr(start, end - start + 1);
     } catch (json::exception& e) {
-        cout << "Chat JSON parsing error with response: " << response << endl;
+        cerr << "Chat JSON parsing error with response: " << response << endl;
         return "update code"; // fallback message
     }
 }
 
-future<string> async_generate_commit_message(AsyncOpenAIAPI& chat_api, const string& code_changes) {
-    json messages = {
+json commit_message_prompt(const string& code_changes) {
+    return {
         {
             {"role", "system"},
             {"content", "You are a git commit message generator. Analyze the code changes and generate a concise commit message that describes what was actually modified, added, or fixed in the code. Focus on the technical changes, not meta-commentary. Return only the commit message without quotes or explanations. Examples: 'add HTTP chunked encoding support', 'handle SSL connection errors', 'extract JSON parsing logic'."}
@@ -72,11 +123,21 @@ future<string> async_generate_commit_message(AsyncOpenAIAPI& chat_api, const str
             {"content", "Generate a commit message for these code changes:\n" + code_changes}
         }
     };
+}
 
-    future<HTTPSResponse> response_future = chat_api.async_chat(messages, 50, 0.3);
+future<string> async_generate_commit_message(AsyncOpenAIAPI& chat_api, const string& code_changes,
+                                             function<void()> on_ready) {
+    future<HTTPSResponse> response_future = chat_api.async_chat(commit_message_prompt(code_changes), 50, 0.3);
 
-    return std::async(std::launch::deferred, [](future<HTTPSResponse> resp_fut) {
+    // Parsed on its own thread as soon as the event loop delivers the
+    // response, so wait_for on the returned future reports it ready
+    return std::async(std::launch::async, [on_ready = std::move(on_ready)](future<HTTPSResponse> resp_fut) {
+        // Fires whether the request succeeded or threw
+        struct NotifyOnExit {
+            const function<void()>& notify;
+            ~NotifyOnExit() { if (notify) notify(); }
+        } notify_on_exit{on_ready};
         HTTPSResponse response = resp_fut.get();
         return parse_chat_response(response.body);
     }, std::move(response_future));
-}
\ No newline at end of file
+}
@@ -3,15 +3,22 @@
 
 #include <vector>
 #include <string>
+#include <functional>
 #include <future>
 #include <nlohmann/json.hpp>
 #include "openai_api.hpp"
 #include "async_openai_api.hpp"
 using namespace std;
 
-float cos_sim(vector<float> a, vector<float> b);
 string generate_commit_message(OpenAIAPI& chat_api, const string& code_changes);
-future<string> async_generate_commit_message(AsyncOpenAIAPI& chat_api, const string& code_changes);
+// System and user messages asking the chat API for a commit message
+nlohmann::json commit_message_prompt(const string& code_changes);
+// Ready once the response has arrived and been parsed; rethrows request errors.
+// on_ready, if given, runs on a worker thread as the request finishes either
+// way, just before the future becomes ready.
+future<string> async_generate_commit_message(AsyncOpenAIAPI& chat_api, const string& code_changes,
+                                             function<void()> on_ready = nullptr);
 string parse_chat_response(const string& response);
 vector<float> parse_embedding(const string& response);
+vector<vector<float>> parse_embeddings(const string& response, size_t expected);
 #endif // UTILS_HPP
\ No newline at end of file